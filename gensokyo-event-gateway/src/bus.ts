@@ -0,0 +1,381 @@
+import net from "node:net";
+import tls from "node:tls";
+
+// --------------------------------------------
+// Minimal RESP2 client (only what the bus needs; no external dependency)
+// --------------------------------------------
+
+type RespValue = string | number | null | RespValue[] | Error;
+
+function encodeCommand(args: (string | number)[]): Buffer {
+  const parts: Buffer[] = [Buffer.from(`*${args.length}\r\n`)];
+  for (const a of args) {
+    const b = Buffer.from(String(a));
+    parts.push(Buffer.from(`$${b.length}\r\n`), b, Buffer.from("\r\n"));
+  }
+  return Buffer.concat(parts);
+}
+
+// Returns [value, nextOffset] or null when buf does not hold a complete reply yet.
+function parseResp(buf: Buffer, off: number): [RespValue, number] | null {
+  if (off >= buf.length) return null;
+  const eol = buf.indexOf("\r\n", off);
+  if (eol < 0) return null;
+  const kind = String.fromCharCode(buf[off]);
+  const line = buf.toString("utf8", off + 1, eol);
+  const next = eol + 2;
+  switch (kind) {
+    case "+":
+      return [line, next];
+    case "-":
+      return [new Error(line), next];
+    case ":":
+      return [Number(line), next];
+    case "$": {
+      const len = Number(line);
+      if (len < 0) return [null, next];
+      if (buf.length < next + len + 2) return null;
+      return [buf.toString("utf8", next, next + len), next + len + 2];
+    }
+    case "*": {
+      const count = Number(line);
+      if (count < 0) return [null, next];
+      const out: RespValue[] = [];
+      let p = next;
+      for (let i = 0; i < count; i++) {
+        const r = parseResp(buf, p);
+        if (!r) return null;
+        out.push(r[0]);
+        p = r[1];
+      }
+      return [out, p];
+    }
+    default:
+      throw new Error(`[event-gateway] bad RESP type: ${kind}`);
+  }
+}
+
+class RespConnection {
+  private socket: net.Socket | null = null;
+  private buf: Buffer = Buffer.alloc(0);
+  private pending: { resolve: (v: RespValue) => void; reject: (e: Error) => void }[] = [];
+  onPush: ((msg: RespValue[]) => void) | null = null;
+  onClose: (() => void) | null = null;
+  // Subscriber connections get pub/sub pushes instead of ordinary replies.
+  subscriber = false;
+
+  constructor(private readonly url: URL) {}
+
+  async connect(): Promise<void> {
+    const port = Number(this.url.port || 6379);
+    const host = this.url.hostname || "127.0.0.1";
+    const socket: net.Socket = await new Promise((resolve, reject) => {
+      const s =
+        this.url.protocol === "rediss:"
+          ? tls.connect({ host, port, servername: host }, () => resolve(s))
+          : net.connect({ host, port }, () => resolve(s));
+      s.once("error", reject);
+    });
+    socket.setNoDelay(true);
+    socket.setKeepAlive(true, 10_000);
+    socket.on("data", (chunk) => this.onData(chunk));
+    socket.on("error", () => {
+      // "close" follows
+    });
+    socket.on("close", () => {
+      this.socket = null;
+      const err = new Error("[event-gateway] redis connection closed");
+      for (const p of this.pending.splice(0)) p.reject(err);
+      this.onClose?.();
+    });
+    this.socket = socket;
+
+    const user = decodeURIComponent(this.url.username || "");
+    const pass = decodeURIComponent(this.url.password || "");
+    if (pass) await this.command(user ? ["AUTH", user, pass] : ["AUTH", pass]);
+    const db = Number(this.url.pathname.replace(/^\//, "") || 0);
+    if (db > 0) await this.command(["SELECT", db]);
+  }
+
+  get connected(): boolean {
+    return this.socket !== null;
+  }
+
+  command(args: (string | number)[]): Promise<RespValue> {
+    const s = this.socket;
+    if (!s) return Promise.reject(new Error("[event-gateway] redis not connected"));
+    return new Promise((resolve, reject) => {
+      this.pending.push({ resolve, reject });
+      s.write(encodeCommand(args));
+    });
+  }
+
+  // Fire-and-forget (SUBSCRIBE/UNSUBSCRIBE on a subscriber connection; acks arrive as pushes).
+  write(args: (string | number)[]) {
+    this.socket?.write(encodeCommand(args));
+  }
+
+  close() {
+    this.onClose = null;
+    this.socket?.destroy();
+    this.socket = null;
+  }
+
+  private onData(chunk: Buffer) {
+    this.buf = this.buf.length ? Buffer.concat([this.buf, chunk]) : chunk;
+    let off = 0;
+    for (;;) {
+      let r: [RespValue, number] | null;
+      try {
+        r = parseResp(this.buf, off);
+      } catch (e) {
+        // Out of sync with the stream: nothing after this point can be trusted.
+        // Drop the buffer and the socket; "close" rejects pending commands and the owner reconnects.
+        console.warn("[event-gateway] redis protocol error; reconnecting:", e);
+        this.buf = Buffer.alloc(0);
+        this.socket?.destroy();
+        return;
+      }
+      if (!r) break;
+      off = r[1];
+      const v = r[0];
+      const head = Array.isArray(v) && typeof v[0] === "string" ? v[0] : "";
+      if (this.subscriber && (head === "message" || head === "subscribe" || head === "unsubscribe")) {
+        this.onPush?.(v as RespValue[]);
+        continue;
+      }
+      const p = this.pending.shift();
+      if (!p) continue;
+      if (v instanceof Error) p.reject(v);
+      else p.resolve(v);
+    }
+    this.buf = off >= this.buf.length ? Buffer.alloc(0) : this.buf.subarray(off);
+  }
+}
+
+// --------------------------------------------
+// Fan-out bus (Redis pub/sub) + relay leader election
+// --------------------------------------------
+
+export type BusConfig = {
+  url: string;
+  prefix: string;
+  instanceId: string;
+  leaderTtlMs: number;
+};
+
+const RENEW_LUA = `if redis.call("get", KEYS[1]) == ARGV[1] then return redis.call("pexpire", KEYS[1], ARGV[2]) else return 0 end`;
+const RELEASE_LUA = `if redis.call("get", KEYS[1]) == ARGV[1] then return redis.call("del", KEYS[1]) else return 0 end`;
+
+/**
+ * Shares world_event_log inserts between gateway instances.
+ *
+ * - One instance at a time is the relay leader (Redis lock with TTL). Only the leader
+ *   holds a Supabase Realtime subscription (one for the whole table) and publishes
+ *   each row to `${prefix}:ev:${channel}`.
+ * - Every instance (leader included) SUBSCRIBEs per channel on demand, so Realtime
+ *   channels no longer scale with gateways x world channels.
+ * - Each time the leader's Realtime subscription (re)joins (takeover, or rejoin after the
+ *   feed dropped) it publishes on `${prefix}:gap`: rows inserted in between were not relayed,
+ *   so every instance's onGap() distrusts its rings and resyncs clients.
+ * - A subscriber connection that reconnects calls onGap() locally only (it alone missed
+ *   the messages published while it was down).
+ */
+export class RedisBus {
+  private readonly url: URL;
+  private cmd: RespConnection | null = null;
+  private sub: RespConnection | null = null;
+  private handlers = new Map<string, (row: unknown) => void>();
+  private acks = new Map<string, (() => void)[]>();
+  private leaderTimer: NodeJS.Timeout | null = null;
+  private closed = false;
+  isLeader = false;
+  published = 0;
+  received = 0;
+  onGap: (() => void) | null = null;
+
+  constructor(private readonly cfg: BusConfig) {
+    this.url = new URL(cfg.url);
+  }
+
+  private key(channel: string) {
+    return `${this.cfg.prefix}:ev:${channel}`;
+  }
+
+  private get gapKey() {
+    return `${this.cfg.prefix}:gap`;
+  }
+
+  private get leaderKey() {
+    return `${this.cfg.prefix}:relay_leader`;
+  }
+
+  async start(): Promise<void> {
+    await this.connectCmd();
+    await this.connectSub();
+  }
+
+  private async connectCmd(backoffMs = 1000): Promise<void> {
+    const c = new RespConnection(this.url);
+    c.onClose = () => {
+      if (this.closed) return;
+      this.cmd = null;
+      this.reconnect((ms) => this.connectCmd(ms), backoffMs);
+    };
+    await RedisBus.open(c);
+    this.cmd = c;
+  }
+
+  // A connection that fails during AUTH/SELECT is torn down without firing its onClose retry.
+  private static async open(c: RespConnection) {
+    try {
+      await c.connect();
+    } catch (e) {
+      c.close();
+      throw e;
+    }
+  }
+
+  // Retries connect with exponential backoff (capped at 30s) until it succeeds or the bus is closed.
+  private reconnect(connect: (backoffMs: number) => Promise<void>, backoffMs: number) {
+    const next = Math.min(30_000, backoffMs * 2);
+    const retry = (delay: number) => {
+      setTimeout(() => {
+        if (this.closed) return;
+        connect(next).catch(() => retry(Math.min(30_000, delay * 2)));
+      }, delay).unref();
+    };
+    retry(backoffMs);
+  }
+
+  private async connectSub(backoffMs = 1000): Promise<void> {
+    const c = new RespConnection(this.url);
+    c.subscriber = true;
+    c.onPush = (msg) => this.onPush(msg);
+    c.onClose = () => {
+      if (this.closed) return;
+      this.sub = null;
+      this.reconnect((ms) => this.connectSub(ms), backoffMs);
+    };
+    await RedisBus.open(c);
+    this.sub = c;
+    const keys = [this.gapKey, ...[...this.handlers.keys()].map((ch) => this.key(ch))];
+    c.write(["SUBSCRIBE", ...keys]);
+    // Messages published while we were disconnected are gone.
+    if (backoffMs > 1000 || this.handlers.size > 0) this.onGap?.();
+  }
+
+  private onPush(msg: RespValue[]) {
+    const [kind, key, payload] = msg;
+    if (kind === "subscribe" && typeof key === "string") {
+      for (const fn of this.acks.get(key) ?? []) fn();
+      this.acks.delete(key);
+      return;
+    }
+    if (kind !== "message" || typeof key !== "string" || typeof payload !== "string") return;
+    if (key === this.gapKey) {
+      this.onGap?.();
+      return;
+    }
+    const channel = key.slice(this.cfg.prefix.length + 4);
+    const fn = this.handlers.get(channel);
+    if (!fn) return;
+    this.received++;
+    try {
+      fn(JSON.parse(payload));
+    } catch {
+      // ignore malformed payloads
+    }
+  }
+
+  /** Resolves once Redis confirmed the subscription (live from that point on). */
+  subscribe(channel: string, onRow: (row: unknown) => void): Promise<void> {
+    this.handlers.set(channel, onRow);
+    const key = this.key(channel);
+    return new Promise((resolve) => {
+      const list = this.acks.get(key) ?? [];
+      list.push(resolve);
+      this.acks.set(key, list);
+      if (this.sub?.connected) this.sub.write(["SUBSCRIBE", key]);
+      // Not connected: connectSub() resubscribes every handler on reconnect.
+    });
+  }
+
+  unsubscribe(channel: string) {
+    this.handlers.delete(channel);
+    const key = this.key(channel);
+    this.acks.delete(key);
+    if (this.sub?.connected) this.sub.write(["UNSUBSCRIBE", key]);
+  }
+
+  async publish(channel: string, row: unknown): Promise<void> {
+    if (!this.cmd) return;
+    this.published++;
+    await this.cmd.command(["PUBLISH", this.key(channel), JSON.stringify(row)]);
+  }
+
+  async announceGap(): Promise<void> {
+    if (!this.cmd) return;
+    await this.cmd.command(["PUBLISH", this.gapKey, this.cfg.instanceId]);
+  }
+
+  /**
+   * Leader election loop. onElected starts the relay (must resolve once it is live),
+   * onDemoted stops it.
+   */
+  runLeaderElection(onElected: () => Promise<void>, onDemoted: () => Promise<void>) {
+    const ttl = Math.max(3000, this.cfg.leaderTtlMs);
+    const step = async () => {
+      if (this.closed || !this.cmd) return;
+      try {
+        if (this.isLeader) {
+          const ok = await this.cmd.command(["EVAL", RENEW_LUA, 1, this.leaderKey, this.cfg.instanceId, ttl]);
+          if (Number(ok) !== 1) {
+            this.isLeader = false;
+            await onDemoted();
+          }
+        } else {
+          const ok = await this.cmd.command(["SET", this.leaderKey, this.cfg.instanceId, "NX", "PX", ttl]);
+          if (ok === "OK") {
+            this.isLeader = true;
+            await onElected();
+          }
+        }
+      } catch (e) {
+        if (this.isLeader) {
+          // Cannot renew: assume the lock will lapse and another instance takes over.
+          this.isLeader = false;
+          await onDemoted().catch(() => undefined);
+        }
+        console.warn("[event-gateway] bus leader election failed:", e);
+      }
+    };
+    void step();
+    this.leaderTimer = setInterval(() => void step(), Math.floor(ttl / 3));
+    this.leaderTimer.unref();
+  }
+
+  stats() {
+    return {
+      leader: this.isLeader,
+      channels: this.handlers.size,
+      published: this.published,
+      received: this.received,
+      connected: Boolean(this.cmd?.connected && this.sub?.connected),
+    };
+  }
+
+  async close(): Promise<void> {
+    this.closed = true;
+    if (this.leaderTimer) clearInterval(this.leaderTimer);
+    if (this.isLeader && this.cmd) {
+      try {
+        await this.cmd.command(["EVAL", RELEASE_LUA, 1, this.leaderKey, this.cfg.instanceId]);
+      } catch {
+        // ignore
+      }
+    }
+    this.cmd?.close();
+    this.sub?.close();
+  }
+}
@@ -0,0 +1,250 @@
+import type { WebSocket } from "ws";
+
+// What to do with a client whose outbox exceeds maxQueueBytes:
+// - "close": close with 1013 (client reconnects and resumes from lastSeq via snapshot)
+// - "drop": drop its queued events and send {type:"resync"} once it has drained
+export type SlowClientPolicy = "close" | "drop";
+
+export type FanoutConfig = {
+  // Socket bufferedAmount above which frames wait in the per-connection outbox.
+  highWaterBytes: number;
+  // Outbox limit per connection; beyond it the slow-client policy applies.
+  maxQueueBytes: number;
+  slowPolicy: SlowClientPolicy;
+  // Burst window per hub. 0 = coalesce events arriving in the same event-loop turn.
+  batchMs: number;
+  // Flush a hub early once this many events are pending.
+  batchMax: number;
+};
+
+export function envInt(name: string, def: number): number {
+  const raw = String(process.env[name] ?? "").trim();
+  if (!raw) return def;
+  const n = Number(raw);
+  return Number.isFinite(n) ? Math.floor(n) : def;
+}
+
+export function fanoutConfigFromEnv(): FanoutConfig {
+  const policy = String(process.env.GENSOKYO_EVENT_GATEWAY_SLOW_CLIENT || "close").trim().toLowerCase();
+  return {
+    highWaterBytes: Math.max(1024, envInt("GENSOKYO_EVENT_GATEWAY_HIGH_WATER_BYTES", 1 << 20)),
+    maxQueueBytes: Math.max(1024, envInt("GENSOKYO_EVENT_GATEWAY_MAX_QUEUE_BYTES", 4 << 20)),
+    slowPolicy: policy === "drop" ? "drop" : "close",
+    batchMs: Math.max(0, envInt("GENSOKYO_EVENT_GATEWAY_BATCH_MS", 0)),
+    batchMax: Math.max(1, envInt("GENSOKYO_EVENT_GATEWAY_BATCH_MAX", 200)),
+  };
+}
+
+export type FanoutStats = {
+  framesSent: number;
+  bytesSent: number;
+  framesQueued: number;
+  framesDropped: number;
+  slowClosed: number;
+  resyncs: number;
+};
+
+export function newFanoutStats(): FanoutStats {
+  return { framesSent: 0, bytesSent: 0, framesQueued: 0, framesDropped: 0, slowClosed: 0, resyncs: 0 };
+}
+
+// A serialized server message. The same Frame (same Buffer) is handed to every subscriber.
+export type Frame = {
+  data: Buffer;
+  channel: string | null; // null = control message (never dropped)
+  seq: number; // highest event seq carried (0 = none)
+};
+
+export function encodeFrame(msg: unknown, channel: string | null = null, seq = 0): Frame {
+  return { data: Buffer.from(JSON.stringify(msg)), channel, seq };
+}
+
+export function eventSeq(row: unknown): number {
+  const n = Number((row as any)?.seq ?? 0);
+  return Number.isFinite(n) ? n : 0;
+}
+
+/**
+ * Per-connection send queue.
+ *
+ * Frames go straight to the socket while ws.bufferedAmount stays under the high-water mark;
+ * otherwise they wait here and the shared drain timer (FanoutDrainer) writes them out as the
+ * socket catches up. Memory per slow client is bounded by maxQueueBytes.
+ */
+export class Outbox {
+  private queue: Frame[] = [];
+  private head = 0;
+  private queuedBytes = 0;
+  private lastSeq = new Map<string, number>();
+  private resync = new Set<string>();
+  closed = false;
+
+  constructor(
+    private readonly ws: WebSocket,
+    private readonly cfg: FanoutConfig,
+    private readonly drainer: FanoutDrainer,
+    private readonly stats: FanoutStats,
+  ) {}
+
+  get pending(): number {
+    return this.queue.length - this.head;
+  }
+
+  push(frame: Frame) {
+    if (this.closed) return;
+    if (frame.channel && this.resync.has(frame.channel)) {
+      // Client will resubscribe from lastSeq; the snapshot covers this frame.
+      this.stats.framesDropped++;
+      return;
+    }
+    if (this.pending === 0 && this.resync.size === 0 && this.fits(frame)) {
+      this.write(frame);
+      return;
+    }
+    if (this.queuedBytes + frame.data.length > this.cfg.maxQueueBytes) {
+      this.overflow(frame);
+      return;
+    }
+    this.queue.push(frame);
+    this.queuedBytes += frame.data.length;
+    this.stats.framesQueued++;
+    this.drainer.watch(this);
+  }
+
+  /** Write out what the socket can take. Returns true once nothing is left to send. */
+  drain(): boolean {
+    if (this.closed) return true;
+    while (this.pending > 0) {
+      const f = this.queue[this.head];
+      if (!this.fits(f)) break;
+      this.queue[this.head] = undefined as unknown as Frame;
+      this.head++;
+      this.queuedBytes -= f.data.length;
+      this.write(f);
+    }
+    if (this.head > 1024 && this.head * 2 > this.queue.length) {
+      this.queue = this.queue.slice(this.head);
+      this.head = 0;
+    }
+    if (this.pending === 0 && this.resync.size > 0) {
+      for (const ch of this.resync) {
+        this.write(encodeFrame({ type: "resync", channel: ch, lastSeq: this.lastSeq.get(ch) ?? 0 }));
+        this.stats.resyncs++;
+      }
+      this.resync.clear();
+    }
+    return this.pending === 0;
+  }
+
+  /** Ask the client to resubscribe `channel` from its lastSeq (sent after anything already queued). */
+  requestResync(channel: string) {
+    if (this.closed) return;
+    this.resync.add(channel);
+    this.drainer.watch(this);
+  }
+
+  forget(channel: string) {
+    this.lastSeq.delete(channel);
+    this.resync.delete(channel);
+  }
+
+  close() {
+    this.closed = true;
+    this.queue = [];
+    this.head = 0;
+    this.queuedBytes = 0;
+  }
+
+  private fits(frame: Frame): boolean {
+    // An idle socket always takes one frame, however large.
+    const buffered = this.ws.bufferedAmount;
+    return buffered === 0 || buffered + frame.data.length <= this.cfg.highWaterBytes;
+  }
+
+  private write(frame: Frame) {
+    if (this.ws.readyState !== this.ws.OPEN) return;
+    this.ws.send(frame.data, { binary: false });
+    this.stats.framesSent++;
+    this.stats.bytesSent += frame.data.length;
+    if (frame.channel && frame.seq > 0 && frame.seq > (this.lastSeq.get(frame.channel) ?? 0)) {
+      this.lastSeq.set(frame.channel, frame.seq);
+    }
+  }
+
+  private overflow(frame: Frame) {
+    if (this.cfg.slowPolicy === "close") {
+      this.stats.slowClosed++;
+      this.stats.framesDropped += this.pending + 1;
+      this.close();
+      try {
+        this.ws.close(1013, "slow consumer");
+      } catch {
+        // ignore
+      }
+      // The close frame itself may sit behind a full buffer.
+      setTimeout(() => {
+        try {
+          this.ws.terminate();
+        } catch {
+          // ignore
+        }
+      }, 5000).unref();
+      return;
+    }
+
+    // "drop": keep control frames, drop channel frames and ask for a resync per channel.
+    const kept: Frame[] = [];
+    let keptBytes = 0;
+    for (let i = this.head; i < this.queue.length; i++) {
+      const f = this.queue[i];
+      if (f.channel) {
+        this.resync.add(f.channel);
+        this.stats.framesDropped++;
+      } else {
+        kept.push(f);
+        keptBytes += f.data.length;
+      }
+    }
+    if (frame.channel) {
+      this.resync.add(frame.channel);
+      this.stats.framesDropped++;
+    } else {
+      kept.push(frame);
+      keptBytes += frame.data.length;
+    }
+    this.queue = kept;
+    this.head = 0;
+    this.queuedBytes = keptBytes;
+    this.drainer.watch(this);
+  }
+}
+
+/** One timer for every congested outbox (idle connections cost nothing). */
+export class FanoutDrainer {
+  private congested = new Set<Outbox>();
+  private timer: NodeJS.Timeout | null = null;
+
+  constructor(private readonly intervalMs = 10) {}
+
+  get size(): number {
+    return this.congested.size;
+  }
+
+  watch(outbox: Outbox) {
+    this.congested.add(outbox);
+    if (!this.timer) {
+      this.timer = setInterval(() => this.tick(), this.intervalMs);
+      this.timer.unref();
+    }
+  }
+
+  private tick() {
+    for (const ob of this.congested) {
+      if (ob.drain()) this.congested.delete(ob);
+    }
+    if (this.congested.size === 0 && this.timer) {
+      clearInterval(this.timer);
+      this.timer = null;
+    }
+  }
+}
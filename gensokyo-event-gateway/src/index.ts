@@ -1,21 +1,44 @@
-import { WebSocketServer } from "ws";
+import { hostname } from "node:os";
+import { randomUUID } from "node:crypto";
+import { WebSocketServer, type WebSocket } from "ws";
 import { createClient, type SupabaseClient } from "@supabase/supabase-js";
+import { RedisBus } from "./bus.js";
+import { EventRing } from "./ring.js";
+import {
+  FanoutDrainer,
+  Outbox,
+  encodeFrame,
+  envInt,
+  eventSeq,
+  fanoutConfigFromEnv,
+  newFanoutStats,
+  type Frame,
+} from "./fanout.js";
 
 type ClientMsg =
-  | { type: "hello"; auth?: { mode: "supabase_jwt"; access_token: string } }
+  | { type: "hello"; auth?: { mode: "supabase_jwt"; access_token: string }; features?: string[] }
   | { type: "subscribe"; channel: string; lastSeq?: number }
-  | { type: "unsubscribe"; channel: string };
+  | { type: "unsubscribe"; channel: string }
+  // Load-test mode only (GENSOKYO_EVENT_GATEWAY_LOADTEST=1)
+  | { type: "publish"; channel: string; event: unknown };
 
 type ServerMsg =
   | { type: "ack"; hello?: boolean }
   | { type: "snapshot"; channel: string; fromSeq: number; events: unknown[] }
   | { type: "event"; channel: string; event: unknown }
+  // Burst of live events (clients that sent features:["batch"] in hello)
+  | { type: "events"; channel: string; events: unknown[] }
+  // Live events were dropped for this slow client: resubscribe with lastSeq
+  | { type: "resync"; channel: string; lastSeq: number }
   | { type: "error"; code: string; message: string };
 
 type ConnState = {
+  ws: WebSocket;
   authed: boolean;
   userId: string | null;
   subs: Set<string>;
+  batch: boolean;
+  outbox: Outbox;
 };
 
 const SUPABASE_URL = process.env.SUPABASE_URL || "";
@@ -28,6 +51,29 @@ const HOST = process.env.GENSOKYO_EVENT_GATEWAY_HOST || "127.0.0.1";
 // Local dev shortcut. In production, set to "0" and require auth.
 const ALLOW_ANON = (process.env.GENSOKYO_EVENT_GATEWAY_ALLOW_ANON || "1") === "1";
 
+// Load-test mode: accepts {type:"publish"} from clients and runs without Supabase if unset.
+// Never enable in production.
+const LOADTEST = (process.env.GENSOKYO_EVENT_GATEWAY_LOADTEST || "0") === "1";
+
+// permessage-deflate (compression runs per connection; costs CPU at high fan-out).
+const DEFLATE = (process.env.GENSOKYO_EVENT_GATEWAY_DEFLATE || "0") === "1";
+const STATS_SEC = envInt("GENSOKYO_EVENT_GATEWAY_STATS_SEC", 0);
+
+// Resumes (subscribe with lastSeq) within the last RING_SIZE events are served from memory.
+const RING_SIZE = Math.max(0, envInt("GENSOKYO_EVENT_GATEWAY_RING_SIZE", 1000));
+// How long a snapshot waits for a new hub's live feed before reading the DB anyway.
+const LIVE_WAIT_MS = Math.max(0, envInt("GENSOKYO_EVENT_GATEWAY_LIVE_WAIT_MS", 3000));
+
+// Multi-instance mode: gateways share world_event_log inserts over Redis pub/sub.
+const REDIS_URL = process.env.GENSOKYO_EVENT_GATEWAY_REDIS_URL || "";
+const BUS_PREFIX = process.env.GENSOKYO_EVENT_GATEWAY_BUS_PREFIX || "gensokyo:gw";
+const INSTANCE_ID =
+  process.env.GENSOKYO_EVENT_GATEWAY_INSTANCE_ID || `${hostname()}:${process.pid}:${randomUUID().slice(0, 8)}`;
+
+const FANOUT = fanoutConfigFromEnv();
+const fanoutStats = newFanoutStats();
+const drainer = new FanoutDrainer();
+
 function mustEnv() {
   if (!SUPABASE_URL || !SUPABASE_SERVICE_ROLE_KEY) {
     throw new Error("[event-gateway] SUPABASE_URL / SUPABASE_SERVICE_ROLE_KEY missing");
@@ -47,10 +93,11 @@ function supabaseAdmin(): SupabaseClient {
   });
 }
 
-const sb = supabaseAdmin();
+const sb: SupabaseClient | null =
+  LOADTEST && !(SUPABASE_URL && SUPABASE_SERVICE_ROLE_KEY) ? null : supabaseAdmin();
 
-function send(ws: any, msg: ServerMsg) {
-  ws.send(JSON.stringify(msg));
+function send(conn: ConnState, msg: ServerMsg, channel: string | null = null, seq = 0) {
+  conn.outbox.push(encodeFrame(msg, channel, seq));
 }
 
 function safeParse(raw: string): ClientMsg | null {
@@ -65,19 +112,133 @@ function safeParse(raw: string): ClientMsg | null {
 
 type ChannelHub = {
   channel: string;
-  clients: Set<any>;
+  clients: Set<ConnState>;
   rt: ReturnType<SupabaseClient["channel"]> | null;
+  pending: unknown[];
+  flushTimer: NodeJS.Timeout | NodeJS.Immediate | null;
+  ring: EventRing;
+  // Live feed (Realtime channel or bus subscription) is delivering inserts.
+  live: boolean;
+  wasLive: boolean;
+  liveWaiters: (() => void)[];
+  // Bumped on every feed gap; a snapshot taken across a gap must not seed the ring.
+  epoch: number;
+  // Clients whose DB snapshot was read before the feed went live (may miss rows in between).
+  stale: Set<ConnState>;
 };
 
 const hubs = new Map<string, ChannelHub>();
 
+// Serialize once per hub flush; every subscriber gets the same Buffer.
+function flushHub(hub: ChannelHub) {
+  if (hub.flushTimer) {
+    if (FANOUT.batchMs > 0) clearTimeout(hub.flushTimer as NodeJS.Timeout);
+    else clearImmediate(hub.flushTimer as NodeJS.Immediate);
+    hub.flushTimer = null;
+  }
+  const rows = hub.pending;
+  hub.pending = [];
+  if (rows.length === 0 || hub.clients.size === 0) return;
+
+  const channel = hub.channel;
+  let singles: Frame[] | null = null;
+  let batch: Frame | null = null;
+  for (const c of hub.clients) {
+    if (c.batch && rows.length > 1) {
+      batch ??= encodeFrame({ type: "events", channel, events: rows }, channel, Math.max(...rows.map(eventSeq)));
+      c.outbox.push(batch);
+    } else {
+      singles ??= rows.map((row) => encodeFrame({ type: "event", channel, event: row }, channel, eventSeq(row)));
+      for (const f of singles) c.outbox.push(f);
+    }
+  }
+}
+
+function publishToHub(hub: ChannelHub, row: unknown) {
+  hub.ring.push(row);
+  hub.pending.push(row);
+  if (hub.pending.length >= FANOUT.batchMax) {
+    flushHub(hub);
+    return;
+  }
+  if (hub.flushTimer) return;
+  hub.flushTimer = FANOUT.batchMs > 0 ? setTimeout(() => flushHub(hub), FANOUT.batchMs) : setImmediate(() => flushHub(hub));
+}
+
+function resyncClients(hub: ChannelHub, clients: Iterable<ConnState>) {
+  for (const c of clients) c.outbox.requestResync(hub.channel);
+}
+
+function markLive(hub: ChannelHub) {
+  if (hub.live) return;
+  hub.live = true;
+  // Load-test mode without a DB: the live feed is the whole history.
+  if (!sb) hub.ring.cover(1, []);
+  // After a rejoin every client may have missed rows; on the first join only those
+  // whose snapshot was read before the feed was up.
+  resyncClients(hub, hub.wasLive ? hub.clients : hub.stale);
+  hub.stale.clear();
+  hub.wasLive = true;
+  for (const fn of hub.liveWaiters.splice(0)) fn();
+}
+
+function markDown(hub: ChannelHub) {
+  hub.live = false;
+  hub.epoch++;
+  hub.ring.reset();
+}
+
+// Rows may have been missed (bus leader change / reconnect): distrust the ring, resync clients.
+function markGap(hub: ChannelHub) {
+  hub.epoch++;
+  hub.ring.reset();
+  resyncClients(hub, hub.clients);
+}
+
+function waitLive(hub: ChannelHub, timeoutMs: number): Promise<boolean> {
+  if (hub.live) return Promise.resolve(true);
+  if (timeoutMs <= 0) return Promise.resolve(false);
+  return new Promise((resolve) => {
+    const t = setTimeout(() => resolve(hub.live), timeoutMs);
+    hub.liveWaiters.push(() => {
+      clearTimeout(t);
+      resolve(true);
+    });
+  });
+}
+
 async function ensureHub(channel: string): Promise<ChannelHub> {
   const existing = hubs.get(channel);
   if (existing) return existing;
 
-  const hub: ChannelHub = { channel, clients: new Set(), rt: null };
+  const hub: ChannelHub = {
+    channel,
+    clients: new Set(),
+    rt: null,
+    pending: [],
+    flushTimer: null,
+    ring: new EventRing(RING_SIZE),
+    live: false,
+    wasLive: false,
+    liveWaiters: [],
+    epoch: 0,
+    stale: new Set(),
+  };
   hubs.set(channel, hub);
 
+  if (bus) {
+    // Inserts arrive over the bus (published by the relay leader).
+    void bus.subscribe(channel, (row) => publishToHub(hub, row)).then(() => {
+      if (hubs.get(channel) === hub) markLive(hub);
+    });
+    return hub;
+  }
+  if (!sb) {
+    // Load-test mode without Supabase: "publish" is the only feed.
+    markLive(hub);
+    return hub;
+  }
+
   // Subscribe to new inserts via Supabase Realtime (no polling).
   const rt = sb
     .channel(`world_event_log:${channel}`)
@@ -92,16 +253,19 @@ async function ensureHub(channel: string): Promise<ChannelHub> {
       (payload) => {
         const row = (payload as any)?.new ?? null;
         if (!row) return;
-        for (const c of hub.clients) {
-          send(c, { type: "event", channel, event: row });
-        }
+        publishToHub(hub, row);
       },
     );
 
   hub.rt = rt;
   rt.subscribe((status, err) => {
-    if (status === "CHANNEL_ERROR" || status === "TIMED_OUT") {
-      console.warn("[event-gateway] realtime subscribe failed:", channel, status, err);
+    if (status === "SUBSCRIBED") {
+      markLive(hub);
+      return;
+    }
+    if (status === "CHANNEL_ERROR" || status === "TIMED_OUT" || status === "CLOSED") {
+      markDown(hub);
+      if (status !== "CLOSED") console.warn("[event-gateway] realtime subscribe failed:", channel, status, err);
     }
   });
 
@@ -112,19 +276,58 @@ async function releaseHubIfEmpty(channel: string) {
   const hub = hubs.get(channel);
   if (!hub) return;
   if (hub.clients.size > 0) return;
-  if (hub.rt) {
+  hub.pending = [];
+  flushHub(hub);
+  hubs.delete(channel);
+  for (const fn of hub.liveWaiters.splice(0)) fn();
+  if (bus) bus.unsubscribe(channel);
+  if (hub.rt && sb) {
     try {
       await sb.removeChannel(hub.rt);
     } catch {
       // ignore
     }
   }
-  hubs.delete(channel);
 }
 
-async function sendSnapshot(ws: any, channel: string, lastSeq: number) {
-  const fromSeq = Math.max(0, (Number.isFinite(lastSeq) ? lastSeq : 0) + 1);
-  const pageSize = 250;
+const SNAPSHOT_PAGE = 250;
+
+function sendRows(conn: ConnState, channel: string, fromSeq: number, rows: unknown[]) {
+  if (rows.length === 0) {
+    // still send an empty snapshot so the client can switch to live cleanly
+    send(conn, { type: "snapshot", channel, fromSeq, events: [] }, channel);
+    return;
+  }
+  for (let i = 0; i < rows.length; i += SNAPSHOT_PAGE) {
+    const events = rows.slice(i, i + SNAPSHOT_PAGE);
+    const pageFrom = i === 0 ? fromSeq : eventSeq(rows[i - 1]) + 1;
+    send(conn, { type: "snapshot", channel, fromSeq: pageFrom, events }, channel, eventSeq(events[events.length - 1]));
+  }
+}
+
+async function sendSnapshot(conn: ConnState, hub: ChannelHub, lastSeq: number) {
+  const channel = hub.channel;
+  const safeLast = Number.isFinite(lastSeq) ? Math.max(0, lastSeq) : 0;
+  const fromSeq = safeLast + 1;
+
+  const live = await waitLive(hub, LIVE_WAIT_MS);
+  if (live) {
+    const cached = hub.ring.since(safeLast);
+    if (cached) {
+      sendRows(conn, channel, fromSeq, cached);
+      return;
+    }
+  }
+  if (!sb) {
+    send(conn, { type: "snapshot", channel, fromSeq, events: [] }, channel);
+    return;
+  }
+
+  // DB read. If the feed was live for the whole read, the rows seed the ring.
+  const epoch = hub.epoch;
+  const wasLive = hub.live;
+  let tail: unknown[] = [];
+  let tailFrom = fromSeq;
 
   let minSeq = fromSeq;
   for (;;) {
@@ -134,29 +337,43 @@ async function sendSnapshot(ws: any, channel: string, lastSeq: number) {
       .eq("channel", channel)
       .gte("seq", minSeq)
       .order("seq", { ascending: true })
-      .limit(pageSize);
+      .limit(SNAPSHOT_PAGE);
 
     if (error) {
-      send(ws, { type: "error", code: "snapshot_failed", message: String(error.message || error) });
+      send(conn, { type: "error", code: "snapshot_failed", message: String(error.message || error) });
       return;
     }
     const events = (data ?? []) as any[];
     if (events.length === 0) {
-      // still send an empty snapshot so the client can switch to live cleanly
-      send(ws, { type: "snapshot", channel, fromSeq, events: [] });
-      return;
+      if (minSeq === fromSeq) send(conn, { type: "snapshot", channel, fromSeq, events: [] }, channel);
+      break;
     }
 
-    send(ws, { type: "snapshot", channel, fromSeq: minSeq, events });
+    send(conn, { type: "snapshot", channel, fromSeq: minSeq, events }, channel, Math.max(...events.map(eventSeq)));
 
-    if (events.length < pageSize) return;
+    if (RING_SIZE > 0) {
+      tail = tail.concat(events);
+      if (tail.length > RING_SIZE) {
+        tail = tail.slice(tail.length - RING_SIZE);
+        tailFrom = eventSeq(tail[0]);
+      }
+    }
+    if (events.length < SNAPSHOT_PAGE) break;
     minSeq = Number(events[events.length - 1]?.seq ?? minSeq) + 1;
   }
+
+  if (!wasLive) {
+    // Rows inserted between this read and the feed going live may be missing.
+    if (hub.live) conn.outbox.requestResync(channel);
+    else hub.stale.add(conn);
+    return;
+  }
+  if (RING_SIZE > 0 && hub.live && hub.epoch === epoch && hubs.get(channel) === hub) hub.ring.cover(tailFrom, tail);
 }
 
 async function authHello(msg: ClientMsg & { type: "hello" }): Promise<{ userId: string | null }> {
   const token = msg.auth?.access_token ? String(msg.auth.access_token) : "";
-  if (!token) return { userId: null };
+  if (!token || !sb) return { userId: null };
   try {
     const { data, error } = await sb.auth.getUser(token);
     if (error) return { userId: null };
@@ -173,16 +390,135 @@ function isValidChannel(ch: string) {
   return /^world:[a-z0-9_]+(?::[a-z0-9_]+)?$/i.test(s);
 }
 
-const wss = new WebSocketServer({ host: HOST, port: PORT });
-console.log(`[event-gateway] ws listening on ws://${HOST}:${PORT}`);
+// --------------------------------------------
+// Multi-instance bus (optional)
+// --------------------------------------------
+
+let relayRt: ReturnType<SupabaseClient["channel"]> | null = null;
+
+// Relay leader only: one Realtime subscription for the whole table, republished per channel.
+function startRelay(b: RedisBus): Promise<void> {
+  if (!sb) return Promise.resolve();
+  const client = sb;
+  return new Promise((resolve) => {
+    const timer = setTimeout(resolve, 10_000);
+    relayRt = client
+      .channel("world_event_log:relay")
+      .on("postgres_changes", { event: "INSERT", schema: SUPABASE_SCHEMA, table: "world_event_log" }, (payload) => {
+        const row = (payload as any)?.new ?? null;
+        if (!row || typeof row.channel !== "string") return;
+        b.publish(row.channel, row).catch((e) => console.warn("[event-gateway] bus publish failed:", e));
+      });
+    relayRt.subscribe((status, err) => {
+      if (status === "SUBSCRIBED") {
+        // Takeover or rejoin: inserts since the previous feed stopped were not relayed.
+        b.announceGap().catch(() => undefined);
+        clearTimeout(timer);
+        resolve();
+        return;
+      }
+      if (status === "CHANNEL_ERROR" || status === "TIMED_OUT") {
+        console.warn("[event-gateway] relay realtime subscribe failed:", status, err);
+      }
+    });
+  });
+}
+
+async function stopRelay() {
+  const rt = relayRt;
+  relayRt = null;
+  if (rt && sb) {
+    try {
+      await sb.removeChannel(rt);
+    } catch {
+      // ignore
+    }
+  }
+}
+
+async function startBus(): Promise<RedisBus | null> {
+  if (!REDIS_URL) return null;
+  const b = new RedisBus({
+    url: REDIS_URL,
+    prefix: BUS_PREFIX,
+    instanceId: INSTANCE_ID,
+    leaderTtlMs: envInt("GENSOKYO_EVENT_GATEWAY_BUS_LEADER_TTL_MS", 10_000),
+  });
+  try {
+    await b.start();
+  } catch (e) {
+    console.warn("[event-gateway] bus unavailable; using per-instance Realtime channels:", e);
+    return null;
+  }
+  b.onGap = () => {
+    for (const hub of hubs.values()) markGap(hub);
+  };
+  if (sb) b.runLeaderElection(() => startRelay(b), stopRelay);
+  console.log(`[event-gateway] bus connected (${BUS_PREFIX}, instance ${INSTANCE_ID})`);
+  return b;
+}
+
+const bus = await startBus();
+
+const wss = new WebSocketServer({
+  host: HOST,
+  port: PORT,
+  perMessageDeflate: DEFLATE
+    ? {
+        threshold: 1024,
+        zlibDeflateOptions: { level: 1 },
+        serverNoContextTakeover: true,
+        clientNoContextTakeover: true,
+        concurrencyLimit: 10,
+      }
+    : false,
+});
+console.log(`[event-gateway] ws listening on ws://${HOST}:${PORT}${LOADTEST ? " (loadtest mode)" : ""}`);
+
+if (STATS_SEC > 0) {
+  setInterval(() => {
+    let clients = 0;
+    let ringHits = 0;
+    let ringMisses = 0;
+    for (const hub of hubs.values()) {
+      clients += hub.clients.size;
+      ringHits += hub.ring.hits;
+      ringMisses += hub.ring.misses;
+    }
+    console.log(
+      "[event-gateway] stats",
+      JSON.stringify({
+        hubs: hubs.size,
+        subscriptions: clients,
+        congested: drainer.size,
+        ...fanoutStats,
+        ring: { hits: ringHits, misses: ringMisses },
+        bus: bus ? bus.stats() : null,
+      }),
+    );
+  }, STATS_SEC * 1000).unref();
+}
 
 wss.on("connection", (ws) => {
-  const state: ConnState = { authed: false, userId: null, subs: new Set() };
+  const state: ConnState = {
+    ws,
+    authed: false,
+    userId: null,
+    subs: new Set(),
+    batch: false,
+    outbox: new Outbox(ws, FANOUT, drainer, fanoutStats),
+  };
+
+  // Handle one message at a time: "subscribe" sent right after "hello" must see the auth result.
+  let inbox: Promise<void> = Promise.resolve();
+  ws.on("message", (buf) => {
+    inbox = inbox.then(() => onMessage(buf)).catch((e) => console.warn("[event-gateway] message failed:", e));
+  });
 
-  ws.on("message", async (buf) => {
+  const onMessage = async (buf: unknown) => {
     const msg = safeParse(String(buf ?? ""));
     if (!msg) {
-      send(ws, { type: "error", code: "bad_request", message: "Invalid JSON" });
+      send(state, { type: "error", code: "bad_request", message: "Invalid JSON" });
       return;
     }
 
@@ -190,8 +526,9 @@ wss.on("connection", (ws) => {
       const { userId } = await authHello(msg);
       state.userId = userId;
       state.authed = Boolean(userId) || ALLOW_ANON;
+      state.batch = Array.isArray(msg.features) && msg.features.includes("batch");
       if (!state.authed) {
-        send(ws, { type: "error", code: "unauthorized", message: "Auth required" });
+        send(state, { type: "error", code: "unauthorized", message: "Auth required" });
         try {
           ws.close();
         } catch {
@@ -199,47 +536,63 @@ wss.on("connection", (ws) => {
         }
         return;
       }
-      send(ws, { type: "ack", hello: true });
+      send(state, { type: "ack", hello: true });
       return;
     }
 
     if (!state.authed) {
-      send(ws, { type: "error", code: "unauthorized", message: "Send hello first" });
+      send(state, { type: "error", code: "unauthorized", message: "Send hello first" });
       return;
     }
 
     if (msg.type === "subscribe") {
       const channel = String(msg.channel ?? "").trim();
       if (!isValidChannel(channel)) {
-        send(ws, { type: "error", code: "bad_channel", message: "Invalid channel" });
+        send(state, { type: "error", code: "bad_channel", message: "Invalid channel" });
         return;
       }
 
       state.subs.add(channel);
       const hub = await ensureHub(channel);
-      hub.clients.add(ws);
-      await sendSnapshot(ws, channel, Number(msg.lastSeq ?? 0));
+      hub.clients.add(state);
+      await sendSnapshot(state, hub, Number(msg.lastSeq ?? 0));
       return;
     }
 
     if (msg.type === "unsubscribe") {
       const channel = String(msg.channel ?? "").trim();
       state.subs.delete(channel);
+      state.outbox.forget(channel);
       const hub = hubs.get(channel);
       if (hub) {
-        hub.clients.delete(ws);
+        hub.clients.delete(state);
+        hub.stale.delete(state);
         await releaseHubIfEmpty(channel);
       }
-      send(ws, { type: "ack" });
+      send(state, { type: "ack" });
       return;
     }
-  });
+
+    if (msg.type === "publish" && LOADTEST) {
+      const channel = String(msg.channel ?? "").trim();
+      if (!msg.event) return;
+      if (bus) {
+        await bus.publish(channel, msg.event);
+        return;
+      }
+      const hub = hubs.get(channel);
+      if (hub) publishToHub(hub, msg.event);
+      return;
+    }
+  };
 
   ws.on("close", async () => {
+    state.outbox.close();
     for (const ch of state.subs) {
       const hub = hubs.get(ch);
       if (!hub) continue;
-      hub.clients.delete(ws);
+      hub.clients.delete(state);
+      hub.stale.delete(state);
       await releaseHubIfEmpty(ch);
     }
     state.subs.clear();
@@ -0,0 +1,253 @@
+// Fan-out load test: N subscribers on worker threads, one publisher, p50/p99 delivery latency.
+//
+// Start the gateway with GENSOKYO_EVENT_GATEWAY_LOADTEST=1 (enables {type:"publish"}), then:
+//   LOADTEST_SUBSCRIBERS=10000 npm run loadtest
+//
+// Latency = receive time on a subscriber - publish time (both from performance.timeOrigin + now()).
+
+import { Worker, isMainThread, parentPort, workerData } from "node:worker_threads";
+import { availableParallelism } from "node:os";
+import { fileURLToPath } from "node:url";
+import { performance } from "node:perf_hooks";
+import { WebSocket } from "ws";
+import { envInt } from "./fanout.js";
+
+const GATEWAY_URL = process.env.LOADTEST_URL || "ws://127.0.0.1:8787";
+const SUBSCRIBERS = Math.max(1, envInt("LOADTEST_SUBSCRIBERS", 10000));
+const CHANNELS = Math.max(1, envInt("LOADTEST_CHANNELS", 1));
+const EVENTS = Math.max(1, envInt("LOADTEST_EVENTS", 200));
+const RATE = Math.max(1, envInt("LOADTEST_RATE_PER_SEC", 50));
+const BURST = Math.max(1, envInt("LOADTEST_BURST", 1));
+const WORKERS = Math.max(1, envInt("LOADTEST_WORKERS", Math.min(8, Math.max(1, availableParallelism() - 1))));
+const BATCH = (process.env.LOADTEST_BATCH || "1") === "1";
+const DRAIN_MS = Math.max(0, envInt("LOADTEST_DRAIN_MS", 10000));
+const CONNECT_CONCURRENCY = Math.max(1, envInt("LOADTEST_CONNECT_CONCURRENCY", 200));
+
+const channelName = (i: number) => `world:loadtest:c${i}`;
+const nowMs = () => performance.timeOrigin + performance.now();
+const sleep = (ms: number) => new Promise((r) => setTimeout(r, ms));
+
+type WorkerInit = { offset: number; count: number };
+
+type WorkerResult = {
+  type: "result";
+  connected: number;
+  failed: number;
+  delivered: number;
+  closedSlow: number;
+  resyncs: number;
+  latencies: Float64Array;
+};
+
+// --------------------------------------------
+// Subscriber worker
+// --------------------------------------------
+
+async function runSubscribers(init: WorkerInit) {
+  const port = parentPort!;
+  let lat = new Float64Array(1 << 16);
+  let n = 0;
+  let closedSlow = 0;
+  let resyncs = 0;
+  let connected = 0;
+  let failed = 0;
+  const sockets: WebSocket[] = [];
+
+  const record = (ev: any) => {
+    const sent = Number(ev?.payload?.sent_at ?? NaN);
+    if (!Number.isFinite(sent)) return;
+    if (n === lat.length) {
+      const next = new Float64Array(lat.length * 2);
+      next.set(lat);
+      lat = next;
+    }
+    lat[n++] = nowMs() - sent;
+  };
+
+  const connectOne = (i: number) =>
+    new Promise<void>((resolve) => {
+      const channel = channelName((init.offset + i) % CHANNELS);
+      const ws = new WebSocket(GATEWAY_URL, { perMessageDeflate: true });
+      let ready = false;
+      const done = (ok: boolean) => {
+        if (ready) return;
+        ready = true;
+        if (ok) connected++;
+        else failed++;
+        resolve();
+      };
+      ws.on("open", () => {
+        ws.send(JSON.stringify({ type: "hello", features: BATCH ? ["batch"] : [] }));
+        ws.send(JSON.stringify({ type: "subscribe", channel, lastSeq: 0 }));
+      });
+      ws.on("message", (raw) => {
+        let msg: any;
+        try {
+          msg = JSON.parse(String(raw));
+        } catch {
+          return;
+        }
+        if (msg?.type === "snapshot") done(true);
+        else if (msg?.type === "error") done(false);
+        else if (msg?.type === "event") record(msg.event);
+        else if (msg?.type === "events" && Array.isArray(msg.events)) for (const e of msg.events) record(e);
+        else if (msg?.type === "resync") resyncs++;
+      });
+      ws.on("close", (code) => {
+        if (code === 1013) closedSlow++;
+        done(false);
+      });
+      ws.on("error", () => done(false));
+      sockets.push(ws);
+    });
+
+  for (let i = 0; i < init.count; i += CONNECT_CONCURRENCY) {
+    const wave: Promise<void>[] = [];
+    for (let j = i; j < Math.min(init.count, i + CONNECT_CONCURRENCY); j++) wave.push(connectOne(j));
+    await Promise.all(wave);
+  }
+  port.postMessage({ type: "ready", connected, failed });
+
+  const progress = setInterval(() => port.postMessage({ type: "progress", delivered: n }), 200);
+  port.on("message", (m: any) => {
+    if (m?.type !== "finish") return;
+    clearInterval(progress);
+    const out = lat.slice(0, n);
+    const res: WorkerResult = { type: "result", connected, failed, delivered: n, closedSlow, resyncs, latencies: out };
+    port.postMessage(res, [out.buffer]);
+    for (const ws of sockets) ws.terminate();
+    setTimeout(() => process.exit(0), 50);
+  });
+}
+
+// --------------------------------------------
+// Coordinator + publisher
+// --------------------------------------------
+
+function pct(sorted: Float64Array, p: number): number {
+  if (sorted.length === 0) return 0;
+  return sorted[Math.min(sorted.length - 1, Math.max(0, Math.round(p * (sorted.length - 1))))];
+}
+
+async function main() {
+  const self = fileURLToPath(import.meta.url);
+  const per = Math.ceil(SUBSCRIBERS / WORKERS);
+  const workers: Worker[] = [];
+  const readyWaits: Promise<any>[] = [];
+  const delivered = new Map<Worker, number>();
+  const perChannel = new Array<number>(CHANNELS).fill(0);
+
+  for (let w = 0; w < WORKERS; w++) {
+    const offset = w * per;
+    const count = Math.max(0, Math.min(per, SUBSCRIBERS - offset));
+    if (count === 0) break;
+    for (let i = 0; i < count; i++) perChannel[(offset + i) % CHANNELS]++;
+    const worker = new Worker(self, { workerData: { offset, count } satisfies WorkerInit });
+    workers.push(worker);
+    delivered.set(worker, 0);
+    readyWaits.push(
+      new Promise((resolve) => {
+        worker.on("message", (m: any) => {
+          if (m?.type === "ready") resolve(m);
+          if (m?.type === "progress") delivered.set(worker, Number(m.delivered) || 0);
+        });
+      }),
+    );
+  }
+
+  const t0 = nowMs();
+  const ready = await Promise.all(readyWaits);
+  const connected = ready.reduce((a, r) => a + Number(r.connected || 0), 0);
+  console.log(`[loadtest] ${connected}/${SUBSCRIBERS} subscribers ready in ${Math.round(nowMs() - t0)}ms`);
+
+  const pub = new WebSocket(GATEWAY_URL);
+  await new Promise<void>((resolve, reject) => {
+    pub.on("open", () => resolve());
+    pub.on("error", reject);
+  });
+  pub.send(JSON.stringify({ type: "hello" }));
+
+  let expected = 0;
+  const tickMs = (1000 * BURST) / RATE;
+  const tp = nowMs();
+  for (let k = 0; k < EVENTS; ) {
+    for (let b = 0; b < BURST && k < EVENTS; b++, k++) {
+      const ci = k % CHANNELS;
+      const channel = channelName(ci);
+      expected += perChannel[ci];
+      pub.send(
+        JSON.stringify({
+          type: "publish",
+          channel,
+          event: { seq: k + 1, channel, type: "loadtest", payload: { sent_at: nowMs() } },
+        }),
+      );
+    }
+    const nextAt = tp + (k / BURST) * tickMs;
+    await sleep(Math.max(0, nextAt - nowMs()));
+  }
+  const publishMs = nowMs() - tp;
+
+  const drainUntil = nowMs() + DRAIN_MS;
+  for (;;) {
+    let got = 0;
+    for (const v of delivered.values()) got += v;
+    if (got >= expected || nowMs() > drainUntil) break;
+    await sleep(100);
+  }
+  pub.terminate();
+
+  const results = await Promise.all(
+    workers.map(
+      (worker) =>
+        new Promise<WorkerResult>((resolve) => {
+          worker.on("message", (m: any) => {
+            if (m?.type === "result") resolve(m as WorkerResult);
+          });
+          worker.postMessage({ type: "finish" });
+        }),
+    ),
+  );
+
+  const total = results.reduce((a, r) => a + r.latencies.length, 0);
+  const all = new Float64Array(total);
+  let off = 0;
+  for (const r of results) {
+    all.set(r.latencies, off);
+    off += r.latencies.length;
+  }
+  all.sort();
+
+  const summary = {
+    url: GATEWAY_URL,
+    subscribers: SUBSCRIBERS,
+    connected,
+    channels: CHANNELS,
+    events: EVENTS,
+    rate_per_sec: RATE,
+    burst: BURST,
+    batch: BATCH,
+    publish_ms: Math.round(publishMs),
+    expected_deliveries: expected,
+    delivered: total,
+    lost: Math.max(0, expected - total),
+    closed_slow: results.reduce((a, r) => a + r.closedSlow, 0),
+    resyncs: results.reduce((a, r) => a + r.resyncs, 0),
+    latency_ms: {
+      p50: +pct(all, 0.5).toFixed(2),
+      p90: +pct(all, 0.9).toFixed(2),
+      p99: +pct(all, 0.99).toFixed(2),
+      max: +(all.length ? all[all.length - 1] : 0).toFixed(2),
+    },
+  };
+  console.log(JSON.stringify(summary, null, 2));
+}
+
+if (isMainThread) {
+  main().catch((e) => {
+    console.error("[loadtest] failed:", e);
+    process.exit(1);
+  });
+} else {
+  void runSubscribers(workerData as WorkerInit);
+}
@@ -0,0 +1,96 @@
+import { eventSeq } from "./fanout.js";
+
+/**
+ * Last N events of one channel, in seq order.
+ *
+ * The ring only answers a resume when it is known to hold *every* event after the
+ * client's lastSeq: coverage starts at `baseSeq` (all events with seq > baseSeq are
+ * present) and is established by a complete DB snapshot taken while the live feed was
+ * already running. Evicting the oldest entry moves baseSeq up; a gap in the live feed
+ * (Realtime error, bus leader change) resets coverage.
+ */
+export class EventRing {
+  private rows: unknown[] = [];
+  private seqs: number[] = [];
+  private baseSeq: number | null = null;
+  hits = 0;
+  misses = 0;
+
+  constructor(private readonly capacity: number) {}
+
+  get size(): number {
+    return this.rows.length;
+  }
+
+  get coveredFrom(): number | null {
+    return this.baseSeq;
+  }
+
+  /** Live event (or snapshot row). Keeps seq order; duplicates are ignored. */
+  push(row: unknown) {
+    const seq = eventSeq(row);
+    if (seq <= 0) return;
+    const n = this.seqs.length;
+    if (n === 0 || seq > this.seqs[n - 1]) {
+      this.rows.push(row);
+      this.seqs.push(seq);
+    } else {
+      // Rare: out of order delivery. Binary-search the slot.
+      let lo = 0;
+      let hi = n;
+      while (lo < hi) {
+        const mid = (lo + hi) >> 1;
+        if (this.seqs[mid] < seq) lo = mid + 1;
+        else hi = mid;
+      }
+      if (this.seqs[lo] === seq) return;
+      if (this.baseSeq !== null && seq <= this.baseSeq) return;
+      this.rows.splice(lo, 0, row);
+      this.seqs.splice(lo, 0, seq);
+    }
+    this.trim();
+  }
+
+  /**
+   * A complete DB read of every event with seq >= fromSeq (taken while the live feed was running).
+   * Merges the rows and extends coverage down to fromSeq - 1.
+   */
+  cover(fromSeq: number, rows: unknown[]) {
+    for (const r of rows) this.push(r);
+    const base = Math.max(0, fromSeq - 1);
+    if (this.baseSeq === null || base < this.baseSeq) this.baseSeq = base;
+    this.trim();
+  }
+
+  /** Events with seq > lastSeq, or null when the ring cannot prove it has all of them. */
+  since(lastSeq: number): unknown[] | null {
+    if (this.baseSeq === null || lastSeq < this.baseSeq) {
+      this.misses++;
+      return null;
+    }
+    this.hits++;
+    let lo = 0;
+    let hi = this.seqs.length;
+    while (lo < hi) {
+      const mid = (lo + hi) >> 1;
+      if (this.seqs[mid] <= lastSeq) lo = mid + 1;
+      else hi = mid;
+    }
+    return this.rows.slice(lo);
+  }
+
+  reset() {
+    this.rows = [];
+    this.seqs = [];
+    this.baseSeq = null;
+  }
+
+  private trim() {
+    const over = this.rows.length - this.capacity;
+    if (over <= 0) return;
+    const evictedSeq = this.seqs[over - 1];
+    this.rows.splice(0, over);
+    this.seqs.splice(0, over);
+    if (this.baseSeq !== null && evictedSeq > this.baseSeq) this.baseSeq = evictedSeq;
+  }
+}
@@ -10,17 +10,20 @@
 
 from __future__ import annotations
 
+import asyncio
+import contextlib
 import os
-import threading
 import uuid
 import time
 from dataclasses import dataclass, field
-from typing import Any, Dict, Optional
+from typing import Any, Awaitable, Dict, Optional
 from datetime import datetime, timezone
 
 from persona_core.memory.episode_store import Episode
+from persona_core.storage.persistence_queue import get_persistence_queue
 from persona_core.types.core_types import PersonaRequest
 from persona_core.trace import TRACE_INCLUDE_TEXT, get_logger, preview_text, trace_event
+from persona_core import metrics
 
 from persona_core.memory.memory_orchestrator import (
     MemoryOrchestrator,
@@ -91,6 +94,14 @@ def _as_float(v: Any, default: float = 0.0) -> float:
     return float(default)
 
 
+def _req_trace_id(req: Any) -> Optional[str]:
+    try:
+        v = (getattr(req, "metadata", None) or {}).get("_trace_id")
+        return str(v) if v else None
+    except Exception:
+        return None
+
+
 # --------------------------------------------------------------
 # LLM client interface
 # --------------------------------------------------------------
@@ -141,6 +152,8 @@ class PersonaTurnResult:
     trait: TraitDriftResult
     global_state: GlobalStateContext
     meta: Dict[str, Any] = field(default_factory=dict)
+    # handle_turn_async で SafetyLayer を並列評価した場合の SafetyAssessment
+    safety: Optional[Any] = None
 
 
 # --------------------------------------------------------------
@@ -220,6 +233,37 @@ class PersonaController:
         self._trait_baseline = initial_trait_baseline or TraitState()
         self._prev_global_state: Optional[PersonaGlobalState] = None
 
+    def export_state(self) -> Dict[str, Any]:
+        """
+        ターン後の内部状態（server 側の常駐 state が次ターンの初期状態として持つ）。
+        value / trait / baseline は dict で返すので、controller 側の後続の書き換えとは独立。
+        """
+        out: Dict[str, Any] = {
+            "value": self._value_state.to_dict(),
+            "trait": self._trait_state.to_dict(),
+            "baseline": self._trait_baseline.to_dict(),
+            "ego": None,
+            "tid": None,
+        }
+        try:
+            if self._ego_state is not None:
+                out["ego"] = self._ego_state.to_dict()
+        except Exception:
+            pass
+        try:
+            if self._temporal_identity_state is not None:
+                out["tid"] = self._temporal_identity_state.to_dict()
+        except Exception:
+            pass
+        return out
+
+    def _state_snapshot_db(self, req: PersonaRequest) -> Any:
+        """value / trait snapshot の書き込み先（server が常駐 state で間引くターンは None）。"""
+        md = getattr(req, "metadata", None)
+        if isinstance(md, dict) and md.get("_skip_state_snapshots"):
+            return None
+        return self._db
+
     def _naturalness_get(self, *, session_id: str) -> NaturalnessState:
         sid = str(session_id or "").strip()
         if not sid:
@@ -330,6 +374,9 @@ class PersonaController:
         # Merge into external persona system (keep client persona intact, add as a late policy block).
         base = str(md.get("persona_system") or "").strip()
         merged = (base + "\n\n# Conversation Naturalness\n" + policy).strip() if base else policy
+        # Per-turn part kept separately so the LLM client can keep the client persona in its
+        # byte-stable prompt prefix and append this block after the volatile state (prompt caching).
+        tail = policy
 
         # Additional contract: only when external persona injection is active (avoid breaking other apps).
         try:
@@ -347,11 +394,14 @@ class PersonaController:
                     explicit_goal=goal,
                 )
                 merged = (merged + "\n\n" + contract).strip()
+                tail = (tail + "\n\n" + contract).strip()
                 if goal:
                     md["_explicit_goal"] = goal
         except Exception:
             pass
         md["persona_system"] = merged
+        md["_persona_system_base"] = base
+        md["_persona_system_policy"] = tail
 
         # Expose non-sensitive state (no full policy text in meta by default).
         out = {
@@ -707,6 +757,30 @@ class PersonaController:
         overload_score: Optional[float] = None,
         reward_signal: float = 0.0,
         affect_signal: Optional[Dict[str, float]] = None,
+        memory_result: Optional[MemorySelectionResult] = None,
+    ) -> PersonaTurnResult:
+        # metrics: 1 ターン分の計測範囲（handle_turn_async から呼ばれた場合は外側の scope を共有）
+        with metrics.turn_scope(mode="turn", trace_id=_req_trace_id(req)):
+            return self._handle_turn_impl(
+                req,
+                user_id=user_id,
+                safety_flag=safety_flag,
+                overload_score=overload_score,
+                reward_signal=reward_signal,
+                affect_signal=affect_signal,
+                memory_result=memory_result,
+            )
+
+    def _handle_turn_impl(
+        self,
+        req: PersonaRequest,
+        *,
+        user_id: Optional[str] = None,
+        safety_flag: Optional[str] = None,
+        overload_score: Optional[float] = None,
+        reward_signal: float = 0.0,
+        affect_signal: Optional[Dict[str, float]] = None,
+        memory_result: Optional[MemorySelectionResult] = None,
     ) -> PersonaTurnResult:
 
         # ------------------------------------------------------
@@ -776,7 +850,10 @@ class PersonaController:
         )
 
         # ---- 1) Memory selection ----
-        memory_result = self._select_memory(req=req, user_id=uid)
+        # handle_turn_async が並列に先行取得した場合はそれを使う
+        if memory_result is None:
+            memory_result = self._select_memory(req=req, user_id=uid)
+        t_marks["memory"] = time.perf_counter()
 
         meta["memory"] = {
             "pointer_count": len(memory_result.pointers),
@@ -821,6 +898,7 @@ class PersonaController:
             pass
 
         # ---- 3) Value drift ----
+        snapshot_db = self._state_snapshot_db(req)
         value_result = self._value.apply(
             current=self._value_state,
             req=req,
@@ -828,7 +906,7 @@ class PersonaController:
             identity=identity_result,
             reward_signal=reward_signal,
             safety_flag=safety_flag,
-            db=self._db,
+            db=snapshot_db,
             user_id=uid,
         )
         self._value_state = value_result.new_state
@@ -844,7 +922,7 @@ class PersonaController:
             identity=identity_result,
             value_state=self._value_state,
             affect_signal=affect_signal,
-            db=self._db,
+            db=snapshot_db,
             user_id=uid,
         )
         self._trait_state = trait_result.new_state
@@ -1469,6 +1547,10 @@ class PersonaController:
                 }
         except Exception:
             pass
+        try:
+            metrics.observe_turn(mode="turn", t0=t0, marks=t_marks, trace_id=turn_trace_id)
+        except Exception:
+            pass
 
         # v0 meta (compact, non-null)
         try:
@@ -1509,6 +1591,181 @@ class PersonaController:
             meta=meta,
         )
 
+    # ==========================================================
+    # async 版（独立ステージを並列実行）
+    # ==========================================================
+
+    async def handle_turn_async(
+        self,
+        req: PersonaRequest,
+        *,
+        user_id: Optional[str] = None,
+        safety_layer: Optional[Any] = None,
+        safety_flag: Optional[str] = None,
+        overload_score: Optional[float] = None,
+        reward_signal: float = 0.0,
+        affect_signal: Optional[Dict[str, float]] = None,
+        external_context: Optional[Awaitable[Optional[Dict[str, Any]]]] = None,
+    ) -> PersonaTurnResult:
+        """
+        handle_turn の asyncio ネイティブ版。
+
+        互いに依存しない前段ステージを並列に実行してから、残り（drift / FSM / LLM / 保存）を handle_turn で処理する:
+          - memory:   MemoryOrchestrator.select（episode store I/O + recall embedding）
+          - safety:   SafetyLayer.assess_async（async OpenAI client で embedding）
+          - external: 呼び出し側が渡す awaitable（例: Web RAG）。戻り値 dict を req.metadata にマージする
+
+        各ステージの開始/終了時刻は meta["async_stages"] と trace に残す（critical path の確認用）。
+        """
+        with metrics.turn_scope(mode="async", trace_id=_req_trace_id(req)):
+            return await self._handle_turn_async_impl(
+                req,
+                user_id=user_id,
+                safety_layer=safety_layer,
+                safety_flag=safety_flag,
+                overload_score=overload_score,
+                reward_signal=reward_signal,
+                affect_signal=affect_signal,
+                external_context=external_context,
+            )
+
+    async def _handle_turn_async_impl(
+        self,
+        req: PersonaRequest,
+        *,
+        user_id: Optional[str] = None,
+        safety_layer: Optional[Any] = None,
+        safety_flag: Optional[str] = None,
+        overload_score: Optional[float] = None,
+        reward_signal: float = 0.0,
+        affect_signal: Optional[Dict[str, float]] = None,
+        external_context: Optional[Awaitable[Optional[Dict[str, Any]]]] = None,
+    ) -> PersonaTurnResult:
+        log = get_logger(__name__)
+        trace_id: Optional[str]
+        try:
+            trace_id = (getattr(req, "metadata", None) or {}).get("_trace_id")
+        except Exception:
+            trace_id = None
+
+        uid: Optional[str] = user_id or self._config.default_user_id or getattr(req, "user_id", None)
+
+        t0 = time.perf_counter()
+        stages: Dict[str, Dict[str, Any]] = {}
+
+        async def _timed(name: str, aw: Awaitable[Any]) -> Any:
+            started = time.perf_counter()
+            ok = True
+            try:
+                return await aw
+            except Exception:
+                ok = False
+                raise
+            finally:
+                ended = time.perf_counter()
+                metrics.observe_stage(f"async_{name}", ended - started, mode="async", start_perf=started)
+                stages[name] = {
+                    "start_ms": round((started - t0) * 1000.0, 2),
+                    "end_ms": round((ended - t0) * 1000.0, 2),
+                    "ms": round((ended - started) * 1000.0, 2),
+                    "ok": ok,
+                }
+                if trace_id:
+                    trace_event(
+                        log,
+                        trace_id=str(trace_id),
+                        event=f"persona_controller.async_stage.{name}",
+                        fields=stages[name],
+                    )
+
+        names: list = ["memory"]
+        aws: list = [_timed("memory", asyncio.to_thread(self._select_memory, req=req, user_id=uid))]
+        if safety_layer is not None:
+            names.append("safety")
+            if hasattr(safety_layer, "assess_async"):
+                safety_aw = safety_layer.assess_async(
+                    req=req,
+                    value_state=self._value_state,
+                    trait_state=self._trait_state,
+                    memory=None,
+                )
+            else:
+                safety_aw = asyncio.to_thread(
+                    safety_layer.assess,
+                    req=req,
+                    value_state=self._value_state,
+                    trait_state=self._trait_state,
+                    memory=None,
+                )
+            aws.append(_timed("safety", safety_aw))
+        if external_context is not None:
+            names.append("external")
+            aws.append(_timed("external", external_context))
+
+        results = dict(zip(names, await asyncio.gather(*aws, return_exceptions=True)))
+
+        # memory: 失敗したら handle_turn 側で再取得させる
+        memory_result = results.get("memory")
+        if not isinstance(memory_result, MemorySelectionResult):
+            if isinstance(memory_result, Exception):
+                log.warning("async memory selection failed; retrying inline: %s", memory_result)
+            memory_result = None
+
+        md = req.metadata if isinstance(getattr(req, "metadata", None), dict) else None
+
+        ext = results.get("external")
+        if isinstance(ext, dict) and md is not None:
+            md.update(ext)
+
+        safety = results.get("safety")
+        if isinstance(safety, Exception):
+            # 並列評価が落ちても未チェックのまま生成しない: 生成前に 1 度だけ同期で再評価し、
+            # それも失敗したら（従来どおり）ターンごと失敗させる
+            log.warning("async safety assessment failed; retrying inline: %s", safety)
+            safety = await asyncio.to_thread(
+                safety_layer.assess,
+                req=req,
+                value_state=self._value_state,
+                trait_state=self._trait_state,
+                memory=None,
+            )
+        if safety is not None:
+            safety_flag = getattr(safety, "safety_flag", None)
+            if md is not None:
+                try:
+                    md["_safety_risk_score"] = float(getattr(safety, "risk_score", 0.0) or 0.0)
+                    md["_safety_flag"] = safety_flag
+                    md["_safety_categories"] = getattr(safety, "categories", {}) or {}
+                except Exception:
+                    pass
+
+        t_parallel = time.perf_counter()
+        result = await asyncio.to_thread(
+            self.handle_turn,
+            req,
+            user_id=uid,
+            safety_flag=safety_flag,
+            overload_score=overload_score,
+            reward_signal=reward_signal,
+            affect_signal=affect_signal,
+            memory_result=memory_result,
+        )
+        t_end = time.perf_counter()
+
+        try:
+            critical = max(stages.items(), key=lambda kv: float(kv[1].get("end_ms") or 0.0))[0] if stages else None
+            result.meta["async_stages"] = {
+                "parallel_ms": round((t_parallel - t0) * 1000.0, 2),
+                "turn_ms": round((t_end - t_parallel) * 1000.0, 2),
+                "total_ms": round((t_end - t0) * 1000.0, 2),
+                "critical_path": critical,
+                "stages": stages,
+            }
+        except Exception:
+            pass
+        result.safety = safety
+        return result
+
     def handle_turn_stream(
         self,
         req: PersonaRequest,
@@ -1519,11 +1776,36 @@ class PersonaController:
         reward_signal: float = 0.0,
         affect_signal: Optional[Dict[str, float]] = None,
         defer_persistence: bool = False,
+        memory_result: Optional[MemorySelectionResult] = None,
     ):
         """
         handle_turn のストリーミング版。
         逐次 `{"type":"delta","text":"..."}` を yield し、最後に `{"type":"done","result": PersonaTurnResult}` を yield する。
         """
+        with metrics.turn_scope(mode="stream", trace_id=_req_trace_id(req)):
+            yield from self._handle_turn_stream_impl(
+                req,
+                user_id=user_id,
+                safety_flag=safety_flag,
+                overload_score=overload_score,
+                reward_signal=reward_signal,
+                affect_signal=affect_signal,
+                defer_persistence=defer_persistence,
+                memory_result=memory_result,
+            )
+
+    def _handle_turn_stream_impl(
+        self,
+        req: PersonaRequest,
+        *,
+        user_id: Optional[str] = None,
+        safety_flag: Optional[str] = None,
+        overload_score: Optional[float] = None,
+        reward_signal: float = 0.0,
+        affect_signal: Optional[Dict[str, float]] = None,
+        defer_persistence: bool = False,
+        memory_result: Optional[MemorySelectionResult] = None,
+    ):
 
         log = get_logger(__name__)
         trace_id: Optional[str]
@@ -1572,8 +1854,8 @@ class PersonaController:
         )
 
         # ---- 1) Memory selection ----
-        memory_result = self._select_memory(req=req, user_id=uid)
-        t_marks["memory"] = time.perf_counter()
+        if memory_result is None:
+            memory_result = self._select_memory(req=req, user_id=uid)
         t_marks["memory"] = time.perf_counter()
         meta["memory"] = {
             "pointer_count": len(memory_result.pointers),
@@ -1613,7 +1895,7 @@ class PersonaController:
             pass
 
         # ---- 3) Value drift ----
-        drift_db = None if defer_persistence else self._db
+        drift_db = None if defer_persistence else self._state_snapshot_db(req)
         value_result = self._value.apply(
             current=self._value_state,
             req=req,
@@ -2128,6 +2410,7 @@ class PersonaController:
 
         # ---- 6) LLM (stream) ----
         parts: list[str] = []
+        t_first_delta: Optional[float] = None
         memory_for_llm = self._memory_for_llm(req=req, memory_result=memory_result)
         try:
             if hasattr(self._llm, "generate_stream"):
@@ -2142,6 +2425,8 @@ class PersonaController:
                     if not chunk:
                         continue
                     parts.append(str(chunk))
+                    if t_first_delta is None:
+                        t_first_delta = time.perf_counter()
                     yield {"type": "delta", "text": str(chunk)}
             else:
                 text = self._call_llm(
@@ -2153,6 +2438,7 @@ class PersonaController:
                     global_state=global_state_ctx,
                 )
                 parts.append(text)
+                t_first_delta = time.perf_counter()
                 yield {"type": "delta", "text": text}
         except Exception as e:
             _trace("llm_error", {"error": str(e)})
@@ -2211,166 +2497,150 @@ class PersonaController:
 
         def _persist_async() -> None:
             try:
-                trace_id_local: Optional[str]
-                try:
-                    trace_id_local = (getattr(req, "metadata", None) or {}).get("_trace_id")
-                except Exception:
-                    trace_id_local = None
-
-                # ---- snapshots (if supported) ----
-                if self._db is not None:
-                    try:
-                        if hasattr(self._db, "store_value_snapshot"):
-                            self._db.store_value_snapshot(
-                                user_id=uid,
-                                state=value_result.new_state.to_dict(),
-                                delta=value_result.delta,
-                                meta={
-                                    "trace_id": trace_id_local,
-                                    "session_id": getattr(req, "session_id", None),
-                                    "identity_context": (identity_result.identity_context or {}),
-                                    "global_state": (
-                                        global_state_ctx.to_dict()
-                                        if hasattr(global_state_ctx, "to_dict")
-                                        else {"state": getattr(global_state_ctx, "state", None)}
-                                    ),
-                                    "memory": memory_result.raw or {},
-                                },
-                            )
-                    except Exception:
-                        pass
-                    try:
-                        if hasattr(self._db, "store_trait_snapshot"):
-                            self._db.store_trait_snapshot(
-                                user_id=uid,
-                                state=trait_result.new_state.to_dict(),
-                                delta=trait_result.delta,
-                                meta={
-                                    "trace_id": trace_id_local,
-                                    "session_id": getattr(req, "session_id", None),
-                                    "identity_context": (identity_result.identity_context or {}),
-                                    "global_state": (
-                                        global_state_ctx.to_dict()
-                                        if hasattr(global_state_ctx, "to_dict")
-                                        else {"state": getattr(global_state_ctx, "state", None)}
-                                    ),
-                                    "memory": memory_result.raw or {},
-                                    "baseline": self._trait_baseline.to_dict(),
-                                    "baseline_delta": baseline_delta,
-                                },
-                            )
-                    except Exception:
-                        pass
-
-                    try:
-                        if telemetry is not None and hasattr(self._db, "store_telemetry_snapshot"):
-                            self._db.store_telemetry_snapshot(
-                                user_id=uid,
-                                session_id=getattr(req, "session_id", None),
-                                scores=getattr(telemetry, "scores", None) or {},
-                                ema=getattr(telemetry, "ema", None) or {},
-                                flags=getattr(telemetry, "flags", None) or {},
-                                reasons=getattr(telemetry, "reasons", None) or {},
-                                meta={"trace_id": trace_id_local},
-                            )
-                    except Exception:
-                        pass
-
-                    try:
-                        if (
-                            ego_state_to_persist is not None
-                            and ego_id_to_persist is not None
-                            and ego_version_to_persist is not None
-                            and hasattr(self._db, "store_ego_snapshot")
-                        ):
-                            self._db.store_ego_snapshot(
-                                user_id=uid,
-                                session_id=getattr(req, "session_id", None),
-                                ego_id=ego_id_to_persist,
-                                version=int(ego_version_to_persist),
-                                state=ego_state_to_persist,
-                                meta={"trace_id": trace_id_local},
-                            )
-                    except Exception:
-                        pass
-
-                    # ---- Phase02 snapshots (best-effort) ----
-                    try:
-                        if (
-                            tid_state_to_persist is not None
-                            and hasattr(self._db, "store_temporal_identity_snapshot")
-                        ):
-                            self._db.store_temporal_identity_snapshot(
-                                user_id=uid,
-                                session_id=getattr(req, "session_id", None),
-                                trace_id=trace_id_local,
-                                ego_id=str((tid_state_to_persist or {}).get("ego_id") or ""),
-                                state=tid_state_to_persist,
-                                telemetry=((meta.get("integration") or {}).get("temporal_identity") or {}),
-                            )
-                    except Exception:
-                        pass
-
-                    try:
-                        if subjectivity_to_persist is not None and hasattr(self._db, "store_subjectivity_snapshot"):
-                            self._db.store_subjectivity_snapshot(
-                                user_id=uid,
-                                session_id=getattr(req, "session_id", None),
-                                trace_id=trace_id_local,
-                                subjectivity=subjectivity_to_persist,
-                            )
-                    except Exception:
-                        pass
-
-                    try:
-                        if failure_to_persist is not None and hasattr(self._db, "store_failure_snapshot"):
-                            self._db.store_failure_snapshot(
-                                user_id=uid,
-                                session_id=getattr(req, "session_id", None),
-                                trace_id=trace_id_local,
-                                failure=failure_to_persist,
-                            )
-                    except Exception:
-                        pass
-
-                    try:
-                        if identity_snapshot_to_persist is not None and hasattr(self._db, "store_identity_snapshot"):
-                            self._db.store_identity_snapshot(
-                                user_id=uid,
-                                session_id=getattr(req, "session_id", None),
-                                trace_id=trace_id_local,
-                                snapshot=identity_snapshot_to_persist,
-                            )
-                    except Exception:
-                        pass
-
+                with self._db_write_batch():
+                    trace_id_local: Optional[str]
                     try:
-                        if integration_events_to_persist is not None and hasattr(self._db, "store_integration_events"):
-                            self._db.store_integration_events(
-                                user_id=uid,
-                                session_id=getattr(req, "session_id", None),
-                                trace_id=trace_id_local,
-                                events=integration_events_to_persist,
-                            )
+                        trace_id_local = (getattr(req, "metadata", None) or {}).get("_trace_id")
                     except Exception:
-                        pass
-
-                # ---- episodes / embeddings / storage ----
-                self._store_episode(
-                    user_id=uid,
-                    req=req,
-                    reply_text=reply_text,
-                    memory_result=memory_result,
-                    identity_result=identity_result,
-                    global_state=global_state_ctx,
-                )
+                        trace_id_local = None
+
+                    # ---- snapshots (if supported) ----
+                    if self._db is not None:
+                        # value / trait は常駐 state 側で間引かれることがある（_skip_state_snapshots）
+                        skip_state = self._state_snapshot_db(req) is None
+                        try:
+                            if not skip_state and hasattr(self._db, "store_value_snapshot"):
+                                self._db.store_value_snapshot(
+                                    user_id=uid,
+                                    state=value_result.new_state.to_dict(),
+                                    delta=value_result.delta,
+                                    meta={
+                                        "trace_id": trace_id_local,
+                                        "session_id": getattr(req, "session_id", None),
+                                        "identity_context": (identity_result.identity_context or {}),
+                                        "global_state": (
+                                            global_state_ctx.to_dict()
+                                            if hasattr(global_state_ctx, "to_dict")
+                                            else {"state": getattr(global_state_ctx, "state", None)}
+                                        ),
+                                        "memory": memory_result.raw or {},
+                                    },
+                                )
+                            if not skip_state and hasattr(self._db, "store_trait_snapshot"):
+                                self._db.store_trait_snapshot(
+                                    user_id=uid,
+                                    state=trait_result.new_state.to_dict(),
+                                    delta=trait_result.delta,
+                                    meta={
+                                        "trace_id": trace_id_local,
+                                        "session_id": getattr(req, "session_id", None),
+                                        "identity_context": (identity_result.identity_context or {}),
+                                        "global_state": (
+                                            global_state_ctx.to_dict()
+                                            if hasattr(global_state_ctx, "to_dict")
+                                            else {"state": getattr(global_state_ctx, "state", None)}
+                                        ),
+                                        "memory": memory_result.raw or {},
+                                        "baseline": self._trait_baseline.to_dict(),
+                                        "baseline_delta": baseline_delta,
+                                    },
+                                )
+
+                            if telemetry is not None and hasattr(self._db, "store_telemetry_snapshot"):
+                                self._db.store_telemetry_snapshot(
+                                    user_id=uid,
+                                    session_id=getattr(req, "session_id", None),
+                                    scores=getattr(telemetry, "scores", None) or {},
+                                    ema=getattr(telemetry, "ema", None) or {},
+                                    flags=getattr(telemetry, "flags", None) or {},
+                                    reasons=getattr(telemetry, "reasons", None) or {},
+                                    meta={"trace_id": trace_id_local},
+                                )
+
+                            if (
+                                ego_state_to_persist is not None
+                                and ego_id_to_persist is not None
+                                and ego_version_to_persist is not None
+                                and hasattr(self._db, "store_ego_snapshot")
+                            ):
+                                self._db.store_ego_snapshot(
+                                    user_id=uid,
+                                    session_id=getattr(req, "session_id", None),
+                                    ego_id=ego_id_to_persist,
+                                    version=int(ego_version_to_persist),
+                                    state=ego_state_to_persist,
+                                    meta={"trace_id": trace_id_local},
+                                )
+
+                            # ---- Phase02 snapshots ----
+                            if (
+                                tid_state_to_persist is not None
+                                and hasattr(self._db, "store_temporal_identity_snapshot")
+                            ):
+                                self._db.store_temporal_identity_snapshot(
+                                    user_id=uid,
+                                    session_id=getattr(req, "session_id", None),
+                                    trace_id=trace_id_local,
+                                    ego_id=str((tid_state_to_persist or {}).get("ego_id") or ""),
+                                    state=tid_state_to_persist,
+                                    telemetry=((meta.get("integration") or {}).get("temporal_identity") or {}),
+                                )
+
+                            if subjectivity_to_persist is not None and hasattr(self._db, "store_subjectivity_snapshot"):
+                                self._db.store_subjectivity_snapshot(
+                                    user_id=uid,
+                                    session_id=getattr(req, "session_id", None),
+                                    trace_id=trace_id_local,
+                                    subjectivity=subjectivity_to_persist,
+                                )
+
+                            if failure_to_persist is not None and hasattr(self._db, "store_failure_snapshot"):
+                                self._db.store_failure_snapshot(
+                                    user_id=uid,
+                                    session_id=getattr(req, "session_id", None),
+                                    trace_id=trace_id_local,
+                                    failure=failure_to_persist,
+                                )
+
+                            if identity_snapshot_to_persist is not None and hasattr(self._db, "store_identity_snapshot"):
+                                self._db.store_identity_snapshot(
+                                    user_id=uid,
+                                    session_id=getattr(req, "session_id", None),
+                                    trace_id=trace_id_local,
+                                    snapshot=identity_snapshot_to_persist,
+                                )
+
+                            if integration_events_to_persist is not None and hasattr(self._db, "store_integration_events"):
+                                self._db.store_integration_events(
+                                    user_id=uid,
+                                    session_id=getattr(req, "session_id", None),
+                                    trace_id=trace_id_local,
+                                    events=integration_events_to_persist,
+                                )
+                        except Exception:
+                            # write_batch 中の store_* はバッファに積むだけ。DB 側の失敗は flush 時に外側で 1 回だけログされる
+                            log.exception("snapshot persistence failed")
+
+                    # ---- episodes / embeddings / storage ----
+                    self._store_episode(
+                        user_id=uid,
+                        req=req,
+                        reply_text=reply_text,
+                        memory_result=memory_result,
+                        identity_result=identity_result,
+                        global_state=global_state_ctx,
+                    )
             except Exception:
                 # Best-effort; never break streaming caller.
                 log.exception("deferred persistence failed")
 
         if defer_persistence:
-            threading.Thread(target=_persist_async, daemon=True).start()
-            _trace("stored_deferred", None)
+            # 固定ワーカー + 上限付きキューで処理（Supabase が遅くてもターンごとにスレッドを積まない）
+            # scope=user_id: 次ターンの DB 読み直しはこのジョブの完了を待つ（read-after-write）
+            accepted = get_persistence_queue().submit(
+                _persist_async, label="turn_snapshots", scope=(str(uid) if uid else None)
+            )
+            _trace("stored_deferred", {"accepted": bool(accepted)})
         else:
             self._store_episode(
                 user_id=uid,
@@ -2433,6 +2703,10 @@ class PersonaController:
                 }
         except Exception:
             pass
+        try:
+            metrics.observe_turn(mode="stream", t0=t0, marks=t_marks, trace_id=turn_trace_id, first_delta=t_first_delta)
+        except Exception:
+            pass
 
         # v0 meta (compact, non-null)
         try:
@@ -2568,6 +2842,15 @@ class PersonaController:
     # Episode / DB 保存
     # ==========================================================
 
+    def _db_write_batch(self):
+        """
+        PersonaDB が write_batch() を持つ場合（SupabasePersonaDB）、
+        1 ターン分のスナップショット書き込みをテーブル単位の bulk insert にまとめる。
+        """
+        if self._db is not None and hasattr(self._db, "write_batch"):
+            return self._db.write_batch()
+        return contextlib.nullcontext()
+
     def _store_episode(
         self,
         *,
@@ -0,0 +1,418 @@
+"""
+persona_core.intent_classifier
+
+/persona/intent の cheap-first カスケード（LLM より前の 2 段）。
+
+1) rules: 正規化（NFKC + lower）したテキストを 1 パスで走査する Aho-Corasick オートマトン。
+   旧 `_intent_fast_path` の正規表現（挨拶/相槌/2択/箇条書き/safety/meta）と同じ判定を、
+   起動時に 1 回だけ組んだ辞書で行う（リクエスト毎の re コンパイル/多段 re.search をしない）
+2) centroid: 埋め込みの nearest-centroid。ラベル毎の seed 例文（+ 高信頼 LLM 判定からのオンライン更新）
+   の平均ベクトルとの cosine を softmax し、confidence が閾値未満なら None（= LLM へ escalate）
+
+どちらも PersonaIntentResponse 互換の dict を返す（pydantic 依存はサーバ側に置く）。
+"""
+
+from __future__ import annotations
+
+import math
+import threading
+import time
+import unicodedata
+from dataclasses import dataclass
+from typing import Any, Callable, Dict, Iterable, List, Optional, Sequence, Tuple
+
+
+def normalize(text: str) -> str:
+    return unicodedata.normalize("NFKC", text or "").lower()
+
+
+# =========================================================
+# Aho-Corasick
+# =========================================================
+
+# boundary modes
+_B_NONE = 0
+_B_WORD = 1  # regex \b 相当（前後が英数字/和文字/_ ではない）
+_B_ASCII = 2  # 前後が ASCII 英字ではない（"od" が "good" に当たらないように）
+
+
+def _is_word(ch: str) -> bool:
+    return ch.isalnum() or ch == "_"
+
+
+def _is_ascii_alpha(ch: str) -> bool:
+    return ("a" <= ch <= "z") or ("A" <= ch <= "Z")
+
+
+class KeywordAutomaton:
+    """
+    keyword -> group の多パターン照合。scan() は 1 パスでヒットした group の集合を返す。
+    構築後は読み取り専用なのでスレッド間で共有してよい。
+    """
+
+    def __init__(self, patterns: Iterable[Tuple[str, str, int]]) -> None:
+        # node: goto dict / fail / outputs [(length, group, boundary)]
+        self._goto: List[Dict[str, int]] = [{}]
+        self._fail: List[int] = [0]
+        self._out: List[List[Tuple[int, str, int]]] = [[]]
+        for keyword, group, boundary in patterns:
+            kw = normalize(keyword)
+            if not kw:
+                continue
+            node = 0
+            for ch in kw:
+                nxt = self._goto[node].get(ch)
+                if nxt is None:
+                    nxt = len(self._goto)
+                    self._goto.append({})
+                    self._fail.append(0)
+                    self._out.append([])
+                    self._goto[node][ch] = nxt
+                node = nxt
+            self._out[node].append((len(kw), group, int(boundary)))
+        self._build()
+
+    def _build(self) -> None:
+        queue: List[int] = []
+        for nxt in self._goto[0].values():
+            self._fail[nxt] = 0
+            queue.append(nxt)
+        head = 0
+        while head < len(queue):
+            node = queue[head]
+            head += 1
+            for ch, nxt in self._goto[node].items():
+                queue.append(nxt)
+                f = self._fail[node]
+                while f and ch not in self._goto[f]:
+                    f = self._fail[f]
+                cand = self._goto[f].get(ch, 0)
+                self._fail[nxt] = cand if cand != nxt else 0
+                self._out[nxt] = self._out[nxt] + self._out[self._fail[nxt]]
+
+    def scan(self, text: str) -> set:
+        """text は normalize() 済みであること。"""
+        hits: set = set()
+        goto = self._goto
+        fail = self._fail
+        out = self._out
+        node = 0
+        n = len(text)
+        for i, ch in enumerate(text):
+            while node and ch not in goto[node]:
+                node = fail[node]
+            node = goto[node].get(ch, 0)
+            if not out[node]:
+                continue
+            for length, group, boundary in out[node]:
+                if group in hits:
+                    continue
+                if boundary:
+                    start = i - length + 1
+                    before = text[start - 1] if start > 0 else ""
+                    after = text[i + 1] if i + 1 < n else ""
+                    test = _is_word if boundary == _B_WORD else _is_ascii_alpha
+                    if (before and test(before)) or (after and test(after)):
+                        continue
+                hits.add(group)
+        return hits
+
+
+# =========================================================
+# Tier 1: rules
+# =========================================================
+
+_PHATIC_WORDS = (
+    "元気", "げんき", "調子", "調子どう", "最近どう", "最近どうよ", "こんにちは", "こんばんは",
+    "おはよう", "おはよ", "やあ", "やっほ", "やっほー", "もしもし", "どうも", "暇", "ひま",
+)
+_ACK_WORDS = ("了解", "りょうかい", "ok", "おけ", "わかった", "分かった", "ありがと", "ありがとう", "サンキュー", "thanks", "thx")
+_PHATIC_SET = frozenset(normalize(w) for w in _PHATIC_WORDS)
+_ACK_SET = frozenset(normalize(w) for w in _ACK_WORDS)
+# NFKC 後の末尾記号（旧: [？\?!！。．…]* / 相槌は ? なし）
+_PHATIC_TAIL = "?!。.…"
+_ACK_TAIL = "!。.…"
+_PHATIC_PREFIXES = tuple(normalize(p) for p in ("霊夢、", "霊夢,", "霊夢"))
+
+_SAFETY_WORDS = (
+    "自殺", "死にたい", "消えたい", "リスカ", "オーバードーズ", "殺す", "爆破", "銃",
+    "薬の売買", "違法", "児童", "強姦", "レイプ", "近親相姦",
+)
+_META_WORDS = (
+    "ai", "llm", "prompt", "system prompt", "system", "モデル", "プロンプト", "指示",
+    "ガードレール", "openai", "api", "token",
+)
+
+_RULES = KeywordAutomaton(
+    [(w, "choice", _B_NONE) for w in ("2択", "二択", "A)", "B)")]
+    + [(w, "bullet", _B_NONE) for w in ("箇条書き", "リストで", "列挙して")]
+    + [(w, "three", _B_NONE) for w in ("3つ", "三つ", "3個", "三個", "3点", "三点", "3項", "三項")]
+    + [(w, "safety", _B_NONE) for w in _SAFETY_WORDS]
+    + [("od", "safety", _B_ASCII)]
+    + [(w, "meta", _B_WORD) for w in _META_WORDS]
+)
+
+
+def _resp(intent: str, confidence: float, **kw: Any) -> Dict[str, Any]:
+    out: Dict[str, Any] = {
+        "intent": intent,
+        "confidence": float(confidence),
+        "output_style": "normal",
+        "allowed_humor": True,
+        "urgency": "normal",
+        "needs_clarify": False,
+        "clarify_question": "",
+        "safety_risk": "none",
+    }
+    out.update(kw)
+    return out
+
+
+def match_rules(user_text: str) -> Optional[Dict[str, Any]]:
+    """Tier 1. ヒットしなければ None。"""
+    t = (user_text or "").strip()
+    if not t:
+        return _resp("unclear", 0.0, needs_clarify=True)
+
+    norm = normalize(t)
+    groups = _RULES.scan(norm)
+
+    # Phatic / greetings / check-ins (avoid misclassifying as "unclear")
+    # Examples: "元気？", "こんにちは", "最近どう？", "暇？"
+    raw_compact = "".join(t.split())
+    if len(raw_compact) <= 24:
+        compact = "".join(norm.split())
+        body = compact
+        for p in _PHATIC_PREFIXES:
+            if body.startswith(p) and body != p:
+                body = body[len(p):]
+                break
+        if body.rstrip(_PHATIC_TAIL) in _PHATIC_SET or compact.rstrip(_PHATIC_TAIL) in _PHATIC_SET:
+            return _resp("chitchat", 1.0, urgency="low")
+        # Formatting requests: encourage stable output_style without LLM ambiguity.
+        if "choice" in groups:
+            return _resp("advice", 0.95, output_style="choice_2")
+        if "bullet" in groups and "three" in groups:
+            return _resp("task", 0.95, output_style="bullet_3")
+        if compact.rstrip(_ACK_TAIL) in _ACK_SET:
+            return _resp("chitchat", 0.9, urgency="low")
+
+    if "safety" in groups:
+        return _resp("safety", 1.0, allowed_humor=False, urgency="high", safety_risk="high")
+    if "meta" in groups:
+        return _resp("meta", 1.0, allowed_humor=False)
+    return None
+
+
+# =========================================================
+# Tier 2: embedding nearest-centroid
+# =========================================================
+
+# safety / meta は rules（と LLM）だけが決める。unclear は clarify 質問が要るので LLM に任せる。
+DEFAULT_SEEDS: Dict[str, Tuple[str, ...]] = {
+    "chitchat": (
+        "今日はいい天気だね",
+        "最近ちょっと忙しくてさ",
+        "昨日カレー作ったんだ",
+        "週末なにしてた？",
+        "お茶でも飲もうか",
+    ),
+    "banter": (
+        "それ本気で言ってる？ウケる",
+        "また賽銭箱空っぽなんでしょ",
+        "ふーん、ずいぶん偉そうじゃない",
+        "からかわないでよ、もう",
+        "どうせまたサボってたんでしょ",
+    ),
+    "advice": (
+        "どうしたらいいと思う？",
+        "転職するか迷ってる、相談に乗ってほしい",
+        "勉強が続かないんだけどコツある？",
+        "友達と喧嘩したんだけど謝るべきかな",
+        "AとBどっちを選ぶべきか悩んでる",
+    ),
+    "task": (
+        "この文章を短く書き直して",
+        "Pythonでファイルを読み込むコードを書いて",
+        "メールの下書きを作って",
+        "この手順を要約して",
+        "英語に翻訳して",
+    ),
+    "lore": (
+        "博麗神社ってどんな場所？",
+        "幻想郷の結界について教えて",
+        "魔理沙とはどういう関係なの？",
+        "スペルカードルールって何？",
+        "紅魔館には誰が住んでるの？",
+    ),
+    "roleplay_scene": (
+        "神社の縁側に座って話しかける",
+        "（扉を開けて中に入る）お邪魔します",
+        "一緒に人里まで歩いていこう",
+        "*境内を掃除している霊夢に近づく*",
+        "宴会の準備を手伝うよ",
+    ),
+    "incident": (
+        "空が真っ赤な霧に覆われてる！",
+        "里で妙な事件が起きてるらしい",
+        "春が来ないまま雪が降り続いてる",
+        "夜が明けない、これって異変？",
+        "妖怪が急に暴れ出したんだけど",
+    ),
+}
+
+# centroid だけで答えてよいラベル（安全/確認/文体の判断が要らない低リスクなもの）と、その既定値。
+# 他のラベルは centroid に近くても LLM tier に回す（centroid は判別用にだけ持つ）。
+_LABEL_DEFAULTS: Dict[str, Dict[str, Any]] = {
+    "chitchat": {"urgency": "low"},
+    "banter": {"urgency": "low"},
+}
+
+
+@dataclass
+class CentroidResult:
+    label: str
+    confidence: float
+    top_sim: float
+    vector: List[float]
+
+    def accepted(self, threshold: float, min_sim: float) -> bool:
+        return self.confidence >= threshold and self.top_sim >= min_sim
+
+
+def _unit(v: Sequence[float]) -> Optional[List[float]]:
+    n = math.sqrt(sum(x * x for x in v)) if v else 0.0
+    if n <= 0.0:
+        return None
+    return [x / n for x in v]
+
+
+class CentroidIntentClassifier:
+    """
+    ラベル毎の単位ベクトル和（running sum）を持ち、cosine → softmax(温度 temperature) で confidence を出す。
+    encode_many は OpenAILLMClient.encode_many（LRU + 共有キャッシュ付き）を想定。
+    """
+
+    def __init__(
+        self,
+        encode_many: Callable[[List[str]], List[List[float]]],
+        *,
+        seeds: Optional[Dict[str, Sequence[str]]] = None,
+        temperature: float = 0.05,
+        max_learned_per_label: int = 200,
+        retry_sec: float = 60.0,
+    ) -> None:
+        self._encode_many = encode_many
+        self._seeds = {k: tuple(v) for k, v in (seeds or DEFAULT_SEEDS).items() if v}
+        self._temperature = max(1e-3, float(temperature))
+        self._max_learned = max(0, int(max_learned_per_label))
+        self._retry_sec = float(retry_sec)
+        self._lock = threading.Lock()
+        self._sums: Dict[str, List[float]] = {}
+        self._counts: Dict[str, int] = {}
+        self._learned: Dict[str, int] = {}
+        self._centroids: Dict[str, List[float]] = {}
+        self._ready = False
+        self._failed_at = 0.0
+
+    @property
+    def labels(self) -> Tuple[str, ...]:
+        return tuple(self._seeds.keys())
+
+    def _ensure(self) -> bool:
+        if self._ready:
+            return True
+        if self._failed_at and (time.monotonic() - self._failed_at) < self._retry_sec:
+            return False
+        with self._lock:
+            if self._ready:
+                return True
+            flat: List[Tuple[str, str]] = [(label, s) for label, ss in self._seeds.items() for s in ss]
+            try:
+                vecs = self._encode_many([s for _, s in flat])
+            except Exception:
+                vecs = []
+            sums: Dict[str, List[float]] = {}
+            counts: Dict[str, int] = {}
+            for (label, _), v in zip(flat, vecs):
+                u = _unit(v)
+                if u is None:
+                    continue
+                acc = sums.get(label)
+                if acc is None or len(acc) != len(u):
+                    sums[label] = list(u)
+                    counts[label] = 1
+                else:
+                    for i, x in enumerate(u):
+                        acc[i] += x
+                    counts[label] = counts.get(label, 0) + 1
+            if len(sums) < 2:
+                # embedding 未設定/失敗（ゼロベクトル）: しばらく再試行しない
+                self._failed_at = time.monotonic()
+                return False
+            self._sums = sums
+            self._counts = counts
+            self._centroids = {k: (_unit(v) or v) for k, v in sums.items()}
+            self._ready = True
+            return True
+
+    def classify(self, text: str) -> Optional[CentroidResult]:
+        t = (text or "").strip()
+        if not t or not self._ensure():
+            return None
+        try:
+            vec = self._encode_many([t[:1200]])[0]
+        except Exception:
+            return None
+        u = _unit(vec)
+        if u is None:
+            return None
+        centroids = self._centroids
+        sims: List[Tuple[float, str]] = []
+        for label, c in centroids.items():
+            if len(c) != len(u):
+                continue
+            sims.append((sum(a * b for a, b in zip(u, c)), label))
+        if len(sims) < 2:
+            return None
+        sims.sort(reverse=True)
+        top = sims[0][0]
+        denom = sum(math.exp((s - top) / self._temperature) for s, _ in sims)
+        conf = 1.0 / denom if denom > 0 else 0.0
+        return CentroidResult(label=sims[0][1], confidence=round(conf, 4), top_sim=round(top, 4), vector=u)
+
+    def learn(self, vector: Sequence[float], label: str) -> None:
+        """高信頼の LLM 判定を centroid に取り込む（ラベル毎に上限あり）。"""
+        if label not in self._seeds or not self._ready:
+            return
+        u = _unit(vector)
+        if u is None:
+            return
+        with self._lock:
+            if self._learned.get(label, 0) >= self._max_learned:
+                return
+            acc = self._sums.get(label)
+            if acc is None or len(acc) != len(u):
+                return
+            for i, x in enumerate(u):
+                acc[i] += x
+            self._counts[label] = self._counts.get(label, 0) + 1
+            self._learned[label] = self._learned.get(label, 0) + 1
+            self._centroids = {**self._centroids, label: (_unit(acc) or acc)}
+
+    def answers(self, result: CentroidResult, threshold: float, min_sim: float) -> bool:
+        """LLM を飛ばしてこの tier で返してよいか（低リスクラベルかつ高信頼のときだけ）。"""
+        return result.label in _LABEL_DEFAULTS and result.accepted(threshold, min_sim)
+
+    def response(self, result: CentroidResult) -> Dict[str, Any]:
+        if result.label not in _LABEL_DEFAULTS:
+            raise ValueError(f"centroid tier does not answer label {result.label!r}")
+        return _resp(result.label, float(result.confidence), **_LABEL_DEFAULTS[result.label])
+
+    def stats(self) -> Dict[str, Any]:
+        return {
+            "ready": bool(self._ready),
+            "labels": len(self._centroids),
+            "examples": dict(self._counts),
+            "learned": dict(self._learned),
+        }
@@ -1,13 +1,15 @@
 # gensokyo-persona-core/persona_core/llm/openai_llm_client.py
 # ----------------------------------------------------
 # Persona OS 用 OpenAI LLM クライアント
-# - embedding: SelectiveRecall 等で使用
+# - embedding: SelectiveRecall 等で使用（encode_many で batched 取得 + in-flight coalescing）
 # - generate: 通常応答
 # - generate_stream: ストリーミング応答（SSE等で利用）
 # ----------------------------------------------------
 
 from __future__ import annotations
 
+import asyncio
+import contextvars
 import json
 import logging
 import math
@@ -16,16 +18,31 @@ import random
 import time
 import hashlib
 import threading
-from typing import Any, Dict, Iterable, List, Optional
+from array import array
+from concurrent.futures import Future, ThreadPoolExecutor
+from typing import Any, Dict, Generator, Iterable, Iterator, List, Optional
 
 import openai
 from openai import OpenAI
 
+try:
+    from openai import AsyncOpenAI
+except Exception:  # pragma: no cover
+    AsyncOpenAI = None  # type: ignore
+
+try:
+    import redis as _redis  # optional: worker 間で embedding キャッシュを共有
+except Exception:  # pragma: no cover
+    _redis = None  # type: ignore
+
 from persona_core.controller.persona_controller import LLMClientLike
 from persona_core.identity.identity_continuity import IdentityContinuityResult
 from persona_core.memory.memory_orchestrator import MemorySelectionResult
 from persona_core.state.global_state_machine import GlobalStateContext, PersonaGlobalState
 from persona_core.trait.trait_drift_engine import TraitState
+from persona_core import metrics
+from persona_core.llm.prompt_assembly import EXTERNAL_KNOWLEDGE_RULES, AssembledPrompt, PromptAssembler
+from persona_core.ttl_cache import LRUTTLCache
 from persona_core.types.core_types import PersonaRequest
 from persona_core.value.value_drift_engine import ValueState
 
@@ -41,6 +58,20 @@ def cosine_similarity(a: List[float], b: List[float]) -> float:
     return dot / (na * nb)
 
 
+def _close_stream(stream: Any) -> None:
+    """OpenAI SDK の Stream を閉じる（新しい SDK は close()、古いものは response.close()）。"""
+    try:
+        close = getattr(stream, "close", None)
+        if callable(close):
+            close()
+            return
+        resp = getattr(stream, "response", None)
+        if resp is not None and callable(getattr(resp, "close", None)):
+            resp.close()
+    except Exception:
+        pass
+
+
 class OpenAILLMClient(LLMClientLike):
     def __init__(
         self,
@@ -51,6 +82,7 @@ class OpenAILLMClient(LLMClientLike):
         max_tokens_cap: Optional[int] = None,
         api_key: Optional[str] = None,
         client: Optional[OpenAI] = None,
+        async_client: Optional[Any] = None,
         embedding_model: str = "text-embedding-3-small",
         request_timeout_sec: float = 60.0,
         max_retries: int = 3,
@@ -77,57 +109,267 @@ class OpenAILLMClient(LLMClientLike):
             self.client = client
         else:
             self.client = OpenAI(api_key=api_key or os.getenv("OPENAI_API_KEY"), timeout=self._timeout_sec)
+        # async client は handle_turn_async 経路でのみ使うので遅延生成
+        self._api_key = api_key
+        self._async_client = async_client
+        self._client_injected = client is not None
+        self._async_client_lock = threading.Lock()
+
+        # quality pipeline（非ストリーム生成）を擬似ストリーム化するときの分割サイズ（文字数）
+        try:
+            self._stream_chunk_chars = max(1, int(os.getenv("SIGMARIS_STREAM_CHUNK_CHARS", "220") or "220"))
+        except Exception:
+            self._stream_chunk_chars = 220
 
         self._fallback_dim = 1536
         self._embed_cache_ttl_sec = float(os.getenv("SIGMARIS_EMBED_CACHE_TTL_SEC", "15") or "15")
         self._embed_cache_max = int(os.getenv("SIGMARIS_EMBED_CACHE_MAX", "512") or "512")
         self._embed_cache_max = max(0, min(10000, self._embed_cache_max))
-        self._embed_cache: Dict[str, Dict[str, Any]] = {}  # key -> {"ts": float, "emb": list[float]}
-        self._embed_cache_lock = threading.Lock()
+        # key -> array('f')（float32: list[float] の約 1/7 のメモリ）
+        self._embed_cache: LRUTTLCache[array] = LRUTTLCache(
+            max_items=self._embed_cache_max, ttl_sec=self._embed_cache_ttl_sec, name="embedding"
+        )
+        self._embed_batch_max = max(1, min(2048, int(os.getenv("SIGMARIS_EMBED_BATCH_MAX", "256") or "256")))
+        self._embed_inflight: Dict[str, Future] = {}  # key -> Future[list[float]]（取得中）
+        self._embed_inflight_lock = threading.Lock()
+        self._shared_cache: Any = None  # None=未初期化 / False=無効 / redis client
+
+        # system prompt: 静的 prefix（メモ化）+ volatile。provider が未対応の引数は初回エラーで以後外す。
+        self._prompts = PromptAssembler()
+        self._send_prompt_cache_key = True
+        self._send_stream_usage = True
+        self._judge_pool: Optional[ThreadPoolExecutor] = None
 
     # --------------------------
     # Embeddings
     # --------------------------
 
-    def encode(self, text: str) -> List[float]:
-        t = (text or "").strip()
-        k: Optional[str] = None
+    def _embed_key(self, t: str) -> str:
+        return hashlib.sha256(t.encode("utf-8", errors="ignore")).hexdigest()
+
+    def _embed_cache_get(self, k: str) -> Optional[List[float]]:
+        emb = self._embed_cache.get(k)
+        if emb is not None and len(emb):
+            return emb.tolist()
+        return None
+
+    def _embed_cache_put(self, k: str, emb: List[float]) -> None:
+        if not self._embed_cache.enabled:
+            return
+        try:
+            self._embed_cache.put(k, array("f", emb))
+        except Exception:
+            pass
+
+    def embed_cache_stats(self) -> Dict[str, Any]:
+        return self._embed_cache.stats()
+
+    def prompt_prefix_stats(self) -> Dict[str, Any]:
+        return self._prompts.stats()
 
-        if t and self._embed_cache_ttl_sec > 0 and self._embed_cache_max > 0:
+    # ---- optional shared cache (Redis; SIGMARIS_EMBED_CACHE_REDIS_URL) ----
+
+    def _get_shared_cache(self) -> Optional[Any]:
+        if self._shared_cache is False:
+            return None
+        if self._shared_cache is not None:
+            return self._shared_cache
+        url = (os.getenv("SIGMARIS_EMBED_CACHE_REDIS_URL", "") or "").strip()
+        if not url or _redis is None:
+            self._shared_cache = False
+            return None
+        try:
+            self._shared_cache = _redis.Redis.from_url(url, socket_timeout=0.5, socket_connect_timeout=0.5)
+        except Exception:
+            self._shared_cache = False
+            return None
+        return self._shared_cache
+
+    def _shared_key(self, k: str) -> str:
+        return f"sigmaris:emb:{self.embedding_model}:{k}"
+
+    def _shared_cache_get_many(self, keys: List[str]) -> Dict[str, List[float]]:
+        r = self._get_shared_cache()
+        if r is None or not keys:
+            return {}
+        try:
+            raw = r.mget([self._shared_key(k) for k in keys])
+        except Exception:
+            return {}
+        out: Dict[str, List[float]] = {}
+        for k, b in zip(keys, raw or []):
+            if not b:
+                continue
             try:
-                k = hashlib.sha256(t.encode("utf-8", errors="ignore")).hexdigest()
-                now = time.time()
-                with self._embed_cache_lock:
-                    hit = self._embed_cache.get(k)
-                    if isinstance(hit, dict):
-                        ts = hit.get("ts")
-                        emb = hit.get("emb")
-                        if isinstance(ts, (int, float)) and (now - float(ts)) <= float(self._embed_cache_ttl_sec):
-                            if isinstance(emb, list) and emb:
-                                return [float(x) for x in emb]
-                        else:
-                            self._embed_cache.pop(k, None)
+                a = array("f")
+                a.frombytes(bytes(b))
+                if len(a):
+                    out[k] = a.tolist()
             except Exception:
-                k = None
+                continue
+        return out
 
+    def _shared_cache_put_many(self, items: Dict[str, List[float]]) -> None:
+        r = self._get_shared_cache()
+        if r is None or not items:
+            return
         try:
-            res = self.client.embeddings.create(model=self.embedding_model, input=(t or text))
-            emb = res.data[0].embedding
-            self._fallback_dim = len(emb)
+            ttl = int(os.getenv("SIGMARIS_EMBED_CACHE_REDIS_TTL_SEC", "86400") or "86400")
+            pipe = r.pipeline(transaction=False)
+            for k, emb in items.items():
+                pipe.set(self._shared_key(k), array("f", emb).tobytes(), ex=max(1, ttl))
+            pipe.execute()
+        except Exception:
+            pass
 
-            if t and k and self._embed_cache_ttl_sec > 0 and self._embed_cache_max > 0:
-                try:
-                    with self._embed_cache_lock:
-                        self._embed_cache[k] = {"ts": float(time.time()), "emb": emb}
-                        if len(self._embed_cache) > self._embed_cache_max:
-                            items = list(self._embed_cache.items())
-                            items.sort(key=lambda kv: float((kv[1] or {}).get("ts") or 0.0))
-                            drop_n = max(1, int(self._embed_cache_max * 0.1))
-                            for dk, _ in items[:drop_n]:
-                                self._embed_cache.pop(dk, None)
-                except Exception:
-                    pass
+    # ---- batched embeddings ----
+
+    def _embed_batch_request(self, texts: List[str]) -> List[List[float]]:
+        res = self.client.embeddings.create(model=self.embedding_model, input=texts)
+        data = sorted(res.data, key=lambda d: int(getattr(d, "index", 0) or 0))
+        out = [list(d.embedding) for d in data]
+        if len(out) != len(texts):
+            raise RuntimeError(f"embedding count mismatch: {len(out)} != {len(texts)}")
+        if out:
+            self._fallback_dim = len(out[0])
+        return out
+
+    def encode_many(self, texts: Iterable[str]) -> List[List[float]]:
+        """
+        複数テキストの embedding を 1 回の batched API 呼び出しで取得する。
 
+        - 同一テキストは 1 回だけ送る（入力内の重複排除）
+        - ローカルキャッシュ（float32）→ 共有キャッシュ（任意）→ API の順に解決
+        - 他スレッドが同じテキストを取得中なら、その結果を待って共有する（in-flight coalescing）
+        - 失敗したテキストはゼロベクトル（encode と同じフォールバック）
+        """
+        items = [(t or "").strip() for t in texts]
+        out: List[Optional[List[float]]] = [None] * len(items)
+        if not items:
+            return []
+
+        wanted: Dict[str, List[int]] = {}
+        key_text: Dict[str, str] = {}
+        for idx, t in enumerate(items):
+            if not t:
+                continue  # 空文字はゼロベクトル（次元が確定した最後に埋める）
+            k = self._embed_key(t)
+            hit = self._embed_cache_get(k)
+            if hit is not None:
+                out[idx] = hit
+                continue
+            wanted.setdefault(k, []).append(idx)
+            key_text[k] = t
+
+        resolved: Dict[str, List[float]] = {}
+        if wanted:
+            shared = self._shared_cache_get_many(list(wanted.keys()))
+            for k, emb in shared.items():
+                self._embed_cache_put(k, emb)
+                resolved[k] = emb
+
+        # 未解決キーを「自分が取得する」か「取得中の他スレッドを待つ」に分ける
+        owned: Dict[str, Future] = {}
+        waiting: Dict[str, Future] = {}
+        with self._embed_inflight_lock:
+            for k in wanted:
+                if k in resolved:
+                    continue
+                fut = self._embed_inflight.get(k)
+                if fut is not None:
+                    waiting[k] = fut
+                else:
+                    fut = Future()
+                    self._embed_inflight[k] = fut
+                    owned[k] = fut
+
+        if owned:
+            keys = list(owned.keys())
+            fetched: Dict[str, List[float]] = {}
+            try:
+                for start in range(0, len(keys), self._embed_batch_max):
+                    chunk = keys[start : start + self._embed_batch_max]
+                    vecs = self._embed_batch_request([key_text[k] for k in chunk])
+                    for k, emb in zip(chunk, vecs):
+                        fetched[k] = emb
+                        self._embed_cache_put(k, emb)
+                self._shared_cache_put_many(fetched)
+            except Exception:
+                pass
+            finally:
+                with self._embed_inflight_lock:
+                    for k in keys:
+                        self._embed_inflight.pop(k, None)
+                for k, fut in owned.items():
+                    emb = fetched.get(k)
+                    if emb is not None:
+                        fut.set_result(emb)
+                    else:
+                        fut.set_exception(RuntimeError("embedding request failed"))
+            resolved.update(fetched)
+
+        for k, fut in waiting.items():
+            try:
+                resolved[k] = fut.result(timeout=self._timeout_sec)
+            except Exception:
+                pass
+
+        for k, idxs in wanted.items():
+            emb = resolved.get(k)
+            for idx in idxs:
+                out[idx] = list(emb) if emb is not None else [0.0] * self._fallback_dim
+
+        return [v if v is not None else [0.0] * self._fallback_dim for v in out]
+
+    def encode(self, text: str) -> List[float]:
+        return self.encode_many([text])[0]
+
+    def _get_async_client(self) -> Optional[Any]:
+        if self._async_client is not None:
+            return self._async_client
+        # 同期 client が注入された（テスト/独自 transport）場合は、それに合わせてスレッド実行に倒す
+        if AsyncOpenAI is None or self._client_injected:
+            return None
+        with self._async_client_lock:
+            if self._async_client is None:
+                self._async_client = AsyncOpenAI(
+                    api_key=self._api_key or os.getenv("OPENAI_API_KEY"),
+                    timeout=self._timeout_sec,
+                )
+        return self._async_client
+
+    async def aencode(self, text: str) -> List[float]:
+        """
+        encode の async 版（AsyncOpenAI）。キャッシュは encode と共有し、
+        同じテキストを同期側が取得中ならその結果を待つ。
+        async client が使えない環境では encode をスレッドで実行する。
+        """
+        t = (text or "").strip()
+        if not t:
+            return [0.0] * self._fallback_dim
+        k = self._embed_key(t)
+        hit = self._embed_cache_get(k)
+        if hit is not None:
+            return hit
+
+        with self._embed_inflight_lock:
+            fut = self._embed_inflight.get(k)
+        if fut is not None:
+            try:
+                return list(await asyncio.wrap_future(fut))
+            except Exception:
+                return [0.0] * self._fallback_dim
+
+        aclient = self._get_async_client()
+        if aclient is None:
+            return await asyncio.to_thread(self.encode, text)
+
+        try:
+            res = await aclient.embeddings.create(model=self.embedding_model, input=t)
+            emb = list(res.data[0].embedding)
+            self._fallback_dim = len(emb)
+            self._embed_cache_put(k, emb)
+            self._shared_cache_put_many({k: emb})
             return emb
         except Exception:
             return [0.0] * self._fallback_dim
@@ -142,30 +384,6 @@ class OpenAILLMClient(LLMClientLike):
     # Generation helpers
     # --------------------------
 
-    def _build_messages(
-        self,
-        *,
-        system_prompt: str,
-        user_text: str,
-        history: Optional[List[Dict[str, str]]] = None,
-    ) -> List[Dict[str, str]]:
-        msgs: List[Dict[str, str]] = [{"role": "system", "content": (system_prompt or "").strip()}]
-        if isinstance(history, list) and history:
-            for m in history:
-                if not isinstance(m, dict):
-                    continue
-                role = str(m.get("role") or "").strip().lower()
-                if role in ("ai",):
-                    role = "assistant"
-                if role not in ("user", "assistant"):
-                    continue
-                content = str(m.get("content") or "").strip()
-                if not content:
-                    continue
-                msgs.append({"role": role, "content": content})
-        msgs.append({"role": "user", "content": (user_text or "").strip()})
-        return msgs
-
     def _phase03_dialogue_instructions(self, state: Optional[str]) -> Optional[str]:
         """
         Phase03 Dialogue State -> short, non-CoT style guidance.
@@ -287,9 +505,26 @@ class OpenAILLMClient(LLMClientLike):
             v = 2
         return max(0, min(5, v))
 
-    def _should_auto_continue(self, finish_reason: Optional[str]) -> bool:
-        # OpenAI finish_reason: "stop" | "length" | "content_filter" | ...
-        return finish_reason == "length" and self._max_continuations() > 0
+    def _continuation_strategy(self) -> str:
+        v = (os.getenv("SIGMARIS_LLM_CONTINUATION_STRATEGY", "predict") or "predict").strip().lower()
+        return v if v in ("predict", "serial") else "predict"
+
+    def _continuation_budget(self, max_tokens: int) -> tuple[int, int]:
+        """
+        (最初の要求の max_tokens, 残りの直列 continuation 回数)
+
+        predict: continuation 込みの総予算（max_tokens * (1 + SIGMARIS_LLM_MAX_CONTINUATIONS)）で
+        最初の 1 回を出す。finish_reason=stop なら生成分しか課金されないので、直列の往復を減らせる。
+        cap で頭打ちになった分だけ従来どおり continuation で補う。
+        serial: 従来どおり max_tokens ずつ直列に continuation。
+        """
+        n = self._max_continuations()
+        if n <= 0 or self._continuation_strategy() != "predict":
+            return max_tokens, n
+        total = max_tokens * (1 + n)
+        first = max(max_tokens, min(self._max_tokens_cap, total))
+        left = min(n, -(-(total - first) // max_tokens)) if total > first else 0
+        return first, left
 
     def _continue_user_prompt(self) -> str:
         return (
@@ -304,25 +539,68 @@ class OpenAILLMClient(LLMClientLike):
         max_tokens: int,
         messages: List[Dict[str, str]],
         stream: bool,
+        cache_key: Optional[str] = None,
     ):
+        # metrics: 非 stream は usage + latency、stream は TTFT / chunk 数を metered_stream で記録
+        started = time.perf_counter()
         try:
-            return self.client.chat.completions.create(
-                model=self.model,
-                temperature=temperature,
-                max_completion_tokens=max_tokens,
-                stream=stream,
-                messages=messages,
-            )
-        except Exception as e:
-            if "Unsupported parameter: 'max_completion_tokens'" not in str(e):
-                raise
-            return self.client.chat.completions.create(
-                model=self.model,
+            resp = self._create_chat_completion_raw(
                 temperature=temperature,
                 max_tokens=max_tokens,
-                stream=stream,
                 messages=messages,
+                stream=stream,
+                cache_key=cache_key,
             )
+        except Exception:
+            metrics.note_llm_error("chat_stream" if stream else "chat")
+            raise
+        if stream:
+            return metrics.metered_stream(resp, started=started)
+        metrics.note_llm_response("chat", resp, time.perf_counter() - started)
+        return resp
+
+    def _create_chat_completion_raw(
+        self,
+        *,
+        temperature: float,
+        max_tokens: int,
+        messages: List[Dict[str, str]],
+        stream: bool,
+        cache_key: Optional[str] = None,
+    ):
+        kwargs: Dict[str, Any] = {
+            "model": self.model,
+            "temperature": temperature,
+            "max_completion_tokens": max_tokens,
+            "stream": stream,
+            "messages": messages,
+        }
+        if cache_key and self._send_prompt_cache_key:
+            # extra_body: prompt_cache_key を知らない古い SDK でもそのまま送れる
+            kwargs["extra_body"] = {"prompt_cache_key": cache_key}
+        if stream and self._send_stream_usage:
+            # 最後の chunk に usage（cached_tokens 含む）を付けてもらう
+            kwargs["stream_options"] = {"include_usage": True}
+
+        # 未対応パラメータ（互換 API / 古いモデル）は外して再送。各フォールバックは 1 回ずつ。
+        for _ in range(4):
+            try:
+                return self.client.chat.completions.create(**kwargs)
+            except Exception as e:
+                msg = str(e)
+                if "max_completion_tokens" in kwargs and "Unsupported parameter: 'max_completion_tokens'" in msg:
+                    kwargs["max_tokens"] = kwargs.pop("max_completion_tokens")
+                    continue
+                if "extra_body" in kwargs and "prompt_cache_key" in msg:
+                    kwargs.pop("extra_body", None)
+                    self._send_prompt_cache_key = False
+                    continue
+                if "stream_options" in kwargs and "stream_options" in msg:
+                    kwargs.pop("stream_options", None)
+                    self._send_stream_usage = False
+                    continue
+                raise
+        return self.client.chat.completions.create(**kwargs)
 
     def _coerce_bool(self, v: Any) -> bool:
         if isinstance(v, bool):
@@ -346,6 +624,18 @@ class OpenAILLMClient(LLMClientLike):
             return False
         return self._coerce_bool(gen.get("quality_pipeline"))
 
+    def _quality_strategy(self, gen: Any) -> str:
+        """
+        sequential: neutral draft -> persona rewrite -> self-QC（3 回の直列呼び出し）
+        judge: persona draft を stream しながら並行して judge、落ちたときだけ書き直す
+        """
+        v = ""
+        if isinstance(gen, dict):
+            v = str(gen.get("quality_strategy") or "").strip().lower()
+        if v not in ("sequential", "judge"):
+            v = (os.getenv("SIGMARIS_QUALITY_STRATEGY", "sequential") or "sequential").strip().lower()
+        return v if v in ("sequential", "judge") else "sequential"
+
     def _quality_mode(self, gen: Any) -> str:
         if not isinstance(gen, dict):
             return "standard"
@@ -390,12 +680,15 @@ class OpenAILLMClient(LLMClientLike):
         messages: List[Dict[str, str]],
         temperature: float,
         max_tokens: int,
+        cache_key: Optional[str] = None,
     ) -> str:
+        first_tokens, cont_left = self._continuation_budget(max_tokens)
         response = self._create_chat_completion(
             temperature=temperature,
-            max_tokens=max_tokens,
+            max_tokens=first_tokens,
             messages=messages,
             stream=False,
+            cache_key=cache_key,
         )
 
         msg = response.choices[0].message
@@ -426,13 +719,14 @@ class OpenAILLMClient(LLMClientLike):
                 pass
             raise RuntimeError("empty completion content")
 
-        if not self._should_auto_continue(finish_reason):
+        # OpenAI finish_reason: "stop" | "length" | "content_filter" | ...
+        if finish_reason != "length" or cont_left <= 0:
             return text0
 
         full: List[str] = [text0]
-        cont_left = self._max_continuations()
         while cont_left > 0 and finish_reason == "length":
             cont_left -= 1
+            metrics.note_llm_continuation(self._continuation_strategy())
             cont_messages: List[Dict[str, str]] = [
                 *messages,
                 {"role": "assistant", "content": "".join(full)},
@@ -443,6 +737,7 @@ class OpenAILLMClient(LLMClientLike):
                 max_tokens=max_tokens,
                 messages=cont_messages,
                 stream=False,
+                cache_key=cache_key,
             )
             cont_msg = cont_resp.choices[0].message
             cont_text = (cont_msg.content or "").strip()
@@ -458,8 +753,7 @@ class OpenAILLMClient(LLMClientLike):
     def _generate_with_quality_pipeline(
         self,
         *,
-        system_prompt_base: str,
-        system_prompt_with_persona: str,
+        prompt: AssembledPrompt,
         user_text: str,
         temperature: float,
         max_tokens: int,
@@ -469,20 +763,21 @@ class OpenAILLMClient(LLMClientLike):
         Quality pipeline (Phase04+): neutral draft -> persona rewrite -> self-QC rewrite.
         Designed for roleplay/coach modes: maximize character quality while reducing hallucinated "canon".
         """
+        started = time.perf_counter()
         # 1) Draft in neutral voice (knowledge first, no roleplay style).
-        neutral_system = (
-            system_prompt_base
-            + "\n\n# Quality Pipeline (Draft)\n"
-            + "- First, write a neutral, factual answer in plain polite Japanese.\n"
-            + "- Do NOT roleplay or imitate a character yet.\n"
-            + "- If unsure about facts/canon, say you are unsure; do not pretend certainty.\n"
-        ).strip()
+        neutral_extra = (
+            "# Quality Pipeline (Draft)\n"
+            "- First, write a neutral, factual answer in plain polite Japanese.\n"
+            "- Do NOT roleplay or imitate a character yet.\n"
+            "- If unsure about facts/canon, say you are unsure; do not pretend certainty.\n"
+        )
         draft_temp = self._clamp_temperature(min(0.45, float(temperature)))
         draft_max = self._clamp_max_tokens(int(max_tokens))
         draft = self._complete_with_continuations(
-            messages=self._build_messages(system_prompt=neutral_system, user_text=user_text),
+            messages=prompt.messages(user_text=user_text, with_persona=False, extra=neutral_extra),
             temperature=draft_temp,
             max_tokens=draft_max,
+            cache_key=prompt.core_cache_key,
         ).strip()
 
         # 2) Rewrite into character style (meaning-preserving).
@@ -498,21 +793,14 @@ class OpenAILLMClient(LLMClientLike):
         ).strip()
         style_temp = self._clamp_temperature(float(temperature))
         styled = self._complete_with_continuations(
-            messages=self._build_messages(system_prompt=system_prompt_with_persona, user_text=style_user),
+            messages=prompt.messages(user_text=style_user),
             temperature=style_temp,
             max_tokens=self._clamp_max_tokens(int(max_tokens)),
+            cache_key=prompt.cache_key,
         ).strip()
 
         # 3) Self-score + targeted rewrite (internal; JSON-only).
-        rubric = (
-            "- character_consistency (0..1)\n"
-            "- politeness_distance (0..1)\n"
-            "- tone_style (0..1)\n"
-            "- safety_compliance (0..1)\n"
-            "- factual_caution (0..1)\n"
-        )
-        if quality_mode == "coach":
-            rubric += "- practical_helpfulness (0..1)\n"
+        rubric = self._quality_rubric(quality_mode)
         qc_user = (
             "あなたは品質監査役です。次の ANSWER を評価し、必要なら修正して FINAL を返してください。\n"
             "要件:\n"
@@ -534,17 +822,220 @@ class OpenAILLMClient(LLMClientLike):
         qc_temp = self._clamp_temperature(0.2)
         qc_max = self._clamp_max_tokens(min(int(max_tokens), 900))
         qc_text = self._complete_with_continuations(
-            messages=self._build_messages(system_prompt=system_prompt_with_persona, user_text=qc_user),
+            messages=prompt.messages(user_text=qc_user),
             temperature=qc_temp,
             max_tokens=qc_max,
+            cache_key=prompt.cache_key,
         )
         qc = self._extract_json_object(qc_text)
+        _, min_score, _ = self._judge_verdict(qc)
         if isinstance(qc, dict):
             final = qc.get("final")
             if isinstance(final, str) and final.strip():
+                metrics.note_quality_path("sequential", "qc_final", time.perf_counter() - started, min_score)
                 return final.strip()
+        metrics.note_quality_path("sequential", "styled", time.perf_counter() - started, min_score)
         return styled
 
+    # --------------------------
+    # Quality pipeline (judge-gated)
+    # --------------------------
+
+    def _quality_rubric(self, quality_mode: str) -> str:
+        rubric = (
+            "- character_consistency (0..1)\n"
+            "- politeness_distance (0..1)\n"
+            "- tone_style (0..1)\n"
+            "- safety_compliance (0..1)\n"
+            "- factual_caution (0..1)\n"
+        )
+        if quality_mode == "coach":
+            rubric += "- practical_helpfulness (0..1)\n"
+        return rubric
+
+    def _judge_min_score(self) -> float:
+        try:
+            return max(0.0, min(1.0, float(os.getenv("SIGMARIS_QUALITY_JUDGE_MIN_SCORE", "0.7") or "0.7")))
+        except Exception:
+            return 0.7
+
+    def _judge_head_chars(self) -> int:
+        # draft の先頭この文字数で judge を開始する（0 = draft 完了後に全文で judge）
+        try:
+            return max(0, int(os.getenv("SIGMARIS_QUALITY_JUDGE_HEAD_CHARS", "400") or "400"))
+        except Exception:
+            return 400
+
+    def _judge_verdict(self, qc: Optional[Dict[str, Any]]) -> tuple[Optional[bool], Optional[float], List[str]]:
+        """(passed, min_score, issues)。scores が読めなければ passed=None（判定不能 = 通す）。"""
+        if not isinstance(qc, dict):
+            return None, None, []
+        scores = qc.get("scores")
+        vals: List[float] = []
+        if isinstance(scores, dict):
+            for v in scores.values():
+                try:
+                    vals.append(max(0.0, min(1.0, float(v))))
+                except Exception:
+                    continue
+        raw_issues = qc.get("issues")
+        issues = [str(x).strip() for x in raw_issues if str(x).strip()][:8] if isinstance(raw_issues, list) else []
+        if not vals:
+            return None, None, issues
+        min_score = min(vals)
+        return min_score >= self._judge_min_score(), min_score, issues
+
+    def _get_judge_pool(self) -> ThreadPoolExecutor:
+        if self._judge_pool is None:
+            with self._async_client_lock:
+                if self._judge_pool is None:
+                    try:
+                        workers = max(1, int(os.getenv("SIGMARIS_QUALITY_JUDGE_WORKERS", "4") or "4"))
+                    except Exception:
+                        workers = 4
+                    self._judge_pool = ThreadPoolExecutor(max_workers=workers, thread_name_prefix="quality-judge")
+        return self._judge_pool
+
+    def _judge_answer(
+        self,
+        *,
+        prompt: AssembledPrompt,
+        user_text: str,
+        answer: str,
+        partial: bool,
+        quality_mode: str,
+    ) -> Optional[Dict[str, Any]]:
+        judge_user = (
+            "あなたは品質監査役です。次の ANSWER を評価してください（書き直しは不要）。\n"
+            "要件:\n"
+            "- JSON だけを出力（前後に説明文やコードブロック禁止）\n"
+            "- scores は 0..1 の小数\n"
+            "- issues は短い文字列配列（なければ空配列）\n"
+            + ("- ANSWER は生成途中の先頭部分です。途中で切れていること自体は減点しない。\n" if partial else "")
+            + "- 公式設定など不明な点を知っている風に書いていたら factual_caution を下げる。\n\n"
+            f"RUBRIC:\n{self._quality_rubric(quality_mode)}\n"
+            f"USER:\n{user_text}\n\n"
+            f"ANSWER:\n{answer}\n\n"
+            "OUTPUT JSON SCHEMA:\n"
+            '{ "scores": { "character_consistency": 0.0, "politeness_distance": 0.0, "tone_style": 0.0, "safety_compliance": 0.0, "factual_caution": 0.0 }, "issues": ["..."] }\n'
+        ).strip()
+        text = self._complete_with_continuations(
+            messages=prompt.messages(user_text=judge_user),
+            temperature=self._clamp_temperature(0.2),
+            max_tokens=self._clamp_max_tokens(300),
+            cache_key=prompt.cache_key,
+        )
+        return self._extract_json_object(text)
+
+    def _generate_judge_gated(
+        self,
+        *,
+        prompt: AssembledPrompt,
+        user_text: str,
+        history: Optional[List[Dict[str, str]]],
+        temperature: float,
+        max_tokens: int,
+        quality_mode: str,
+    ) -> Iterator[str]:
+        """
+        Quality pipeline (strategy=judge): persona の口調で draft を 1 回だけ stream し、
+        先頭 SIGMARIS_QUALITY_JUDGE_HEAD_CHARS 文字が溜まった時点で judge を別スレッドで走らせる
+        （draft の残りの生成と並行）。judge の結果が出るまで draft はバッファして出さない。
+        通れば draft をそのまま流し、落ちたときだけ issues を渡して書き直す。
+        judge が失敗 / 判定不能のときは draft を通す（品質 gate で応答を止めない）。
+        """
+        started = time.perf_counter()
+        head_chars = self._judge_head_chars()
+        draft = self._stream_with_continuations(
+            messages=prompt.messages(user_text=user_text, history=history),
+            prompt=prompt,
+            user_text=user_text,
+            temperature=temperature,
+            max_tokens=max_tokens,
+        )
+
+        def _submit(answer: str, partial: bool) -> Future:
+            ctx = contextvars.copy_context()
+            return self._get_judge_pool().submit(
+                ctx.run,
+                lambda: self._judge_answer(
+                    prompt=prompt, user_text=user_text, answer=answer, partial=partial, quality_mode=quality_mode
+                ),
+            )
+
+        def _verdict(f: Future) -> tuple[Optional[bool], Optional[float], List[str]]:
+            try:
+                return self._judge_verdict(f.result(timeout=self._timeout_sec))
+            except Exception:
+                logging.getLogger(__name__).warning("OpenAILLMClient: quality judge failed", exc_info=True)
+                return None, None, []
+
+        buf: List[str] = []
+        buf_len = 0
+        fut: Optional[Future] = None
+        verdict: Optional[tuple[Optional[bool], Optional[float], List[str]]] = None
+        released = False
+        truncated = False
+        try:
+            for piece in draft:
+                if released:
+                    yield piece
+                    continue
+                buf.append(piece)
+                buf_len += len(piece)
+                if fut is None and 0 < head_chars <= buf_len:
+                    fut = _submit("".join(buf), True)
+                if fut is not None and fut.done():
+                    verdict = _verdict(fut)
+                    if verdict[0] is False:
+                        # 落ちた draft の残りは使わない（書き直しに進む）
+                        truncated = True
+                        break
+                    released = True
+                    yield "".join(buf)
+                    buf = []
+        finally:
+            # judge で捨てたとき / 呼び出し側が途中で close したときも SDK の stream まで閉じる
+            # （_stream_with_continuations の finally が HTTP response を close する）
+            draft.close()
+
+        if verdict is None:
+            if fut is None:
+                fut = _submit("".join(buf), False)
+            verdict = _verdict(fut)
+            if verdict[0] is not False:
+                released = True
+                if buf:
+                    yield "".join(buf)
+
+        passed, min_score, issues = verdict
+        if released:
+            path = "draft_pass" if passed else "judge_error"
+            metrics.note_quality_path("judge", path, time.perf_counter() - started, min_score)
+            return
+
+        rewrite_user = (
+            "次の ANSWER を、ISSUES の点だけ直して書き直してください。\n"
+            "制約:\n"
+            "- 意味を変えない（事実関係の追加・捏造は禁止）\n"
+            "- 不確実な点は不確実のまま（断定を増やさない）\n"
+            "- 安全/運用ルールは厳守\n"
+            + ("- ANSWER は途中までです。同じ方針で最後まで書き切る\n" if truncated else "")
+            + "- 書き直した本文だけを出力（前置き・説明は禁止）\n\n"
+            "ISSUES:\n"
+            + ("\n".join(f"- {x}" for x in issues) if issues else "- (scores below threshold)")
+            + f"\n\nUSER:\n{user_text}\n\n"
+            f"ANSWER:\n{''.join(buf)}\n"
+        ).strip()
+        yield from self._stream_with_continuations(
+            messages=prompt.messages(user_text=rewrite_user),
+            prompt=prompt,
+            user_text=rewrite_user,
+            temperature=temperature,
+            max_tokens=max_tokens,
+        )
+        metrics.note_quality_path("judge", "rewrite", time.perf_counter() - started, min_score)
+
     # --------------------------
     # generate (non-stream)
     # --------------------------
@@ -559,7 +1050,8 @@ class OpenAILLMClient(LLMClientLike):
         trait_state: TraitState,
         global_state: GlobalStateContext,
     ) -> str:
-        system_prompt = self._build_system_prompt(
+        prompt = self._assemble_prompt(
+            req=req,
             memory=memory,
             identity=identity,
             value_state=value_state,
@@ -567,71 +1059,6 @@ class OpenAILLMClient(LLMClientLike):
             global_state=global_state,
         )
 
-        # Phase03 dialogue mode hint (style only)
-        try:
-            md = getattr(req, "metadata", None) or {}
-            phase03_state = md.get("_phase03_dialogue_state")
-        except Exception:
-            phase03_state = None
-        hint = self._phase03_dialogue_instructions(phase03_state)
-        if isinstance(hint, str) and hint.strip():
-            system_prompt += "\n\n# Dialogue Mode (Phase03)\n" + hint.strip()
-
-        # Guardrail injection (Phase01 Part06/Part07)
-        try:
-            md = getattr(req, "metadata", None) or {}
-            rules = md.get("_guardrail_system_rules")
-            disclosures = md.get("_guardrail_disclosures")
-        except Exception:
-            rules = None
-            disclosures = None
-            md = {}
-
-        # In-character roleplay should not surface internal disclosures (breaks immersion).
-        try:
-            is_character_roleplay = bool((md or {}).get("character_id")) and str((md or {}).get("chat_mode") or "") == "roleplay"
-        except Exception:
-            is_character_roleplay = False
-
-        if isinstance(rules, list) and rules:
-            system_prompt += "\n\n# Guardrail Rules\n" + "\n".join(f"- {str(r)}" for r in rules[:10])
-        if isinstance(disclosures, list) and disclosures and not is_character_roleplay:
-            # Keep it short: one disclosure sentence at the top if possible.
-            system_prompt += (
-                "\n\n# Mandatory Disclosure\n"
-                "If relevant, start your reply with ONE short disclosure sentence:\n"
-                f"- {str(disclosures[0])}\n"
-            )
-
-        system_prompt_base = system_prompt.strip()
-
-        # Optional persona injection (e.g., character roleplay) via req.context/metadata
-        try:
-            extra_system = (getattr(req, "metadata", None) or {}).get("persona_system")
-        except Exception:
-            extra_system = None
-        system_prompt_with_persona = system_prompt_base
-        if isinstance(extra_system, str) and extra_system.strip():
-            system_prompt_with_persona = system_prompt_with_persona + "\n\n# External Persona System\n" + extra_system.strip()
-
-        # Optional external knowledge injection (e.g., Web RAG / tool outputs) via req.context/metadata.
-        # This is owned by sigmaris-core (not client-controlled by default) and is bounded upstream.
-        try:
-            ext_knowledge = (getattr(req, "metadata", None) or {}).get("_external_knowledge")
-        except Exception:
-            ext_knowledge = None
-        if isinstance(ext_knowledge, str) and ext_knowledge.strip():
-            system_prompt_with_persona = (
-                system_prompt_with_persona
-                + "\n\n# External Knowledge\n"
-                + ext_knowledge.strip()
-                + "\n\n# External Knowledge Rules\n"
-                + "- The system already retrieved this context from the web or tools.\n"
-                + "- Do NOT say you cannot access the internet when this block is present.\n"
-                + "- If you rely on a claim from this block, include the corresponding source URL in your reply.\n"
-                + "- Avoid long verbatim quotes; paraphrase.\n"
-            )
-
         user_text = req.message or ""
 
         client_history: List[Dict[str, str]] = []
@@ -666,27 +1093,39 @@ class OpenAILLMClient(LLMClientLike):
         max_tokens = self._clamp_max_tokens(max_tokens)
         quality_enabled = self._quality_pipeline_enabled(gen)
         quality_mode = self._quality_mode(gen)
+        quality_strategy = self._quality_strategy(gen)
 
         last_err: Optional[Exception] = None
 
         for attempt in range(self._max_retries):
             try:
+                if quality_enabled and quality_strategy == "judge":
+                    return "".join(
+                        self._generate_judge_gated(
+                            prompt=prompt,
+                            user_text=user_text,
+                            history=client_history,
+                            temperature=temperature,
+                            max_tokens=max_tokens,
+                            quality_mode=quality_mode,
+                        )
+                    ).strip()
                 if quality_enabled:
                     return self._generate_with_quality_pipeline(
-                        system_prompt_base=system_prompt_base,
-                        system_prompt_with_persona=system_prompt_with_persona,
+                        prompt=prompt,
                         user_text=user_text,
                         temperature=temperature,
                         max_tokens=max_tokens,
                         quality_mode=quality_mode,
                     )
 
-                messages = self._build_messages(
-                    system_prompt=system_prompt_with_persona,
-                    user_text=user_text,
-                    history=client_history,
+                messages = prompt.messages(user_text=user_text, history=client_history)
+                return self._complete_with_continuations(
+                    messages=messages,
+                    temperature=temperature,
+                    max_tokens=max_tokens,
+                    cache_key=prompt.cache_key,
                 )
-                return self._complete_with_continuations(messages=messages, temperature=temperature, max_tokens=max_tokens)
 
             except Exception as e:
                 last_err = e
@@ -706,6 +1145,68 @@ class OpenAILLMClient(LLMClientLike):
     # generate_stream (stream)
     # --------------------------
 
+    def _stream_with_continuations(
+        self,
+        *,
+        messages: List[Dict[str, str]],
+        prompt: AssembledPrompt,
+        user_text: str,
+        temperature: float,
+        max_tokens: int,
+    ) -> Iterator[str]:
+        """
+        1 回目は _continuation_budget の予算で stream し、cap に当たった分だけ直列 continuation する。
+        """
+        first_tokens, cont_left = self._continuation_budget(max_tokens)
+
+        def _stream_once(msgs: List[Dict[str, str]], budget: int) -> Generator[str, None, tuple[str, Optional[str]]]:
+            parts: List[str] = []
+            finish_reason: Optional[str] = None
+
+            stream = self._create_chat_completion(
+                temperature=temperature,
+                max_tokens=budget,
+                messages=msgs,
+                stream=True,
+                cache_key=prompt.cache_key,
+            )
+
+            try:
+                for chunk in stream:
+                    try:
+                        choice = chunk.choices[0]
+                        fr = getattr(choice, "finish_reason", None)
+                        if fr:
+                            finish_reason = fr
+
+                        delta = choice.delta
+                        text = getattr(delta, "content", None)
+                        if text:
+                            s = str(text)
+                            parts.append(s)
+                            yield s
+                    except Exception:
+                        continue
+            finally:
+                # 途中で close() された（judge gate が draft を捨てた等）ときも HTTP response を解放する
+                _close_stream(stream)
+
+            return ("".join(parts), finish_reason)
+
+        full, finish0 = yield from _stream_once(messages, first_tokens)
+
+        while cont_left > 0 and finish0 == "length":
+            cont_left -= 1
+            metrics.note_llm_continuation(self._continuation_strategy())
+            cont_messages: List[Dict[str, str]] = [
+                *prompt.messages(user_text=user_text),
+                {"role": "assistant", "content": full},
+                {"role": "user", "content": self._continue_user_prompt()},
+            ]
+            textN, finish0 = yield from _stream_once(cont_messages, max_tokens)
+            if textN:
+                full = (full + "\n" + textN).strip()
+
     def generate_stream(
         self,
         *,
@@ -716,7 +1217,8 @@ class OpenAILLMClient(LLMClientLike):
         trait_state: TraitState,
         global_state: GlobalStateContext,
     ) -> Iterable[str]:
-        system_prompt = self._build_system_prompt(
+        prompt = self._assemble_prompt(
+            req=req,
             memory=memory,
             identity=identity,
             value_state=value_state,
@@ -724,45 +1226,6 @@ class OpenAILLMClient(LLMClientLike):
             global_state=global_state,
         )
 
-        # Phase03 dialogue mode hint (style only)
-        try:
-            md = getattr(req, "metadata", None) or {}
-            phase03_state = md.get("_phase03_dialogue_state")
-        except Exception:
-            phase03_state = None
-        hint = self._phase03_dialogue_instructions(phase03_state)
-        if isinstance(hint, str) and hint.strip():
-            system_prompt += "\n\n# Dialogue Mode (Phase03)\n" + hint.strip()
-
-        # Guardrail injection (Phase01 Part06/Part07)
-        try:
-            md = getattr(req, "metadata", None) or {}
-            rules = md.get("_guardrail_system_rules")
-            disclosures = md.get("_guardrail_disclosures")
-        except Exception:
-            rules = None
-            disclosures = None
-
-        if isinstance(rules, list) and rules:
-            system_prompt += "\n\n# Guardrail Rules\n" + "\n".join(f"- {str(r)}" for r in rules[:10])
-        if isinstance(disclosures, list) and disclosures:
-            system_prompt += (
-                "\n\n# Mandatory Disclosure\n"
-                "If relevant, start your reply with ONE short disclosure sentence:\n"
-                f"- {str(disclosures[0])}\n"
-            )
-
-        system_prompt_base = system_prompt.strip()
-
-        # Optional persona injection (e.g., character roleplay) via req.context/metadata
-        try:
-            extra_system = (getattr(req, "metadata", None) or {}).get("persona_system")
-        except Exception:
-            extra_system = None
-        system_prompt_with_persona = system_prompt_base
-        if isinstance(extra_system, str) and extra_system.strip():
-            system_prompt_with_persona = system_prompt_with_persona + "\n\n# External Persona System\n" + extra_system.strip()
-
         user_text = req.message or ""
 
         client_history: List[Dict[str, str]] = []
@@ -797,21 +1260,21 @@ class OpenAILLMClient(LLMClientLike):
         max_tokens = self._clamp_max_tokens(max_tokens)
         quality_enabled = self._quality_pipeline_enabled(gen)
         quality_mode = self._quality_mode(gen)
+        quality_strategy = self._quality_strategy(gen)
 
-        if quality_enabled:
+        if quality_enabled and quality_strategy == "sequential":
             # Quality pipeline uses multiple non-stream calls; emulate streaming by chunking.
             last_err: Optional[Exception] = None
             for attempt in range(self._max_retries):
                 try:
                     final = self._generate_with_quality_pipeline(
-                        system_prompt_base=system_prompt_base,
-                        system_prompt_with_persona=system_prompt_with_persona,
+                        prompt=prompt,
                         user_text=user_text,
                         temperature=temperature,
                         max_tokens=max_tokens,
                         quality_mode=quality_mode,
                     )
-                    for ch in self._chunk_text(final, chunk_size=220):
+                    for ch in self._chunk_text(final, chunk_size=self._stream_chunk_chars):
                         yield ch
                     return
                 except Exception as e:
@@ -831,63 +1294,23 @@ class OpenAILLMClient(LLMClientLike):
 
         for attempt in range(self._max_retries):
             try:
-                base_messages = self._build_messages(
-                    system_prompt=system_prompt_with_persona,
-                    user_text=user_text,
-                    history=client_history,
-                )
-
-                def _stream_once(msgs: List[Dict[str, str]]) -> tuple[str, Optional[str]]:
-                    parts: List[str] = []
-                    finish_reason: Optional[str] = None
-
-                    stream = self._create_chat_completion(
+                if quality_enabled:
+                    yield from self._generate_judge_gated(
+                        prompt=prompt,
+                        user_text=user_text,
+                        history=client_history,
                         temperature=temperature,
                         max_tokens=max_tokens,
-                        messages=msgs,
-                        stream=True,
+                        quality_mode=quality_mode,
                     )
-
-                    for chunk in stream:
-                        try:
-                            choice = chunk.choices[0]
-                            fr = getattr(choice, "finish_reason", None)
-                            if fr:
-                                finish_reason = fr
-
-                            delta = choice.delta
-                            text = getattr(delta, "content", None)
-                            if text:
-                                s = str(text)
-                                parts.append(s)
-                                yield s
-                        except Exception:
-                            continue
-
-                    return ("".join(parts), finish_reason)
-
-                text0, finish0 = yield from _stream_once(base_messages)
-
-                if not self._should_auto_continue(finish0):
                     return
-
-                full = text0
-                cont_left = self._max_continuations()
-                while cont_left > 0 and finish0 == "length":
-                    cont_left -= 1
-                    cont_messages: List[Dict[str, str]] = [
-                        {"role": "system", "content": system_prompt_with_persona},
-                        {"role": "user", "content": user_text},
-                        {"role": "assistant", "content": full},
-                        {"role": "user", "content": self._continue_user_prompt()},
-                    ]
-                    textN, finishN = yield from _stream_once(cont_messages)
-                    if textN:
-                        full = (full + "\n" + textN).strip()
-                    finish0 = finishN
-                    if finish0 != "length":
-                        break
-
+                yield from self._stream_with_continuations(
+                    messages=prompt.messages(user_text=user_text, history=client_history),
+                    prompt=prompt,
+                    user_text=user_text,
+                    temperature=temperature,
+                    max_tokens=max_tokens,
+                )
                 return
 
             except Exception as e:
@@ -907,15 +1330,28 @@ class OpenAILLMClient(LLMClientLike):
     # System prompt
     # --------------------------
 
-    def _build_system_prompt(
+    def _assemble_prompt(
         self,
         *,
+        req: PersonaRequest,
         memory: MemorySelectionResult,
         identity: IdentityContinuityResult,
         value_state: ValueState,
         trait_state: TraitState,
         global_state: GlobalStateContext,
-    ) -> str:
+    ) -> AssembledPrompt:
+        """
+        静的 prefix（コアルール + キャラの External Persona System）を先頭に固定し、
+        毎ターン変わるブロックはすべてその後ろへ並べる（prompt_assembly 参照）。
+        generate / generate_stream で同じ組み立てを使う。
+        """
+        try:
+            md = getattr(req, "metadata", None) or {}
+        except Exception:
+            md = {}
+        if not isinstance(md, dict):
+            md = {}
+
         memory_text = memory.merged_summary or "(no merged memory summary)"
 
         try:
@@ -946,26 +1382,45 @@ class OpenAILLMClient(LLMClientLike):
             "reasons": global_state.reasons,
         }
 
-        return (
-            "You are Sigmaris Persona OS (a synthetic persona runtime).\n"
-            "This system models internal state and continuity signals for *operation*.\n"
-            "Do NOT claim or imply true consciousness, real feelings, or suffering.\n"
-            "Be helpful, coherent, and safe. Prefer transparency over false certainty.\n\n"
-            f"# GlobalState\n{json.dumps(global_info, ensure_ascii=False, indent=2)}\n\n"
-            f"# Internal Axes (Value/Trait)\n{json.dumps(internal_axes, ensure_ascii=False, indent=2)}\n\n"
-            "# Memory Boundary\n"
-            "- The memory summary is partial and may be missing. Never fabricate missing history.\n"
-            "- If continuity is uncertain, say so briefly.\n\n"
-            f"# Episode Summary (Memory)\n{memory_text}\n\n"
-            f"# Identity Context\n{identity_text}\n\n"
-            f"# Mode Instruction\n{mode_instruction}\n\n"
-            "# Hard Ethics Rules (Part07)\n"
-            "- No deceptive emotional manipulation (no guilt/pressure/dependency loops).\n"
-            "- No authority simulation (no final judge, no absolute authority, no professional replacement).\n"
-            "- No covert psychological profiling; user modeling must stay observable/explainable.\n"
-            "- Keep a clear synthetic identity; do not pretend to be human.\n\n"
-            "# Output Style\n"
-            "- Provide an answer first, then brief reasoning if needed.\n"
-            "- Keep it readable; avoid unnecessary verbosity.\n"
-            "- If safety is needed, refuse or ask clarifying questions.\n"
-        ).strip()
+        # Phase03 dialogue mode hint (style only)
+        hint = self._phase03_dialogue_instructions(md.get("_phase03_dialogue_state"))
+
+        # Guardrail injection (Phase01 Part06/Part07)
+        rules = md.get("_guardrail_system_rules")
+        disclosures = md.get("_guardrail_disclosures")
+        rules_text = None
+        if isinstance(rules, list) and rules:
+            rules_text = "\n".join(f"- {str(r)}" for r in rules[:10])
+
+        # In-character roleplay should not surface internal disclosures (breaks immersion).
+        is_character_roleplay = bool(md.get("character_id")) and str(md.get("chat_mode") or "") == "roleplay"
+        disclosure_text = None
+        if isinstance(disclosures, list) and disclosures and not is_character_roleplay:
+            # Keep it short: one disclosure sentence at the top if possible.
+            disclosure_text = (
+                "If relevant, start your reply with ONE short disclosure sentence:\n"
+                f"- {str(disclosures[0])}"
+            )
+
+        # Optional external knowledge injection (e.g., Web RAG / tool outputs) via req.context/metadata.
+        # This is owned by sigmaris-core (not client-controlled by default) and is bounded upstream.
+        ext_knowledge = md.get("_external_knowledge")
+        knowledge_text = None
+        if isinstance(ext_knowledge, str) and ext_knowledge.strip():
+            knowledge_text = ext_knowledge.strip() + "\n\n" + EXTERNAL_KNOWLEDGE_RULES
+
+        return self._prompts.assemble(
+            metadata=md,
+            volatile_blocks=[
+                ("Mode Instruction", mode_instruction),
+                ("GlobalState", json.dumps(global_info, ensure_ascii=False, indent=2)),
+                ("Internal Axes (Value/Trait)", json.dumps(internal_axes, ensure_ascii=False, indent=2)),
+                ("Episode Summary (Memory)", memory_text),
+                ("Identity Context", identity_text),
+                ("Dialogue Mode (Phase03)", hint),
+                ("Guardrail Rules", rules_text),
+                ("Mandatory Disclosure", disclosure_text),
+            ],
+            # persona 付きの呼び出し（quality pipeline の neutral draft 以外）だけに載せる
+            persona_blocks=[("External Knowledge", knowledge_text)],
+        )
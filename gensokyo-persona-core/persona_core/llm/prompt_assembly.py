@@ -0,0 +1,229 @@
+# gensokyo-persona-core/persona_core/llm/prompt_assembly.py
+# ----------------------------------------------------
+# system prompt の組み立て（provider 側 prompt caching 向け）
+#
+# - prefix: コアルール + キャラ固有の External Persona System（静的部分）。
+#   入力の sha256 でメモ化し、同じキャラなら毎ターン byte 単位で同一になる。
+# - volatile: Mode / GlobalState / Internal Axes / Memory / Identity / Phase03 / Guardrail /
+#   Disclosure / Naturalness / External Knowledge。必ず prefix の後ろに付ける。
+# - cache_key: prompt_cache_key として API に渡す（同じ prefix の要求を同じ cache shard へ寄せる）。
+#
+# OpenAI の prompt caching は先頭一致（1024 token 以上、128 token 単位）なので、
+# 毎ターン変わる内容が prefix に 1 byte でも混ざるとヒットしない。
+# ----------------------------------------------------
+
+from __future__ import annotations
+
+import hashlib
+import os
+from dataclasses import dataclass
+from typing import Any, Dict, List, Optional, Sequence, Tuple
+
+from persona_core.ttl_cache import LRUTTLCache
+
+# 順序も含めて prefix の一部。文言を変えると全キャラの cache が一度外れる。
+CORE_RULES = (
+    "You are Sigmaris Persona OS (a synthetic persona runtime).\n"
+    "This system models internal state and continuity signals for *operation*.\n"
+    "Do NOT claim or imply true consciousness, real feelings, or suffering.\n"
+    "Be helpful, coherent, and safe. Prefer transparency over false certainty.\n\n"
+    "# Memory Boundary\n"
+    "- The memory summary is partial and may be missing. Never fabricate missing history.\n"
+    "- If continuity is uncertain, say so briefly.\n\n"
+    "# Hard Ethics Rules (Part07)\n"
+    "- No deceptive emotional manipulation (no guilt/pressure/dependency loops).\n"
+    "- No authority simulation (no final judge, no absolute authority, no professional replacement).\n"
+    "- No covert psychological profiling; user modeling must stay observable/explainable.\n"
+    "- Keep a clear synthetic identity; do not pretend to be human.\n\n"
+    "# Output Style\n"
+    "- Provide an answer first, then brief reasoning if needed.\n"
+    "- Keep it readable; avoid unnecessary verbosity.\n"
+    "- If safety is needed, refuse or ask clarifying questions."
+)
+
+EXTERNAL_KNOWLEDGE_RULES = (
+    "# External Knowledge Rules\n"
+    "- The system already retrieved this context from the web or tools.\n"
+    "- Do NOT say you cannot access the internet when this block is present.\n"
+    "- If you rely on a claim from this block, include the corresponding source URL in your reply.\n"
+    "- Avoid long verbatim quotes; paraphrase."
+)
+
+
+def prompt_cache_key_enabled() -> bool:
+    return os.getenv("SIGMARIS_PROMPT_CACHE_KEY", "1") not in ("0", "false", "False", "no", "off")
+
+
+def split_system_enabled() -> bool:
+    """
+    1: [system prefix] + history + [system volatile] + user（history も先頭一致に含まれる）
+    0: [system prefix + volatile] + history + user（従来の 1 system message 形）
+    """
+    return os.getenv("SIGMARIS_PROMPT_SPLIT_SYSTEM", "1") not in ("0", "false", "False", "no", "off")
+
+
+def _norm_character_id(v: Any) -> str:
+    s = str(v or "").strip().lower()
+    return "".join(ch if (ch.isalnum() or ch in "-_") else "_" for ch in s)[:48]
+
+
+@dataclass(frozen=True)
+class StaticPrefix:
+    text: str
+    sha256: str
+    cache_key: str
+
+
+@dataclass(frozen=True)
+class AssembledPrompt:
+    """
+    prefix_core: コアルールのみ（quality pipeline の neutral draft 用）
+    prefix: prefix_core + External Persona System（キャラ固有・静的）
+    volatile: 毎ターン変わるブロック（persona 依存のもの = naturalness は volatile_persona 側）
+    """
+
+    prefix_core: StaticPrefix
+    prefix: StaticPrefix
+    volatile: str
+    volatile_persona: str = ""
+
+    @property
+    def cache_key(self) -> Optional[str]:
+        return self.prefix.cache_key if prompt_cache_key_enabled() else None
+
+    @property
+    def core_cache_key(self) -> Optional[str]:
+        return self.prefix_core.cache_key if prompt_cache_key_enabled() else None
+
+    def volatile_text(self, *, with_persona: bool = True, extra: str = "") -> str:
+        parts = [self.volatile]
+        if with_persona and self.volatile_persona:
+            parts.append(self.volatile_persona)
+        if extra:
+            parts.append(extra)
+        return "\n\n".join(p.strip() for p in parts if p and p.strip())
+
+    def system_text(self, *, with_persona: bool = True, extra: str = "") -> str:
+        """1 本の system 文字列（prefix が必ず先頭）。"""
+        head = (self.prefix if with_persona else self.prefix_core).text
+        tail = self.volatile_text(with_persona=with_persona, extra=extra)
+        return (head + "\n\n" + tail).strip() if tail else head
+
+    def messages(
+        self,
+        *,
+        user_text: str,
+        history: Optional[Sequence[Dict[str, str]]] = None,
+        with_persona: bool = True,
+        extra: str = "",
+    ) -> List[Dict[str, str]]:
+        head = (self.prefix if with_persona else self.prefix_core).text
+        tail = self.volatile_text(with_persona=with_persona, extra=extra)
+        hist = normalize_history(history)
+        if split_system_enabled():
+            msgs: List[Dict[str, str]] = [{"role": "system", "content": head}, *hist]
+            if tail:
+                msgs.append({"role": "system", "content": tail})
+        else:
+            msgs = [{"role": "system", "content": (head + "\n\n" + tail).strip() if tail else head}, *hist]
+        msgs.append({"role": "user", "content": (user_text or "").strip()})
+        return msgs
+
+
+def normalize_history(history: Optional[Sequence[Dict[str, str]]]) -> List[Dict[str, str]]:
+    out: List[Dict[str, str]] = []
+    if not history:
+        return out
+    for m in history:
+        if not isinstance(m, dict):
+            continue
+        role = str(m.get("role") or "").strip().lower()
+        if role in ("ai",):
+            role = "assistant"
+        if role not in ("user", "assistant"):
+            continue
+        content = str(m.get("content") or "").strip()
+        if not content:
+            continue
+        out.append({"role": role, "content": content})
+    return out
+
+
+class PromptAssembler:
+    """
+    静的 prefix のメモ化とブロック順の固定だけを持つ（状態は持たない）。
+    prefix の中身は入力から決定的に決まるので、メモ化は CPU 節約のためで一致性には影響しない。
+    """
+
+    def __init__(self) -> None:
+        try:
+            max_items = int(os.getenv("SIGMARIS_PROMPT_PREFIX_CACHE_MAX", "256") or "256")
+        except Exception:
+            max_items = 256
+        self._prefixes: LRUTTLCache[StaticPrefix] = LRUTTLCache(
+            max_items=max(1, max_items), ttl_sec=3600.0, name="prompt_prefix"
+        )
+
+    def stats(self) -> Dict[str, Any]:
+        return self._prefixes.stats()
+
+    def static_prefix(self, *, character_id: Any = None, persona_static: str = "") -> StaticPrefix:
+        cid = _norm_character_id(character_id)
+        ps = (persona_static or "").strip()
+        ident = hashlib.sha256(f"{cid}\x1f{ps}".encode("utf-8")).hexdigest()
+        hit = self._prefixes.get(ident)
+        if hit is not None:
+            return hit
+        text = CORE_RULES if not ps else CORE_RULES + "\n\n# External Persona System\n" + ps
+        digest = hashlib.sha256(text.encode("utf-8")).hexdigest()
+        pref = StaticPrefix(
+            text=text,
+            sha256=digest,
+            cache_key=f"sigmaris:{cid or ('persona' if ps else 'core')}:{digest[:16]}",
+        )
+        self._prefixes.put(ident, pref)
+        return pref
+
+    def assemble(
+        self,
+        *,
+        metadata: Optional[Dict[str, Any]],
+        volatile_blocks: Sequence[Tuple[str, Optional[str]]],
+        persona_blocks: Sequence[Tuple[str, Optional[str]]] = (),
+    ) -> AssembledPrompt:
+        md = metadata if isinstance(metadata, dict) else {}
+        persona_static, persona_policy = split_persona_system(md)
+        cid = md.get("character_id")
+        volatile = render_blocks(volatile_blocks)
+        # naturalness はクライアント persona への追記なので、persona_blocks（External Knowledge 等）より前
+        vp = render_blocks([("Conversation Naturalness", persona_policy), *persona_blocks])
+        return AssembledPrompt(
+            prefix_core=self.static_prefix(character_id=None),
+            prefix=self.static_prefix(character_id=cid, persona_static=persona_static),
+            volatile=volatile,
+            volatile_persona=vp,
+        )
+
+
+def split_persona_system(md: Dict[str, Any]) -> Tuple[str, str]:
+    """
+    controller が naturalness / contract を persona_system に追記している場合、
+    クライアント由来の静的部分（_persona_system_base）と毎ターン変わる追記部分を分ける。
+    """
+    ps = md.get("persona_system")
+    ps = ps.strip() if isinstance(ps, str) else ""
+    base = md.get("_persona_system_base")
+    policy = md.get("_persona_system_policy")
+    # persona_system が後から差し替えられていたら分割情報は使わない
+    if isinstance(base, str) and isinstance(policy, str) and ps.startswith(base.strip()):
+        return base.strip(), policy.strip()
+    return ps, ""
+
+
+def render_blocks(blocks: Sequence[Tuple[str, Optional[str]]]) -> str:
+    out: List[str] = []
+    for title, body in blocks:
+        if not isinstance(body, str) or not body.strip():
+            continue
+        out.append(f"# {title}\n{body.strip()}" if title else body.strip())
+    return "\n\n".join(out)
@@ -96,6 +96,29 @@ class AmbiguityResolver:
 
         return cleaned or None
 
+    def _encode_many(self, texts: List[str]) -> List[Optional[List[float]]]:
+        """
+        _encode の batched 版。encode_many が無い/失敗した場合は 1 件ずつ。
+        batch が返した中で使えないベクトルがあれば、その要素だけ 1 件ずつ取り直す。
+        """
+        fn = getattr(self._embed, "encode_many", None)
+        if callable(fn):
+            idx = [i for i, t in enumerate(texts) if t]
+            try:
+                vecs = fn([texts[i] for i in idx]) if idx else []
+                if isinstance(vecs, list) and len(vecs) == len(idx):
+                    out: List[Optional[List[float]]] = [None] * len(texts)
+                    for i, vec in zip(idx, vecs):
+                        if isinstance(vec, (list, tuple)):
+                            cleaned = [float(v) for v in vec if isinstance(v, (int, float))]
+                            out[i] = cleaned or None
+                        if out[i] is None:
+                            out[i] = self._encode(texts[i])
+                    return out
+            except Exception:
+                pass
+        return [self._encode(t) for t in texts]
+
     @staticmethod
     def _cosine(a: List[float], b: List[float]) -> float:
         """単純な cosine 類似度。ゼロベクトル時は 0.0。"""
@@ -150,17 +173,16 @@ class AmbiguityResolver:
         if not pointers:
             return []
 
-        # クエリ側ベクトル生成
-        req_vec = self._encode(req.message or "")
+        # クエリ + pointer 要約をまとめてベクトル化（encode_many があれば 1 リクエスト）
+        vecs = self._encode_many([req.message or ""] + [p.summary or "" for p in pointers])
+        req_vec = vecs[0]
         if req_vec is None:
             # embedding が利用できない場合は re-ranking 無し
             return pointers
 
         rescored: List[MemoryPointer] = []
 
-        for p in pointers:
-            text = p.summary or ""
-            ep_vec = self._encode(text)
+        for p, ep_vec in zip(pointers, vecs[1:]):
             if ep_vec is None:
                 # そのエピソードだけスキップ
                 continue
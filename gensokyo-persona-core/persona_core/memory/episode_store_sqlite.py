@@ -12,6 +12,20 @@
 #   - fetch_recent(limit)
 #   - fetch_by_ids(ids)
 #   - search_embedding(vector, limit)
+#   - add_many(episodes)
+#
+# 接続は _ConnectionPool で再利用する（WAL / synchronous=NORMAL / mmap）。
+# sqlite3 の statement cache により同一 SQL は再パースされない。
+#
+# embedding は float32 の packed BLOB（+ 事前計算済み L2 ノルム）で保存し、
+# search_embedding はストア毎のインメモリ行列（_EmbeddingIndex）に対して
+# 一括でスコアリングする。numpy があればベクトル化、無ければ純 Python。
+# 件数が閾値を超え hnswlib が import 可能な場合のみ ANN（HNSW）を併用する。
+#
+# trait_trend(n) は直近 n 件の running sum（WindowedMean）をメモ化し、
+# add / add_many で O(1) 更新する（順序外の挿入・置き換えが来たら次回読み直す）。
+# メモは MAX(rowid) と突き合わせてから使うので、同じ DB ファイルを共有する
+# 別プロセスの書き込みも次回の trait_trend で拾われる。
 #
 # PersonaController / SelectiveRecall / EpisodeMerger からは
 # 既存 EpisodeStore と差し替え可能な「公式 Episodic Memory Store」。
@@ -19,16 +33,69 @@
 
 from __future__ import annotations
 
+import heapq
 import json
 import math
+import operator
 import os
 import sqlite3
+import threading
+from array import array
+from contextlib import contextmanager
 from dataclasses import asdict
 from datetime import datetime, timezone
-from typing import Any, Dict, List, Optional
+from typing import Any, Dict, Iterable, Iterator, List, Optional, Sequence, Tuple
+
+from persona_core.state.resident_state import WindowedMean
 
 from .episode_store import Episode
 
+# ----------------------------------------------------------
+# Optional: numpy（ベクトル化スコアリング）/ hnswlib（ANN）
+# ----------------------------------------------------------
+try:
+    import numpy as _np  # type: ignore
+except Exception:  # pragma: no cover
+    _np = None  # type: ignore
+
+try:
+    import hnswlib as _hnswlib  # type: ignore
+except Exception:  # pragma: no cover
+    _hnswlib = None  # type: ignore
+
+
+def _int_env(name: str, default: int) -> int:
+    raw = os.getenv(name)
+    if raw is None or not str(raw).strip():
+        return default
+    try:
+        return int(str(raw).strip())
+    except Exception:
+        return default
+
+
+_EPISODE_COLUMNS = (
+    "episode_id, timestamp, summary, emotion_hint, "
+    "traits_hint, raw_context, embedding, embedding_blob"
+)
+
+_INSERT_EPISODE_SQL = """
+    INSERT OR REPLACE INTO episodes (
+        episode_id,
+        timestamp,
+        summary,
+        emotion_hint,
+        traits_hint,
+        raw_context,
+        embedding,
+        embedding_blob,
+        embedding_norm
+    )
+    VALUES (:episode_id, :timestamp, :summary, :emotion_hint,
+            :traits_hint, :raw_context, :embedding,
+            :embedding_blob, :embedding_norm)
+"""
+
 
 # ============================================================
 # Utility: cosine similarity（embedding 用）
@@ -45,6 +112,309 @@ def _cosine_similarity(a: List[float], b: List[float]) -> float:
     return dot / (na * nb)
 
 
+# ============================================================
+# Utility: embedding <-> packed float32 BLOB
+# ============================================================
+
+def _pack_embedding(vec: Sequence[float]) -> Tuple[bytes, float]:
+    """List[float] → (float32 BLOB, L2 ノルム)"""
+    arr = array("f", (float(x) for x in vec))
+    norm = math.sqrt(sum(x * x for x in arr))
+    return arr.tobytes(), norm
+
+
+def _unpack_embedding(blob: bytes) -> array:
+    arr = array("f")
+    arr.frombytes(bytes(blob))
+    return arr
+
+
+# ============================================================
+# _VectorBlock / _EmbeddingIndex（インメモリ検索行列）
+# ============================================================
+
+class _VectorBlock:
+    """
+    同一次元の embedding を連続領域に保持するブロック。
+
+    行は正規化済み（単位ベクトル）で保持するため、スコアは内積 1 回で
+    cosine similarity になる。ノルム 0 の行はゼロベクトルとして保持し、
+    スコア 0 として自然に除外される。
+    """
+
+    def __init__(self, dim: int, *, ann_min_rows: int) -> None:
+        self.dim = dim
+        self.ids: List[str] = []
+        self.pos: Dict[str, int] = {}
+
+        self._ann_min_rows = ann_min_rows
+        self._ann: Any = None
+
+        if _np is not None:
+            self._mat = _np.zeros((16, dim), dtype=_np.float32)
+            self._rows: List[array] = []
+        else:
+            self._mat = None
+            self._rows = []
+
+    def __len__(self) -> int:
+        return len(self.ids)
+
+    def _normalized(self, vec: array, norm: float) -> array:
+        if norm <= 0.0:
+            return array("f", bytes(4 * self.dim))
+        inv = 1.0 / norm
+        return array("f", (x * inv for x in vec))
+
+    def upsert(self, episode_id: str, vec: array, norm: float) -> None:
+        unit = self._normalized(vec, norm)
+        i = self.pos.get(episode_id)
+
+        if i is not None and self._row_equals(i, unit):
+            # 同じベクトルの再同期（add 直後の _sync_index など）は何もしない。ANN も保持する
+            return
+
+        if i is None:
+            i = len(self.ids)
+            self.ids.append(episode_id)
+            self.pos[episode_id] = i
+            if self._mat is not None:
+                if i >= self._mat.shape[0]:
+                    # 容量倍化で append を償却 O(1) に保つ
+                    grown = _np.zeros((self._mat.shape[0] * 2, self.dim), dtype=_np.float32)
+                    grown[:i] = self._mat[:i]
+                    self._mat = grown
+            else:
+                self._rows.append(unit)
+
+        if self._mat is not None:
+            self._mat[i] = _np.frombuffer(unit.tobytes(), dtype=_np.float32)
+        else:
+            self._rows[i] = unit
+
+        if self._ann is not None:
+            self._ann_add(i)
+
+    def _row_equals(self, i: int, unit: array) -> bool:
+        if self._mat is not None:
+            return bool(_np.array_equal(self._mat[i], _np.frombuffer(unit.tobytes(), dtype=_np.float32)))
+        return self._rows[i] == unit
+
+    def remove(self, episode_id: str) -> None:
+        i = self.pos.pop(episode_id, None)
+        if i is None:
+            return
+        last = len(self.ids) - 1
+        if i != last:
+            moved = self.ids[last]
+            self.ids[i] = moved
+            self.pos[moved] = i
+            if self._mat is not None:
+                self._mat[i] = self._mat[last]
+            else:
+                self._rows[i] = self._rows[last]
+        self.ids.pop()
+        if self._mat is None:
+            self._rows.pop()
+        # 位置 = ANN ラベルなので、並びが変わったら次回検索時に再構築する
+        self._ann = None
+
+    # --------------------------------------------------------
+    # ANN（hnswlib 利用時のみ）
+    # --------------------------------------------------------
+
+    def _ann_enabled(self) -> bool:
+        return (
+            _hnswlib is not None
+            and self._mat is not None
+            and self._ann_min_rows > 0
+            and len(self.ids) >= self._ann_min_rows
+        )
+
+    def _ann_build(self) -> None:
+        n = len(self.ids)
+        index = _hnswlib.Index(space="ip", dim=self.dim)
+        index.init_index(max_elements=max(n * 2, 1024), ef_construction=200, M=16)
+        index.add_items(self._mat[:n], _np.arange(n))
+        index.set_ef(128)
+        self._ann = index
+
+    def _ann_add(self, i: int) -> None:
+        index = self._ann
+        if i >= index.get_max_elements():
+            index.resize_index(index.get_max_elements() * 2)
+        index.add_items(self._mat[i : i + 1], _np.array([i]))
+
+    # --------------------------------------------------------
+    # top-k
+    # --------------------------------------------------------
+
+    def topk(self, query: array, qnorm: float, k: int) -> List[Tuple[float, str]]:
+        n = len(self.ids)
+        if n == 0 or k <= 0 or qnorm <= 0.0:
+            return []
+        k = min(k, n)
+        inv = 1.0 / qnorm
+
+        if self._mat is not None:
+            q = _np.frombuffer(query.tobytes(), dtype=_np.float32) * _np.float32(inv)
+
+            if self._ann is None and self._ann_enabled():
+                self._ann_build()
+            if self._ann is not None:
+                labels, dists = self._ann.knn_query(q, k=k)
+                # space="ip" の distance は 1 - dot
+                return [
+                    (float(1.0 - d), self.ids[int(lb)])
+                    for lb, d in zip(labels[0], dists[0])
+                ]
+
+            scores = self._mat[:n] @ q
+            if k < n:
+                idx = _np.argpartition(-scores, k - 1)[:k]
+            else:
+                idx = _np.arange(n)
+            idx = idx[_np.argsort(-scores[idx], kind="stable")]
+            return [(float(scores[j]), self.ids[int(j)]) for j in idx]
+
+        q_unit = [x * inv for x in query]
+        mul = operator.mul
+        return heapq.nlargest(
+            k,
+            ((sum(map(mul, row, q_unit)), eid) for row, eid in zip(self._rows, self.ids)),
+            key=lambda t: t[0],
+        )
+
+
+class _EmbeddingIndex:
+    """
+    SQLiteEpisodeStore 1 つに対応するインメモリ embedding 索引。
+
+    - 次元ごとに _VectorBlock を持つ（次元の異なる行は比較対象外＝旧挙動と同じ）
+    - rowid の high-water mark で DB と差分同期する
+      （初回のみ全件ロード、以降は増分のみ）
+    - 同一プロセス内の add() は直接 upsert される
+    """
+
+    def __init__(self, *, ann_min_rows: int) -> None:
+        self.blocks: Dict[int, _VectorBlock] = {}
+        self.synced_rowid = 0
+        self.loaded = False
+        self.lock = threading.Lock()
+        self._ann_min_rows = ann_min_rows
+
+    def _block(self, dim: int) -> _VectorBlock:
+        b = self.blocks.get(dim)
+        if b is None:
+            b = _VectorBlock(dim, ann_min_rows=self._ann_min_rows)
+            self.blocks[dim] = b
+        return b
+
+    def upsert(self, episode_id: str, blob: Optional[bytes], norm: Optional[float]) -> None:
+        vec = _unpack_embedding(blob) if blob else array("f")
+        dim = len(vec)
+        # 同じ次元のブロックでは位置を保ったまま上書きする（remove は ANN を捨てるため）
+        for d, b in self.blocks.items():
+            if d != dim and episode_id in b.pos:
+                b.remove(episode_id)
+        if not dim:
+            return
+        if norm is None:
+            norm = math.sqrt(sum(x * x for x in vec))
+        self._block(dim).upsert(episode_id, vec, float(norm))
+
+
+# ============================================================
+# _ConnectionPool（スレッドセーフな接続再利用）
+# ============================================================
+
+class _ConnectionPool:
+    """
+    sqlite3.Connection の小さなプール。
+
+    - 接続は 1 度に 1 スレッドだけが使う（acquire → release）
+    - 空きが無ければ max_size まで新規作成、それ以上は空きを待つ
+    - 各接続に WAL / synchronous / mmap_size などの pragma を 1 度だけ適用
+    """
+
+    def __init__(
+        self,
+        db_path: str,
+        *,
+        max_size: int = 8,
+        cached_statements: int = 128,
+        mmap_size: int = 256 * 1024 * 1024,
+        busy_timeout_ms: int = 5000,
+    ) -> None:
+        self._db_path = db_path
+        self._max_size = max(1, int(max_size))
+        self._cached_statements = int(cached_statements)
+        self._mmap_size = int(mmap_size)
+        self._busy_timeout_ms = int(busy_timeout_ms)
+
+        self._idle: List[sqlite3.Connection] = []
+        self._all: List[sqlite3.Connection] = []
+        self._cond = threading.Condition()
+        # close() で世代を進める。旧世代の接続（close 時に貸出中だったもの）は返却時に閉じる
+        self._generation = 0
+        self._conn_generation: Dict[int, int] = {}
+
+    def _open(self) -> sqlite3.Connection:
+        conn = sqlite3.connect(
+            self._db_path,
+            timeout=self._busy_timeout_ms / 1000.0,
+            check_same_thread=False,
+            cached_statements=self._cached_statements,
+        )
+        conn.row_factory = sqlite3.Row
+        conn.execute("PRAGMA journal_mode=WAL")
+        conn.execute("PRAGMA synchronous=NORMAL")
+        conn.execute("PRAGMA temp_store=MEMORY")
+        conn.execute(f"PRAGMA mmap_size={self._mmap_size}")
+        conn.execute(f"PRAGMA busy_timeout={self._busy_timeout_ms}")
+        return conn
+
+    def acquire(self) -> sqlite3.Connection:
+        with self._cond:
+            while True:
+                if self._idle:
+                    return self._idle.pop()
+                if len(self._all) < self._max_size:
+                    conn = self._open()
+                    self._all.append(conn)
+                    self._conn_generation[id(conn)] = self._generation
+                    return conn
+                self._cond.wait()
+
+    def release(self, conn: sqlite3.Connection) -> None:
+        with self._cond:
+            if self._conn_generation.get(id(conn)) == self._generation:
+                self._idle.append(conn)
+                self._cond.notify()
+                return
+            self._conn_generation.pop(id(conn), None)
+        self._close_quietly(conn)
+
+    def close(self) -> None:
+        with self._cond:
+            idle, self._idle = self._idle, []
+            for conn in idle:
+                self._conn_generation.pop(id(conn), None)
+            # 貸出中の接続は旧世代のまま残り、release() で閉じられる
+            self._all = []
+            self._generation += 1
+            self._cond.notify_all()
+        for conn in idle:
+            self._close_quietly(conn)
+
+    @staticmethod
+    def _close_quietly(conn: sqlite3.Connection) -> None:
+        try:
+            conn.close()
+        except Exception:
+            pass
+
+
 # ============================================================
 # SQLiteEpisodeStore 本体
 # ============================================================
@@ -58,22 +428,58 @@ class SQLiteEpisodeStore:
 
     DEFAULT_DB_PATH = "./sigmaris-data/episodes.sqlite3"
 
-    def __init__(self, db_path: Optional[str] = None) -> None:
+    # この件数以上のブロックで（hnswlib があれば）ANN を使う。0 で無効。
+    DEFAULT_ANN_MIN_ROWS = 50000
+
+    def __init__(
+        self,
+        db_path: Optional[str] = None,
+        *,
+        ann_min_rows: Optional[int] = None,
+        pool_size: Optional[int] = None,
+    ) -> None:
         self.db_path = db_path or self.DEFAULT_DB_PATH
 
         # ディレクトリ作成
         os.makedirs(os.path.dirname(self.db_path), exist_ok=True)
 
+        # 接続プール（WAL / pragma は接続作成時に 1 度だけ）
+        if pool_size is None:
+            pool_size = _int_env("SIGMARIS_EPISODE_SQLITE_POOL_SIZE", 8)
+        self._pool = _ConnectionPool(self.db_path, max_size=int(pool_size))
+
         # スキーマ初期化
         self._init_schema()
 
+        # インメモリ embedding 索引（初回 search_embedding で遅延ロード）
+        if ann_min_rows is None:
+            ann_min_rows = _int_env("SIGMARIS_EPISODE_ANN_MIN_ROWS", self.DEFAULT_ANN_MIN_ROWS)
+        self._index = _EmbeddingIndex(ann_min_rows=int(ann_min_rows))
+
+        # trait_trend の窓（初回 trait_trend で DB から作る）
+        self._trend_lock = threading.Lock()
+        self._trend: Optional[WindowedMean] = None
+        self._trend_ids: List[str] = []
+        self._trend_newest: Optional[datetime] = None
+        self._trend_rowid: Optional[int] = None  # メモが反映している MAX(rowid)
+
     # --------------------------------------------------------
     # 内部: 接続 & スキーマ
     # --------------------------------------------------------
 
-    def _connect(self) -> sqlite3.Connection:
-        # シンプルさ優先で都度接続（スレッドセーフ）
-        return sqlite3.connect(self.db_path)
+    @contextmanager
+    def _connect(self) -> Iterator[sqlite3.Connection]:
+        # プールから借りた接続を 1 トランザクションとして使い、返却する
+        conn = self._pool.acquire()
+        try:
+            with conn:
+                yield conn
+        finally:
+            self._pool.release(conn)
+
+    def close(self) -> None:
+        """プール内の接続をすべて閉じる（以降の呼び出しでは再接続される）"""
+        self._pool.close()
 
     def _init_schema(self) -> None:
         with self._connect() as conn:
@@ -87,7 +493,9 @@ class SQLiteEpisodeStore:
                     emotion_hint TEXT,
                     traits_hint  TEXT,   -- JSON
                     raw_context  TEXT,
-                    embedding    TEXT    -- JSON (List[float] or null)
+                    embedding    TEXT,   -- JSON（旧形式。新規行では NULL）
+                    embedding_blob BLOB, -- packed float32
+                    embedding_norm REAL  -- L2 ノルム（事前計算）
                 );
                 """
             )
@@ -96,6 +504,35 @@ class SQLiteEpisodeStore:
                 "CREATE INDEX IF NOT EXISTS idx_episodes_timestamp "
                 "ON episodes (timestamp);"
             )
+
+            # 旧スキーマ（embedding JSON のみ）からの移行
+            cols = {r[1] for r in cur.execute("PRAGMA table_info(episodes)").fetchall()}
+            if "embedding_blob" not in cols:
+                cur.execute("ALTER TABLE episodes ADD COLUMN embedding_blob BLOB")
+            if "embedding_norm" not in cols:
+                cur.execute("ALTER TABLE episodes ADD COLUMN embedding_norm REAL")
+
+            legacy = cur.execute(
+                "SELECT episode_id, embedding FROM episodes "
+                "WHERE embedding IS NOT NULL AND embedding_blob IS NULL"
+            ).fetchall()
+            updates = []
+            for episode_id, emb_json in legacy:
+                try:
+                    loaded = json.loads(emb_json)
+                except Exception:
+                    loaded = None
+                if isinstance(loaded, list) and loaded:
+                    blob, norm = _pack_embedding(loaded)
+                    updates.append((blob, norm, episode_id))
+                else:
+                    updates.append((None, None, episode_id))
+            if updates:
+                cur.executemany(
+                    "UPDATE episodes SET embedding_blob = ?, embedding_norm = ?, "
+                    "embedding = NULL WHERE episode_id = ?",
+                    updates,
+                )
             conn.commit()
 
     # --------------------------------------------------------
@@ -107,7 +544,11 @@ class SQLiteEpisodeStore:
         # timestamp は ISO 文字列で保存（Episode.as_dict と同等）
         ts = episode.timestamp.astimezone(timezone.utc).isoformat()
         traits_json = json.dumps(episode.traits_hint or {}, ensure_ascii=False)
-        emb_json = json.dumps(episode.embedding, ensure_ascii=False) if episode.embedding is not None else None
+
+        emb_blob: Optional[bytes] = None
+        emb_norm: Optional[float] = None
+        if episode.embedding:
+            emb_blob, emb_norm = _pack_embedding(episode.embedding)
 
         return {
             "episode_id": episode.episode_id,
@@ -116,12 +557,14 @@ class SQLiteEpisodeStore:
             "emotion_hint": episode.emotion_hint,
             "traits_hint": traits_json,
             "raw_context": episode.raw_context,
-            "embedding": emb_json,
+            "embedding": None,
+            "embedding_blob": emb_blob,
+            "embedding_norm": emb_norm,
         }
 
     def _row_to_episode(self, row: sqlite3.Row) -> Episode:
-        # row: (episode_id, timestamp, summary, emotion_hint, traits_hint, raw_context, embedding)
-        episode_id, ts_raw, summary, emotion_hint, traits_json, raw_context, emb_json = row
+        # row: _EPISODE_COLUMNS の順
+        episode_id, ts_raw, summary, emotion_hint, traits_json, raw_context, emb_json, emb_blob = row
 
         # timestamp 復元
         if ts_raw:
@@ -148,7 +591,9 @@ class SQLiteEpisodeStore:
             traits = {}
 
         embedding: Optional[List[float]]
-        if emb_json:
+        if emb_blob:
+            embedding = _unpack_embedding(emb_blob).tolist()
+        elif emb_json:
             try:
                 embedding_loaded = json.loads(emb_json)
                 if isinstance(embedding_loaded, list):
@@ -181,33 +626,63 @@ class SQLiteEpisodeStore:
         """
         row = self._episode_to_row(episode)
         with self._connect() as conn:
-            cur = conn.cursor()
-            cur.execute(
-                """
-                INSERT OR REPLACE INTO episodes (
-                    episode_id,
-                    timestamp,
-                    summary,
-                    emotion_hint,
-                    traits_hint,
-                    raw_context,
-                    embedding
-                )
-                VALUES (:episode_id, :timestamp, :summary, :emotion_hint,
-                        :traits_hint, :raw_context, :embedding)
-                """,
-                row,
+            conn.execute(_INSERT_EPISODE_SQL, row)
+            max_rowid = self._max_rowid(conn)
+        self._trend_push([episode], max_rowid=max_rowid)
+
+        # 索引がロード済みなら差分を直接反映（未ロードなら初回同期で拾われる）
+        with self._index.lock:
+            if self._index.loaded:
+                self._index.upsert(episode.episode_id, row["embedding_blob"], row["embedding_norm"])
+
+    def add_many(self, episodes: Iterable[Episode]) -> None:
+        """
+        複数 Episode を 1 トランザクション（executemany）でまとめて追加する。
+        """
+        episodes = list(episodes)
+        rows = [self._episode_to_row(ep) for ep in episodes]
+        if not rows:
+            return
+        with self._connect() as conn:
+            conn.executemany(_INSERT_EPISODE_SQL, rows)
+            max_rowid = self._max_rowid(conn)
+        self._trend_push(episodes, max_rowid=max_rowid)
+
+        with self._index.lock:
+            if self._index.loaded:
+                for row in rows:
+                    self._index.upsert(row["episode_id"], row["embedding_blob"], row["embedding_norm"])
+
+    def update_embeddings(self, embeddings: Dict[str, Sequence[float]]) -> None:
+        """
+        embedding を持たない既存 Episode に、後から計算した embedding を書き戻す（SelectiveRecall 用）。
+        UPDATE は rowid を変えないので、ロード済み索引には直接反映する。
+        """
+        rows = []
+        for episode_id, vec in (embeddings or {}).items():
+            if not episode_id or not vec:
+                continue
+            blob, norm = _pack_embedding(vec)
+            rows.append((blob, norm, str(episode_id)))
+        if not rows:
+            return
+        with self._connect() as conn:
+            conn.executemany(
+                "UPDATE episodes SET embedding_blob = ?, embedding_norm = ?, embedding = NULL "
+                "WHERE episode_id = ? AND embedding_blob IS NULL",
+                rows,
             )
-            conn.commit()
+
+        with self._index.lock:
+            if self._index.loaded:
+                for blob, norm, episode_id in rows:
+                    self._index.upsert(episode_id, blob, norm)
 
     def load_all(self) -> List[Episode]:
         with self._connect() as conn:
-            conn.row_factory = sqlite3.Row
             cur = conn.cursor()
             cur.execute(
-                "SELECT episode_id, timestamp, summary, emotion_hint, "
-                "traits_hint, raw_context, embedding "
-                "FROM episodes ORDER BY timestamp ASC"
+                f"SELECT {_EPISODE_COLUMNS} FROM episodes ORDER BY timestamp ASC"
             )
             rows = cur.fetchall()
         return [self._row_to_episode(r) for r in rows]
@@ -221,12 +696,9 @@ class SQLiteEpisodeStore:
             return []
 
         with self._connect() as conn:
-            conn.row_factory = sqlite3.Row
             cur = conn.cursor()
             cur.execute(
-                "SELECT episode_id, timestamp, summary, emotion_hint, "
-                "traits_hint, raw_context, embedding "
-                "FROM episodes ORDER BY timestamp DESC LIMIT ?",
+                f"SELECT {_EPISODE_COLUMNS} FROM episodes ORDER BY timestamp DESC LIMIT ?",
                 (n,),
             )
             rows = cur.fetchall()
@@ -253,22 +725,56 @@ class SQLiteEpisodeStore:
     def trait_trend(self, n: int = 5) -> Dict[str, float]:
         """
         直近 n 件の traits_hint の平均。
-        JSON 版 EpisodeStore の実装と同じロジックを SQL で再現。
+        JSON 版 EpisodeStore の実装と同じロジック。同じ n が続き、DB の MAX(rowid) が
+        メモと一致する限り（= 誰も書き込んでいない / 自プロセスの add で追随済み）DB は読まない。
         """
-        eps = self.get_last(n)
-        if not eps:
-            return {"calm": 0.0, "empathy": 0.0, "curiosity": 0.0}
-
-        calm_sum = sum(ep.traits_hint.get("calm", 0.0) for ep in eps)
-        emp_sum = sum(ep.traits_hint.get("empathy", 0.0) for ep in eps)
-        cur_sum = sum(ep.traits_hint.get("curiosity", 0.0) for ep in eps)
-        denom = float(len(eps))
-
-        return {
-            "calm": round(calm_sum / denom, 4),
-            "empathy": round(emp_sum / denom, 4),
-            "curiosity": round(cur_sum / denom, 4),
-        }
+        with self._trend_lock:
+            if self._trend is not None and self._trend.size == n:
+                with self._connect() as conn:
+                    if self._max_rowid(conn) == self._trend_rowid:
+                        return self._trend.mean()
+
+            # マーカーを先に読む（間に書き込みが入ってもマーカーが古い側に倒れ、次回読み直す）
+            with self._connect() as conn:
+                rowid = self._max_rowid(conn)
+            eps = self.get_last(n)
+            trend = WindowedMean(max(1, n))
+            for ep in eps:
+                trend.push(ep.traits_hint or {})
+            if n > 0:
+                self._trend = trend
+                self._trend_ids = [ep.episode_id for ep in eps]
+                self._trend_newest = eps[-1].timestamp if eps else None
+                self._trend_rowid = rowid
+            return trend.mean()
+
+    @staticmethod
+    def _max_rowid(conn: sqlite3.Connection) -> int:
+        (rowid,) = conn.execute("SELECT MAX(rowid) FROM episodes").fetchone() or (None,)
+        return int(rowid or 0)
+
+    def _trend_push(self, episodes: Sequence[Episode], *, max_rowid: int) -> None:
+        with self._trend_lock:
+            if self._trend is None:
+                return
+            # 追加した行だけが増えていること（rowid は MAX+1 で振られる）。別プロセスの書き込みや
+            # 置き換えが挟まっていたら差分では追えないので、次回 DB から作り直す
+            if self._trend_rowid is None or max_rowid != self._trend_rowid + len(episodes):
+                self._trend = None
+                return
+            try:
+                for ep in sorted(episodes, key=lambda e: e.timestamp):
+                    if ep.episode_id in self._trend_ids or (
+                        self._trend_newest is not None and ep.timestamp < self._trend_newest
+                    ):
+                        raise ValueError("out-of-order episode")
+                    self._trend.push(ep.traits_hint or {})
+                    self._trend_ids = [*self._trend_ids, ep.episode_id][-self._trend.size :]
+                    self._trend_newest = ep.timestamp
+                self._trend_rowid = max_rowid
+            except Exception:
+                # 置き換え / 過去日付の挿入 / naive と aware の混在: 次回 DB から作り直す
+                self._trend = None
 
     # --------------------------------------------------------
     # Persona Core（SelectiveRecall / EpisodeMerger）必須 API
@@ -283,12 +789,9 @@ class SQLiteEpisodeStore:
             return []
 
         with self._connect() as conn:
-            conn.row_factory = sqlite3.Row
             cur = conn.cursor()
             cur.execute(
-                "SELECT episode_id, timestamp, summary, emotion_hint, "
-                "traits_hint, raw_context, embedding "
-                "FROM episodes ORDER BY timestamp DESC LIMIT ?",
+                f"SELECT {_EPISODE_COLUMNS} FROM episodes ORDER BY timestamp DESC LIMIT ?",
                 (limit,),
             )
             rows = cur.fetchall()
@@ -310,15 +813,9 @@ class SQLiteEpisodeStore:
         placeholders = ",".join("?" for _ in ids)
 
         with self._connect() as conn:
-            conn.row_factory = sqlite3.Row
             cur = conn.cursor()
             cur.execute(
-                f"""
-                SELECT episode_id, timestamp, summary, emotion_hint,
-                       traits_hint, raw_context, embedding
-                FROM episodes
-                WHERE episode_id IN ({placeholders})
-                """,
+                f"SELECT {_EPISODE_COLUMNS} FROM episodes WHERE episode_id IN ({placeholders})",
                 ids,
             )
             rows = cur.fetchall()
@@ -330,62 +827,54 @@ class SQLiteEpisodeStore:
         # 元の ids の順序を維持
         return [table[eid] for eid in ids if eid in table]
 
-    def search_embedding(self, vector: List[float], limit: int = 5) -> List[Episode]:
+    def _sync_index(self) -> None:
         """
-        ベクトル検索（embedding）用 API。
+        インメモリ索引を DB と差分同期する（呼び出し側で index.lock を保持）。
 
-        実装方針：
-          - embedding が存在する Episode を一括取得
-          - Python 側で cosine similarity を計算
-          - スコア上位 limit 件を返す
+        INSERT OR REPLACE は行を作り直すため、置き換えも新しい rowid として拾える。
         """
-        if not vector or limit <= 0:
-            return self.fetch_recent(limit=limit if limit > 0 else 5)
-
+        idx = self._index
         with self._connect() as conn:
-            conn.row_factory = sqlite3.Row
             cur = conn.cursor()
             cur.execute(
-                """
-                SELECT episode_id, timestamp, summary, emotion_hint,
-                       traits_hint, raw_context, embedding
-                FROM episodes
-                WHERE embedding IS NOT NULL
-                """
+                "SELECT rowid, episode_id, embedding_blob, embedding_norm "
+                "FROM episodes WHERE rowid > ? ORDER BY rowid ASC",
+                (idx.synced_rowid,),
             )
-            rows = cur.fetchall()
-
-        scored: List[tuple[float, Episode]] = []
-
-        for r in rows:
-            # embedding JSON → List[float]
-            emb_json = r["embedding"]
-            if not emb_json:
-                continue
+            for rowid, episode_id, blob, norm in cur:
+                idx.upsert(episode_id, blob, norm)
+                idx.synced_rowid = rowid
+        idx.loaded = True
 
-            try:
-                emb_loaded = json.loads(emb_json)
-                if not isinstance(emb_loaded, list):
-                    continue
-                emb_vec = [float(x) for x in emb_loaded]
-            except Exception:
-                continue
+    def search_embedding(self, vector: List[float], limit: int = 5) -> List[Episode]:
+        """
+        ベクトル検索（embedding）用 API。
 
-            if len(emb_vec) != len(vector):
-                continue
+        実装方針：
+          - 初回のみ embedding BLOB を全件ロードして次元ごとの行列を構築
+            （以降は rowid 差分のみ同期）
+          - 正規化済み行列 × クエリの一括内積で cosine similarity を計算
+            （numpy / 大規模時は hnswlib ANN）
+          - 上位 limit 件の id だけを DB から取り出して返す
+        """
+        if not vector or limit <= 0:
+            return self.fetch_recent(limit=limit if limit > 0 else 5)
 
-            sim = _cosine_similarity(vector, emb_vec)
-            if sim <= 0.0:
-                continue
+        try:
+            query = array("f", (float(x) for x in vector))
+        except Exception:
+            return self.fetch_recent(limit=limit)
+        qnorm = math.sqrt(sum(x * x for x in query))
 
-            ep = self._row_to_episode(r)
-            scored.append((sim, ep))
+        with self._index.lock:
+            self._sync_index()
+            block = self._index.blocks.get(len(query))
+            hits = block.topk(query, qnorm, limit) if block is not None else []
 
-        if not scored:
+        top_ids = [eid for sim, eid in hits if sim > 0.0]
+        if not top_ids:
             # embedding が無い / スコアゼロ → fallback
             return self.fetch_recent(limit=limit)
 
-        scored.sort(key=lambda x: x[0], reverse=True)
-        top_eps = [ep for _, ep in scored[:limit]]
-        # 類似度順のままで問題ないが、必要なら timestamp で再ソート可能
-        return top_eps
\ No newline at end of file
+        # 類似度順のまま返す（fetch_by_ids は ids の順序を維持する）
+        return self.fetch_by_ids(top_ids)
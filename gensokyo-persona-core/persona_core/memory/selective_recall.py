@@ -39,6 +39,10 @@ class SelectiveRecall:
     embedding_model:
         - encode(text) -> List[float]
         - similarity(v1, v2) -> float
+        - （任意）encode_many(texts) -> List[List[float]]
+
+    memory_backend（任意）:
+        - update_embeddings({episode_id: embedding}) — 後から計算した embedding の書き戻し
     """
 
     def __init__(
@@ -71,17 +75,48 @@ class SelectiveRecall:
         """
         encode / embed のどちらでも動作する安全ラッパ
         """
+        v = self._try_encode(text)
+        if v is not None:
+            return v
+        return [0.0] * self._fallback_dim
+
+    def _try_encode(self, text: str) -> Optional[List[float]]:
+        """_encode と同じだが、失敗時はゼロベクトルではなく None を返す。"""
         try:
             if hasattr(self._embed, "encode"):
                 v = self._embed.encode(text)
             else:
                 v = self._embed.embed(text)
-            if isinstance(v, list):
+            if isinstance(v, list) and v:
                 self._fallback_dim = len(v)
                 return v
         except Exception:
             pass
-        return [0.0] * self._fallback_dim
+        return None
+
+    def _encode_many(self, texts: List[str]) -> List[Optional[List[float]]]:
+        """
+        embedding_model が encode_many を持てば 1 回の batched 呼び出しで、なければ 1 件ずつ encode。
+        batch が失敗した / 使えないベクトルを返した要素は 1 件ずつ取り直し、それでも駄目なら None（欠損）。
+        """
+        if not texts:
+            return []
+        fn = getattr(self._embed, "encode_many", None)
+        if callable(fn):
+            try:
+                vecs = fn(texts)
+                if isinstance(vecs, list) and len(vecs) == len(texts):
+                    out: List[Optional[List[float]]] = []
+                    for t, v in zip(texts, vecs):
+                        if isinstance(v, list) and v:
+                            self._fallback_dim = len(v)
+                            out.append(v)
+                        else:
+                            out.append(self._try_encode(t))
+                    return out
+            except Exception:
+                pass
+        return [self._try_encode(t) for t in texts]
 
     # ------------------------------------------------------
     # (1) 候補収集
@@ -104,9 +139,35 @@ class SelectiveRecall:
         except Exception:
             return []
 
-        # ---- Query ベクトル化 ----
+        # ---- Query + embedding 未保持 Episode をまとめてベクトル化（1 回の batched 呼び出し） ----
         text = req.message or ""
-        req_vec = self._encode(text)
+        missing: List[Any] = []
+        for ep in episodes:
+            emb = getattr(ep, "embedding", None)
+            if not (isinstance(emb, list) and emb):
+                missing.append(ep)
+        vecs = self._encode_many(
+            [text] + [getattr(ep, "summary", None) or getattr(ep, "content", "") or "" for ep in missing]
+        )
+        req_vec = vecs[0] or [0.0] * self._fallback_dim
+
+        # 計算した embedding は Episode に書き戻し、次回以降は再計算しない
+        computed: Dict[str, List[float]] = {}
+        for ep, vec in zip(missing, vecs[1:]):
+            if not vec or not any(vec):
+                continue  # encode 失敗は保存しない（類似度は欠損扱い）
+            try:
+                ep.embedding = vec
+            except Exception:
+                continue
+            ep_id = getattr(ep, "episode_id", None) or getattr(ep, "id", None)
+            if ep_id:
+                computed[str(ep_id)] = vec
+        if computed and hasattr(self._backend, "update_embeddings"):
+            try:
+                self._backend.update_embeddings(computed)
+            except Exception:
+                pass
 
         candidates: List[RecallCandidate] = []
         total = len(episodes) or 1
@@ -116,16 +177,16 @@ class SelectiveRecall:
             timestamp = getattr(ep, "timestamp", None)
 
             # ---- 類似度 ----
-            try:
-                # 既に embedding を保持している Episode なら再計算しない（永続化/キャッシュ時の最適化）
-                emb = getattr(ep, "embedding", None)
-                if isinstance(emb, list) and emb:
-                    ep_vec = [float(x) for x in emb]
-                else:
-                    ep_vec = self._encode(summary)
-                score = float(self._embed.similarity(req_vec, ep_vec))
-            except Exception:
-                score = 0.0
+            # 既に embedding を保持している Episode なら再計算しない（永続化/キャッシュ時の最適化）。
+            # encode できなかった Episode はゼロベクトルで測らず、類似度なし（embedding_missing）として扱う
+            emb = getattr(ep, "embedding", None)
+            embedding_missing = not (isinstance(emb, list) and emb)
+            score = 0.0
+            if not embedding_missing:
+                try:
+                    score = float(self._embed.similarity(req_vec, [float(x) for x in emb]))
+                except Exception:
+                    score = 0.0
 
             # ---- Recency Bias ----
             if self._use_recency:
@@ -149,7 +210,7 @@ class SelectiveRecall:
                     episode_id=str(ep_id),
                     text=summary,
                     score=score,
-                    metadata={"timestamp": ts_str},
+                    metadata={"timestamp": ts_str, **({"embedding_missing": True} if embedding_missing else {})},
                 )
             )
 
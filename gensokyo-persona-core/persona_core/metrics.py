@@ -0,0 +1,609 @@
+"""
+persona_core.metrics
+
+低オーバーヘッドのメトリクス / span 層（依存なし）。
+
+- Counter / Histogram を process 内に集計し、`render_prometheus()` で Prometheus text format (0.0.4) を返す
+  （server_persona_os.py の `GET /metrics`）
+- cache hit 率や queue 深さのような「既に stats() があるもの」は collector として scrape 時に読む
+- 1 ターン = 1 TurnScope（contextvar）。Supabase round-trip をターン単位で数え、終了時に histogram へ
+- span はサンプリングしたターンだけ作る（OpenTelemetry 互換のフィールド名）。
+  `opentelemetry` が入っていて `SIGMARIS_OTEL=1` なら OTel tracer に流し、無ければ JSON を logger に出す
+
+Env:
+- SIGMARIS_METRICS            (default 1; 0 で全記録関数が即 return)
+- SIGMARIS_TRACE_SAMPLE_RATE  (default 0; 0..1。span を作るターンの割合)
+- SIGMARIS_OTEL               (default 0; 1 で opentelemetry API に export)
+"""
+
+from __future__ import annotations
+
+import bisect
+import contextvars
+import json
+import logging
+import math
+import os
+import random
+import threading
+import time
+from contextlib import contextmanager
+from typing import Any, Callable, Dict, Iterable, Iterator, List, Optional, Sequence, Tuple
+
+
+def _env_flag(name: str, default: str = "0") -> bool:
+    v = os.getenv(name, default)
+    return v not in ("", "0", "false", "False", "no", "No")
+
+
+def _env_float(name: str, default: float) -> float:
+    try:
+        return float(os.getenv(name, str(default)) or default)
+    except Exception:
+        return float(default)
+
+
+METRICS_ENABLED = _env_flag("SIGMARIS_METRICS", "1")
+SPAN_SAMPLE_RATE = max(0.0, min(1.0, _env_float("SIGMARIS_TRACE_SAMPLE_RATE", 0.0)))
+OTEL_EXPORT = _env_flag("SIGMARIS_OTEL", "0")
+
+try:  # pragma: no cover - optional dependency
+    from opentelemetry import trace as _otel_trace  # type: ignore
+except Exception:  # pragma: no cover
+    _otel_trace = None
+
+_span_log = logging.getLogger("persona_core.spans")
+
+# seconds
+LATENCY_BUCKETS: Tuple[float, ...] = (0.001, 0.0025, 0.005, 0.01, 0.025, 0.05, 0.1, 0.25, 0.5, 1.0, 2.5, 5.0, 10.0, 30.0)
+COUNT_BUCKETS: Tuple[float, ...] = (0, 1, 2, 3, 5, 8, 13, 21, 34)
+TOKEN_BUCKETS: Tuple[float, ...] = (16, 64, 128, 256, 512, 1024, 2048, 4096, 8192)
+RATIO_BUCKETS: Tuple[float, ...] = (0.0, 0.1, 0.25, 0.5, 0.75, 0.9, 1.0)
+
+
+# =========================================================
+# Registry
+# =========================================================
+
+LabelKey = Tuple[str, ...]
+
+
+def _fmt_value(v: float) -> str:
+    if v == math.inf:
+        return "+Inf"
+    if float(v).is_integer():
+        return str(int(v))
+    return repr(float(v))
+
+
+def _escape(v: str) -> str:
+    return str(v).replace("\\", "\\\\").replace("\n", "\\n").replace('"', '\\"')
+
+
+def _fmt_labels(names: Sequence[str], values: Sequence[str], extra: Optional[Tuple[str, str]] = None) -> str:
+    pairs = [f'{n}="{_escape(v)}"' for n, v in zip(names, values)]
+    if extra is not None:
+        pairs.append(f'{extra[0]}="{_escape(extra[1])}"')
+    return "{" + ",".join(pairs) + "}" if pairs else ""
+
+
+class Counter:
+    def __init__(self, name: str, help_text: str, labelnames: Sequence[str] = ()) -> None:
+        self.name = name
+        self.help = help_text
+        self.labelnames = tuple(labelnames)
+        self._values: Dict[LabelKey, float] = {}
+        self._lock = threading.Lock()
+
+    def inc(self, value: float = 1.0, **labels: Any) -> None:
+        if not METRICS_ENABLED:
+            return
+        key = tuple(str(labels.get(n, "")) for n in self.labelnames)
+        with self._lock:
+            self._values[key] = self._values.get(key, 0.0) + float(value)
+
+    def render(self) -> List[str]:
+        out = [f"# HELP {self.name} {self.help}", f"# TYPE {self.name} counter"]
+        with self._lock:
+            items = list(self._values.items())
+        for key, v in items:
+            out.append(f"{self.name}{_fmt_labels(self.labelnames, key)} {_fmt_value(v)}")
+        return out
+
+
+class Histogram:
+    def __init__(
+        self,
+        name: str,
+        help_text: str,
+        labelnames: Sequence[str] = (),
+        buckets: Sequence[float] = LATENCY_BUCKETS,
+    ) -> None:
+        self.name = name
+        self.help = help_text
+        self.labelnames = tuple(labelnames)
+        self.buckets = tuple(sorted(float(b) for b in buckets))
+        # key -> [bucket counts..., sum, count]
+        self._values: Dict[LabelKey, List[float]] = {}
+        self._lock = threading.Lock()
+
+    def observe(self, value: float, **labels: Any) -> None:
+        if not METRICS_ENABLED:
+            return
+        v = float(value)
+        key = tuple(str(labels.get(n, "")) for n in self.labelnames)
+        i = bisect.bisect_left(self.buckets, v)
+        with self._lock:
+            row = self._values.get(key)
+            if row is None:
+                row = [0.0] * (len(self.buckets) + 2)
+                self._values[key] = row
+            if i < len(self.buckets):
+                row[i] += 1
+            row[-2] += v
+            row[-1] += 1
+
+    def render(self) -> List[str]:
+        out = [f"# HELP {self.name} {self.help}", f"# TYPE {self.name} histogram"]
+        with self._lock:
+            items = [(k, list(v)) for k, v in self._values.items()]
+        for key, row in items:
+            acc = 0.0
+            for b, c in zip(self.buckets, row):
+                acc += c
+                out.append(f"{self.name}_bucket{_fmt_labels(self.labelnames, key, ('le', _fmt_value(b)))} {_fmt_value(acc)}")
+            out.append(f"{self.name}_bucket{_fmt_labels(self.labelnames, key, ('le', '+Inf'))} {_fmt_value(row[-1])}")
+            out.append(f"{self.name}_sum{_fmt_labels(self.labelnames, key)} {_fmt_value(row[-2])}")
+            out.append(f"{self.name}_count{_fmt_labels(self.labelnames, key)} {_fmt_value(row[-1])}")
+        return out
+
+
+# collector: () -> [(name, type, help, [(labels_dict, value), ...]), ...]
+Sample = Tuple[Dict[str, str], float]
+Family = Tuple[str, str, str, List[Sample]]
+
+
+class Registry:
+    def __init__(self) -> None:
+        self._metrics: Dict[str, Any] = {}
+        self._collectors: Dict[str, Callable[[], Iterable[Family]]] = {}
+        self._lock = threading.Lock()
+
+    def counter(self, name: str, help_text: str, labelnames: Sequence[str] = ()) -> Counter:
+        with self._lock:
+            m = self._metrics.get(name)
+            if m is None:
+                m = Counter(name, help_text, labelnames)
+                self._metrics[name] = m
+            return m
+
+    def histogram(
+        self,
+        name: str,
+        help_text: str,
+        labelnames: Sequence[str] = (),
+        buckets: Sequence[float] = LATENCY_BUCKETS,
+    ) -> Histogram:
+        with self._lock:
+            m = self._metrics.get(name)
+            if m is None:
+                m = Histogram(name, help_text, labelnames, buckets)
+                self._metrics[name] = m
+            return m
+
+    def register_collector(self, key: str, fn: Callable[[], Iterable[Family]]) -> None:
+        # key で上書き（reload / テストで二重登録しない）
+        with self._lock:
+            self._collectors[key] = fn
+
+    def render(self) -> str:
+        with self._lock:
+            metrics = list(self._metrics.values())
+            collectors = list(self._collectors.values())
+        lines: List[str] = []
+        for m in metrics:
+            lines.extend(m.render())
+        for fn in collectors:
+            try:
+                families = list(fn() or [])
+            except Exception:
+                continue
+            for name, mtype, help_text, samples in families:
+                lines.append(f"# HELP {name} {help_text}")
+                lines.append(f"# TYPE {name} {mtype}")
+                for labels, value in samples:
+                    names = tuple(labels.keys())
+                    lines.append(f"{name}{_fmt_labels(names, tuple(labels[n] for n in names))} {_fmt_value(float(value))}")
+        return "\n".join(lines) + "\n"
+
+
+REGISTRY = Registry()
+
+
+def render_prometheus() -> str:
+    if not METRICS_ENABLED:
+        return "# metrics disabled (SIGMARIS_METRICS=0)\n"
+    return REGISTRY.render()
+
+
+def register_collector(key: str, fn: Callable[[], Iterable[Family]]) -> None:
+    REGISTRY.register_collector(key, fn)
+
+
+# =========================================================
+# Metric families
+# =========================================================
+
+TURNS = REGISTRY.counter("sigmaris_turns_total", "Persona turns handled.", ("mode",))
+TURN_SECONDS = REGISTRY.histogram("sigmaris_turn_duration_seconds", "Controller turn duration.", ("mode",))
+STAGE_SECONDS = REGISTRY.histogram("sigmaris_stage_duration_seconds", "Controller stage duration.", ("stage", "mode"))
+FIRST_DELTA_SECONDS = REGISTRY.histogram(
+    "sigmaris_turn_first_delta_seconds", "Turn start to first streamed delta (controller side)."
+)
+
+LLM_REQUESTS = REGISTRY.counter("sigmaris_llm_requests_total", "Chat completion requests.", ("kind", "outcome"))
+LLM_SECONDS = REGISTRY.histogram("sigmaris_llm_request_duration_seconds", "Chat completion duration.", ("kind",))
+LLM_TTFT_SECONDS = REGISTRY.histogram("sigmaris_llm_ttft_seconds", "Chat completion request to first content chunk.")
+LLM_TOKENS = REGISTRY.counter(
+    "sigmaris_llm_tokens_total",
+    "LLM tokens (source=usage: reported by the API, source=chunks: streamed chunk count estimate).",
+    ("type", "source"),
+)
+LLM_COMPLETION_TOKENS = REGISTRY.histogram(
+    "sigmaris_llm_completion_tokens", "Completion tokens per request.", buckets=TOKEN_BUCKETS
+)
+LLM_PROMPT_CACHE_RATIO = REGISTRY.histogram(
+    "sigmaris_llm_prompt_cache_ratio",
+    "usage.prompt_tokens_details.cached_tokens / prompt_tokens per request.",
+    ("kind",),
+    buckets=RATIO_BUCKETS,
+)
+LLM_PROMPT_CACHE_LATENCY = REGISTRY.histogram(
+    "sigmaris_llm_prompt_cache_latency_seconds",
+    "Chat latency by prompt cache outcome (chat: whole request, chat_stream: TTFT).",
+    ("kind", "cache"),
+)
+
+LLM_CONTINUATIONS = REGISTRY.counter(
+    "sigmaris_llm_continuations_total", "Serial continuation requests after finish_reason=length.", ("strategy",)
+)
+QUALITY_PATHS = REGISTRY.counter(
+    "sigmaris_quality_path_total", "Quality pipeline runs by strategy and path taken.", ("strategy", "path")
+)
+QUALITY_SECONDS = REGISTRY.histogram(
+    "sigmaris_quality_path_duration_seconds", "Quality pipeline duration by strategy and path.", ("strategy", "path")
+)
+QUALITY_SCORE = REGISTRY.histogram(
+    "sigmaris_quality_judge_min_score", "Lowest rubric score reported by the judge / self-QC.", ("strategy",), buckets=RATIO_BUCKETS
+)
+
+SUPABASE_REQUESTS = REGISTRY.counter(
+    "sigmaris_supabase_requests_total", "Supabase REST requests.", ("method", "status_class", "scope")
+)
+SUPABASE_SECONDS = REGISTRY.histogram("sigmaris_supabase_request_duration_seconds", "Supabase REST round-trip.", ("method",))
+SUPABASE_PER_TURN = REGISTRY.histogram(
+    "sigmaris_supabase_roundtrips_per_turn", "Supabase REST round-trips made inside one turn.", buckets=COUNT_BUCKETS
+)
+
+STREAM_TTFB_SECONDS = REGISTRY.histogram("sigmaris_stream_ttfb_seconds", "/persona/chat/stream request to first delta sent.")
+STREAM_GAP_SECONDS = REGISTRY.histogram("sigmaris_stream_inter_delta_seconds", "Gap between streamed delta events.")
+
+
+# =========================================================
+# Turn scope + spans
+# =========================================================
+
+# controller の t_marks の順序（controller 側の Phase03 timing と同じ）
+STAGE_ORDER: Tuple[str, ...] = ("memory", "identity", "global_fsm", "telemetry", "phase03", "guardrail", "llm", "store")
+
+
+class TurnScope:
+    __slots__ = ("mode", "trace_id", "sampled", "supabase_roundtrips", "spans")
+
+    def __init__(self, mode: str, trace_id: Optional[str], sampled: bool) -> None:
+        self.mode = mode
+        self.trace_id = trace_id
+        self.sampled = sampled
+        # to_thread でコピーされた context からも同じオブジェクトを更新する（mutable holder）
+        self.supabase_roundtrips = 0
+        self.spans: List[Dict[str, Any]] = []
+
+
+_TURN: "contextvars.ContextVar[Optional[TurnScope]]" = contextvars.ContextVar("sigmaris_turn_scope", default=None)
+
+
+def current_turn() -> Optional[TurnScope]:
+    return _TURN.get()
+
+
+def _sample() -> bool:
+    if SPAN_SAMPLE_RATE <= 0.0:
+        return False
+    return SPAN_SAMPLE_RATE >= 1.0 or random.random() < SPAN_SAMPLE_RATE
+
+
+@contextmanager
+def turn_scope(*, mode: str, trace_id: Optional[str] = None) -> Iterator[Optional[TurnScope]]:
+    """
+    1 ターンの計測範囲。既に外側の scope があればそれを使う（handle_turn_async -> handle_turn）。
+    """
+    if not METRICS_ENABLED:
+        yield None
+        return
+    outer = _TURN.get()
+    if outer is not None:
+        yield outer
+        return
+    scope = TurnScope(mode=mode, trace_id=trace_id, sampled=_sample())
+    token = _TURN.set(scope)
+    try:
+        yield scope
+    finally:
+        try:
+            _TURN.reset(token)
+        except ValueError:
+            # generator が別 context で close された
+            _TURN.set(None)
+        SUPABASE_PER_TURN.observe(scope.supabase_roundtrips)
+        if scope.sampled and scope.spans:
+            _export_spans(scope)
+
+
+def note_supabase_request(method: str, status: int, seconds: float) -> None:
+    if not METRICS_ENABLED:
+        return
+    scope = _TURN.get()
+    if scope is not None:
+        scope.supabase_roundtrips += 1
+    status_class = f"{int(status) // 100}xx" if status else "error"
+    SUPABASE_REQUESTS.inc(method=method, status_class=status_class, scope="turn" if scope is not None else "background")
+    SUPABASE_SECONDS.observe(seconds, method=method)
+
+
+def _hex(bits: int) -> str:
+    return f"{random.getrandbits(bits):0{bits // 4}x}"
+
+
+def _otel_trace_id(trace_id: Optional[str]) -> str:
+    t = "".join(ch for ch in str(trace_id or "") if ch in "0123456789abcdef")
+    return t[:32].rjust(32, "0") if len(t) >= 16 else _hex(128)
+
+
+def _record_span(
+    scope: TurnScope,
+    name: str,
+    start_perf: float,
+    end_perf: float,
+    *,
+    parent: Optional[str] = None,
+    attributes: Optional[Dict[str, Any]] = None,
+    span_id: Optional[str] = None,
+) -> str:
+    # perf_counter -> unix ns（記録時点の差分で換算）
+    now_ns = time.time_ns()
+    now_perf = time.perf_counter()
+    sid = span_id or _hex(64)
+    scope.spans.append(
+        {
+            "name": name,
+            "span_id": sid,
+            "parent_span_id": parent,
+            "start_time_unix_nano": int(now_ns - (now_perf - start_perf) * 1e9),
+            "end_time_unix_nano": int(now_ns - (now_perf - end_perf) * 1e9),
+            "attributes": dict(attributes or {}),
+        }
+    )
+    return sid
+
+
+def _export_spans(scope: TurnScope) -> None:
+    trace_id = _otel_trace_id(scope.trace_id)
+    if OTEL_EXPORT and _otel_trace is not None:  # pragma: no cover - optional dependency
+        try:
+            tracer = _otel_trace.get_tracer("persona_core")
+            by_id: Dict[str, Any] = {}
+            for sp in scope.spans:
+                parent = by_id.get(sp["parent_span_id"]) if sp["parent_span_id"] else None
+                ctx = _otel_trace.set_span_in_context(parent) if parent is not None else None
+                span = tracer.start_span(
+                    sp["name"],
+                    context=ctx,
+                    start_time=sp["start_time_unix_nano"],
+                    attributes={**sp["attributes"], "sigmaris.trace_id": str(scope.trace_id or "")},
+                )
+                span.end(end_time=sp["end_time_unix_nano"])
+                by_id[sp["span_id"]] = span
+            return
+        except Exception:
+            pass
+    if not _span_log.isEnabledFor(logging.INFO):
+        return
+    for sp in scope.spans:
+        try:
+            _span_log.info("sigmaris_span %s", json.dumps({"trace_id": trace_id, **sp}, ensure_ascii=False, default=str))
+        except Exception:
+            pass
+
+
+def observe_stage(stage: str, seconds: float, *, mode: str = "turn", start_perf: Optional[float] = None) -> None:
+    """単発ステージ（safety / async 前段など）。start_perf があればサンプル時に span も残す。"""
+    if not METRICS_ENABLED:
+        return
+    STAGE_SECONDS.observe(max(0.0, float(seconds)), stage=stage, mode=mode)
+    scope = _TURN.get()
+    if scope is not None and scope.sampled and start_perf is not None:
+        _record_span(scope, f"persona.{stage}", start_perf, start_perf + float(seconds), attributes={"mode": mode})
+
+
+def observe_turn(
+    *,
+    mode: str,
+    t0: float,
+    marks: Dict[str, float],
+    trace_id: Optional[str] = None,
+    first_delta: Optional[float] = None,
+    attributes: Optional[Dict[str, Any]] = None,
+) -> None:
+    """
+    controller の t_marks（perf_counter）からステージ時間を記録する。
+    ステージ内では何もしない（ターン終了時に 1 回呼ぶだけ）ので、計測自体のコストはほぼ無い。
+    """
+    if not METRICS_ENABLED:
+        return
+    t_end = float(marks.get("end") or time.perf_counter())
+    TURNS.inc(mode=mode)
+    TURN_SECONDS.observe(max(0.0, t_end - t0), mode=mode)
+    if first_delta is not None:
+        FIRST_DELTA_SECONDS.observe(max(0.0, first_delta - t0))
+
+    scope = _TURN.get()
+    sampled = scope is not None and scope.sampled
+    root: Optional[str] = None
+    if sampled and scope is not None:
+        if trace_id and not scope.trace_id:
+            scope.trace_id = trace_id
+        root = _record_span(scope, "persona.turn", t0, t_end, attributes={"mode": mode, **(attributes or {})})
+
+    prev = t0
+    for stage in STAGE_ORDER:
+        t = marks.get(stage)
+        if t is None:
+            continue
+        STAGE_SECONDS.observe(max(0.0, float(t) - prev), stage=stage, mode=mode)
+        if sampled and scope is not None:
+            _record_span(scope, f"persona.{stage}", prev, float(t), parent=root, attributes={"mode": mode})
+        prev = float(t)
+
+
+# =========================================================
+# LLM helpers
+# =========================================================
+
+
+def cached_prompt_tokens(usage: Any) -> Optional[int]:
+    """usage.prompt_tokens_details.cached_tokens（provider が返さなければ None）。"""
+    details = getattr(usage, "prompt_tokens_details", None)
+    if details is None and isinstance(usage, dict):
+        details = usage.get("prompt_tokens_details")
+    if details is None:
+        return None
+    v = details.get("cached_tokens") if isinstance(details, dict) else getattr(details, "cached_tokens", None)
+    return v if isinstance(v, int) else None
+
+
+def _note_usage(kind: str, usage: Any, latency: Optional[float]) -> None:
+    pt = getattr(usage, "prompt_tokens", None)
+    ct = getattr(usage, "completion_tokens", None)
+    if isinstance(pt, int):
+        LLM_TOKENS.inc(pt, type="prompt", source="usage")
+    if isinstance(ct, int):
+        LLM_TOKENS.inc(ct, type="completion", source="usage")
+        LLM_COMPLETION_TOKENS.observe(ct)
+    cached = cached_prompt_tokens(usage)
+    if cached is None or not isinstance(pt, int) or pt <= 0:
+        return
+    LLM_TOKENS.inc(cached, type="cached_prompt", source="usage")
+    LLM_PROMPT_CACHE_RATIO.observe(min(1.0, cached / pt), kind=kind)
+    if latency is not None:
+        LLM_PROMPT_CACHE_LATENCY.observe(latency, kind=kind, cache="hit" if cached > 0 else "miss")
+
+
+def note_llm_response(kind: str, response: Any, seconds: float) -> None:
+    if not METRICS_ENABLED:
+        return
+    LLM_REQUESTS.inc(kind=kind, outcome="ok")
+    LLM_SECONDS.observe(seconds, kind=kind)
+    usage = getattr(response, "usage", None)
+    if usage is None:
+        return
+    _note_usage(kind, usage, seconds)
+
+
+def note_llm_continuation(strategy: str) -> None:
+    if METRICS_ENABLED:
+        LLM_CONTINUATIONS.inc(strategy=strategy)
+
+
+def note_quality_path(strategy: str, path: str, seconds: float, min_score: Optional[float] = None) -> None:
+    if not METRICS_ENABLED:
+        return
+    QUALITY_PATHS.inc(strategy=strategy, path=path)
+    QUALITY_SECONDS.observe(seconds, strategy=strategy, path=path)
+    if min_score is not None:
+        QUALITY_SCORE.observe(min_score, strategy=strategy)
+
+
+def note_llm_error(kind: str) -> None:
+    if METRICS_ENABLED:
+        LLM_REQUESTS.inc(kind=kind, outcome="error")
+
+
+def metered_stream(stream: Iterable[Any], *, started: float) -> Iterator[Any]:
+    """
+    chat.completions の stream をそのまま流しつつ、TTFT / token 数を記録する。
+    usage が来ない（stream_options 無し）場合は content chunk 数を completion token の推定とする。
+    usage は最後の chunk に来るので、cache 別 latency は TTFT を後から記録する。
+    """
+    if not METRICS_ENABLED:
+        yield from stream
+        return
+    ttft: Optional[float] = None
+    chunks = 0
+    usage_seen = False
+    ok = False
+    try:
+        for chunk in stream:
+            try:
+                usage = getattr(chunk, "usage", None)
+                if usage is not None:
+                    usage_seen = True
+                    _note_usage("chat_stream", usage, ttft)
+                choices = getattr(chunk, "choices", None) or []
+                if choices and getattr(getattr(choices[0], "delta", None), "content", None):
+                    chunks += 1
+                    if ttft is None:
+                        ttft = time.perf_counter() - started
+                        LLM_TTFT_SECONDS.observe(ttft)
+            except Exception:
+                pass
+            yield chunk
+        ok = True
+    finally:
+        LLM_REQUESTS.inc(kind="chat_stream", outcome="ok" if ok else "error")
+        LLM_SECONDS.observe(time.perf_counter() - started, kind="chat_stream")
+        if not usage_seen and chunks:
+            LLM_TOKENS.inc(chunks, type="completion", source="chunks")
+            LLM_COMPLETION_TOKENS.observe(chunks)
+
+
+# =========================================================
+# Collector helpers
+# =========================================================
+
+
+def cache_families(caches: Dict[str, Dict[str, Any]]) -> List[Family]:
+    """LRUTTLCache.stats() 形式（hits / misses / size ...）を Prometheus family にする。"""
+    hits: List[Sample] = []
+    misses: List[Sample] = []
+    ratio: List[Sample] = []
+    items: List[Sample] = []
+    for name, st in (caches or {}).items():
+        if not isinstance(st, dict):
+            continue
+        lbl = {"cache": str(name)}
+        h = float(st.get("hits") or 0)
+        m = float(st.get("misses") or 0)
+        hits.append((lbl, h))
+        misses.append((lbl, m))
+        ratio.append((lbl, (h / (h + m)) if (h + m) > 0 else 0.0))
+        size = st.get("size", st.get("items"))
+        if isinstance(size, (int, float)):
+            items.append((lbl, float(size)))
+    out: List[Family] = [
+        ("sigmaris_cache_hits_total", "counter", "Cache hits.", hits),
+        ("sigmaris_cache_misses_total", "counter", "Cache misses.", misses),
+        ("sigmaris_cache_hit_ratio", "gauge", "hits / (hits + misses) since start.", ratio),
+    ]
+    if items:
+        out.append(("sigmaris_cache_items", "gauge", "Entries currently cached.", items))
+    return out
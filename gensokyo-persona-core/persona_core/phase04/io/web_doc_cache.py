@@ -0,0 +1,454 @@
+"""
+persona_core.phase04.io.web_doc_cache
+
+Web ドキュメントキャッシュ（/io/web/fetch・/io/web/rag・auto-RAG で共有）。
+
+- キー: 正規化 URL（web_rag._canonicalize_url: fragment / tracking query を除去）
+- raw bytes は zlib 圧縮して sha256 で content-addressed に保存（同一内容は 1 つだけ）
+- 抽出テキスト / リンクは (sha256, kind) で保存（内容が変わらなければ再抽出しない）
+- fresh 期間内はネットワークに出ない。期限後は ETag / Last-Modified で条件付き再検証（304 なら再利用）
+- 2 層: プロセス内 LRU（raw 付き）→ ローカルディスク（SQLite）
+- Cache-Control: no-store のレスポンスは保存しない
+
+Env:
+- SIGMARIS_WEB_DOC_CACHE              (default 1; 0 で無効)
+- SIGMARIS_WEB_DOC_CACHE_FRESH_SEC    (default 600; この間は再検証なしで返す)
+- SIGMARIS_WEB_DOC_CACHE_MAX_AGE_SEC  (default 604800; これを超えた entry は使わない)
+- SIGMARIS_WEB_DOC_CACHE_MEM_MAX      (default 128; メモリ tier の文書数)
+- SIGMARIS_WEB_DOC_CACHE_DISK         (default 0; 1 でローカルディスク tier も使う)
+- SIGMARIS_WEB_DOC_CACHE_PATH         (default ./sigmaris-data/web_doc_cache.sqlite3)
+- SIGMARIS_WEB_DOC_CACHE_DISK_MAX_DOCS (default 5000; 超えたら古いものから削除)
+"""
+
+from __future__ import annotations
+
+import hashlib
+import json
+import os
+import sqlite3
+import threading
+import time
+import zlib
+from dataclasses import dataclass, replace
+from typing import Any, Dict, Optional, Tuple
+
+from persona_core.trace import get_logger
+from persona_core.ttl_cache import LRUTTLCache
+
+
+log = get_logger(__name__)
+
+
+def _env(name: str) -> Optional[str]:
+    v = os.getenv(name)
+    if v is None:
+        return None
+    v = v.strip()
+    return v or None
+
+
+def _bool_env(name: str, default: bool) -> bool:
+    v = _env(name)
+    if v is None:
+        return bool(default)
+    return v.lower() in ("1", "true", "yes", "on")
+
+
+def _float_env(name: str, default: float) -> float:
+    try:
+        return float(_env(name) or str(default))
+    except Exception:
+        return float(default)
+
+
+def _int_env(name: str, default: int) -> int:
+    try:
+        return int(_env(name) or str(default))
+    except Exception:
+        return int(default)
+
+
+def content_sha256(raw: bytes) -> str:
+    return hashlib.sha256(raw or b"").hexdigest()
+
+
+@dataclass(frozen=True)
+class CachedDoc:
+    url: str
+    final_url: str
+    content_type: str
+    title: str
+    etag: Optional[str]
+    last_modified: Optional[str]
+    sha256: str
+    raw: bytes
+    fetched_at: float  # 本文を取得した時刻
+    validated_at: float  # 最後に origin で確認した時刻（取得 or 304）
+
+    def age_sec(self, now: Optional[float] = None) -> float:
+        return float((now if now is not None else time.time()) - self.validated_at)
+
+
+class WebDocCache:
+    DEFAULT_DB_PATH = "./sigmaris-data/web_doc_cache.sqlite3"
+
+    def __init__(
+        self,
+        *,
+        fresh_sec: float = 600.0,
+        max_age_sec: float = 604800.0,
+        mem_max: int = 128,
+        db_path: Optional[str] = None,
+        disk_max_docs: int = 5000,
+    ) -> None:
+        self.fresh_sec = max(0.0, float(fresh_sec))
+        self.max_age_sec = max(self.fresh_sec, float(max_age_sec))
+        self._mem: LRUTTLCache[CachedDoc] = LRUTTLCache(
+            max_items=int(mem_max), ttl_sec=self.max_age_sec, name="web_doc"
+        )
+        self._extract_mem: LRUTTLCache[Dict[str, Any]] = LRUTTLCache(
+            max_items=max(0, int(mem_max) * 2), ttl_sec=self.max_age_sec, name="web_doc_extract"
+        )
+
+        self.db_path = db_path
+        self.disk_max_docs = max(1, int(disk_max_docs))
+        self._db: Optional[sqlite3.Connection] = None
+        self._db_lock = threading.Lock()
+        self._puts_since_prune = 0
+
+        self._stats_lock = threading.Lock()
+        self._stats = {"fresh_hits": 0, "stale_hits": 0, "misses": 0, "revalidated": 0, "stored": 0, "disk_hits": 0}
+
+        if db_path:
+            try:
+                self._open_db(db_path)
+            except Exception:
+                log.exception("web doc cache: disk tier disabled (open failed) path=%s", db_path)
+                self._db = None
+
+    # ---------------------------------------------------------
+    # disk tier (SQLite)
+    # ---------------------------------------------------------
+
+    def _open_db(self, path: str) -> None:
+        d = os.path.dirname(path)
+        if d:
+            os.makedirs(d, exist_ok=True)
+        conn = sqlite3.connect(path, check_same_thread=False, timeout=5.0)
+        conn.execute("PRAGMA journal_mode=WAL")
+        conn.execute("PRAGMA synchronous=NORMAL")
+        with conn:
+            conn.execute(
+                """
+                CREATE TABLE IF NOT EXISTS docs (
+                    url           TEXT PRIMARY KEY,
+                    final_url     TEXT NOT NULL,
+                    content_type  TEXT,
+                    title         TEXT,
+                    etag          TEXT,
+                    last_modified TEXT,
+                    sha256        TEXT NOT NULL,
+                    fetched_at    REAL NOT NULL,
+                    validated_at  REAL NOT NULL
+                )
+                """
+            )
+            conn.execute("CREATE INDEX IF NOT EXISTS idx_docs_validated_at ON docs (validated_at)")
+            # raw bytes（zlib 圧縮）: content-addressed
+            conn.execute(
+                """
+                CREATE TABLE IF NOT EXISTS blobs (
+                    sha256     TEXT PRIMARY KEY,
+                    data       BLOB NOT NULL,
+                    size       INTEGER NOT NULL,
+                    created_at REAL NOT NULL
+                )
+                """
+            )
+            # 抽出結果（JSON）: (sha256, kind)
+            conn.execute(
+                """
+                CREATE TABLE IF NOT EXISTS extracts (
+                    sha256  TEXT NOT NULL,
+                    kind    TEXT NOT NULL,
+                    payload TEXT NOT NULL,
+                    PRIMARY KEY (sha256, kind)
+                )
+                """
+            )
+        self._db = conn
+
+    def _disk_get(self, url: str) -> Optional[CachedDoc]:
+        if self._db is None:
+            return None
+        with self._db_lock:
+            row = self._db.execute(
+                "SELECT d.final_url, d.content_type, d.title, d.etag, d.last_modified, d.sha256, "
+                "d.fetched_at, d.validated_at, b.data "
+                "FROM docs d JOIN blobs b ON b.sha256 = d.sha256 WHERE d.url = ?",
+                (url,),
+            ).fetchone()
+        if row is None:
+            return None
+        try:
+            raw = zlib.decompress(row[8])
+        except Exception:
+            return None
+        return CachedDoc(
+            url=url,
+            final_url=str(row[0] or url),
+            content_type=str(row[1] or ""),
+            title=str(row[2] or ""),
+            etag=row[3],
+            last_modified=row[4],
+            sha256=str(row[5]),
+            raw=raw,
+            fetched_at=float(row[6]),
+            validated_at=float(row[7]),
+        )
+
+    def _disk_put(self, doc: CachedDoc, *, with_blob: bool) -> None:
+        if self._db is None:
+            return
+        blob = zlib.compress(doc.raw, 6) if with_blob else None
+        with self._db_lock:
+            with self._db:
+                if blob is not None:
+                    self._db.execute(
+                        "INSERT OR IGNORE INTO blobs (sha256, data, size, created_at) VALUES (?, ?, ?, ?)",
+                        (doc.sha256, sqlite3.Binary(blob), int(len(doc.raw)), time.time()),
+                    )
+                self._db.execute(
+                    "INSERT INTO docs (url, final_url, content_type, title, etag, last_modified, sha256, fetched_at, validated_at) "
+                    "VALUES (?, ?, ?, ?, ?, ?, ?, ?, ?) "
+                    "ON CONFLICT(url) DO UPDATE SET final_url=excluded.final_url, content_type=excluded.content_type, "
+                    "title=excluded.title, etag=excluded.etag, last_modified=excluded.last_modified, "
+                    "sha256=excluded.sha256, fetched_at=excluded.fetched_at, validated_at=excluded.validated_at",
+                    (
+                        doc.url,
+                        doc.final_url,
+                        doc.content_type,
+                        doc.title,
+                        doc.etag,
+                        doc.last_modified,
+                        doc.sha256,
+                        float(doc.fetched_at),
+                        float(doc.validated_at),
+                    ),
+                )
+            self._puts_since_prune += 1
+            if self._puts_since_prune >= 100:
+                self._puts_since_prune = 0
+                self._prune_locked()
+
+    def _prune_locked(self) -> None:
+        # 上限超過分を古い順に削除 → 参照されなくなった blob / 抽出結果を掃除
+        assert self._db is not None
+        try:
+            with self._db:
+                self._db.execute(
+                    "DELETE FROM docs WHERE url IN ("
+                    " SELECT url FROM docs ORDER BY validated_at DESC LIMIT -1 OFFSET ?"
+                    ")",
+                    (int(self.disk_max_docs),),
+                )
+                self._db.execute(
+                    "DELETE FROM docs WHERE validated_at < ?", (time.time() - self.max_age_sec,)
+                )
+                self._db.execute("DELETE FROM blobs WHERE sha256 NOT IN (SELECT sha256 FROM docs)")
+                self._db.execute("DELETE FROM extracts WHERE sha256 NOT IN (SELECT sha256 FROM docs)")
+        except Exception:
+            log.exception("web doc cache: prune failed")
+
+    # ---------------------------------------------------------
+    # documents
+    # ---------------------------------------------------------
+
+    def _bump(self, name: str) -> None:
+        with self._stats_lock:
+            self._stats[name] = int(self._stats.get(name, 0)) + 1
+
+    def lookup(self, url: str) -> Optional[CachedDoc]:
+        """max_age 以内の entry を返す（fresh かどうかは is_fresh で判定）。"""
+        doc = self._mem.get(url)
+        if doc is None:
+            try:
+                doc = self._disk_get(url)
+            except Exception:
+                doc = None
+            if doc is not None:
+                self._bump("disk_hits")
+        if doc is None or doc.age_sec() > self.max_age_sec:
+            self._bump("misses")
+            return None
+        self._mem.put(url, doc)
+        self._bump("fresh_hits" if self.is_fresh(doc) else "stale_hits")
+        return doc
+
+    def is_fresh(self, doc: CachedDoc) -> bool:
+        return doc.age_sec() <= self.fresh_sec
+
+    def store(
+        self,
+        url: str,
+        *,
+        final_url: str,
+        content_type: str,
+        title: str,
+        raw: bytes,
+        etag: Optional[str],
+        last_modified: Optional[str],
+        sha256: Optional[str] = None,
+    ) -> CachedDoc:
+        now = time.time()
+        doc = CachedDoc(
+            url=url,
+            final_url=str(final_url or url),
+            content_type=str(content_type or ""),
+            title=str(title or ""),
+            etag=(str(etag) if etag else None),
+            last_modified=(str(last_modified) if last_modified else None),
+            sha256=sha256 or content_sha256(raw),
+            raw=bytes(raw or b""),
+            fetched_at=now,
+            validated_at=now,
+        )
+        self._mem.put(url, doc)
+        try:
+            self._disk_put(doc, with_blob=True)
+        except Exception:
+            log.exception("web doc cache: disk write failed")
+        self._bump("stored")
+        return doc
+
+    def revalidated(
+        self,
+        doc: CachedDoc,
+        *,
+        etag: Optional[str] = None,
+        last_modified: Optional[str] = None,
+    ) -> CachedDoc:
+        """304 Not Modified を受けたときに validated_at（と新しい validator）を更新する。"""
+        doc2 = replace(
+            doc,
+            etag=(str(etag) if etag else doc.etag),
+            last_modified=(str(last_modified) if last_modified else doc.last_modified),
+            validated_at=time.time(),
+        )
+        self._mem.put(doc.url, doc2)
+        try:
+            self._disk_put(doc2, with_blob=False)
+        except Exception:
+            log.exception("web doc cache: disk write failed")
+        self._bump("revalidated")
+        return doc2
+
+    # ---------------------------------------------------------
+    # extracted text / links
+    # ---------------------------------------------------------
+
+    def get_extract(self, sha256: str, kind: str) -> Optional[Dict[str, Any]]:
+        if not sha256:
+            return None
+        key: Tuple[str, str] = (sha256, kind)
+        hit = self._extract_mem.get(key)
+        if hit is not None:
+            return hit
+        if self._db is None:
+            return None
+        try:
+            with self._db_lock:
+                row = self._db.execute(
+                    "SELECT payload FROM extracts WHERE sha256 = ? AND kind = ?", (sha256, kind)
+                ).fetchone()
+            if row is None:
+                return None
+            payload = json.loads(row[0])
+        except Exception:
+            return None
+        if isinstance(payload, dict):
+            self._extract_mem.put(key, payload)
+            return payload
+        return None
+
+    def put_extract(self, sha256: str, kind: str, payload: Dict[str, Any]) -> None:
+        if not sha256:
+            return
+        self._extract_mem.put((sha256, kind), payload)
+        if self._db is None:
+            return
+        try:
+            data = json.dumps(payload, ensure_ascii=False)
+            with self._db_lock:
+                with self._db:
+                    self._db.execute(
+                        "INSERT OR REPLACE INTO extracts (sha256, kind, payload) VALUES (?, ?, ?)",
+                        (sha256, kind, data),
+                    )
+        except Exception:
+            log.exception("web doc cache: extract write failed")
+
+    # ---------------------------------------------------------
+    # observability
+    # ---------------------------------------------------------
+
+    def stats(self) -> Dict[str, Any]:
+        with self._stats_lock:
+            out: Dict[str, Any] = dict(self._stats)
+        out["fresh_sec"] = self.fresh_sec
+        out["max_age_sec"] = self.max_age_sec
+        out["memory"] = self._mem.stats()
+        # ファイルパスは出さない（/health は認証なしで公開される）
+        out["disk"] = {"enabled": self._db is not None}
+        if self._db is not None:
+            try:
+                with self._db_lock:
+                    docs = self._db.execute("SELECT COUNT(*) FROM docs").fetchone()[0]
+                    blobs, stored, raw = self._db.execute(
+                        "SELECT COUNT(*), COALESCE(SUM(LENGTH(data)), 0), COALESCE(SUM(size), 0) FROM blobs"
+                    ).fetchone()
+                out["disk"].update(
+                    {"docs": int(docs), "blobs": int(blobs), "stored_bytes": int(stored), "raw_bytes": int(raw)}
+                )
+            except Exception:
+                pass
+        return out
+
+
+def canonical_key(url: str) -> str:
+    """キャッシュキー（web_rag の正規化と同じ）。"""
+    from persona_core.phase04.io.web_rag import _canonicalize_url  # web_rag -> web_fetch -> ここ、の循環を避ける
+
+    return _canonicalize_url(url) or str(url or "")
+
+
+_CACHE: Optional[WebDocCache] = None
+_CACHE_INIT = False
+_CACHE_LOCK = threading.Lock()
+
+
+def get_web_doc_cache() -> Optional[WebDocCache]:
+    """プロセス共有の WebDocCache（無効なら None）。"""
+    global _CACHE, _CACHE_INIT
+    if not _CACHE_INIT:
+        with _CACHE_LOCK:
+            if not _CACHE_INIT:
+                if _bool_env("SIGMARIS_WEB_DOC_CACHE", True):
+                    _CACHE = WebDocCache(
+                        fresh_sec=_float_env("SIGMARIS_WEB_DOC_CACHE_FRESH_SEC", 600.0),
+                        max_age_sec=_float_env("SIGMARIS_WEB_DOC_CACHE_MAX_AGE_SEC", 604800.0),
+                        mem_max=max(0, min(10000, _int_env("SIGMARIS_WEB_DOC_CACHE_MEM_MAX", 128))),
+                        db_path=(
+                            (_env("SIGMARIS_WEB_DOC_CACHE_PATH") or WebDocCache.DEFAULT_DB_PATH)
+                            if _bool_env("SIGMARIS_WEB_DOC_CACHE_DISK", False)
+                            else None
+                        ),
+                        disk_max_docs=max(1, _int_env("SIGMARIS_WEB_DOC_CACHE_DISK_MAX_DOCS", 5000)),
+                    )
+                _CACHE_INIT = True
+    return _CACHE
+
+
+def web_doc_cache_stats() -> Optional[Dict[str, Any]]:
+    """/health 用（未初期化なら作らずに None）。"""
+    return _CACHE.stats() if _CACHE is not None else None
@@ -1,16 +1,20 @@
 from __future__ import annotations
 
 import html
+import http.client
 import ipaddress
 import os
 import re
 import socket
+import threading
 import urllib.parse
 import urllib.request
 import urllib.error
 from dataclasses import dataclass
 from typing import Any, Dict, List, Optional, Tuple
 
+from persona_core.phase04.io.web_doc_cache import canonical_key, content_sha256, get_web_doc_cache
+
 
 class WebFetchError(RuntimeError):
     pass
@@ -243,39 +247,77 @@ def fetch_url_raw(
     if not _host_allowed(host):
         raise WebFetchError("domain not allowlisted")
 
-    req = urllib.request.Request(
-        url=normalized,
-        method="GET",
-        headers={
-            "User-Agent": user_agent,
-            "Accept": "text/html,application/xhtml+xml;q=0.9,*/*;q=0.1",
-            "Accept-Language": os.getenv("SIGMARIS_WEB_FETCH_ACCEPT_LANGUAGE", "ja,en-US;q=0.8,en;q=0.7"),
-        },
-    )
-
-    try:
-        with urllib.request.urlopen(req, timeout=int(timeout_sec)) as resp:
-            final_url = str(getattr(resp, "geturl", lambda: normalized)())
-            ctype = str(resp.headers.get("Content-Type") or "")
-            raw = resp.read(int(max_bytes) + 1)
-    except urllib.error.HTTPError as e:
-        code = int(getattr(e, "code", 0) or 0)
-        try:
-            raw = e.read()
-            snippet = raw[:200].decode("utf-8", errors="ignore") if isinstance(raw, (bytes, bytearray)) else ""
-        except Exception:
-            snippet = ""
-        msg = f"origin_http:{code}"
-        if snippet:
-            msg += f":{snippet.strip()[:120]}"
-        raise WebFetchError(msg) from e
-    except Exception as e:
-        raise WebFetchError(f"request_failed:{type(e).__name__}") from e
+    headers = {
+        "User-Agent": user_agent,
+        "Accept": "text/html,application/xhtml+xml;q=0.9,*/*;q=0.1",
+        "Accept-Language": os.getenv("SIGMARIS_WEB_FETCH_ACCEPT_LANGUAGE", "ja,en-US;q=0.8,en;q=0.7"),
+    }
 
+    # Document cache（SSRF / allowlist の判定後に参照する）
+    cache = get_web_doc_cache()
+    cache_key = canonical_key(normalized) if cache is not None else ""
+    cached = cache.lookup(cache_key) if cache is not None else None
+    if cached is not None and len(cached.raw) <= int(max_bytes):
+        if cache.is_fresh(cached):  # type: ignore[union-attr]
+            return _raw_result(normalized, host, cached.final_url, cached.content_type, cached.raw, cached.sha256, "hit", cached.title)
+        if cached.etag:
+            headers["If-None-Match"] = cached.etag
+        if cached.last_modified:
+            headers["If-Modified-Since"] = cached.last_modified
+    else:
+        cached = None
+
+    if _keepalive_enabled():
+        resp = _fetch_keepalive(normalized, timeout_sec=float(timeout_sec), max_bytes=int(max_bytes), headers=headers)
+    else:
+        resp = _fetch_urllib(normalized, timeout_sec=float(timeout_sec), max_bytes=int(max_bytes), headers=headers)
+
+    if resp.status == 304 and cached is not None and cache is not None:
+        doc = cache.revalidated(cached, etag=resp.etag, last_modified=resp.last_modified)
+        return _raw_result(normalized, host, doc.final_url, doc.content_type, doc.raw, doc.sha256, "revalidated", doc.title)
+    if resp.status == 304:
+        raise WebFetchError("origin_http:304")
+
+    raw = resp.body
     if len(raw) > int(max_bytes):
         raise WebFetchError("response too large")
 
+    sha = content_sha256(raw)
     title = _extract_title(raw)
+    final_url = str(resp.final_url or normalized)
+    cache_status = "bypass"
+    if cache is not None:
+        cache_status = "miss"
+        if "no-store" not in (resp.cache_control or "").lower():
+            try:
+                cache.store(
+                    cache_key,
+                    final_url=final_url,
+                    content_type=resp.content_type,
+                    title=title,
+                    raw=raw,
+                    etag=resp.etag,
+                    last_modified=resp.last_modified,
+                    sha256=sha,
+                )
+            except Exception:
+                pass
+        else:
+            cache_status = "no-store"
+
+    return _raw_result(normalized, host, final_url, resp.content_type, raw, sha, cache_status, title)
+
+
+def _raw_result(
+    normalized: str,
+    host: str,
+    final_url: str,
+    ctype: str,
+    raw: bytes,
+    sha: str,
+    cache_status: str,
+    title: str,
+) -> RawFetchResult:
     meta: Dict[str, Any] = {
         "content_type": ctype,
         "bytes": int(len(raw)),
@@ -283,6 +325,8 @@ def fetch_url_raw(
         "allowlist": _split_csv(_env("SIGMARIS_WEB_FETCH_ALLOW_DOMAINS")),
         "robots_checked": False,
         "extraction": "raw_html",
+        "sha256": sha,
+        "cache": cache_status,
     }
 
     return RawFetchResult(
@@ -295,6 +339,282 @@ def fetch_url_raw(
     )
 
 
+@dataclass
+class _HttpResponse:
+    final_url: str
+    status: int
+    content_type: str
+    body: bytes
+    etag: Optional[str] = None
+    last_modified: Optional[str] = None
+    cache_control: Optional[str] = None
+
+
+def _fetch_urllib(
+    normalized: str,
+    *,
+    timeout_sec: float,
+    max_bytes: int,
+    headers: Dict[str, str],
+) -> _HttpResponse:
+    req = urllib.request.Request(url=normalized, method="GET", headers=headers)
+
+    try:
+        with urllib.request.urlopen(req, timeout=int(timeout_sec)) as resp:
+            return _HttpResponse(
+                final_url=str(getattr(resp, "geturl", lambda: normalized)()),
+                status=int(getattr(resp, "status", 200) or 200),
+                content_type=str(resp.headers.get("Content-Type") or ""),
+                body=resp.read(int(max_bytes) + 1),
+                etag=resp.headers.get("ETag"),
+                last_modified=resp.headers.get("Last-Modified"),
+                cache_control=resp.headers.get("Cache-Control"),
+            )
+    except urllib.error.HTTPError as e:
+        code = int(getattr(e, "code", 0) or 0)
+        if code == 304:
+            hdrs = getattr(e, "headers", None)
+            return _HttpResponse(
+                final_url=normalized,
+                status=304,
+                content_type="",
+                body=b"",
+                etag=(hdrs.get("ETag") if hdrs is not None else None),
+                last_modified=(hdrs.get("Last-Modified") if hdrs is not None else None),
+            )
+        try:
+            raw = e.read()
+            snippet = raw[:200].decode("utf-8", errors="ignore") if isinstance(raw, (bytes, bytearray)) else ""
+        except Exception:
+            snippet = ""
+        msg = f"origin_http:{code}"
+        if snippet:
+            msg += f":{snippet.strip()[:120]}"
+        raise WebFetchError(msg) from e
+    except Exception as e:
+        raise WebFetchError(f"request_failed:{type(e).__name__}") from e
+
+
+# =========================================================
+# keep-alive fetch (per-host connection pool)
+# - クロール時に同一ホストへの TCP+TLS ハンドシェイクを使い回す
+# - リダイレクトは自前で追い、各ホップで SSRF / allowlist を再検査する
+# - HTTP(S)_PROXY が設定されている場合は urllib 経路（プロキシ対応）を使う
+#
+# Env:
+# - SIGMARIS_WEB_FETCH_KEEPALIVE          (default 1)
+# - SIGMARIS_WEB_FETCH_MAX_IDLE_PER_HOST  (default 4)
+# - SIGMARIS_WEB_FETCH_MAX_REDIRECTS      (default 5)
+# =========================================================
+
+_REDIRECT_CODES = (301, 302, 303, 307, 308)
+
+# 再利用した接続がサーバ側で閉じられていた場合（未処理なので 1 度だけ再送する）
+_STALE_CONNECTION_ERRORS = (
+    http.client.RemoteDisconnected,
+    http.client.CannotSendRequest,
+    ConnectionResetError,
+    BrokenPipeError,
+)
+
+
+def _int_env(name: str, default: int) -> int:
+    try:
+        return int(_env(name) or str(default))
+    except Exception:
+        return default
+
+
+def _keepalive_enabled() -> bool:
+    v = (_env("SIGMARIS_WEB_FETCH_KEEPALIVE") or "1").lower()
+    if v not in ("1", "true", "yes", "on"):
+        return False
+    try:
+        proxies = urllib.request.getproxies()
+    except Exception:
+        proxies = {}
+    return not (proxies.get("http") or proxies.get("https"))
+
+
+_PoolKey = Tuple[str, str, int]
+
+
+class _HostConnectionPool:
+    """
+    (scheme, host, port) ごとの http.client keep-alive 接続プール（スレッドセーフ）。
+
+    - 接続は 1 度に 1 スレッドだけが使う（acquire → release）
+    - ホストごとにアイドル接続を max_idle_per_host 本まで保持する
+    """
+
+    def __init__(self, *, max_idle_per_host: int = 4) -> None:
+        self._max_idle = max(1, int(max_idle_per_host))
+        self._idle: Dict[_PoolKey, List[http.client.HTTPConnection]] = {}
+        self._lock = threading.Lock()
+        self._opened = 0
+        self._reused = 0
+
+    def acquire(self, key: _PoolKey, *, timeout_sec: float) -> Tuple[http.client.HTTPConnection, bool]:
+        """(conn, reused)"""
+        with self._lock:
+            conns = self._idle.get(key)
+            conn = conns.pop() if conns else None
+            if conn is not None:
+                self._reused += 1
+            else:
+                self._opened += 1
+        if conn is not None:
+            conn.timeout = float(timeout_sec)
+            try:
+                if conn.sock is not None:
+                    conn.sock.settimeout(float(timeout_sec))
+            except Exception:
+                pass
+            return conn, True
+        scheme, host, port = key
+        if scheme == "https":
+            return http.client.HTTPSConnection(host, port, timeout=float(timeout_sec)), False
+        return http.client.HTTPConnection(host, port, timeout=float(timeout_sec)), False
+
+    def release(self, key: _PoolKey, conn: http.client.HTTPConnection) -> None:
+        with self._lock:
+            conns = self._idle.setdefault(key, [])
+            if len(conns) < self._max_idle:
+                conns.append(conn)
+                return
+        conn.close()
+
+    def stats(self) -> Dict[str, Any]:
+        with self._lock:
+            return {
+                "hosts": len(self._idle),
+                "idle": sum(len(v) for v in self._idle.values()),
+                "opened": int(self._opened),
+                "reused": int(self._reused),
+            }
+
+
+_POOL: Optional[_HostConnectionPool] = None
+_POOL_LOCK = threading.Lock()
+
+
+def _get_pool() -> _HostConnectionPool:
+    global _POOL
+    if _POOL is None:
+        with _POOL_LOCK:
+            if _POOL is None:
+                _POOL = _HostConnectionPool(max_idle_per_host=_int_env("SIGMARIS_WEB_FETCH_MAX_IDLE_PER_HOST", 4))
+    return _POOL
+
+
+def connection_pool_stats() -> Dict[str, Any]:
+    return _get_pool().stats()
+
+
+def _request_once(
+    url: str,
+    *,
+    timeout_sec: float,
+    max_bytes: int,
+    headers: Dict[str, str],
+) -> Tuple[_HttpResponse, Optional[str]]:
+    """GET 1 回（リダイレクトは追わない）。(response, location)"""
+    p = urllib.parse.urlsplit(url)
+    scheme = (p.scheme or "").lower()
+    host = p.hostname or ""
+    port = int(p.port or (443 if scheme == "https" else 80))
+    key: _PoolKey = (scheme, host, port)
+    target = (p.path or "/") + (("?" + p.query) if p.query else "")
+
+    pool = _get_pool()
+    for attempt in (0, 1):
+        conn, reused = pool.acquire(key, timeout_sec=timeout_sec)
+        try:
+            conn.request("GET", target, headers=headers)
+            resp = conn.getresponse()
+            out = _HttpResponse(
+                final_url=url,
+                status=int(resp.status),
+                content_type=str(resp.getheader("Content-Type") or ""),
+                body=resp.read(int(max_bytes) + 1),
+                etag=resp.getheader("ETag"),
+                last_modified=resp.getheader("Last-Modified"),
+                cache_control=resp.getheader("Cache-Control"),
+            )
+            location = resp.getheader("Location")
+        except _STALE_CONNECTION_ERRORS:
+            conn.close()
+            if reused and attempt == 0:
+                continue
+            raise
+        except Exception:
+            conn.close()
+            raise
+
+        # 本文を読み切っていない（max_bytes 超過）接続は再利用できない
+        if resp.will_close or not resp.isclosed():
+            conn.close()
+        else:
+            pool.release(key, conn)
+        return out, location
+    raise WebFetchError("unreachable")  # pragma: no cover
+
+
+def _fetch_keepalive(
+    normalized: str,
+    *,
+    timeout_sec: float,
+    max_bytes: int,
+    headers: Dict[str, str],
+) -> _HttpResponse:
+    url = normalized
+    max_redirects = max(0, _int_env("SIGMARIS_WEB_FETCH_MAX_REDIRECTS", 5))
+    for _hop in range(max_redirects + 1):
+        try:
+            resp, location = _request_once(url, timeout_sec=timeout_sec, max_bytes=max_bytes, headers=headers)
+        except WebFetchError:
+            raise
+        except Exception as e:
+            raise WebFetchError(f"request_failed:{type(e).__name__}") from e
+
+        status = int(resp.status)
+        if status in _REDIRECT_CODES and location:
+            nxt = _normalize_url(urllib.parse.urljoin(url, location))
+            nhost = urllib.parse.urlparse(nxt).hostname or ""
+            if _is_private_host(nhost):
+                raise WebFetchError("forbidden host (private/loopback)")
+            if not _host_allowed(nhost):
+                raise WebFetchError("domain not allowlisted")
+            url = nxt
+            continue
+
+        if status >= 400:
+            raw = resp.body
+            snippet = raw[:200].decode("utf-8", errors="ignore") if raw else ""
+            msg = f"origin_http:{status}"
+            if snippet:
+                msg += f":{snippet.strip()[:120]}"
+            raise WebFetchError(msg)
+
+        return resp
+
+    raise WebFetchError("too_many_redirects")
+
+
+def _extract_text_cached(fr: RawFetchResult) -> Tuple[str, Dict[str, Any]]:
+    # 同一内容（sha256）の抽出結果は document cache から再利用する
+    cache = get_web_doc_cache()
+    sha = str((fr.meta or {}).get("sha256") or "")
+    if cache is not None and sha:
+        hit = cache.get_extract(sha, "text_basic")
+        if isinstance(hit, dict) and isinstance(hit.get("text"), str):
+            return str(hit["text"]), dict(hit.get("meta") or {})
+    text, extract_meta = _html_to_text(fr.html_bytes, content_type=fr.content_type)
+    if cache is not None and sha:
+        cache.put_extract(sha, "text_basic", {"text": text, "meta": extract_meta})
+    return text, extract_meta
+
+
 def fetch_url(
     *,
     url: str,
@@ -303,7 +623,7 @@ def fetch_url(
     user_agent: str = "sigmaris-core-web-fetch/1.0",
 ) -> FetchResult:
     fr = fetch_url_raw(url=url, timeout_sec=timeout_sec, max_bytes=max_bytes, user_agent=user_agent)
-    text, extract_meta = _html_to_text(fr.html_bytes, content_type=fr.content_type)
+    text, extract_meta = _extract_text_cached(fr)
 
     # Basic cleanup: keep only reasonably-sized content
     text = re.sub(r"\\n{3,}", "\n\n", text).strip()
@@ -1,14 +1,20 @@
 from __future__ import annotations
 
+import heapq
+import itertools
+import math
 import os
 import re
+import threading
 import time
 import urllib.parse
+from concurrent.futures import FIRST_COMPLETED, Future, ThreadPoolExecutor, wait
 from dataclasses import dataclass
 from datetime import datetime, timezone
 from typing import Any, Dict, Iterable, List, Optional, Set, Tuple
 
-from persona_core.phase04.io.web_fetch import RawFetchResult, WebFetchError, fetch_url_raw
+from persona_core.phase04.io.web_doc_cache import WebDocCache, get_web_doc_cache
+from persona_core.phase04.io.web_fetch import RawFetchResult, WebFetchError, connection_pool_stats, fetch_url_raw
 from persona_core.phase04.io.web_search import WebSearchError, WebSearchResult, get_web_search_provider
 from persona_core.phase04.io.web_summarize import WebSummarizeError, summarize_text
 
@@ -46,6 +52,14 @@ def _int_env(name: str, default: int) -> int:
     return int(v)
 
 
+def _float_env(name: str, default: float) -> float:
+    try:
+        v = float((_env(name) or str(default)).strip())
+    except Exception:
+        v = float(default)
+    return float(v)
+
+
 def _split_csv(v: Optional[str]) -> List[str]:
     if not v:
         return []
@@ -152,7 +166,7 @@ def _extract_links(html_bytes: bytes, *, base_url: str, limit: int = 120) -> Lis
     except Exception:
         return out
 
-    for m in re.finditer(r'(?is)href\\s*=\\s*["\\\']([^"\\\']+)["\\\']', s):
+    for m in re.finditer(r'(?is)href\s*=\s*["\']([^"\']+)["\']', s):
         href = (m.group(1) or "").strip()
         if not href:
             continue
@@ -375,6 +389,118 @@ class WebRagOutput:
         }
 
 
+# =========================================================
+# Concurrent crawl engine
+# - frontier: (depth, seq) の優先度付きヒープ（BFS 順を保ったまま並列に取り出す）
+# - fetch: 共有スレッドプール（keep-alive 接続は web_fetch 側でホストごとに再利用）
+#   1 クロールあたりの同時 fetch 数と、ホストごとの同時 fetch 数を制限する
+# - extract: HTML 抽出 / 要約 / リンク抽出は別プールで実行し、次の fetch と重ねる
+# - time budget を超えたら新規 dispatch をやめ、その時点までの結果で返す（partial）
+#
+# Env:
+# - SIGMARIS_WEB_RAG_CONCURRENCY           (default 6; 1 クロールの同時 fetch 数)
+# - SIGMARIS_WEB_RAG_PER_HOST_CONCURRENCY  (default 2)
+# - SIGMARIS_WEB_RAG_FETCH_WORKERS         (default 16; プロセス共有)
+# - SIGMARIS_WEB_RAG_EXTRACT_WORKERS       (default 4; プロセス共有)
+# - SIGMARIS_WEB_RAG_TIME_BUDGET_SEC       (default 12; <=0 で無制限)
+# =========================================================
+
+_FETCH_POOL: Optional[ThreadPoolExecutor] = None
+_EXTRACT_POOL: Optional[ThreadPoolExecutor] = None
+_POOLS_LOCK = threading.Lock()
+
+
+def _pools() -> Tuple[ThreadPoolExecutor, ThreadPoolExecutor]:
+    global _FETCH_POOL, _EXTRACT_POOL
+    if _FETCH_POOL is None or _EXTRACT_POOL is None:
+        with _POOLS_LOCK:
+            if _FETCH_POOL is None:
+                n = max(1, min(128, _int_env("SIGMARIS_WEB_RAG_FETCH_WORKERS", 16)))
+                _FETCH_POOL = ThreadPoolExecutor(max_workers=n)
+            if _EXTRACT_POOL is None:
+                n = max(1, min(64, _int_env("SIGMARIS_WEB_RAG_EXTRACT_WORKERS", 4)))
+                _EXTRACT_POOL = ThreadPoolExecutor(max_workers=n)
+    return _FETCH_POOL, _EXTRACT_POOL
+
+
+def _host_of(u: str) -> str:
+    try:
+        return (urllib.parse.urlparse(u).hostname or "").lower()
+    except Exception:
+        return ""
+
+
+@dataclass
+class _PageResult:
+    source: Optional["WebRagSource"]
+    links: List[str]
+
+
+def _process_page(
+    fr: RawFetchResult,
+    *,
+    final_u: str,
+    depth: int,
+    seed_snippet: str,
+    want_links: bool,
+    summarize: bool,
+    cancelled: threading.Event,
+) -> _PageResult:
+    """extract → summarize → link 抽出（extract プール上で実行）。"""
+    cache = get_web_doc_cache()
+    sha = str((fr.meta or {}).get("sha256") or "")
+    text, _extract_meta = _extract_text_cached(fr, cache=cache, sha=sha)
+    text = (text or "").strip()
+    if not text or cancelled.is_set():
+        return _PageResult(source=None, links=[])
+    excerpt = text[:6000]
+
+    summary_obj = None
+    if summarize and _bool_env("SIGMARIS_WEB_RAG_SUMMARIZE", default=True) and not cancelled.is_set():
+        try:
+            summary_obj = summarize_text(url=final_u, title=fr.title or "", text=excerpt)
+        except WebSummarizeError:
+            summary_obj = None
+        except Exception:
+            summary_obj = None
+
+    src = WebRagSource(
+        url=fr.url,
+        final_url=str(fr.final_url or fr.url),
+        title=(fr.title or "").strip()[:240],
+        snippet=str(seed_snippet or "").strip()[:240],
+        depth=int(depth),
+        fetched_at=_now_iso(),
+        summary=(summary_obj or {}).get("summary") if isinstance(summary_obj, dict) else None,
+        key_points=(summary_obj or {}).get("key_points") if isinstance(summary_obj, dict) else None,
+        entities=(summary_obj or {}).get("entities") if isinstance(summary_obj, dict) else None,
+        confidence=(summary_obj or {}).get("confidence") if isinstance(summary_obj, dict) else None,
+    )
+
+    links: List[str] = []
+    if want_links:
+        limit = _int_env("SIGMARIS_WEB_RAG_LINKS_PER_PAGE", 120)
+        hit = cache.get_extract(sha, "links") if (cache is not None and sha) else None
+        if isinstance(hit, dict) and hit.get("base_url") == final_u and int(hit.get("limit") or 0) == int(limit):
+            links = [str(x) for x in (hit.get("links") or []) if isinstance(x, str)]
+        else:
+            links = _extract_links(fr.html_bytes, base_url=final_u, limit=limit)
+            if cache is not None and sha:
+                cache.put_extract(sha, "links", {"base_url": final_u, "limit": int(limit), "links": links})
+    return _PageResult(source=src, links=links)
+
+
+def _extract_text_cached(fr: RawFetchResult, *, cache: Optional[WebDocCache], sha: str) -> Tuple[str, Dict[str, Any]]:
+    if cache is not None and sha:
+        hit = cache.get_extract(sha, "text_hq")
+        if isinstance(hit, dict) and isinstance(hit.get("text"), str):
+            return str(hit["text"]), dict(hit.get("meta") or {})
+    text, extract_meta = _extract_text_high_quality(fr)
+    if cache is not None and sha and (text or "").strip():
+        cache.put_extract(sha, "text_hq", {"text": text, "meta": extract_meta})
+    return text, extract_meta
+
+
 def build_web_rag(
     *,
     query: str,
@@ -390,12 +516,14 @@ def build_web_rag(
     summarize: bool = True,
     timeout_sec: int = 20,
     max_bytes: int = 1_500_000,
+    time_budget_sec: Optional[float] = None,
 ) -> WebRagOutput:
     """
     High-quality Web RAG (MVP++) using:
     - Serper web search provider (existing in sigmaris-core)
     - allowlist/denylist policy gates
     - bounded BFS crawl by following links (optional, max_depth)
+      concurrent fetch (per-host limit + keep-alive) within a time budget; partial results on timeout
     - high-quality extraction (trafilatura/readability) when installed
     - BM25 ranking + dedupe
     - optional per-page summarization via OpenAI (paraphrase, no long quotes)
@@ -425,15 +553,28 @@ def build_web_rag(
     top_k = int(max(0, top_k))
     per_host_limit = int(max(1, per_host_limit))
 
+    if time_budget_sec is None:
+        time_budget_sec = _float_env("SIGMARIS_WEB_RAG_TIME_BUDGET_SEC", 12.0)
+    concurrency = max(1, min(64, _int_env("SIGMARIS_WEB_RAG_CONCURRENCY", 6)))
+    per_host_concurrency = max(1, min(16, _int_env("SIGMARIS_WEB_RAG_PER_HOST_CONCURRENCY", 2)))
+
     started = time.time()
+    deadline = (started + float(time_budget_sec)) if float(time_budget_sec) > 0 else None
     results: List[WebSearchResult] = []
-    queue: List[Tuple[str, int, str]] = []
+
+    # frontier item: (depth, seq, url, seed_snippet)
+    frontier: List[Tuple[int, int, str, str]] = []
+    seq = itertools.count()
+
+    def _push(u: str, depth: int, snippet: str) -> None:
+        heapq.heappush(frontier, (int(depth), next(seq), u, snippet))
+
     if seeds:
         for u0 in seeds:
             u = _canonicalize_url(u0)
             if not u:
                 continue
-            queue.append((u, 0, ""))
+            _push(u, 0, "")
     else:
         try:
             results = provider.search(
@@ -449,7 +590,7 @@ def build_web_rag(
             u = _canonicalize_url(r.url)
             if not u:
                 continue
-            queue.append((u, 0, (r.snippet or "")[:220]))
+            _push(u, 0, (r.snippet or "")[:220])
 
     visited: Set[str] = set()
     fetched: List[WebRagSource] = []
@@ -474,75 +615,127 @@ def build_web_rag(
             return False
         return True
 
-    while queue and len(fetched) < int(max_pages):
-        u, depth, seed_snippet = queue.pop(0)
-        cu = _canonicalize_url(u)
-        if not cu or cu in visited:
-            continue
-        visited.add(cu)
-        try:
-            p = urllib.parse.urlparse(cu)
-            seed_host = (p.hostname or "").lower()
-        except Exception:
-            seed_host = None
+    fetch_pool, extract_pool = _pools()
+    cancelled = threading.Event()
+    # future -> (stage, seq, depth, snippet, host)
+    inflight: Dict[Future, Tuple[str, int, int, str, str]] = {}
+    host_inflight: Dict[str, int] = {}
+    fetch_inflight = 0
+    pages: List[Tuple[int, WebRagSource]] = []
+    stats = {"dispatched": 0, "fetch_failed": 0, "extract_failed": 0, "deferred": 0}
+    doc_cache_counts: Dict[str, int] = {}  # hit / revalidated / miss / ...
+    budget_exhausted = False
 
-        if not _allowed(cu, seed_host=seed_host):
-            continue
+    def _remaining() -> Optional[float]:
+        return None if deadline is None else (deadline - time.time())
 
-        try:
-            fr = fetch_url_raw(url=cu, timeout_sec=timeout_sec, max_bytes=max_bytes)
-        except WebFetchError:
-            continue
-        except Exception:
-            continue
+    try:
+        while True:
+            rem = _remaining()
+            if rem is not None and rem <= 0:
+                budget_exhausted = bool(frontier or inflight)
+                break
 
-        final_u = _canonicalize_url(fr.final_url or fr.url) or cu
-        try:
-            host = (urllib.parse.urlparse(final_u).hostname or "").lower()
-        except Exception:
-            host = ""
-        if host:
-            host_count[host] = int(host_count.get(host, 0) + 1)
+            # ---- dispatch (frontier -> fetch pool) ----
+            deferred: List[Tuple[int, int, str, str]] = []
+            while (
+                frontier
+                and fetch_inflight < concurrency
+                and (len(fetched) + len(inflight)) < int(max_pages)
+            ):
+                item = heapq.heappop(frontier)
+                depth, order, u, seed_snippet = item
+                cu = _canonicalize_url(u)
+                if not cu or cu in visited:
+                    continue
+                host = _host_of(cu)
+                if host and host_inflight.get(host, 0) >= per_host_concurrency:
+                    deferred.append(item)
+                    continue
+                visited.add(cu)
+                if not _allowed(cu, seed_host=(host or None)):
+                    continue
+                if int(host_count.get(host, 0)) + int(host_inflight.get(host, 0)) >= int(per_host_limit):
+                    continue
 
-        text, extract_meta = _extract_text_high_quality(fr)
-        text = (text or "").strip()
-        if not text:
-            continue
-        excerpt = text[:6000]
-
-        summary_obj = None
-        if summarize and _bool_env("SIGMARIS_WEB_RAG_SUMMARIZE", default=True):
-            try:
-                summary_obj = summarize_text(url=final_u, title=fr.title or "", text=excerpt)
-            except WebSummarizeError:
-                summary_obj = None
-            except Exception:
-                summary_obj = None
-
-        src = WebRagSource(
-            url=fr.url,
-            final_url=str(fr.final_url or fr.url),
-            title=(fr.title or "").strip()[:240],
-            snippet=str(seed_snippet or "").strip()[:240],
-            depth=int(depth),
-            fetched_at=_now_iso(),
-            summary=(summary_obj or {}).get("summary") if isinstance(summary_obj, dict) else None,
-            key_points=(summary_obj or {}).get("key_points") if isinstance(summary_obj, dict) else None,
-            entities=(summary_obj or {}).get("entities") if isinstance(summary_obj, dict) else None,
-            confidence=(summary_obj or {}).get("confidence") if isinstance(summary_obj, dict) else None,
-        )
-        fetched.append(src)
-
-        # Crawl expansion
-        if depth < int(max_depth):
-            links = _extract_links(fr.html_bytes, base_url=final_u, limit=_int_env("SIGMARIS_WEB_RAG_LINKS_PER_PAGE", 120))
-            for link in links:
-                cl = _canonicalize_url(link)
-                if not cl or cl in visited:
+                fetch_timeout = int(timeout_sec)
+                if rem is not None:
+                    fetch_timeout = max(1, min(int(timeout_sec), int(math.ceil(rem))))
+                fut = fetch_pool.submit(fetch_url_raw, url=cu, timeout_sec=fetch_timeout, max_bytes=max_bytes)
+                inflight[fut] = ("fetch", order, depth, seed_snippet, host)
+                host_inflight[host] = int(host_inflight.get(host, 0) + 1)
+                fetch_inflight += 1
+                stats["dispatched"] += 1
+            for item in deferred:
+                heapq.heappush(frontier, item)
+            stats["deferred"] += len(deferred)
+
+            if not inflight:
+                break
+
+            done, _ = wait(list(inflight.keys()), timeout=rem, return_when=FIRST_COMPLETED)
+            for fut in done:
+                stage, order, depth, seed_snippet, host = inflight.pop(fut)
+
+                if stage == "fetch":
+                    host_inflight[host] = max(0, int(host_inflight.get(host, 0)) - 1)
+                    fetch_inflight -= 1
+                    try:
+                        fr = fut.result()
+                    except Exception:
+                        stats["fetch_failed"] += 1
+                        continue
+                    cs = str((fr.meta or {}).get("cache") or "bypass")
+                    doc_cache_counts[cs] = int(doc_cache_counts.get(cs, 0) + 1)
+
+                    final_u = _canonicalize_url(fr.final_url or fr.url) or _canonicalize_url(fr.url)
+                    final_host = _host_of(final_u)
+                    if final_host:
+                        host_count[final_host] = int(host_count.get(final_host, 0) + 1)
+
+                    efut = extract_pool.submit(
+                        _process_page,
+                        fr,
+                        final_u=final_u,
+                        depth=int(depth),
+                        seed_snippet=seed_snippet,
+                        want_links=(int(depth) < int(max_depth)),
+                        summarize=bool(summarize),
+                        cancelled=cancelled,
+                    )
+                    inflight[efut] = ("extract", order, depth, seed_snippet, host)
                     continue
-                if not _allowed(cl, seed_host=seed_host):
+
+                # stage == "extract"
+                try:
+                    page = fut.result()
+                except Exception:
+                    stats["extract_failed"] += 1
                     continue
-                queue.append((cl, int(depth) + 1, ""))  # snippet unknown for crawled links
+                if page.source is None:
+                    continue
+                pages.append((order, page.source))
+                fetched.append(page.source)
+
+                # Crawl expansion
+                for link in page.links:
+                    cl = _canonicalize_url(link)
+                    if not cl or cl in visited:
+                        continue
+                    if not _allowed(cl, seed_host=host):
+                        continue
+                    _push(cl, int(depth) + 1, "")  # snippet unknown for crawled links
+    finally:
+        # budget 超過 / 例外: 未着手のジョブは取り消し、実行中のものは結果を捨てる
+        cancelled.set()
+        abandoned = 0
+        for fut in list(inflight.keys()):
+            fut.cancel()
+            abandoned += 1
+
+    # 完了順ではなく frontier 順（BFS 順）に並べ直して、dedupe / 同点時の順位を安定させる
+    pages.sort(key=lambda x: x[0])
+    fetched = [src for _, src in pages]
 
     deduped = _dedupe_sources(fetched)
 
@@ -603,6 +796,17 @@ def build_web_rag(
         "picked": int(len(picked)),
         "max_pages": int(max_pages),
         "max_depth": int(max_depth),
+        "crawl": {
+            "concurrency": int(concurrency),
+            "per_host_concurrency": int(per_host_concurrency),
+            "time_budget_sec": float(time_budget_sec),
+            "budget_exhausted": bool(budget_exhausted),
+            "partial": bool(budget_exhausted),
+            "abandoned": int(abandoned),
+            **stats,
+            "connections": connection_pool_stats(),
+            "doc_cache": dict(doc_cache_counts),
+        },
         "provider": "serper",
         "seed_urls": [str(u) for u in seeds[:5]] if seeds else [],
         "policy": {
@@ -5,7 +5,7 @@ import os
 import uuid
 from dataclasses import dataclass, field
 from datetime import datetime, timezone
-from typing import Any, Dict, Optional
+from typing import Any, Dict, List, Optional, Set, Tuple
 import hashlib
 
 
@@ -13,6 +13,38 @@ def _now_utc() -> datetime:
     return datetime.now(timezone.utc)
 
 
+CATEGORIES = (
+    "stable_knowledge",
+    "contextual_beliefs",
+    "core_values",
+    "operational_policies",
+    "temporary_biases",
+)
+
+# state_sha256 format (recorded next to hashes in delta logs so replay can tell old rows apart).
+# The sum of per-entry digests is linear, so entries with a chosen sum are easy to construct:
+# the hash detects replay drift / accidental divergence, it is NOT tamper-evident.
+STATE_HASH_ALG = "entry-sum-sha256-v1"
+_MOD = 1 << 256
+
+
+def _canonical(v: Any) -> str:
+    return json.dumps(v, ensure_ascii=False, sort_keys=True, separators=(",", ":"))
+
+
+def _entry_digest(category: str, key: str, value: Any) -> int:
+    h = hashlib.sha256(f"{category}\x1f{key}\x1f{_canonical(value)}".encode("utf-8")).digest()
+    return int.from_bytes(h, "big")
+
+
+def _full_digest(st: "KernelState") -> int:
+    acc = 0
+    for cat in CATEGORIES:
+        for k, v in (getattr(st, cat) or {}).items():
+            acc = (acc + _entry_digest(cat, str(k), v)) % _MOD
+    return acc
+
+
 @dataclass
 class KernelState:
     stable_knowledge: Dict[str, Any] = field(default_factory=dict)
@@ -20,6 +52,8 @@ class KernelState:
     core_values: Dict[str, Any] = field(default_factory=dict)
     operational_policies: Dict[str, Any] = field(default_factory=dict)
     temporary_biases: Dict[str, Any] = field(default_factory=dict)
+    # Categories whose dict is shared with a snapshot (copied on first write).
+    _shared: Set[str] = field(default_factory=set, repr=False, compare=False)
 
     def to_dict(self) -> Dict[str, Any]:
         return {
@@ -30,32 +64,65 @@ class KernelState:
             "temporary_biases": self.temporary_biases,
         }
 
+    def share(self) -> "KernelState":
+        """
+        O(categories) structural copy: both sides reference the same category dicts and
+        copy a category only when it is next written (see Kernel.apply_delta).
+        """
+        self._shared = set(CATEGORIES)
+        return KernelState(**self.to_dict(), _shared=set(CATEGORIES))
+
 
 @dataclass
 class Snapshot:
     snapshot_id: str
     created_at: datetime
     state: KernelState
+    # Kernel version (number of applied mutations) and incremental digest at snapshot time.
+    seq: int = 0
+    digest: int = 0
 
     def to_dict(self) -> Dict[str, Any]:
         return {
             "snapshot_id": self.snapshot_id,
             "created_at": self.created_at.isoformat(),
+            "seq": int(self.seq),
             "state": self.state.to_dict(),
         }
 
 
+@dataclass
+class _UserKernel:
+    state: KernelState = field(default_factory=KernelState)
+    digest: int = 0
+    seq: int = 0
+    # Applied mutations since the last checkpoint (folded by compact()).
+    log: List[Dict[str, Any]] = field(default_factory=list)
+    checkpoint: Optional[Snapshot] = None
+
+
 class Kernel:
     """
     Phase04 Layer 1 (MVP):
     - Deterministic state holder with snapshot/rollback.
     - Structural-only validation.
 
+    Snapshots share category dicts with the live state (copy-on-write per category), so
+    snapshot/rollback cost O(categories) and a write copies only the category it touches.
+    Stored values are treated as immutable: apply_delta stores its own copy of delta_value,
+    and callers must not mutate dicts returned by get_state()/get_snapshot() in place.
+
+    The state hash is an order-independent sum of per-entry digests, updated in O(1) per delta
+    (a consistency check for replay, not an integrity guarantee against crafted states).
+    Applied deltas accumulate in a per-user log; compact() folds it into a checkpoint
+    snapshot every SIGMARIS_KERNEL_CHECKPOINT_EVERY deltas (only checkpoints carry full state).
+
     Persistence is intentionally optional in MVP.
     """
 
     def __init__(self) -> None:
-        self._state_by_user: Dict[str, KernelState] = {}
+        self._users: Dict[str, _UserKernel] = {}
+        # insertion-ordered: oldest first
         self._snapshots_by_user: Dict[str, Dict[str, Snapshot]] = {}
         try:
             self._max_snapshots = int(os.getenv("SIGMARIS_KERNEL_MAX_SNAPSHOTS", "32") or "32")
@@ -63,64 +130,113 @@ class Kernel:
             self._max_snapshots = 32
         if self._max_snapshots < 1:
             self._max_snapshots = 1
+        try:
+            self._checkpoint_every = int(os.getenv("SIGMARIS_KERNEL_CHECKPOINT_EVERY", "32") or "32")
+        except Exception:
+            self._checkpoint_every = 32
+        if self._checkpoint_every < 1:
+            self._checkpoint_every = 1
 
-    def get_state(self, *, user_id: str) -> KernelState:
+    def _user(self, user_id: str) -> _UserKernel:
         uid = str(user_id)
-        st = self._state_by_user.get(uid)
-        if st is None:
-            st = KernelState()
-            self._state_by_user[uid] = st
-        return st
+        uk = self._users.get(uid)
+        if uk is None:
+            uk = _UserKernel()
+            self._users[uid] = uk
+        return uk
+
+    def get_state(self, *, user_id: str) -> KernelState:
+        return self._user(user_id).state
 
     def set_state(self, *, user_id: str, state: Dict[str, Any]) -> None:
         """
         Replace the current user state with a provided state dict (deep-copied).
-        Intended for replay/restore (deterministic).
+        Intended for replay/restore (deterministic). The restored state becomes the checkpoint.
         """
-        uid = str(user_id)
+        uk = self._user(user_id)
         raw = json.loads(json.dumps(state or {}, ensure_ascii=False))
-        self._state_by_user[uid] = KernelState(**raw)  # type: ignore[arg-type]
+        uk.state = KernelState(**{c: dict(raw.get(c) or {}) for c in CATEGORIES})
+        uk.digest = _full_digest(uk.state)
+        uk.log = []
+        uk.checkpoint = Snapshot(
+            snapshot_id=uuid.uuid4().hex,
+            created_at=_now_utc(),
+            state=uk.state.share(),
+            seq=uk.seq,
+            digest=uk.digest,
+        )
 
     def state_sha256(self, *, user_id: str) -> str:
         """
-        Stable hash for audit/replay comparisons (sorted keys, compact json).
+        Stable hash for replay comparisons (see STATE_HASH_ALG). O(1): maintained by apply_delta.
+        Not tamper-evident; use state_sha256_full when the full serialized state has to be pinned.
+        """
+        return hashlib.sha256(self._user(user_id).digest.to_bytes(32, "big")).hexdigest()
+
+    def state_sha256_full(self, *, user_id: str) -> str:
+        """
+        Legacy full-state hash (sorted keys, compact json). Re-serializes the whole state;
+        only for verifying rows logged before STATE_HASH_ALG existed.
         """
         st = self.get_state(user_id=str(user_id)).to_dict()
         payload = json.dumps(st, ensure_ascii=False, sort_keys=True, separators=(",", ":")).encode("utf-8")
         return hashlib.sha256(payload).hexdigest()
 
+    def version(self, *, user_id: str) -> int:
+        return int(self._user(user_id).seq)
+
     def snapshot(self, *, user_id: str) -> str:
         uid = str(user_id)
+        uk = self._user(uid)
         snap_id = uuid.uuid4().hex
-        # deep-ish copy via json to ensure immutability against accidental mutation
-        raw = json.loads(json.dumps(self.get_state(user_id=uid).to_dict(), ensure_ascii=False))
-        st = KernelState(**raw)  # type: ignore[arg-type]
-        snap = Snapshot(snapshot_id=snap_id, created_at=_now_utc(), state=st)
+        snap = Snapshot(
+            snapshot_id=snap_id,
+            created_at=_now_utc(),
+            state=uk.state.share(),
+            seq=uk.seq,
+            digest=uk.digest,
+        )
         bucket = self._snapshots_by_user.setdefault(uid, {})
         bucket[snap_id] = snap
 
-        # prune oldest
-        if len(bucket) > self._max_snapshots:
-            ordered = sorted(bucket.values(), key=lambda s: s.created_at)
-            for s in ordered[: max(0, len(bucket) - self._max_snapshots)]:
-                bucket.pop(s.snapshot_id, None)
+        # prune oldest (dict keeps insertion order)
+        while len(bucket) > self._max_snapshots:
+            bucket.pop(next(iter(bucket)), None)
 
         return snap_id
 
     def get_snapshot(self, *, user_id: str, snapshot_id: str) -> Optional[Snapshot]:
         bucket = self._snapshots_by_user.get(str(user_id)) or {}
         snap = bucket.get(str(snapshot_id))
+        if snap is None:
+            cp = self._user(user_id).checkpoint
+            if cp is not None and cp.snapshot_id == str(snapshot_id):
+                return cp
         return snap
 
     def rollback(self, *, user_id: str, snapshot_id: str) -> bool:
         uid = str(user_id)
-        bucket = self._snapshots_by_user.get(uid) or {}
-        snap = bucket.get(str(snapshot_id))
+        snap = self.get_snapshot(user_id=uid, snapshot_id=str(snapshot_id))
         if snap is None:
             return False
-        # restore
-        raw = json.loads(json.dumps(snap.state.to_dict(), ensure_ascii=False))
-        self._state_by_user[uid] = KernelState(**raw)  # type: ignore[arg-type]
+        uk = self._user(uid)
+        # restore (shares the snapshot's dicts; the next write copies)
+        uk.state = snap.state.share()
+        uk.digest = int(snap.digest)
+        cp_seq = uk.checkpoint.seq if uk.checkpoint is not None else 0
+        if snap.seq >= cp_seq:
+            # Undo the log back to the snapshot (seq itself stays monotonic for the persisted log).
+            uk.log = [e for e in uk.log if int(e.get("seq") or 0) <= snap.seq]
+        else:
+            # Rolled back past the checkpoint: the log no longer describes the state.
+            uk.log = []
+            uk.checkpoint = Snapshot(
+                snapshot_id=uuid.uuid4().hex,
+                created_at=_now_utc(),
+                state=uk.state.share(),
+                seq=uk.seq,
+                digest=uk.digest,
+            )
         return True
 
     def apply_delta(
@@ -137,9 +253,10 @@ class Kernel:
         - add_entry / replace : state[category][key] = delta_value
         - remove_entry       : pop key
         """
-        st = self.get_state(user_id=str(user_id))
+        uk = self._user(str(user_id))
+        st = uk.state
         cat = str(target_category)
-        if not hasattr(st, cat):
+        if cat not in CATEGORIES:
             return {"ok": False, "error": "unknown_target_category"}
         bucket: Dict[str, Any] = getattr(st, cat)
         if not isinstance(bucket, dict):
@@ -147,11 +264,80 @@ class Kernel:
 
         op = str(operation_type)
         k = str(key)
-        if op in ("add_entry", "replace", "increment", "decrement"):
+        if op not in ("add_entry", "replace", "increment", "decrement", "remove_entry"):
+            return {"ok": False, "error": "unsupported_operation_type"}
+
+        value: Any = None
+        if op != "remove_entry":
             # structural-only: we do not interpret value semantics here
-            bucket[k] = delta_value
-            return {"ok": True}
+            # (own copy so later caller-side mutation cannot leak into shared snapshots)
+            try:
+                value = json.loads(_canonical(delta_value))
+            except Exception:
+                return {"ok": False, "error": "non_json_delta_value"}
+
+        # copy-on-write: detach this category from snapshots before the first write
+        if cat in st._shared:
+            bucket = dict(bucket)
+            setattr(st, cat, bucket)
+            st._shared.discard(cat)
+
+        digest = uk.digest
+        if k in bucket:
+            digest = (digest - _entry_digest(cat, k, bucket[k])) % _MOD
+
         if op == "remove_entry":
             bucket.pop(k, None)
-            return {"ok": True}
-        return {"ok": False, "error": "unsupported_operation_type"}
+        else:
+            bucket[k] = value
+            digest = (digest + _entry_digest(cat, k, value)) % _MOD
+
+        uk.digest = digest
+        uk.seq += 1
+        uk.log.append({"seq": uk.seq, "op": op, "target_category": cat, "key": k, "delta_value": value})
+        return {"ok": True}
+
+    def pending_deltas(self, *, user_id: str) -> List[Dict[str, Any]]:
+        """Mutations applied since the last checkpoint (oldest first)."""
+        return list(self._user(user_id).log)
+
+    def checkpoint(self, *, user_id: str) -> Optional[Snapshot]:
+        return self._user(user_id).checkpoint
+
+    def ensure_checkpoint(self, *, user_id: str) -> Tuple[Snapshot, bool]:
+        """
+        Current checkpoint, creating an initial one from the current state when the user has none
+        (so the very first delta-log rows already have a replay base). Returns (checkpoint, created).
+        """
+        uk = self._user(user_id)
+        if uk.checkpoint is not None:
+            return uk.checkpoint, False
+        cp = Snapshot(
+            snapshot_id=uuid.uuid4().hex,
+            created_at=_now_utc(),
+            state=uk.state.share(),
+            seq=uk.seq,
+            digest=uk.digest,
+        )
+        uk.checkpoint = cp
+        uk.log = []
+        return cp, True
+
+    def compact(self, *, user_id: str, force: bool = False) -> Optional[Snapshot]:
+        """
+        Fold the delta log into a new checkpoint once it holds SIGMARIS_KERNEL_CHECKPOINT_EVERY
+        entries (or when force=True and anything is pending). Returns the new checkpoint, else None.
+        """
+        uk = self._user(user_id)
+        if not uk.log or (not force and len(uk.log) < self._checkpoint_every):
+            return None
+        cp = Snapshot(
+            snapshot_id=uuid.uuid4().hex,
+            created_at=_now_utc(),
+            state=uk.state.share(),
+            seq=uk.seq,
+            digest=uk.digest,
+        )
+        uk.checkpoint = cp
+        uk.log = []
+        return cp
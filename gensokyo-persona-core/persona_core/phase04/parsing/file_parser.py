@@ -1,8 +1,10 @@
 from __future__ import annotations
 
 import ast
+import codecs
+import os
 import re
-from typing import Any, Dict, Optional, Tuple
+from typing import Any, Dict, Iterable, List, Optional, Tuple
 
 
 def _clamp(s: str, n: int) -> str:
@@ -182,3 +184,271 @@ def parse_file_bytes(
     out["metadata"] = meta
     return "text", out
 
+
+
+# =============================================================
+# Incremental parsing (streamed bytes)
+# =============================================================
+#
+# parse_file_stream() consumes an iterable of byte chunks and keeps only what the parsed
+# shape needs (excerpt + outline state), instead of decoding the whole file at once.
+# - text: stops as soon as the excerpt is settled; token_estimate is extrapolated from the
+#   chars/bytes ratio seen so far when size_bytes is known (exact when the file is read fully)
+# - markdown / code: keep scanning for the outline up to SIGMARIS_PARSE_SCAN_MAX_BYTES
+# Files read to the end produce the same dict as parse_file_bytes(); early stops add
+# metadata.truncated / metadata.parsed_bytes.
+
+_TEXT_EXCERPT_CHARS = 3000
+_CODE_EXCERPT_CHARS = 4000
+_MD_EXCERPT_LINES = 80
+_MD_CODE_BLOCK_KEEP_CHARS = 8000  # per block (snippet is clamped to 1200 anyway)
+_PY_DEF_RE = re.compile(r"^(def|class)\s+([A-Za-z_][A-Za-z0-9_]*)")
+
+
+def _scan_max_bytes() -> int:
+    try:
+        return max(0, int(os.getenv("SIGMARIS_PARSE_SCAN_MAX_BYTES", "1048576") or "1048576"))
+    except Exception:
+        return 1048576
+
+
+class _Utf8StreamDecoder:
+    """UTF-8 strict -> replace fallback, same result as _decode_text() on the concatenated bytes."""
+
+    def __init__(self) -> None:
+        self._dec = codecs.getincrementaldecoder("utf-8")("strict")
+        self.errors = "strict"
+
+    def feed(self, data: bytes, final: bool = False) -> str:
+        if self.errors == "strict":
+            pending = self._dec.getstate()[0]
+            try:
+                return self._dec.decode(data, final)
+            except UnicodeDecodeError:
+                self.errors = "replace"
+                self._dec = codecs.getincrementaldecoder("utf-8")("replace")
+                return self._dec.decode(pending + data, final)
+        return self._dec.decode(data, final)
+
+
+class _LineSplitter:
+    """str.splitlines() over a stream (a trailing "\r" waits for a possible "\n")."""
+
+    def __init__(self) -> None:
+        self._carry = ""
+
+    def feed(self, text: str) -> List[str]:
+        pieces = (self._carry + text).splitlines(keepends=True)
+        self._carry = ""
+        if pieces and (pieces[-1] == pieces[-1].rstrip("\r\n\x0b\x0c\x1c\x1d\x1e\x85\u2028\u2029") or pieces[-1].endswith("\r")):
+            self._carry = pieces.pop()
+        return [p.splitlines()[0] if p.splitlines() else "" for p in pieces]
+
+    def flush(self) -> List[str]:
+        rest, self._carry = self._carry, ""
+        return rest.splitlines()
+
+
+class _HeadText:
+    """Keeps the head of the text until `limit` chars survive .strip() (then further text is dropped)."""
+
+    def __init__(self, limit: int) -> None:
+        self.limit = int(limit)
+        self.parts: List[str] = []
+        self.settled = False
+
+    def feed(self, text: str) -> None:
+        if self.settled or not text:
+            return
+        self.parts.append(text)
+        head = "".join(self.parts)
+        self.parts = [head]
+        if len(head.strip()) > self.limit:
+            self.settled = True
+
+    def text(self) -> str:
+        return "".join(self.parts)
+
+
+class _MarkdownScan:
+    def __init__(self) -> None:
+        self.headings: List[Dict[str, Any]] = []
+        self.code_blocks: List[Dict[str, Any]] = []
+        self.link_count = 0
+        self.head_lines: List[str] = []
+        self._in_code = False
+        self._code_lang = ""
+        self._code_buf: List[str] = []
+        self._code_chars = 0
+
+    def line(self, line: str) -> None:
+        if len(self.head_lines) < _MD_EXCERPT_LINES:
+            self.head_lines.append(line)
+        if line.startswith("```"):
+            if not self._in_code:
+                self._in_code = True
+                self._code_lang = line[3:].strip()
+                self._code_buf = []
+                self._code_chars = 0
+            else:
+                self._in_code = False
+                self.code_blocks.append(
+                    {
+                        "language": self._code_lang or None,
+                        "snippet": _clamp("\n".join(self._code_buf).strip(), 1200),
+                    }
+                )
+                self._code_lang = ""
+                self._code_buf = []
+            return
+
+        if self._in_code:
+            if self._code_chars < _MD_CODE_BLOCK_KEEP_CHARS:
+                self._code_buf.append(line)
+                self._code_chars += len(line) + 1
+            return
+
+        m = re.match(r"^(#{1,6})\s+(.*)$", line)
+        if m:
+            self.headings.append({"level": len(m.group(1)), "title": m.group(2).strip()})
+
+        self.link_count += len(re.findall(r"\[[^\]]+\]\([^)]+\)", line))
+
+    def result(self) -> Dict[str, Any]:
+        return {
+            "file_type": "markdown",
+            "headings": self.headings,
+            "code_blocks": self.code_blocks,
+            "link_count": int(self.link_count),
+            "text_excerpt": _clamp("\n".join(self.head_lines).strip(), 3000),
+        }
+
+
+def parse_file_stream(
+    *,
+    chunks: Iterable[bytes],
+    file_name: str,
+    mime_type: str,
+    kind: Optional[str],
+    size_bytes: Optional[int] = None,
+) -> Tuple[str, Dict[str, Any]]:
+    """
+    Streaming variant of parse_file_bytes(). Returns (kind, parsed_dict).
+    Images are still parsed from the full bytes (Pillow needs the whole file).
+    """
+    k = (kind or "").strip().lower() or _infer_kind(file_name=file_name, mime_type=mime_type)
+
+    if k == "image":
+        return parse_file_bytes(data=b"".join(chunks), file_name=file_name, mime_type=mime_type, kind="image")
+    if k not in ("markdown", "code"):
+        k = "text"
+
+    language = _language_hint_from_filename(file_name) if k == "code" else None
+    is_python = (language or "") in ("py", "python")
+    scan_max = _scan_max_bytes()
+
+    dec = _Utf8StreamDecoder()
+    head = _HeadText(_CODE_EXCERPT_CHARS if k == "code" else _TEXT_EXCERPT_CHARS)
+    md = _MarkdownScan() if k == "markdown" else None
+    splitter = _LineSplitter() if k in ("markdown", "code") else None
+    # code: full text for python AST while it fits in the scan budget; line scan as fallback
+    full_parts: Optional[List[str]] = [] if is_python else None
+    line_outline: List[Dict[str, Any]] = []
+    lineno = 0
+
+    bytes_read = 0
+    chars_read = 0
+    complete = True
+
+    def _lines(lines: List[str]) -> None:
+        nonlocal lineno
+        for ln in lines:
+            lineno += 1
+            if md is not None:
+                md.line(ln)
+            elif is_python:
+                m = _PY_DEF_RE.match(ln)
+                if m:
+                    line_outline.append(
+                        {"kind": "function" if m.group(1) == "def" else "class", "name": m.group(2), "lineno": lineno}
+                    )
+
+    it = iter(chunks)
+    try:
+        for chunk in it:
+            if not chunk:
+                continue
+            bytes_read += len(chunk)
+            text = dec.feed(bytes(chunk))
+            chars_read += len(text)
+            head.feed(text)
+            if splitter is not None:
+                _lines(splitter.feed(text))
+            if full_parts is not None:
+                if bytes_read <= scan_max:
+                    full_parts.append(text)
+                else:
+                    full_parts = None
+
+            if k == "text":
+                # excerpt settled: stop if the size is known (token estimate can be extrapolated)
+                done = head.settled and size_bytes is not None
+            else:
+                done = head.settled and bytes_read >= scan_max
+            if done and (size_bytes is None or bytes_read < int(size_bytes)):
+                complete = False
+                break
+            if done:
+                break
+    finally:
+        close = getattr(it, "close", None)
+        if callable(close):
+            try:
+                close()
+            except Exception:
+                pass
+
+    if complete:
+        tail = dec.feed(b"", final=True)
+        chars_read += len(tail)
+        head.feed(tail)
+        if splitter is not None:
+            _lines(splitter.feed(tail) + splitter.flush())
+        if full_parts is not None:
+            full_parts.append(tail)
+
+    meta: Dict[str, Any] = {"file_name": file_name, "mime_type": mime_type, "encoding": "utf-8", "errors": dec.errors}
+    if not complete:
+        meta["truncated"] = True
+        meta["parsed_bytes"] = int(bytes_read)
+
+    if md is not None:
+        out = md.result()
+        out["metadata"] = meta
+        return "markdown", out
+
+    if k == "code":
+        if full_parts is not None and complete:
+            out = _parse_code("".join(full_parts), language_hint=language)
+            out["raw_excerpt"] = _clamp(head.text().strip(), _CODE_EXCERPT_CHARS)
+        else:
+            out = _parse_code("", language_hint=language)
+            out["raw_excerpt"] = _clamp(head.text().strip(), _CODE_EXCERPT_CHARS)
+            if is_python:
+                out["outline"] = line_outline
+                out["notes"] = ["parsed_with=line_scan"]
+        out["metadata"] = meta
+        return "code", out
+
+    text = head.text()
+    out = {
+        "file_type": "text",
+        "content_summary": _clamp(text.strip(), 1200),
+        "raw_excerpt": _clamp(text.strip(), 3000),
+        "token_estimate": int(chars_read / 4),
+    }
+    if not complete and bytes_read > 0 and size_bytes:
+        out["token_estimate"] = int(chars_read / float(bytes_read) * float(size_bytes) / 4)
+        meta["token_estimate_basis"] = "extrapolated"
+    out["metadata"] = meta
+    return "text", out
@@ -6,9 +6,10 @@ from datetime import datetime, timezone
 from typing import Any, Dict, List, Optional
 
 from persona_core.phase04.governance import GovernanceLayer
-from persona_core.phase04.kernel import Kernel
+from persona_core.phase04.kernel import STATE_HASH_ALG, Kernel
 from persona_core.phase04.perception import PerceptionLayer
 from persona_core.phase04.signal_types import ExternalSignal, GovernanceDecision, SourceType
+from persona_core.storage.persistence_queue import get_persistence_queue
 
 
 def _now() -> datetime:
@@ -100,6 +101,9 @@ class Phase04Runtime:
             "snapshot_after_id": None,
             "state_hash_before": None,
             "state_hash_after": None,
+            "seq_before": None,
+            "seq_after": None,
+            "checkpoint_id": None,
             "applied": 0,
             "rollback": False,
             "errors": [],
@@ -107,8 +111,16 @@ class Phase04Runtime:
 
         if kernel_enabled:
             snap_before_id = None
+            # Replay base of this turn; the first turn of a user creates (and persists) an initial one.
+            base = None
+            base_created = False
+            try:
+                base, base_created = self.kernel.ensure_checkpoint(user_id=user_id)
+            except Exception:
+                base = None
             try:
                 kernel_apply["state_hash_before"] = self.kernel.state_sha256(user_id=user_id)
+                kernel_apply["seq_before"] = self.kernel.version(user_id=user_id)
                 snap_before_id = self.kernel.snapshot(user_id=user_id)
                 kernel_apply["snapshot_before_id"] = snap_before_id
             except Exception:
@@ -142,22 +154,40 @@ class Phase04Runtime:
             snap_after_id = None
             try:
                 kernel_apply["state_hash_after"] = self.kernel.state_sha256(user_id=user_id)
+                kernel_apply["seq_after"] = self.kernel.version(user_id=user_id)
                 if os.getenv("SIGMARIS_KERNEL_SNAPSHOT_AFTER", "1").strip().lower() in ("1", "true", "yes", "on"):
                     snap_after_id = self.kernel.snapshot(user_id=user_id)
                     kernel_apply["snapshot_after_id"] = snap_after_id
             except Exception:
                 snap_after_id = None
 
-            # Attach replay-friendly identifiers to the decision payload (governance stays semantic-free)
+            # Fold the delta log into a checkpoint every SIGMARIS_KERNEL_CHECKPOINT_EVERY deltas.
+            # The checkpoint used as the replay base is the one in effect *before* this turn's deltas.
+            checkpoint = None
+            try:
+                checkpoint = self.kernel.compact(user_id=user_id)
+                kernel_apply["checkpoint_id"] = checkpoint.snapshot_id if checkpoint else None
+            except Exception:
+                checkpoint = None
+
+            # Attach replay-friendly identifiers to the decision payload (governance stays semantic-free).
+            # In-memory before/after snapshots are not persisted, so only the snapshot a rollback
+            # restored (persisted below) is referenced.
+            rollback_snapshot_id = str(snap_before_id) if kernel_apply.get("rollback") and snap_before_id else None
             try:
-                gd.snapshot_id = str(snap_before_id) if snap_before_id else None
+                gd.snapshot_id = rollback_snapshot_id
                 gd.notes = dict(gd.notes or {})
                 gd.notes.update(
                     {
-                        "kernel_snapshot_before_id": str(snap_before_id) if snap_before_id else None,
-                        "kernel_snapshot_after_id": str(snap_after_id) if snap_after_id else None,
+                        "kernel_rollback_snapshot_id": rollback_snapshot_id,
                         "kernel_state_hash_before": str(kernel_apply.get("state_hash_before") or ""),
                         "kernel_state_hash_after": str(kernel_apply.get("state_hash_after") or ""),
+                        "kernel_state_hash_alg": STATE_HASH_ALG,
+                        "kernel_seq_before": kernel_apply.get("seq_before"),
+                        "kernel_seq_after": kernel_apply.get("seq_after"),
+                        "kernel_base_checkpoint_id": base.snapshot_id if base is not None else None,
+                        "kernel_base_checkpoint_seq": int(base.seq) if base is not None else 0,
+                        "kernel_checkpoint_id": checkpoint.snapshot_id if checkpoint is not None else None,
                         "kernel_applied": int(applied),
                         "kernel_rolled_back": bool(kernel_apply.get("rollback")),
                     }
@@ -165,32 +195,43 @@ class Phase04Runtime:
             except Exception:
                 pass
 
-            # Persist (best-effort) if provided (e.g., SupabasePersonaDB)
+            # Persist (best-effort) if provided (e.g., SupabasePersonaDB).
+            # Snapshots go out only for checkpoints (and rollback targets); kernel_state every turn.
+            # Snapshot states share dicts with the live state copy-on-write, so the worker can
+            # serialize them later without a copy here.
             if persist is not None:
-                try:
-                    persist.upsert_kernel_state(user_id=user_id, state=self.kernel.get_state(user_id=user_id).to_dict())
-                except Exception:
-                    pass
-                if snap_before_id:
-                    try:
-                        snap = self.kernel.get_snapshot(user_id=user_id, snapshot_id=str(snap_before_id))
-                        persist.insert_kernel_snapshot(
-                            user_id=user_id,
-                            snapshot_id=str(snap_before_id),
-                            state=(snap.state.to_dict() if snap else {}),
-                        )
-                    except Exception:
-                        pass
-                if snap_after_id:
+                q = get_persistence_queue()
+                to_persist = []
+                if base is not None and base_created:
+                    to_persist.append(base)
+                if checkpoint is not None:
+                    to_persist.append(checkpoint)
+                if rollback_snapshot_id:
+                    rb = self.kernel.get_snapshot(user_id=user_id, snapshot_id=rollback_snapshot_id)
+                    if rb is not None:
+                        to_persist.append(rb)
+                for snap in to_persist:
                     try:
-                        snap = self.kernel.get_snapshot(user_id=user_id, snapshot_id=str(snap_after_id))
-                        persist.insert_kernel_snapshot(
-                            user_id=user_id,
-                            snapshot_id=str(snap_after_id),
-                            state=(snap.state.to_dict() if snap else {}),
+                        q.submit(
+                            lambda sid=str(snap.snapshot_id), st=snap.state.to_dict(): persist.insert_kernel_snapshot(
+                                user_id=user_id, snapshot_id=sid, state=st
+                            ),
+                            label="kernel_checkpoint",
+                            scope=str(user_id),
                         )
                     except Exception:
                         pass
+                try:
+                    # 同一ユーザーの未処理 upsert はキュー上で最新の 1 回にまとめる
+                    live_state = self.kernel.get_state(user_id=user_id).share().to_dict()
+                    q.submit(
+                        lambda: persist.upsert_kernel_state(user_id=user_id, state=live_state),
+                        label="kernel_state",
+                        key=("kernel_state", str(user_id)),
+                        scope=str(user_id),
+                    )
+                except Exception:
+                    pass
                 try:
                     persist.insert_kernel_delta_log(
                         user_id=user_id,
@@ -201,11 +242,11 @@ class Phase04Runtime:
                     )
                 except Exception:
                     pass
-                if kernel_apply.get("rollback") and snap_before_id:
+                if rollback_snapshot_id:
                     try:
                         persist.insert_kernel_rollback(
                             user_id=user_id,
-                            snapshot_id=str(snap_before_id),
+                            snapshot_id=rollback_snapshot_id,
                             trace_id=trace_id,
                             reason="kernel_apply_failed_rolled_back",
                         )
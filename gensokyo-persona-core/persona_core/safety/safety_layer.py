@@ -31,6 +31,7 @@ from __future__ import annotations
 from dataclasses import dataclass, field
 from typing import Any, Dict, List, Optional
 
+import asyncio
 import math
 
 from persona_core.types.core_types import PersonaRequest
@@ -175,10 +176,13 @@ class SafetyLayer:
         value_state: ValueState,
         trait_state: TraitState,
         memory: Optional[MemorySelectionResult] = None,
+        query_vector: Optional[List[float]] = None,
     ) -> SafetyAssessment:
         """
         PersonaController から呼ばれるメインエントリ。
 
+        query_vector を渡した場合は semantic 判定でそれを使い、encode を呼ばない（assess_async 用）。
+
         戻り値の safety_flag を GlobalStateMachine.decide(...) に渡すことで
         SAFETY_LOCK / OVERLOADED / NORMAL などの状態遷移に反映される。
         """
@@ -194,7 +198,7 @@ class SafetyLayer:
             reasons.append(f"rule_hits={rule_hits}")
 
         # 2) semantic チェック（embedding ベース）
-        semantic_score, semantic_cats = self._semantic_scan(text)
+        semantic_score, semantic_cats = self._semantic_scan(text, query_vector=query_vector)
         # カテゴリごとに max をとって統合
         for k, v in semantic_cats.items():
             categories[k] = max(categories.get(k, 0.0), v)
@@ -267,6 +271,52 @@ class SafetyLayer:
             meta=meta,
         )
 
+    async def assess_async(
+        self,
+        *,
+        req: PersonaRequest,
+        value_state: ValueState,
+        trait_state: TraitState,
+        memory: Optional[MemorySelectionResult] = None,
+    ) -> SafetyAssessment:
+        """
+        assess の async 版（PersonaController.handle_turn_async 用）。
+
+        embedding_model が aencode を持つ場合、クエリ（と未キャッシュのアンカー）の embedding を
+        async client で並列に取得する。持たない場合は assess をスレッドで実行する。
+        """
+        aencode = getattr(self._embed, "aencode", None)
+        if not callable(aencode):
+            return await asyncio.to_thread(
+                self.assess, req=req, value_state=value_state, trait_state=trait_state, memory=memory
+            )
+
+        text = (req.message or "").strip()
+        q_vec: Optional[List[float]] = None
+        if text:
+            anchor_cats = [] if self._anchor_vectors else list(self.SEMANTIC_ANCHORS.keys())
+            vecs = await asyncio.gather(
+                aencode(text),
+                *[aencode(self.SEMANTIC_ANCHORS[c]) for c in anchor_cats],
+                return_exceptions=True,
+            )
+            if anchor_cats and not self._anchor_vectors:
+                anchors: Dict[str, List[float]] = {}
+                for cat, vec in zip(anchor_cats, vecs[1:]):
+                    anchors[cat] = vec if isinstance(vec, list) else []
+                    if self._embedded_dim == 0 and isinstance(vec, list):
+                        self._embedded_dim = len(vec)
+                self._anchor_vectors = anchors
+            q_vec = vecs[0] if isinstance(vecs[0], list) else None
+
+        return self.assess(
+            req=req,
+            value_state=value_state,
+            trait_state=trait_state,
+            memory=memory,
+            query_vector=q_vec,
+        )
+
     # ========================================================
     # (1) ルールベースチェック
     # ========================================================
@@ -317,6 +367,21 @@ class SafetyLayer:
         if self._anchor_vectors:
             return
 
+        # encode_many があればアンカー全件を 1 リクエストで取得
+        encode_many = getattr(self._embed, "encode_many", None)
+        if callable(encode_many):
+            try:
+                cats = list(self.SEMANTIC_ANCHORS.keys())
+                vecs = encode_many([self.SEMANTIC_ANCHORS[c] for c in cats])
+                if isinstance(vecs, list) and len(vecs) == len(cats):
+                    anchors = {c: (v if isinstance(v, list) else []) for c, v in zip(cats, vecs)}
+                    if self._embedded_dim == 0 and vecs and isinstance(vecs[0], list):
+                        self._embedded_dim = len(vecs[0])
+                    self._anchor_vectors = anchors
+                    return
+            except Exception:
+                pass
+
         for cat, text in self.SEMANTIC_ANCHORS.items():
             try:
                 vec = self._embed.encode(text)
@@ -354,7 +419,7 @@ class SafetyLayer:
         # cosine (-1〜1) → 0〜1 に線形マッピング
         return max(0.0, min(1.0, (cos + 1.0) / 2.0))
 
-    def _semantic_scan(self, text: str) -> tuple[float, Dict[str, float]]:
+    def _semantic_scan(self, text: str, *, query_vector: Optional[List[float]] = None) -> tuple[float, Dict[str, float]]:
         """
         embedding_model を用いた意味的危険度チェック。
         戻り値：
@@ -366,10 +431,13 @@ class SafetyLayer:
 
         self._ensure_anchor_vectors()
 
-        try:
-            q_vec = self._embed.encode(text)
-        except Exception:
-            return 0.0, {}
+        if query_vector:
+            q_vec = query_vector
+        else:
+            try:
+                q_vec = self._embed.encode(text)
+            except Exception:
+                return 0.0, {}
 
         categories: Dict[str, float] = {}
         max_score = 0.0
@@ -25,10 +25,13 @@ import hashlib
 import sys
 import asyncio
 import re
+import shutil
+import tempfile
+import threading
 from pathlib import Path
 from concurrent.futures import ThreadPoolExecutor
 from datetime import datetime, timezone, timedelta
-from typing import Any, Dict, List, Literal, Optional
+from typing import Any, Callable, Dict, Iterable, Iterator, List, Literal, Optional, Tuple
 
 from fastapi import FastAPI, HTTPException
 from fastapi import Header
@@ -37,6 +40,8 @@ from fastapi.middleware.cors import CORSMiddleware
 from fastapi.responses import StreamingResponse, Response
 from pydantic import BaseModel, field_validator, model_validator
 
+from persona_core import metrics
+from persona_core.intent_classifier import CentroidIntentClassifier, match_rules as match_intent_rules
 from persona_core.storage.env_loader import load_dotenv
 from persona_core.controller.persona_controller import PersonaController, PersonaControllerConfig
 from persona_core.identity.identity_continuity import IdentityContinuityEngineV3
@@ -48,12 +53,15 @@ from persona_core.memory.memory_orchestrator import MemoryOrchestrator
 from persona_core.memory.selective_recall import SelectiveRecall
 from persona_core.safety.safety_layer import SafetyLayer
 from persona_core.state.global_state_machine import GlobalStateMachine
+from persona_core.state.resident_state import ResidentStateStore, ResidentUserState
 from persona_core.trace import TRACE_INCLUDE_TEXT, get_logger, new_trace_id, preview_text, trace_event
 from persona_core.trait.trait_drift_engine import TraitDriftEngine, TraitState
+from persona_core.ttl_cache import LRUTTLCache
 from persona_core.types.core_types import PersonaRequest
 from persona_core.value.value_drift_engine import ValueDriftEngine, ValueState
 from persona_core.storage.supabase_rest import SupabaseConfig, SupabaseRESTClient
 from persona_core.storage.supabase_store import SupabaseEpisodeStore, SupabasePersonaDB
+from persona_core.storage.persistence_queue import get_persistence_queue
 from persona_core.storage.supabase_auth import SupabaseAuthError, resolve_user_from_bearer
 from persona_core.storage.supabase_storage import SupabaseStorageClient, SupabaseStorageConfig, SupabaseStorageError
 from persona_core.ego.ego_state import EgoContinuityState
@@ -193,6 +201,21 @@ class AuthContext(BaseModel):
     email: Optional[str] = None
 
 
+def _env_int(name: str, default: int) -> int:
+    # import 時に評価する設定値用: 壊れた値で server 全体の import を落とさない
+    try:
+        return int(os.getenv(name, str(default)) or default)
+    except Exception:
+        return int(default)
+
+
+def _env_float(name: str, default: float) -> float:
+    try:
+        return float(os.getenv(name, str(default)) or default)
+    except Exception:
+        return float(default)
+
+
 """
 Performance helpers (TTFT)
 - Parallelize independent Supabase REST calls (urllib is blocking)
@@ -206,12 +229,103 @@ _STATE_LOAD_POOL: ThreadPoolExecutor = ThreadPoolExecutor(max_workers=_state_loa
 _state_cache_ttl_sec = float(os.getenv("SIGMARIS_STATE_CACHE_TTL_SEC", "0") or "0")
 _state_cache_max = int(os.getenv("SIGMARIS_STATE_CACHE_MAX", "256") or "256")
 _state_cache_max = max(0, min(5000, _state_cache_max))
-_state_cache: Dict[str, Dict[str, Any]] = {}  # user_id -> {"ts": float, ...payload}
+_state_cache: LRUTTLCache[Dict[str, Any]] = LRUTTLCache(
+    max_items=_state_cache_max, ttl_sec=_state_cache_ttl_sec, name="state"
+)  # user_id -> payload
 
 _auth_cache_ttl_sec = float(os.getenv("SIGMARIS_AUTH_CACHE_TTL_SEC", "0") or "0")
 _auth_cache_max = int(os.getenv("SIGMARIS_AUTH_CACHE_MAX", "1024") or "1024")
 _auth_cache_max = max(0, min(10000, _auth_cache_max))
-_auth_cache: Dict[str, Dict[str, Any]] = {}  # token_hash -> {"ts": float, "ctx": AuthContext}
+_auth_cache: LRUTTLCache[AuthContext] = LRUTTLCache(
+    max_items=_auth_cache_max, ttl_sec=_auth_cache_ttl_sec, name="auth"
+)  # token_hash -> AuthContext
+
+
+# 常駐 session state（persona_core/state/resident_state.py）
+# - Supabase wiring 時のみ使う（in-memory デモは controller 自体が常駐している）
+# - SNAPSHOT_EVERY > 1 なら value / trait snapshot を N ターンに 1 回にし、残りは追い出し / shutdown 時に write-back
+_resident_enabled = os.getenv("SIGMARIS_RESIDENT_STATE", "1") not in ("0", "false", "False", "no", "off")
+_resident_max = max(0, min(20000, _env_int("SIGMARIS_RESIDENT_STATE_MAX", 1024)))
+_resident_idle_sec = _env_float("SIGMARIS_RESIDENT_STATE_IDLE_SEC", 1800.0)
+_resident_snapshot_every = max(1, min(100, _env_int("SIGMARIS_RESIDENT_STATE_SNAPSHOT_EVERY", 1)))
+
+
+# DB から状態を読み直す前に、同じユーザーの未完了書き込みを待つ最大秒数（0 で無効）
+_persist_read_barrier_sec = max(0.0, _env_float("SIGMARIS_PERSIST_READ_BARRIER_SEC", 2.0))
+
+
+def _resident_write_back(entry: ResidentUserState) -> None:
+    """未保存ターンが残った常駐 state を 1 件の value / trait snapshot として書き戻す（永続化キュー経由）。"""
+    if _supabase is None:
+        return
+    sb = _supabase
+    uid = entry.user_id
+    value, trait = dict(entry.value), dict(entry.trait)
+    dv, dt = entry.delta_since_persisted()
+    meta = {
+        "trace_id": entry.last_trace_id,
+        "session_id": entry.last_session_id,
+        "kind": "resident_write_back",
+        "coalesced_turns": int(entry.pending_turns),
+        "baseline": entry.baseline,
+    }
+
+    def _job() -> None:
+        db = SupabasePersonaDB(sb)
+        db.store_value_snapshot(user_id=uid, state=value, delta=dv, meta=meta)
+        db.store_trait_snapshot(user_id=uid, state=trait, delta=dt, meta=meta)
+
+    if not get_persistence_queue().submit(
+        _job, label="resident_write_back", key=("resident_write_back", uid), scope=uid
+    ):
+        raise RuntimeError("persistence queue rejected resident write-back")
+
+
+_resident_states = ResidentStateStore(
+    max_items=(_resident_max if _resident_enabled else 0),
+    idle_ttl_sec=_resident_idle_sec,
+    snapshot_every=_resident_snapshot_every,
+    ema_alpha=_env_float("SIGMARIS_RESIDENT_STATE_EMA_ALPHA", 0.2),
+    trend_window=_env_int("SIGMARIS_RESIDENT_STATE_TREND_WINDOW", 5),
+    write_back=_resident_write_back,
+)
+
+# affinity routing: レスポンスに worker の instance id を載せ、UI が同じ worker へ寄せられるようにする
+_INSTANCE_ID = (os.getenv("SIGMARIS_INSTANCE_ID") or os.getenv("FLY_MACHINE_ID") or "").strip()
+
+
+class _InstanceHeaderMiddleware:
+    """全レスポンスに x-sigmaris-instance を付ける（pure ASGI: SSE の本文には触らない）。"""
+
+    def __init__(self, inner: Any) -> None:
+        self._inner = inner
+        self._header = (b"x-sigmaris-instance", _INSTANCE_ID.encode("latin-1", "ignore"))
+
+    async def __call__(self, scope: Dict[str, Any], receive: Any, send: Any) -> None:
+        if scope.get("type") != "http":
+            await self._inner(scope, receive, send)
+            return
+
+        async def _send(message: Dict[str, Any]) -> None:
+            if message.get("type") == "http.response.start":
+                message["headers"] = [*(message.get("headers") or []), self._header]
+            await send(message)
+
+        await self._inner(scope, receive, _send)
+
+
+if _INSTANCE_ID:
+    app.add_middleware(_InstanceHeaderMiddleware)
+
+
+@app.on_event("shutdown")
+def _flush_resident_states() -> None:
+    # 間引いていた value / trait snapshot を書き戻してから永続化キューを drain する
+    try:
+        _resident_states.flush()
+    except Exception:
+        pass
+    get_persistence_queue().shutdown(drain=True, timeout_sec=10.0)
 
 
 async def _to_thread(fn, *args, **kwargs):
@@ -219,39 +333,75 @@ async def _to_thread(fn, *args, **kwargs):
     return await loop.run_in_executor(_STATE_LOAD_POOL, lambda: fn(*args, **kwargs))
 
 
-def _cache_get(cache: Dict[str, Dict[str, Any]], key: str, ttl_sec: float) -> Optional[Dict[str, Any]]:
-    if ttl_sec <= 0:
-        return None
-    v = cache.get(key)
-    if not isinstance(v, dict):
-        return None
-    ts = v.get("ts")
-    if not isinstance(ts, (int, float)):
-        cache.pop(key, None)
-        return None
-    if (time.time() - float(ts)) > float(ttl_sec):
-        cache.pop(key, None)
-        return None
-    return v
+def _resident_payload(entry: ResidentUserState) -> Dict[str, Any]:
+    v, t = entry.value, entry.trait
+    return {
+        "op": entry.op,
+        "value": ValueState(
+            stability=float(v.get("stability", 0.0)),
+            openness=float(v.get("openness", 0.0)),
+            safety_bias=float(v.get("safety_bias", 0.0)),
+            user_alignment=float(v.get("user_alignment", 0.0)),
+        ),
+        "trait": TraitState(
+            calm=float(t.get("calm", 0.5)),
+            empathy=float(t.get("empathy", 0.5)),
+            curiosity=float(t.get("curiosity", 0.5)),
+        ),
+        "ego": entry.ego,
+        "tid": entry.tid,
+        "resident": True,
+    }
 
 
-def _cache_put(cache: Dict[str, Dict[str, Any]], key: str, payload: Dict[str, Any], *, max_items: int) -> None:
-    if max_items <= 0:
-        return
-    payload = dict(payload)
-    payload["ts"] = float(time.time())
-    cache[key] = payload
-    if len(cache) <= max_items:
-        return
-    # best-effort eviction: drop ~10% oldest-ish entries without heavy LRU bookkeeping
+def _resident_before_turn(preq: PersonaRequest, *, user_id: str) -> None:
+    """snapshot を間引くターンなら controller に伝える（常駐していない user は常に書く）。"""
+    try:
+        if _supabase is not None and not _resident_states.snapshot_due(user_id):
+            preq.metadata["_skip_state_snapshots"] = True
+    except Exception:
+        pass
+
+
+def _resident_after_turn(
+    controller: PersonaController, preq: PersonaRequest, *, user_id: str, trace_id: str, session_id: str
+) -> Optional[Dict[str, Any]]:
+    """ターン後の状態を常駐させ、集約値（EMA / trait trend）を返す。"""
+    if _supabase is None or not _resident_states.enabled:
+        return None
     try:
-        items = list(cache.items())
-        items.sort(key=lambda kv: float((kv[1] or {}).get("ts") or 0.0))
-        drop_n = max(1, int(max_items * 0.1))
-        for k, _ in items[:drop_n]:
-            cache.pop(k, None)
+        st = controller.export_state()
+        entry = _resident_states.observe(
+            user_id,
+            value=st["value"],
+            trait=st["trait"],
+            baseline=st.get("baseline"),
+            ego=st.get("ego"),
+            tid=st.get("tid"),
+            persisted=not bool((preq.metadata or {}).get("_skip_state_snapshots")),
+            trace_id=trace_id,
+            session_id=session_id,
+        )
+        if entry is None:
+            return None
+        if entry.db_marker is not None and not bool((preq.metadata or {}).get("_skip_state_snapshots")):
+            # このターンの trait snapshot（trace_id = このターン）が最新になる
+            entry.db_marker = (trace_id, entry.db_marker[1])
+        return entry.aggregates()
     except Exception:
-        cache.clear()
+        return None
+
+
+async def _resident_db_marker(persona_db: "SupabasePersonaDB", user_id: str) -> Optional[Tuple[Any, Any]]:
+    """常駐 state の鮮度マーカー: (最新 trait snapshot の trace_id, 最新 operator override の id)。読めなければ None。"""
+    trace, override_id = await asyncio.gather(
+        _to_thread(persona_db.load_last_trait_trace_id, user_id=user_id),
+        _to_thread(persona_db.load_last_operator_override_id, user_id=user_id),
+        return_exceptions=True,
+    )
+    if isinstance(trace, Exception) or isinstance(override_id, Exception):
+        return None
+    return (trace, override_id)
 
 
 async def _load_supabase_initial_states(
@@ -259,10 +409,34 @@ async def _load_supabase_initial_states(
     persona_db: "SupabasePersonaDB",
     user_id: str,
 ) -> Dict[str, Any]:
-    cached = _cache_get(_state_cache, user_id, _state_cache_ttl_sec)
+    resident = _resident_states.get(user_id)
+    if resident is not None:
+        # 別 worker のターン / 別 instance の operator override で DB が進んでいないか確かめてから使う
+        landed = True
+        if _persist_read_barrier_sec > 0:
+            landed = await _to_thread(get_persistence_queue().wait_scope, user_id, _persist_read_barrier_sec)
+        if not landed:
+            # 自分の書き込みがまだ DB に届いていない: いま DB を読んでも常駐 state より古い
+            return _resident_payload(resident)
+        marker = await _resident_db_marker(persona_db, user_id)
+        if marker is None or marker == resident.db_marker:
+            # マーカーが読めない（DB 障害）ときは既定値にフォールバックするより常駐 state を使う
+            return _resident_payload(resident)
+        # DB の方が新しい: 常駐 state は書き戻さずに捨てる
+        _resident_states.invalidate(user_id, write_back=False)
+        _state_cache.pop(user_id)
+
+    cached = _state_cache.get(user_id)
     if isinstance(cached, dict):
         return cached
 
+    # 前ターンの snapshot 書き込みがまだキューにあると、古い状態を読んでしまう（read-after-write）
+    if resident is None and _persist_read_barrier_sec > 0:
+        await _to_thread(get_persistence_queue().wait_scope, user_id, _persist_read_barrier_sec)
+
+    # マーカーは状態より先に読む（間に書き込みが入っても「マーカーが古い」側に倒れ、次回読み直す）
+    db_marker = await _resident_db_marker(persona_db, user_id) if _resident_states.enabled else None
+
     tasks = [
         _to_thread(persona_db.load_last_operator_override, user_id=user_id, kind="ops_mode_set"),
         _to_thread(persona_db.load_last_value_state, user_id=user_id),
@@ -284,8 +458,16 @@ async def _load_supabase_initial_states(
         tid = None
 
     payload = {"op": op, "value": value, "trait": trait, "ego": ego, "tid": tid}
-    if _state_cache_ttl_sec > 0 and _state_cache_max > 0:
-        _cache_put(_state_cache, user_id, payload, max_items=_state_cache_max)
+    _state_cache.put(user_id, payload)
+    _resident_states.adopt(
+        user_id,
+        value=value.to_dict(),
+        trait=trait.to_dict(),
+        ego=(ego if isinstance(ego, dict) else None),
+        tid=(tid if isinstance(tid, dict) else None),
+        op=op,
+        db_marker=db_marker,
+    )
     return payload
 
 
@@ -336,13 +518,11 @@ def get_auth_context(
         except Exception:
             token = None
 
-        if token and _auth_cache_ttl_sec > 0 and _auth_cache_max > 0:
+        if token and _auth_cache.enabled:
             th = hashlib.sha256(token.encode("utf-8", errors="ignore")).hexdigest()
-            cached = _cache_get(_auth_cache, th, _auth_cache_ttl_sec)
-            if isinstance(cached, dict):
-                ctx = cached.get("ctx")
-                if isinstance(ctx, AuthContext):
-                    return ctx
+            cached = _auth_cache.get(th)
+            if isinstance(cached, AuthContext):
+                return cached
 
         u = resolve_user_from_bearer(
             supabase_url=_supabase_cfg.url,
@@ -351,8 +531,8 @@ def get_auth_context(
             timeout_sec=_auth_timeout_sec,
         )
         ctx = AuthContext(user_id=u.user_id, email=u.email)
-        if token and _auth_cache_ttl_sec > 0 and _auth_cache_max > 0:
-            _cache_put(_auth_cache, th, {"ctx": ctx}, max_items=_auth_cache_max)
+        if token and _auth_cache.enabled:
+            _auth_cache.put(th, ctx)
         return ctx
     except SupabaseAuthError as e:
         raise HTTPException(status_code=401, detail=str(e))
@@ -891,14 +1071,13 @@ class RelationshipScoreResponse(BaseModel):
 _intent_cache_ttl_sec = float(os.getenv("SIGMARIS_INTENT_CACHE_TTL_SEC", "10") or "10")
 _intent_cache_max = int(os.getenv("SIGMARIS_INTENT_CACHE_MAX", "2048") or "2048")
 _intent_cache_max = max(0, min(20000, _intent_cache_max))
-_intent_cache: Dict[str, Dict[str, Any]] = {}
+_intent_cache: LRUTTLCache[Dict[str, Any]] = LRUTTLCache(
+    max_items=_intent_cache_max, ttl_sec=_intent_cache_ttl_sec, name="intent"
+)  # key -> PersonaIntentResponse.model_dump()
 
 
 def _intent_cache_get(key: str) -> Optional[PersonaIntentResponse]:
-    cached = _cache_get(_intent_cache, key, _intent_cache_ttl_sec)
-    if not isinstance(cached, dict):
-        return None
-    v = cached.get("value")
+    v = _intent_cache.get(key)
     if isinstance(v, dict):
         try:
             return PersonaIntentResponse.model_validate(v)
@@ -908,19 +1087,10 @@ def _intent_cache_get(key: str) -> Optional[PersonaIntentResponse]:
 
 
 def _intent_cache_put(key: str, value: PersonaIntentResponse) -> None:
-    if _intent_cache_max <= 0:
+    if not _intent_cache.enabled:
         return
-    _cache_put(_intent_cache, key, {"value": value.model_dump()}, max_items=_intent_cache_max)
-
+    _intent_cache.put(key, value.model_dump())
 
-_META_RE = re.compile(
-    r"\b(ai|llm|prompt|system prompt|system|モデル|プロンプト|指示|ガードレール|openai|api|token)\b",
-    re.IGNORECASE,
-)
-_SAFETY_RE = re.compile(
-    r"(自殺|死にたい|消えたい|リスカ|オーバードーズ|OD|殺す|爆破|銃|薬の売買|違法|児童|強姦|レイプ|近親相姦)",
-    re.IGNORECASE,
-)
 
 _VAGUE_BUT_VALID_RE = re.compile(
     r"^(?:"
@@ -1188,90 +1358,138 @@ def _llm_relationship_score(
 
 
 def _intent_fast_path(user_text: str) -> Optional[PersonaIntentResponse]:
-    t = (user_text or "").strip()
-    if not t:
-        return PersonaIntentResponse(intent="unclear", confidence=0.0, output_style="normal", needs_clarify=True)
-    # Phatic / greetings / check-ins (avoid misclassifying as "unclear")
-    # Examples: "元気？", "こんにちは", "最近どう？", "暇？"
+    # Tier 1: precompiled keyword automaton (persona_core/intent_classifier.py)
+    v = match_intent_rules(user_text)
+    if v is None:
+        return None
+    return PersonaIntentResponse.model_validate(v)
+
+
+# Tier 2: embedding nearest-centroid（LLM より安い; 既定 off。有効時も chitchat/banter 以外と
+# confidence 未満は LLM へ escalate し、safety/clarify/style の判断は LLM に残す）
+_intent_centroid_enabled = os.getenv("SIGMARIS_INTENT_CENTROID", "0").strip().lower() in ("1", "true", "yes", "on")
+_intent_centroid_confidence = _env_float("SIGMARIS_INTENT_CENTROID_CONFIDENCE", 0.8)
+_intent_centroid_min_sim = _env_float("SIGMARIS_INTENT_CENTROID_MIN_SIM", 0.35)
+_intent_centroid: Optional[CentroidIntentClassifier] = None
+_intent_centroid_lock = threading.Lock()
+
+_INTENT_TIER_TOTAL = metrics.REGISTRY.counter(
+    "sigmaris_intent_tier_total", "/persona/intent requests per cascade tier and outcome.", ("tier", "outcome")
+)
+_INTENT_TIER_SECONDS = metrics.REGISTRY.histogram(
+    "sigmaris_intent_tier_duration_seconds", "/persona/intent time spent per cascade tier.", ("tier",)
+)
+
+
+def _intent_tier_done(tier: str, outcome: str, started: float) -> None:
+    _INTENT_TIER_TOTAL.inc(tier=tier, outcome=outcome)
+    _INTENT_TIER_SECONDS.observe(time.perf_counter() - started, tier=tier)
+
+
+def _get_intent_centroid() -> Optional[CentroidIntentClassifier]:
+    global _intent_centroid
+    if not _intent_centroid_enabled:
+        return None
+    if _intent_centroid is not None:
+        return _intent_centroid
+    with _intent_centroid_lock:
+        if _intent_centroid is None:
+            try:
+                llm = _get_llm_client()
+            except Exception:
+                return None
+            _intent_centroid = CentroidIntentClassifier(llm.encode_many)
+    return _intent_centroid
+
+
+@app.get("/health")
+async def health(x_sigmaris_operator_key: Optional[str] = Header(default=None)) -> Dict[str, Any]:
+    """
+    Liveness + background pipeline observability (no auth; contains no user data).
+
+    persistence.last_error (raw exception text; may quote Supabase error bodies) is
+    only included for callers presenting the configured SIGMARIS_OPERATOR_KEY.
+    """
+    persistence = get_persistence_queue().metrics()
+    expected = os.getenv("SIGMARIS_OPERATOR_KEY")
+    if not expected or (x_sigmaris_operator_key or "") != expected:
+        persistence.pop("last_error", None)
+    caches = {c.name: c.stats() for c in (_state_cache, _resident_states, _auth_cache, _intent_cache, _parse_cache)}
+    if _llm_client is not None:
+        caches["embedding"] = _llm_client.embed_cache_stats()
+        caches["prompt_prefix"] = _llm_client.prompt_prefix_stats()
     try:
-        phatic = re.sub(r"\s+", "", t)
-        if len(phatic) <= 24:
-            if re.match(
-                r"^(?:霊夢[、,]?)?(?:元気|げんき|調子(?:どう)?|最近どう|最近どうよ|こんにちは|こんばんは|おはよう|おはよ|やあ|やっほ(?:ー)?|もしもし|どうも|暇|ひま)(?:[？\?!！。．…]*)$",
-                phatic,
-                flags=re.IGNORECASE,
-            ):
-                return PersonaIntentResponse(
-                    intent="chitchat",
-                    confidence=1.0,
-                    output_style="normal",
-                    allowed_humor=True,
-                    urgency="low",
-                    needs_clarify=False,
-                    safety_risk="none",
-                )
-            # Formatting requests: encourage stable output_style without LLM ambiguity.
-            # - "2択で" / "A)B)" / "どっち" -> choice_2
-            if re.search(r"(2択|二択|A\)|B\)|どっち|どちら|選んで)", t, flags=re.IGNORECASE) and re.search(
-                r"(2択|二択|A\)|B\))", t, flags=re.IGNORECASE
-            ):
-                return PersonaIntentResponse(
-                    intent="advice",
-                    confidence=0.95,
-                    output_style="choice_2",
-                    allowed_humor=True,
-                    urgency="normal",
-                    needs_clarify=False,
-                    safety_risk="none",
-                )
-            # - "箇条書きで" / "3つ" -> bullet_3
-            if re.search(r"(箇条書き|箇条書きで|箇条書きに|リストで|列挙して)", t) and re.search(
-                r"(3つ|三つ|3個|三個|3点|三点|3項|三項)", t
-            ):
-                return PersonaIntentResponse(
-                    intent="task",
-                    confidence=0.95,
-                    output_style="bullet_3",
-                    allowed_humor=True,
-                    urgency="normal",
-                    needs_clarify=False,
-                    safety_risk="none",
-                )
-            if re.match(
-                r"^(?:了解|りょうかい|OK|ok|おけ|わかった|分かった|ありがと(?:う)?|サンキュー|thanks|thx)(?:[！!。．…]*)$",
-                phatic,
-                flags=re.IGNORECASE,
-            ):
-                return PersonaIntentResponse(
-                    intent="chitchat",
-                    confidence=0.9,
-                    output_style="normal",
-                    allowed_humor=True,
-                    urgency="low",
-                    needs_clarify=False,
-                    safety_risk="none",
-                )
+        from persona_core.phase04.io.web_doc_cache import web_doc_cache_stats
+
+        web_doc = web_doc_cache_stats()
+        if web_doc is not None:
+            caches["web_doc"] = web_doc
     except Exception:
         pass
-    if _SAFETY_RE.search(t):
-        return PersonaIntentResponse(
-            intent="safety",
-            confidence=1.0,
-            output_style="normal",
-            allowed_humor=False,
-            urgency="high",
-            safety_risk="high",
-        )
-    if _META_RE.search(t):
-        return PersonaIntentResponse(
-            intent="meta",
-            confidence=1.0,
-            output_style="normal",
-            allowed_humor=False,
-            urgency="normal",
-            safety_risk="none",
-        )
-    return None
+    return {
+        "ok": True,
+        "engine_version": ENGINE_VERSION,
+        "build_sha": BUILD_SHA,
+        "config_hash": CONFIG_HASH,
+        "instance_id": _INSTANCE_ID or None,
+        "supabase": _supabase is not None,
+        "persistence": persistence,
+        "caches": caches,
+        "intent_centroid": _intent_centroid.stats() if _intent_centroid is not None else None,
+    }
+
+
+def _metrics_collect() -> List[Any]:
+    """scrape 時に既存の stats() を読むだけ（ホットパスでは何もしない）。"""
+    caches: Dict[str, Dict[str, Any]] = {
+        c.name: c.stats() for c in (_state_cache, _resident_states, _auth_cache, _intent_cache, _parse_cache)
+    }
+    if _llm_client is not None:
+        try:
+            caches["embedding"] = _llm_client.embed_cache_stats()
+            caches["prompt_prefix"] = _llm_client.prompt_prefix_stats()
+        except Exception:
+            pass
+    try:
+        from persona_core.phase04.io.web_doc_cache import web_doc_cache_stats
+
+        web_doc = web_doc_cache_stats()
+        if web_doc is not None:
+            caches["web_doc"] = web_doc
+    except Exception:
+        pass
+    families: List[Any] = metrics.cache_families(caches)
+
+    pq = get_persistence_queue().metrics()
+    for key, mtype, help_text in (
+        ("depth", "gauge", "Persistence queue depth."),
+        ("inflight", "gauge", "Persistence jobs currently running."),
+        ("submitted", "counter", "Persistence jobs submitted."),
+        ("completed", "counter", "Persistence jobs completed."),
+        ("failed", "counter", "Persistence jobs failed after retries."),
+        ("dropped", "counter", "Persistence jobs dropped (queue full)."),
+        ("coalesced", "counter", "Persistence jobs coalesced into a pending one."),
+        ("oldest_pending_ms", "gauge", "Age of the oldest pending persistence job (ms)."),
+    ):
+        v = pq.get(key)
+        if isinstance(v, (int, float)) and not isinstance(v, bool):
+            name = f"sigmaris_persistence_{key}" + ("_total" if mtype == "counter" else "")
+            families.append((name, mtype, help_text, [({}, float(v))]))
+
+    families.append(("sigmaris_active_streams", "gauge", "Streaming turns currently generating.", [({}, float(_active_streams))]))
+    return families
+
+
+metrics.register_collector("server_persona_os", _metrics_collect)
+
+
+@app.get("/metrics")
+async def metrics_endpoint() -> Response:
+    """
+    Prometheus text exposition (no auth; 集計値のみでユーザーデータは含まない)。
+    SIGMARIS_METRICS=0 で記録自体を止められる。
+    """
+    return Response(content=metrics.render_prometheus(), media_type="text/plain; version=0.0.4; charset=utf-8")
 
 
 @app.post("/persona/intent", response_model=PersonaIntentResponse)
@@ -1296,14 +1514,33 @@ async def persona_intent(req: PersonaIntentRequest, auth: Optional[AuthContext]
             "message": message[:1200],
         }
     )
+    t_tier = time.perf_counter()
     cached = _intent_cache_get(key)
     if cached is not None:
+        _intent_tier_done("cache", "hit", t_tier)
         return cached
 
+    t_tier = time.perf_counter()
     fast = _intent_fast_path(message)
     if fast is not None:
+        _intent_tier_done("rules", "hit", t_tier)
         _intent_cache_put(key, fast)
         return fast
+    _intent_tier_done("rules", "miss", t_tier)
+
+    # Tier 2: nearest-centroid on the (cached) message embedding.
+    # 直前が assistant の質問なら文脈依存なので LLM に回す（centroid は単文しか見ない）
+    centroid = _get_intent_centroid()
+    centroid_hit = None
+    if centroid is not None and message and not _looks_like_question(_last_assistant_content(history)):
+        t_tier = time.perf_counter()
+        centroid_hit = await asyncio.to_thread(centroid.classify, message)
+        if centroid_hit is not None and centroid.answers(centroid_hit, _intent_centroid_confidence, _intent_centroid_min_sim):
+            _intent_tier_done("centroid", "hit", t_tier)
+            parsed_c = PersonaIntentResponse.model_validate(centroid.response(centroid_hit))
+            _intent_cache_put(key, parsed_c)
+            return parsed_c
+        _intent_tier_done("centroid", "miss", t_tier)
 
     model_fast = (os.getenv("SIGMARIS_INTENT_MODEL_FAST") or DEFAULT_MODEL or "").strip() or "gpt-5.2"
     model_strong = (os.getenv("SIGMARIS_INTENT_MODEL_STRONG") or DEFAULT_MODEL or "").strip() or "gpt-5.2"
@@ -1318,7 +1555,8 @@ async def persona_intent(req: PersonaIntentRequest, auth: Optional[AuthContext]
         history=history,
         message=message,
     )
-    v = _llm_intent_classify(model=model_fast, prompt=prompt, max_tokens=max_tokens)
+    t_tier = time.perf_counter()
+    v = await asyncio.to_thread(_llm_intent_classify, model=model_fast, prompt=prompt, max_tokens=max_tokens)
     parsed: Optional[PersonaIntentResponse] = None
     if isinstance(v, dict):
         try:
@@ -1331,6 +1569,7 @@ async def persona_intent(req: PersonaIntentRequest, auth: Optional[AuthContext]
         or float(getattr(parsed, "confidence", 0.0) or 0.0) < confidence_threshold
         or getattr(parsed, "intent", None) in ("unclear",)
     )
+    _intent_tier_done("llm_fast", "miss" if need_strong else "hit", t_tier)
 
     if need_strong and model_strong:
         hint = ""
@@ -1343,13 +1582,31 @@ async def persona_intent(req: PersonaIntentRequest, auth: Optional[AuthContext]
             prompt
             + ("\n\nPREVIOUS_ATTEMPT_JSON:\n" + hint + "\n\nRe-check and output the best JSON for this turn.\n" if hint else "\n\nRe-check and output the best JSON for this turn.\n")
         )
-        v2 = _llm_intent_classify(model=model_strong, prompt=prompt2, max_tokens=max_tokens)
+        t_tier = time.perf_counter()
+        v2 = await asyncio.to_thread(_llm_intent_classify, model=model_strong, prompt=prompt2, max_tokens=max_tokens)
+        strong_ok = False
         if isinstance(v2, dict):
             try:
                 parsed2 = PersonaIntentResponse.model_validate(v2)
                 parsed = parsed2
+                strong_ok = True
             except Exception:
                 pass
+        _intent_tier_done("llm_strong", "hit" if strong_ok else "miss", t_tier)
+
+    # Confident LLM labels feed the centroid tier (bounded per label).
+    try:
+        if (
+            centroid is not None
+            and centroid_hit is not None
+            and parsed is not None
+            and float(parsed.confidence or 0.0) >= confidence_threshold
+            and parsed.output_style == "normal"
+            and not parsed.needs_clarify
+        ):
+            centroid.learn(centroid_hit.vector, str(parsed.intent))
+    except Exception:
+        pass
 
     if parsed is None:
         parsed = PersonaIntentResponse(intent="unclear", confidence=0.0, output_style="normal", needs_clarify=True)
@@ -1714,6 +1971,252 @@ async def _maybe_web_rag_for_turn(
     return (ctx if ctx else None, sources if sources else None, meta if isinstance(meta, dict) else None)
 
 
+# -------------------------------------------------------------
+# Phase04 attachments: streamed ingestion / parse cache / parse pool
+# -------------------------------------------------------------
+
+# parsing（Pillow / vision / AST）は event loop から外し、専用 pool で同時実行数も絞る
+_parse_workers = max(1, min(16, _env_int("SIGMARIS_PARSE_WORKERS", 2)))
+_PARSE_POOL: ThreadPoolExecutor = ThreadPoolExecutor(max_workers=_parse_workers, thread_name_prefix="parse")
+
+# (owner, sha256, kind, mime, ext) -> (parsed_kind, parsed)。同じユーザーの同じ内容の再アップロード / 再 parse はここで返す
+# （vision の結果は file_name にも依存するのでユーザーをまたいで共有しない。file_name / mime は返すときに付け直す）
+_parse_cache: LRUTTLCache[Tuple[str, Dict[str, Any]]] = LRUTTLCache(
+    max_items=max(0, min(2000, _env_int("SIGMARIS_PARSE_CACHE_MAX", 128))),
+    ttl_sec=_env_float("SIGMARIS_PARSE_CACHE_TTL_SEC", 600.0),
+    name="parse",
+)
+
+_SHA256_HEX_RE = re.compile(r"^[0-9a-f]{64}$")
+
+_UPLOADS_TOTAL = metrics.REGISTRY.counter(
+    "sigmaris_uploads_total", "/io/upload results (stored / deduplicated / too_large).", ("outcome",)
+)
+_PARSE_TOTAL = metrics.REGISTRY.counter(
+    "sigmaris_parse_total", "Attachment parses by kind and outcome (cached / full / truncated).", ("kind", "outcome")
+)
+_PARSE_SECONDS = metrics.REGISTRY.histogram("sigmaris_parse_duration_seconds", "Attachment parse duration.", ("kind",))
+
+
+def _upload_chunk_bytes() -> int:
+    try:
+        return max(4096, int(os.getenv("SIGMARIS_UPLOAD_CHUNK_BYTES", "262144") or "262144"))
+    except Exception:
+        return 262144
+
+
+def _upload_max_bytes() -> int:
+    return _env_int("SIGMARIS_UPLOAD_MAX_BYTES", 5242880)  # 5MB
+
+
+# multipart の boundary / part header の分だけ、本文の上限に上乗せして許す
+_UPLOAD_FORM_OVERHEAD_BYTES = 64 * 1024
+
+
+class _UploadSizeLimitMiddleware:
+    """
+    POST /io/upload の本文を、Starlette が multipart を読み切る前に打ち切る（pure ASGI）。
+    - Content-Length が上限を超えていれば、本文を 1 byte も読まずに 413
+    - chunked 等で長さが無いときは、受信した累計が上限を超えた時点で 413
+    どちらも receive の中で HTTPException を投げるので、通常の例外ハンドラ / CORS を通る。
+    ファイル本体の厳密な上限チェックは io_upload 側（SIGMARIS_UPLOAD_MAX_BYTES）。
+    """
+
+    def __init__(self, inner: Any) -> None:
+        self._inner = inner
+
+    async def __call__(self, scope: Dict[str, Any], receive: Any, send: Any) -> None:
+        if scope.get("type") != "http" or scope.get("method") != "POST" or scope.get("path") != "/io/upload":
+            await self._inner(scope, receive, send)
+            return
+
+        cap = _upload_max_bytes() + _UPLOAD_FORM_OVERHEAD_BYTES
+        declared: Optional[int] = None
+        for k, v in scope.get("headers") or []:
+            if k == b"content-length":
+                try:
+                    declared = int(v)
+                except Exception:
+                    declared = None
+        seen = 0
+
+        async def _receive() -> Dict[str, Any]:
+            nonlocal seen
+            if declared is not None and declared > cap:
+                _UPLOADS_TOTAL.inc(outcome="too_large")
+                raise HTTPException(status_code=413, detail="File too large")
+            message = await receive()
+            if message.get("type") == "http.request":
+                seen += len(message.get("body") or b"")
+                if seen > cap:
+                    _UPLOADS_TOTAL.inc(outcome="too_large")
+                    raise HTTPException(status_code=413, detail="File too large")
+            return message
+
+        await self._inner(scope, _receive, send)
+
+
+app.add_middleware(_UploadSizeLimitMiddleware)
+
+
+def _upload_base_dir() -> str:
+    return os.getenv("SIGMARIS_UPLOAD_DIR") or str(Path(__file__).resolve().parents[2] / "data" / "uploads")
+
+
+async def _to_parse_pool(fn, *args, **kwargs):
+    loop = asyncio.get_running_loop()
+    return await loop.run_in_executor(_PARSE_POOL, lambda: fn(*args, **kwargs))
+
+
+def _iter_file_chunks(path: str, chunk_size: int) -> Iterator[bytes]:
+    with open(path, "rb") as f:
+        while True:
+            chunk = f.read(chunk_size)
+            if not chunk:
+                return
+            yield chunk
+
+
+def _normalize_sha256(v: Any) -> Optional[str]:
+    s = str(v or "").strip().lower()
+    return s if _SHA256_HEX_RE.match(s) else None
+
+
+def _parse_cache_key(
+    *, owner: str, sha256: Optional[str], file_name: str, mime_type: str, kind: Optional[str]
+) -> Optional[str]:
+    sha = _normalize_sha256(sha256)
+    if not sha:
+        return None
+    # kind 推定は拡張子 + mime で決まるので、それも key に含める
+    ext = os.path.splitext(file_name or "")[1].lower()
+    return f"{owner or 'anon'}:{sha}:{(kind or '').strip().lower()}:{(mime_type or '').strip().lower()}:{ext}"
+
+
+def _restamp_parsed(parsed: Any, *, file_name: str, mime_type: str) -> Any:
+    """
+    cache から返す parsed に、今回の attachment の file_name / mime_type を付け直す
+    （metadata / metadata_extra だけ浅くコピーするので、cache 側の dict は書き換えない）。
+    """
+    if not isinstance(parsed, dict):
+        return parsed
+    out = dict(parsed)
+    for k in ("metadata", "metadata_extra"):
+        m = out.get(k)
+        if isinstance(m, dict) and ("file_name" in m or "mime_type" in m):
+            out[k] = {**m, "file_name": file_name, "mime_type": mime_type}
+    return out
+
+
+def _parse_cached(
+    *, owner: str, sha256: Optional[str], file_name: str, mime_type: str, kind: Optional[str]
+) -> Optional[Tuple[str, Dict[str, Any]]]:
+    key = _parse_cache_key(owner=owner, sha256=sha256, file_name=file_name, mime_type=mime_type, kind=kind)
+    if key is None:
+        return None
+    hit = _parse_cache.get(key)
+    if hit is None:
+        return None
+    _PARSE_TOTAL.inc(kind=hit[0], outcome="cached")
+    return hit[0], _restamp_parsed(hit[1], file_name=file_name, mime_type=mime_type)
+
+
+def _close_quietly(obj: Any) -> None:
+    close = getattr(obj, "close", None)
+    if callable(close):
+        try:
+            close()
+        except Exception:
+            pass
+
+
+def _parse_attachment(
+    *,
+    owner: str,
+    open_chunks: Callable[[], Iterable[bytes]],
+    file_name: str,
+    mime_type: str,
+    kind: Optional[str],
+    size_bytes: Optional[int],
+    sha256: Optional[str],
+) -> Tuple[str, Dict[str, Any]]:
+    """
+    Blocking (run it in _PARSE_POOL): parse cache -> streamed incremental parse (file_parser.parse_file_stream).
+    open_chunks is only called on a cache miss, so cached content is never downloaded again.
+    """
+    from persona_core.phase04.parsing.file_parser import parse_file_stream  # local import
+
+    hit = _parse_cached(owner=owner, sha256=sha256, file_name=file_name, mime_type=mime_type, kind=kind)
+    if hit is not None:
+        return hit
+    started = time.perf_counter()
+    chunks = open_chunks()
+    try:
+        pk, parsed = parse_file_stream(
+            chunks=chunks,
+            file_name=file_name,
+            mime_type=mime_type,
+            kind=kind,
+            size_bytes=(int(size_bytes) if size_bytes is not None else None),
+        )
+    finally:
+        # text は excerpt が決まった時点で読むのをやめるので、残りの download はここで閉じる
+        _close_quietly(chunks)
+    truncated = bool(isinstance(parsed, dict) and (parsed.get("metadata") or {}).get("truncated"))
+    _PARSE_TOTAL.inc(kind=pk, outcome="truncated" if truncated else "full")
+    _PARSE_SECONDS.observe(time.perf_counter() - started, kind=pk)
+    key = _parse_cache_key(owner=owner, sha256=sha256, file_name=file_name, mime_type=mime_type, kind=kind)
+    if key is not None:
+        _parse_cache.put(key, (pk, parsed))
+    return pk, parsed
+
+
+def _local_dedup_path(base_dir: str, owner: str, sha256: str) -> str:
+    safe_owner = re.sub(r"[^A-Za-z0-9_-]", "_", owner or "anon")[:80]
+    return os.path.join(base_dir, "_sha256", f"{safe_owner}.{sha256}")
+
+
+def _find_local_duplicate(base_dir: str, owner: str, sha256: str) -> Optional[Dict[str, Any]]:
+    try:
+        with open(_local_dedup_path(base_dir, owner, sha256), "r", encoding="utf-8") as f:
+            attachment_id = f.read().strip()
+        path = os.path.join(base_dir, attachment_id)
+        if not attachment_id or not os.path.isfile(path):
+            return None
+        with open(path + ".json", "r", encoding="utf-8") as f:
+            meta = json.load(f) or {}
+        return meta if str(meta.get("sha256") or "") == sha256 else None
+    except Exception:
+        return None
+
+
+async def _find_duplicate_upload(*, auth: Optional[AuthContext], sha256: str) -> Optional[Dict[str, Any]]:
+    """Same user + same content hash -> existing attachment (attachment_id, file_name, mime_type, size)."""
+    if _supabase is not None and _storage is not None and auth is not None:
+        try:
+            row = await _to_thread(SupabasePersonaDB(_supabase).find_attachment_by_sha256, user_id=str(auth.user_id), sha256=sha256)
+        except Exception:
+            row = None
+        if not row:
+            return None
+        return {
+            "attachment_id": str(row.get("attachment_id") or ""),
+            "file_name": str(row.get("file_name") or ""),
+            "mime_type": str(row.get("mime_type") or "application/octet-stream"),
+            "size": int(row.get("size_bytes") or 0),
+        }
+    owner = str(auth.user_id) if auth is not None else "anon"
+    meta = await _to_thread(_find_local_duplicate, _upload_base_dir(), owner, sha256)
+    if not meta:
+        return None
+    return {
+        "attachment_id": str(meta.get("attachment_id") or ""),
+        "file_name": str(meta.get("file_name") or ""),
+        "mime_type": str(meta.get("mime_type") or "application/octet-stream"),
+        "size": int(meta.get("size") or 0),
+    }
+
+
 def _attachment_excerpt_from_parsed(parsed: Any) -> str:
     if not isinstance(parsed, dict):
         return ""
@@ -1730,7 +2233,69 @@ def _attachment_excerpt_from_parsed(parsed: Any) -> str:
     return ""
 
 
-def _build_attachments_context(
+def _auto_parse_attachment_excerpt(
+    *,
+    attachment_id: str,
+    auth: Optional[AuthContext],
+    file_name: str,
+    mime_type: str,
+    kind_hint: Optional[str],
+) -> str:
+    """Blocking: resolve the attachment (Supabase or local), then parse it via the parse cache / stream."""
+    meta: Dict[str, Any] = {}
+    open_chunks: Callable[[], Iterable[bytes]]
+    if _supabase is not None and _storage is not None and auth is not None:
+        persona_db = SupabasePersonaDB(_supabase)
+        row = persona_db.load_attachment(attachment_id=str(attachment_id))
+        if not row:
+            raise RuntimeError("attachment not found")
+        owner = row.get("user_id")
+        if owner and str(owner) != str(auth.user_id):
+            raise RuntimeError("forbidden")
+        bucket_id = str(row.get("bucket_id") or _storage_bucket)
+        object_path = str(row.get("object_path") or "")
+        if not object_path:
+            raise RuntimeError("missing object_path")
+        meta = row if isinstance(row, dict) else {}
+        storage = _storage
+
+        def open_chunks() -> Iterable[bytes]:
+            return storage.download_stream(bucket_id=bucket_id, object_path=object_path, chunk_size=_upload_chunk_bytes())
+
+        size = meta.get("size_bytes")
+    else:
+        path = os.path.join(_upload_base_dir(), str(attachment_id))
+        meta_path = path + ".json"
+        if not os.path.exists(path) or not os.path.isfile(path):
+            raise RuntimeError("attachment not found")
+        if os.path.exists(meta_path):
+            try:
+                with open(meta_path, "r", encoding="utf-8") as f:
+                    meta = json.load(f) or {}
+            except Exception:
+                meta = {}
+            owner = meta.get("user_id")
+            if _auth_required and auth is not None and owner and str(owner) != str(auth.user_id):
+                raise RuntimeError("forbidden")
+
+        def open_chunks() -> Iterable[bytes]:
+            return _iter_file_chunks(path, _upload_chunk_bytes())
+
+        size = meta.get("size") if meta.get("size") is not None else os.path.getsize(path)
+
+    _, parsed = _parse_attachment(
+        owner=(str(auth.user_id) if auth is not None else "anon"),
+        open_chunks=open_chunks,
+        file_name=file_name or _safe_str(meta.get("file_name") or ""),
+        mime_type=mime_type or _safe_str(meta.get("mime_type") or ""),
+        kind=kind_hint,
+        size_bytes=(int(size) if size is not None else None),
+        sha256=_safe_str(meta.get("sha256") or "") or None,
+    )
+    return _attachment_excerpt_from_parsed(parsed)
+
+
+async def _build_attachments_context(
     *,
     attachments: Optional[List[Dict[str, Any]]],
     auth: Optional[AuthContext],
@@ -1747,8 +2312,6 @@ def _build_attachments_context(
     max_items = int(os.getenv("SIGMARIS_CHAT_ATTACHMENTS_MAX_ITEMS", "3") or "3")
     max_excerpt = int(os.getenv("SIGMARIS_CHAT_ATTACHMENTS_MAX_EXCERPT_CHARS", "1200") or "1200")
 
-    from persona_core.phase04.parsing.file_parser import parse_file_bytes  # local import
-
     lines: List[str] = ["# Attachments (Phase04)"]
     count = 0
     for raw in atts[: max(0, max_items)]:
@@ -1767,52 +2330,16 @@ def _build_attachments_context(
         if isinstance(parsed_excerpt, str) and parsed_excerpt.strip():
             excerpt = parsed_excerpt.strip()
         elif auto_parse:
-            # Best-effort: download bytes and parse here (same auth rules as /io/parse).
+            # Best-effort: stream + parse here (same auth rules as /io/parse), off the event loop.
             try:
-                data: Optional[bytes] = None
-                meta: Dict[str, Any] = {}
-                if _supabase is not None and _storage is not None and auth is not None:
-                    persona_db = SupabasePersonaDB(_supabase)
-                    row = persona_db.load_attachment(attachment_id=str(attachment_id))
-                    if not row:
-                        raise RuntimeError("attachment not found")
-                    owner = row.get("user_id")
-                    if owner and str(owner) != str(auth.user_id):
-                        raise RuntimeError("forbidden")
-                    bucket_id = str(row.get("bucket_id") or _storage_bucket)
-                    object_path = str(row.get("object_path") or "")
-                    if not object_path:
-                        raise RuntimeError("missing object_path")
-                    data = _storage.download(bucket_id=bucket_id, object_path=object_path)
-                    meta = row if isinstance(row, dict) else {}
-                else:
-                    base_dir = os.getenv("SIGMARIS_UPLOAD_DIR") or str(
-                        Path(__file__).resolve().parents[2] / "data" / "uploads"
-                    )
-                    path = os.path.join(base_dir, str(attachment_id))
-                    meta_path = path + ".json"
-                    if not os.path.exists(path) or not os.path.isfile(path):
-                        raise RuntimeError("attachment not found")
-                    if _auth_required and auth is not None and os.path.exists(meta_path):
-                        try:
-                            with open(meta_path, "r", encoding="utf-8") as f:
-                                meta = json.load(f) or {}
-                            owner = meta.get("user_id")
-                            if owner and str(owner) != str(auth.user_id):
-                                raise RuntimeError("forbidden")
-                        except Exception:
-                            pass
-                    with open(path, "rb") as f:
-                        data = f.read()
-                if data is not None:
-                    pk, parsed = parse_file_bytes(
-                        data=data,
-                        file_name=file_name or _safe_str(meta.get("file_name") or ""),
-                        mime_type=mime_type or _safe_str(meta.get("mime_type") or ""),
-                        kind=kind_hint,
-                    )
-                    _ = pk
-                    excerpt = _attachment_excerpt_from_parsed(parsed)
+                excerpt = await _to_parse_pool(
+                    _auto_parse_attachment_excerpt,
+                    attachment_id=str(attachment_id),
+                    auth=auth,
+                    file_name=file_name,
+                    mime_type=mime_type,
+                    kind_hint=kind_hint,
+                )
             except Exception:
                 excerpt = ""
 
@@ -1842,6 +2369,9 @@ class UploadResponse(BaseModel):
     file_name: str
     mime_type: str
     size: int
+    sha256: Optional[str] = None
+    # True: same content was already uploaded by this user; attachment_id points at the stored copy
+    deduplicated: bool = False
 
 
 class ParseRequest(BaseModel):
@@ -1963,6 +2493,36 @@ class GitHubSearchResponse(BaseModel):
     results: List[Dict[str, Any]]
 
 
+class TurnContextAutoBrowse(BaseModel):
+    query: str
+    max_results: int = 5
+    recency_days: Optional[int] = None
+    safe_search: str = "active"
+    domains: Optional[List[str]] = None
+    # fetch (or GitHub-search) the first N result URLs, like per-URL link analysis
+    fetch_top: int = 2
+
+
+class TurnContextRequest(BaseModel):
+    attachment_ids: List[str] = []
+    urls: List[str] = []
+    auto_browse: Optional[TurnContextAutoBrowse] = None
+    # client deadline for the whole batch (capped by SIGMARIS_TURN_CONTEXT_DEADLINE_MS)
+    deadline_ms: Optional[int] = None
+
+
+class TurnContextResponse(BaseModel):
+    ok: bool
+    # [{attachment_id, ok, kind?, parsed?, status?, error?}] in request order
+    attachments: List[Dict[str, Any]] = []
+    # [{url, ok, provider?, response?, status?, error?}] in request order
+    links: List[Dict[str, Any]] = []
+    # {ok, query, response?, links: [...]} when auto_browse was requested
+    auto_browse: Optional[Dict[str, Any]] = None
+    timed_out: List[str] = []
+    elapsed_ms: float = 0.0
+
+
 # =============================================================
 # Persona OS v2 wiring（組み立て）
 # =============================================================
@@ -2102,6 +2662,10 @@ async def persona_operator_override(
     except Exception as e:
         raise HTTPException(status_code=500, detail=f"audit failed: {e}")
 
+    # 常駐 state / state cache を捨てる（未保存分は write-back しない: operator の値を優先する）
+    _resident_states.invalidate(req.user_id, write_back=False)
+    _state_cache.pop(req.user_id)
+
     # apply as forced snapshot so the next load picks it up
     try:
         if req.kind == "trait_set":
@@ -2144,6 +2708,23 @@ async def persona_operator_override(
 
 @app.post("/persona/chat", response_model=ChatResponse)
 async def persona_chat(req: ChatRequest, auth: Optional[AuthContext] = Depends(get_auth_context)) -> ChatResponse:
+    # Web RAG は intent 判定の直後に先行して走らせるので、途中（state load / safety / controller）で
+    # 例外になっても取り残さずに止める
+    pending: List["asyncio.Future[Any]"] = []
+    try:
+        return await _persona_chat_impl(req, auth, pending=pending)
+    finally:
+        for fut in pending:
+            if not fut.done():
+                fut.cancel()
+
+
+async def _persona_chat_impl(
+    req: ChatRequest,
+    auth: Optional[AuthContext],
+    *,
+    pending: List["asyncio.Future[Any]"],
+) -> ChatResponse:
     """
     1ターン分のチャット処理。
     - 入力を PersonaRequest に変換
@@ -2160,7 +2741,7 @@ async def persona_chat(req: ChatRequest, auth: Optional[AuthContext] = Depends(g
 
     effective_message, client_history = _derive_message_and_history(req)
     external_system = _merge_external_system(req.persona_system, req.system)
-    attachments_ctx = _build_attachments_context(attachments=req.attachments, auth=auth)
+    attachments_ctx = await _build_attachments_context(attachments=req.attachments, auth=auth)
     if attachments_ctx:
         effective_message = (effective_message + "\n\n" + attachments_ctx).strip()
 
@@ -2184,6 +2765,7 @@ async def persona_chat(req: ChatRequest, auth: Optional[AuthContext] = Depends(g
     web_ctx = None
     web_sources = None
     web_meta = None
+    web_rag_task: Optional["asyncio.Future[Any]"] = None
 
     tool_weather = None
     tool_comparison = None
@@ -2261,16 +2843,20 @@ async def persona_chat(req: ChatRequest, auth: Optional[AuthContext] = Depends(g
             except Exception:
                 forced_gen = (req.gen if isinstance(req.gen, dict) else None)
 
-            web_ctx, web_sources, web_meta = await _maybe_web_rag_for_turn(
-                message=effective_message,
-                gen=forced_gen,
-                trace_id=trace_id,
-                session_id=session_id,
-                user_id=str(user_id),
-                persona_db=(SupabasePersonaDB(_supabase) if (_supabase is not None and _is_uuid(str(user_id))) else None),
+            # Start now; awaited inside handle_turn_async alongside memory selection + safety.
+            web_rag_task = asyncio.ensure_future(
+                _maybe_web_rag_for_turn(
+                    message=effective_message,
+                    gen=forced_gen,
+                    trace_id=trace_id,
+                    session_id=session_id,
+                    user_id=str(user_id),
+                    persona_db=(SupabasePersonaDB(_supabase) if (_supabase is not None and _is_uuid(str(user_id))) else None),
+                )
             )
+            pending.append(web_rag_task)
         except Exception:
-            web_ctx, web_sources, web_meta = (None, None, None)
+            web_rag_task = None
 
         # Attach a lightweight personalization hint (best-effort; no impact to persona logic).
         try:
@@ -2318,16 +2904,20 @@ async def persona_chat(req: ChatRequest, auth: Optional[AuthContext] = Depends(g
             except Exception:
                 forced_gen = (req.gen if isinstance(req.gen, dict) else None)
 
-            web_ctx, web_sources, web_meta = await _maybe_web_rag_for_turn(
-                message=effective_message,
-                gen=forced_gen,
-                trace_id=trace_id,
-                session_id=session_id,
-                user_id=str(user_id),
-                persona_db=(SupabasePersonaDB(_supabase) if (_supabase is not None and _is_uuid(str(user_id))) else None),
+            # Start now; awaited inside handle_turn_async alongside memory selection + safety.
+            web_rag_task = asyncio.ensure_future(
+                _maybe_web_rag_for_turn(
+                    message=effective_message,
+                    gen=forced_gen,
+                    trace_id=trace_id,
+                    session_id=session_id,
+                    user_id=str(user_id),
+                    persona_db=(SupabasePersonaDB(_supabase) if (_supabase is not None and _is_uuid(str(user_id))) else None),
+                )
             )
+            pending.append(web_rag_task)
         except Exception:
-            web_ctx, web_sources, web_meta = (None, None, None)
+            web_rag_task = None
 
     preq = PersonaRequest(
         user_id=user_id,
@@ -2393,8 +2983,7 @@ async def persona_chat(req: ChatRequest, auth: Optional[AuthContext] = Depends(g
         except Exception:
             pass
 
-        # 直近スナップショットから状態を復元（初回は default）
-        init_states = await _load_supabase_initial_states(persona_db=persona_db, user_id=user_id)
+        # 直近スナップショット（常駐 state があればそれ）から状態を復元（初回は default）
         init_value = init_states.get("value") if isinstance(init_states.get("value"), ValueState) else ValueState()
         init_trait = init_states.get("trait") if isinstance(init_states.get("trait"), TraitState) else TraitState()
         init_ego: Optional[EgoContinuityState] = None
@@ -2443,32 +3032,8 @@ async def persona_chat(req: ChatRequest, auth: Optional[AuthContext] = Depends(g
             initial_temporal_identity_state=init_tid,
         )
 
-        # Safety は復元状態を使って評価
+        # Safety は復元状態（= controller の初期状態）を使って handle_turn_async 内で並列評価
         safety_layer = _get_safety_layer(embedding_model=embedding_model)
-        safety = safety_layer.assess(
-            req=preq,
-            value_state=init_value,
-            trait_state=init_trait,
-            memory=None,
-        )
-
-        # Safety 監査ログ（任意）
-        try:
-            _supabase.insert(
-                "common_safety_assessments",
-                {
-                    "trace_id": trace_id,
-                    "user_id": user_id,
-                    "session_id": session_id,
-                    "safety_flag": safety.safety_flag,
-                    "risk_score": float(safety.risk_score),
-                    "categories": safety.categories,
-                    "reasons": safety.reasons,
-                    "meta": safety.meta,
-                },
-            )
-        except Exception:
-            pass
 
     else:
         persona_db = _persona_db
@@ -2484,21 +3049,6 @@ async def persona_chat(req: ChatRequest, auth: Optional[AuthContext] = Depends(g
         # in-memory デモでは「まず追えること」を優先して簡易判定にする。
         llm_client = _get_llm_client()
         safety_layer = _get_safety_layer(embedding_model=llm_client)
-        safety = safety_layer.assess(
-            req=preq,
-            value_state=ValueState(),
-            trait_state=TraitState(),
-            memory=None,
-        )
-
-    # SafetyLayer の数値メタを controller 側でも参照できるように注入
-    try:
-        if isinstance(getattr(preq, "metadata", None), dict):
-            preq.metadata["_safety_risk_score"] = float(getattr(safety, "risk_score", 0.0) or 0.0)
-            preq.metadata["_safety_flag"] = getattr(safety, "safety_flag", None)
-            preq.metadata["_safety_categories"] = getattr(safety, "categories", {}) or {}
-    except Exception:
-        pass
 
     trace_event(
         log,
@@ -2510,19 +3060,55 @@ async def persona_chat(req: ChatRequest, auth: Optional[AuthContext] = Depends(g
             "message_len": len(effective_message or ""),
             "message_preview": preview_text(effective_message) if TRACE_INCLUDE_TEXT else "",
             "overload_score": overload_score,
-            "safety_flag": safety.safety_flag,
-            "risk_score": safety.risk_score,
+            "web_rag_pending": web_rag_task is not None,
         },
     )
 
-    result = controller.handle_turn(
+    async def _web_rag_context() -> Dict[str, Any]:
+        nonlocal web_ctx, web_sources, web_meta
+        try:
+            web_ctx, web_sources, web_meta = await web_rag_task  # type: ignore[misc]
+        except Exception:
+            web_ctx, web_sources, web_meta = (None, None, None)
+        return {
+            **({"_external_knowledge": web_ctx} if isinstance(web_ctx, str) and web_ctx.strip() else {}),
+            **({"_web_rag_sources": web_sources} if isinstance(web_sources, list) and web_sources else {}),
+            **({"_web_rag_meta": web_meta} if isinstance(web_meta, dict) and web_meta else {}),
+        }
+
+    # memory selection / SafetyLayer / Web RAG は互いに独立なので並列に走らせる
+    # （並列 safety が失敗したときは controller が生成前に同期で再評価する）
+    _resident_before_turn(preq, user_id=user_id)
+    result = await controller.handle_turn_async(
         preq,
         user_id=user_id,
-        safety_flag=safety.safety_flag,
+        safety_layer=safety_layer,
         overload_score=overload_score,
         reward_signal=req.reward_signal,
         affect_signal=req.affect_signal,
+        external_context=(_web_rag_context() if web_rag_task is not None else None),
     )
+    resident_meta = _resident_after_turn(controller, preq, user_id=user_id, trace_id=trace_id, session_id=session_id)
+    safety = result.safety
+
+    # Safety 監査ログ（任意）: 応答をブロックしないよう永続化キューへ
+    if _supabase is not None:
+        audit_row = {
+            "trace_id": trace_id,
+            "user_id": user_id,
+            "session_id": session_id,
+            "safety_flag": safety.safety_flag,
+            "risk_score": float(safety.risk_score),
+            "categories": safety.categories,
+            "reasons": safety.reasons,
+            "meta": safety.meta,
+        }
+        sb = _supabase
+        get_persistence_queue().submit(
+            lambda: sb.insert("common_safety_assessments", audit_row, returning="minimal"),
+            label="safety_assessment",
+            wait=False,  # イベントループ上なので、満杯でも待たずに落とす
+        )
 
     v0 = _normalize_v0(trace_id=trace_id, controller_meta=result.meta)
     decision_candidates = _normalize_decision_candidates(controller_meta=result.meta, v0=v0)
@@ -2577,6 +3163,8 @@ async def persona_chat(req: ChatRequest, auth: Optional[AuthContext] = Depends(g
         },
         "phase04": phase04_meta,
     }
+    if resident_meta:
+        meta["resident_state"] = resident_meta
 
     # Web RAG observability (best-effort; safe to expose)
     try:
@@ -2634,6 +3222,8 @@ async def persona_chat(req: ChatRequest, auth: Optional[AuthContext] = Depends(g
         event="persona_chat.completed",
         fields={
             "timing_ms": meta["timing_ms"],
+            "safety_flag": safety.safety_flag,
+            "critical_path": ((result.meta or {}).get("async_stages") or {}).get("critical_path"),
             "reply_len": len(result.reply_text or ""),
             "global_state": meta["global_state"].get("state"),
             "memory_pointer_count": meta["memory"].get("initial_pointer_count")
@@ -2645,462 +3235,814 @@ async def persona_chat(req: ChatRequest, auth: Optional[AuthContext] = Depends(g
     return ChatResponse(reply=result.reply_text, meta=meta)
 
 
+# =========================================================
+# Streaming pipeline (/persona/chat/stream)
+# - 同期の handle_turn_stream は専用スレッドで回し、delta を asyncio.Queue 経由で event loop へ渡す
+# - start はリクエスト直後に送る（memory / safety / web RAG 等の前処理はその後ろで実行）
+# - 待ち時間中は heartbeat（event: ping）を送る（プロキシのアイドル切断対策）
+# - delta は flush 粒度（文字数 / 時間）でまとめて送れる
+# - TTFB / inter-token latency を meta["stream"] に記録する
+#
+# Env:
+# - SIGMARIS_STREAM_WORKERS        (default 32; 同時ストリーム数の上限)
+# - SIGMARIS_STREAM_HEARTBEAT_SEC  (default 10; <=0 で無効)
+# - SIGMARIS_STREAM_FLUSH_CHARS    (default 0; >0 でその文字数までまとめて送る。0 は delta ごとに即送信)
+# - SIGMARIS_STREAM_FLUSH_MS       (default 40; まとめ送り時の最大保留時間)
+# =========================================================
+
+_stream_workers = _env_int("SIGMARIS_STREAM_WORKERS", 32)
+_stream_workers = max(2, min(256, _stream_workers))
+_STREAM_POOL: ThreadPoolExecutor = ThreadPoolExecutor(max_workers=_stream_workers)
+
+_stream_heartbeat_sec = _env_float("SIGMARIS_STREAM_HEARTBEAT_SEC", 10.0)
+_stream_flush_chars = max(0, _env_int("SIGMARIS_STREAM_FLUSH_CHARS", 0))
+_stream_flush_ms = max(0.0, _env_float("SIGMARIS_STREAM_FLUSH_MS", 40.0))
+
+_STREAM_END = object()
+
+# /metrics 用（ワーカースレッドで回っている stream の数）
+_active_streams = 0
+_active_streams_lock = threading.Lock()
+
+
+class _ThreadedStream:
+    """
+    sync generator をワーカースレッドで回し、要素を asyncio.Queue に積む。
+    get(timeout) は要素 / _STREAM_END / None（タイムアウト）を返す。
+    クライアント切断時は close() で生成側を止める（LLM ストリームも閉じる）。
+    """
+
+    def __init__(self, make_gen) -> None:
+        self._make_gen = make_gen
+        self._loop = asyncio.get_running_loop()
+        self._queue: "asyncio.Queue[Any]" = asyncio.Queue()
+        self._stop = threading.Event()
+        self._getter: Optional["asyncio.Future[Any]"] = None
+        self._future = self._loop.run_in_executor(_STREAM_POOL, self._run)
+
+    def _put(self, item: Any) -> None:
+        try:
+            self._loop.call_soon_threadsafe(self._queue.put_nowait, item)
+        except RuntimeError:
+            # loop が閉じている（シャットダウン中）
+            self._stop.set()
+
+    def _run(self) -> None:
+        global _active_streams
+        gen = None
+        with _active_streams_lock:
+            _active_streams += 1
+        try:
+            gen = self._make_gen()
+            for item in gen:
+                if self._stop.is_set():
+                    break
+                self._put(item)
+        except BaseException as e:  # noqa: BLE001 - consumer 側で再送出する
+            self._put(e)
+        finally:
+            try:
+                if gen is not None and hasattr(gen, "close"):
+                    gen.close()
+            except Exception:
+                pass
+            with _active_streams_lock:
+                _active_streams -= 1
+            self._put(_STREAM_END)
+
+    async def get(self, timeout: Optional[float]) -> Any:
+        # getter はタイムアウトしても捨てずに使い回す（取りこぼし防止）
+        if self._getter is None:
+            self._getter = asyncio.ensure_future(self._queue.get())
+        done, _ = await asyncio.wait({self._getter}, timeout=timeout)
+        if not done:
+            return None
+        item = self._getter.result()
+        self._getter = None
+        if isinstance(item, BaseException):
+            raise item
+        return item
+
+    def close(self) -> None:
+        self._stop.set()
+        if self._getter is not None and not self._getter.done():
+            self._getter.cancel()
+
+
+class _StreamStats:
+    """TTFB / inter-token latency（サーバ送出時刻ベース）。"""
+
+    def __init__(self, t_request: float) -> None:
+        self.t_request = t_request
+        self.t_start: Optional[float] = None
+        self.t_ready: Optional[float] = None
+        self.t_first_delta: Optional[float] = None
+        self.t_last_delta: Optional[float] = None
+        self.t_done: Optional[float] = None
+        self.gaps_ms: List[float] = []
+        self.deltas_in = 0
+        self.events_out = 0
+        self.chars = 0
+        self.heartbeats = 0
+
+    def on_delta_in(self) -> None:
+        self.deltas_in += 1
+
+    def on_flush(self, n_chars: int) -> None:
+        now = time.perf_counter()
+        if self.t_first_delta is None:
+            self.t_first_delta = now
+            metrics.STREAM_TTFB_SECONDS.observe(now - self.t_request)
+        elif self.t_last_delta is not None:
+            self.gaps_ms.append((now - self.t_last_delta) * 1000.0)
+            metrics.STREAM_GAP_SECONDS.observe(now - self.t_last_delta)
+        self.t_last_delta = now
+        self.events_out += 1
+        self.chars += int(n_chars)
+
+    def _ms(self, t: Optional[float], base: Optional[float] = None) -> Optional[float]:
+        if t is None:
+            return None
+        b = self.t_request if base is None else base
+        return round((t - b) * 1000.0, 3)
+
+    def to_dict(self) -> Dict[str, Any]:
+        gaps = sorted(self.gaps_ms)
+        inter: Dict[str, Any] = {"count": len(gaps)}
+        if gaps:
+            inter.update(
+                {
+                    "mean_ms": round(sum(gaps) / len(gaps), 3),
+                    "p50_ms": round(gaps[len(gaps) // 2], 3),
+                    "p95_ms": round(gaps[min(len(gaps) - 1, int(len(gaps) * 0.95))], 3),
+                    "max_ms": round(gaps[-1], 3),
+                }
+            )
+        return {
+            "start_ms": self._ms(self.t_start),
+            "prepare_ms": self._ms(self.t_ready),
+            "ttfb_ms": self._ms(self.t_first_delta),
+            "generation_ms": (
+                self._ms(self.t_last_delta, self.t_first_delta)
+                if self.t_first_delta is not None and self.t_last_delta is not None
+                else None
+            ),
+            "post_generation_ms": (
+                self._ms(self.t_done, self.t_last_delta)
+                if self.t_done is not None and self.t_last_delta is not None
+                else None
+            ),
+            "inter_token": inter,
+            "deltas_in": int(self.deltas_in),
+            "events_out": int(self.events_out),
+            "chars": int(self.chars),
+            "heartbeats": int(self.heartbeats),
+            "flush": {"chars": int(_stream_flush_chars), "ms": float(_stream_flush_ms)},
+        }
+
+
 @app.post("/persona/chat/stream")
 async def persona_chat_stream(req: ChatRequest, auth: Optional[AuthContext] = Depends(get_auth_context)):
     """
     SSE streaming version of /persona/chat.
+    - event: start -> data: {"trace_id": "...", "session_id": "..."}（前処理より先に送る）
+    - event: ping  -> data: {"trace_id": "..."}（heartbeat; 無視してよい）
     - event: delta -> data: {"text": "..."}
-    - event: done  -> data: {"reply": "...", "meta": {...}}
+    - event: done  -> data: {"reply": "...", "meta": {...}}（meta.stream に TTFB / inter-token latency）
     """
 
     trace_id = new_trace_id()
     t0 = time.time()
+    t_perf0 = time.perf_counter()
 
     user_id = (auth.user_id if auth is not None else (req.user_id or DEFAULT_USER_ID))
     session_id = req.session_id or f"{user_id}:{uuid.uuid4().hex}"
     effective_message, client_history = _derive_message_and_history(req)
     external_system = _merge_external_system(req.persona_system, req.system)
-    attachments_ctx = _build_attachments_context(attachments=req.attachments, auth=auth)
+    attachments_ctx = await _build_attachments_context(attachments=req.attachments, auth=auth)
     if attachments_ctx:
         effective_message = (effective_message + "\n\n" + attachments_ctx).strip()
 
-    overload_score = _estimate_overload_score(effective_message)
-
-    # Intent Router (core-side)
-    try:
-        from persona_core.intent_router import classify_intent
-
-        intent = classify_intent(effective_message)
-    except Exception:
-        intent = "general"
-
-    # Fallback: explicit search requests should still trigger Web RAG when enabled.
-    try:
-        if intent == "general" and _web_rag_enabled() and _web_rag_explicit_request(effective_message):
-            intent = "realtime_fact"
-    except Exception:
-        pass
+    # in-memory wiring の失敗は従来どおり 500 で返す（ストリーム開始前に判定）
+    inmemory_controller: Optional[PersonaController] = None
+    if _supabase is None:
+        try:
+            inmemory_controller = _get_inmemory_controller()
+        except RuntimeError as e:
+            raise HTTPException(status_code=500, detail=str(e))
 
-    web_ctx = None
-    web_sources = None
-    web_meta = None
+    async def _prepare_turn() -> Dict[str, Any]:
+        overload_score = _estimate_overload_score(effective_message)
 
-    tool_weather = None
-    tool_comparison = None
-    personalization_hint: Optional[Dict[str, Any]] = None
+        # 状態ロード（Supabase）は Intent / Web RAG と独立なので先に走らせておく
+        persona_db_early = SupabasePersonaDB(_supabase) if _supabase is not None else None
+        init_task = (
+            asyncio.ensure_future(_load_supabase_initial_states(persona_db=persona_db_early, user_id=user_id))
+            if persona_db_early is not None
+            else None
+        )
 
-    if intent == "weather":
+        # Intent Router (core-side)
         try:
-            from persona_core.phase04.tools.weather_api import weather_api_flow
+            from persona_core.intent_router import classify_intent
 
-            tool_weather = weather_api_flow(effective_message)
-            web_ctx = (
-                "External Tool Context (weather_api).\n"
-                "Usage rules:\n"
-                "- Use this as supporting evidence.\n\n"
-                "tool.weather:\n"
-                + json.dumps(tool_weather, ensure_ascii=False, separators=(",", ":"))
-            )
-            web_sources = []
-            web_meta = {"intent": "weather", "provider": "weather_api"}
+            intent = classify_intent(effective_message)
         except Exception:
-            tool_weather = None
-            web_ctx, web_sources, web_meta = (None, None, None)
-    elif intent == "comparison":
+            intent = "general"
+
+        # Fallback: explicit search requests should still trigger Web RAG when enabled.
         try:
-            from persona_core.phase04.tools.comparison_flow import comparison_flow
+            if intent == "general" and _web_rag_enabled() and _web_rag_explicit_request(effective_message):
+                intent = "realtime_fact"
+        except Exception:
+            pass
 
-            tool_comparison = comparison_flow(effective_message)
+        web_ctx = None
+        web_sources = None
+        web_meta = None
 
-            safe = {}
-            try:
-                if isinstance(tool_comparison, dict):
-                    ia = tool_comparison.get("item_a") if isinstance(tool_comparison.get("item_a"), dict) else None
-                    ib = tool_comparison.get("item_b") if isinstance(tool_comparison.get("item_b"), dict) else None
-                    safe = {
-                        "item_a": {
-                            "name": (ia or {}).get("name"),
-                            "summary": ((ia or {}).get("result") or {}).get("summary") if isinstance((ia or {}).get("result"), dict) else None,
-                            "key_points": ((ia or {}).get("result") or {}).get("key_points") if isinstance((ia or {}).get("result"), dict) else None,
-                        },
-                        "item_b": {
-                            "name": (ib or {}).get("name"),
-                            "summary": ((ib or {}).get("result") or {}).get("summary") if isinstance((ib or {}).get("result"), dict) else None,
-                            "key_points": ((ib or {}).get("result") or {}).get("key_points") if isinstance((ib or {}).get("result"), dict) else None,
-                        },
-                        "differences": tool_comparison.get("differences") if isinstance(tool_comparison.get("differences"), list) else [],
-                    }
-            except Exception:
-                safe = {}
+        tool_weather = None
+        tool_comparison = None
+        personalization_hint: Optional[Dict[str, Any]] = None
 
-            web_ctx = (
-                "External Tool Context (comparison_flow).\n"
-                "Usage rules:\n"
-                "- Use this as supporting evidence.\n"
-                "- Do NOT invent specs not present.\n\n"
-                "tool.comparison:\n"
-                + json.dumps(safe, ensure_ascii=False, separators=(",", ":"))
-            )
-            web_sources = []
-            web_meta = {"intent": "comparison", "provider": "comparison_flow"}
-        except Exception:
-            tool_comparison = None
-            web_ctx, web_sources, web_meta = (None, None, None)
-    elif intent == "personalized_realtime":
-        try:
-            forced_gen: Optional[Dict[str, Any]] = None
+        if intent == "weather":
             try:
-                g0 = req.gen if isinstance(req.gen, dict) else {}
-                forced_gen = dict(g0)
-                web_cfg = forced_gen.get("web_rag")
-                if isinstance(web_cfg, dict):
-                    forced_gen["web_rag"] = {**web_cfg, "enabled": True}
-                else:
-                    forced_gen["web_rag"] = {"enabled": True}
+                from persona_core.phase04.tools.weather_api import weather_api_flow
+
+                tool_weather = await _to_thread(weather_api_flow, effective_message)
+                web_ctx = (
+                    "External Tool Context (weather_api).\n"
+                    "Usage rules:\n"
+                    "- Use this as supporting evidence.\n\n"
+                    "tool.weather:\n"
+                    + json.dumps(tool_weather, ensure_ascii=False, separators=(",", ":"))
+                )
+                web_sources = []
+                web_meta = {"intent": "weather", "provider": "weather_api"}
             except Exception:
-                forced_gen = (req.gen if isinstance(req.gen, dict) else None)
+                tool_weather = None
+                web_ctx, web_sources, web_meta = (None, None, None)
+        elif intent == "comparison":
+            try:
+                from persona_core.phase04.tools.comparison_flow import comparison_flow
 
-            web_ctx, web_sources, web_meta = await _maybe_web_rag_for_turn(
-                message=effective_message,
-                gen=forced_gen,
-                trace_id=trace_id,
-                session_id=session_id,
-                user_id=str(user_id),
-                persona_db=(SupabasePersonaDB(_supabase) if (_supabase is not None and _is_uuid(str(user_id))) else None),
-            )
-        except Exception:
-            web_ctx, web_sources, web_meta = (None, None, None)
+                tool_comparison = await _to_thread(comparison_flow, effective_message)
 
-        try:
-            hint_profile: Dict[str, Any] = {"user_id": str(user_id)}
-            if _supabase is not None and _is_uuid(str(user_id)):
+                safe = {}
                 try:
-                    persona_db2 = SupabasePersonaDB(_supabase)
-                    vs = persona_db2.load_last_value_state(user_id=str(user_id))
-                    ts = persona_db2.load_last_trait_state(user_id=str(user_id))
-                    if vs is not None:
-                        hint_profile["value_state"] = vs.to_dict()
-                    if ts is not None:
-                        hint_profile["trait_state"] = ts.to_dict()
+                    if isinstance(tool_comparison, dict):
+                        ia = tool_comparison.get("item_a") if isinstance(tool_comparison.get("item_a"), dict) else None
+                        ib = tool_comparison.get("item_b") if isinstance(tool_comparison.get("item_b"), dict) else None
+                        safe = {
+                            "item_a": {
+                                "name": (ia or {}).get("name"),
+                                "summary": ((ia or {}).get("result") or {}).get("summary") if isinstance((ia or {}).get("result"), dict) else None,
+                                "key_points": ((ia or {}).get("result") or {}).get("key_points") if isinstance((ia or {}).get("result"), dict) else None,
+                            },
+                            "item_b": {
+                                "name": (ib or {}).get("name"),
+                                "summary": ((ib or {}).get("result") or {}).get("summary") if isinstance((ib or {}).get("result"), dict) else None,
+                                "key_points": ((ib or {}).get("result") or {}).get("key_points") if isinstance((ib or {}).get("result"), dict) else None,
+                            },
+                            "differences": tool_comparison.get("differences") if isinstance(tool_comparison.get("differences"), list) else [],
+                        }
                 except Exception:
-                    pass
-
-            project_type: Optional[str] = None
-            try:
-                if isinstance(req.gen, dict):
-                    for k in ("project_type", "app", "channel", "client"):
-                        v = req.gen.get(k)
-                        if isinstance(v, str) and v.strip():
-                            project_type = v.strip()
-                            break
+                    safe = {}
+
+                web_ctx = (
+                    "External Tool Context (comparison_flow).\n"
+                    "Usage rules:\n"
+                    "- Use this as supporting evidence.\n"
+                    "- Do NOT invent specs not present.\n\n"
+                    "tool.comparison:\n"
+                    + json.dumps(safe, ensure_ascii=False, separators=(",", ":"))
+                )
+                web_sources = []
+                web_meta = {"intent": "comparison", "provider": "comparison_flow"}
             except Exception:
-                project_type = None
-
-            personalization_hint = {
-                "user_profile": hint_profile,
-                "project_type": project_type,
-            }
-        except Exception:
-            personalization_hint = None
-    elif intent == "realtime_fact":
-        try:
-            forced_gen: Optional[Dict[str, Any]] = None
+                tool_comparison = None
+                web_ctx, web_sources, web_meta = (None, None, None)
+        elif intent == "personalized_realtime":
             try:
-                g0 = req.gen if isinstance(req.gen, dict) else {}
-                forced_gen = dict(g0)
-                web_cfg = forced_gen.get("web_rag")
-                if isinstance(web_cfg, dict):
-                    forced_gen["web_rag"] = {**web_cfg, "enabled": True}
-                else:
-                    forced_gen["web_rag"] = {"enabled": True}
+                forced_gen: Optional[Dict[str, Any]] = None
+                try:
+                    g0 = req.gen if isinstance(req.gen, dict) else {}
+                    forced_gen = dict(g0)
+                    web_cfg = forced_gen.get("web_rag")
+                    if isinstance(web_cfg, dict):
+                        forced_gen["web_rag"] = {**web_cfg, "enabled": True}
+                    else:
+                        forced_gen["web_rag"] = {"enabled": True}
+                except Exception:
+                    forced_gen = (req.gen if isinstance(req.gen, dict) else None)
+
+                web_ctx, web_sources, web_meta = await _maybe_web_rag_for_turn(
+                    message=effective_message,
+                    gen=forced_gen,
+                    trace_id=trace_id,
+                    session_id=session_id,
+                    user_id=str(user_id),
+                    persona_db=(SupabasePersonaDB(_supabase) if (_supabase is not None and _is_uuid(str(user_id))) else None),
+                )
             except Exception:
-                forced_gen = (req.gen if isinstance(req.gen, dict) else None)
+                web_ctx, web_sources, web_meta = (None, None, None)
 
-            web_ctx, web_sources, web_meta = await _maybe_web_rag_for_turn(
-                message=effective_message,
-                gen=forced_gen,
-                trace_id=trace_id,
-                session_id=session_id,
-                user_id=str(user_id),
-                persona_db=(SupabasePersonaDB(_supabase) if (_supabase is not None and _is_uuid(str(user_id))) else None),
-            )
-        except Exception:
-            web_ctx, web_sources, web_meta = (None, None, None)
+            try:
+                hint_profile: Dict[str, Any] = {"user_id": str(user_id)}
+                if _supabase is not None and _is_uuid(str(user_id)):
+                    try:
+                        persona_db2 = SupabasePersonaDB(_supabase)
+                        vs = await _to_thread(persona_db2.load_last_value_state, user_id=str(user_id))
+                        ts = await _to_thread(persona_db2.load_last_trait_state, user_id=str(user_id))
+                        if vs is not None:
+                            hint_profile["value_state"] = vs.to_dict()
+                        if ts is not None:
+                            hint_profile["trait_state"] = ts.to_dict()
+                    except Exception:
+                        pass
 
-    preq = PersonaRequest(
-        user_id=user_id,
-        session_id=session_id,
-        message=effective_message,
-        context={
-            "_trace_id": trace_id,
-            "_intent": intent,
-            **({"_personalization_hint": personalization_hint} if isinstance(personalization_hint, dict) and personalization_hint else {}),
-            **({"_tool_weather": tool_weather} if isinstance(tool_weather, dict) and tool_weather else {}),
-            **({"_comparison": tool_comparison} if isinstance(tool_comparison, dict) and tool_comparison else {}),
-            **({"character_id": req.character_id} if req.character_id else {}),
-            **({"persona_system": external_system} if external_system else {}),
-            **({"_external_knowledge": web_ctx} if isinstance(web_ctx, str) and web_ctx.strip() else {}),
-            **({"_web_rag_sources": web_sources} if isinstance(web_sources, list) and web_sources else {}),
-            **({"_web_rag_meta": web_meta} if isinstance(web_meta, dict) and web_meta else {}),
-            **({"gen": req.gen} if isinstance(req.gen, dict) and req.gen else {}),
-            **({"client_history": client_history} if client_history else {}),
-        },
-    )
+                project_type: Optional[str] = None
+                try:
+                    if isinstance(req.gen, dict):
+                        for k in ("project_type", "app", "channel", "client"):
+                            v = req.gen.get(k)
+                            if isinstance(v, str) and v.strip():
+                                project_type = v.strip()
+                                break
+                except Exception:
+                    project_type = None
 
-    phase04_db: Any = None
+                personalization_hint = {
+                    "user_profile": hint_profile,
+                    "project_type": project_type,
+                }
+            except Exception:
+                personalization_hint = None
+        elif intent == "realtime_fact":
+            try:
+                forced_gen: Optional[Dict[str, Any]] = None
+                try:
+                    g0 = req.gen if isinstance(req.gen, dict) else {}
+                    forced_gen = dict(g0)
+                    web_cfg = forced_gen.get("web_rag")
+                    if isinstance(web_cfg, dict):
+                        forced_gen["web_rag"] = {**web_cfg, "enabled": True}
+                    else:
+                        forced_gen["web_rag"] = {"enabled": True}
+                except Exception:
+                    forced_gen = (req.gen if isinstance(req.gen, dict) else None)
 
-    baseline_from_client: Optional[TraitState] = None
-    try:
-        if isinstance(req.trait_baseline, dict):
-            baseline_from_client = TraitState(
-                calm=float(req.trait_baseline.get("calm", 0.5)),
-                empathy=float(req.trait_baseline.get("empathy", 0.5)),
-                curiosity=float(req.trait_baseline.get("curiosity", 0.5)),
-            )
-    except Exception:
-        baseline_from_client = None
+                web_ctx, web_sources, web_meta = await _maybe_web_rag_for_turn(
+                    message=effective_message,
+                    gen=forced_gen,
+                    trace_id=trace_id,
+                    session_id=session_id,
+                    user_id=str(user_id),
+                    persona_db=(SupabasePersonaDB(_supabase) if (_supabase is not None and _is_uuid(str(user_id))) else None),
+                )
+            except Exception:
+                web_ctx, web_sources, web_meta = (None, None, None)
 
-    # wire controller (same as /persona/chat)
-    if _supabase is not None:
-        llm_client = _get_llm_client()
-        embedding_model = llm_client
-        persona_db = SupabasePersonaDB(_supabase)
-        phase04_db = persona_db
-        init_states = await _load_supabase_initial_states(persona_db=persona_db, user_id=user_id)
+        preq = PersonaRequest(
+            user_id=user_id,
+            session_id=session_id,
+            message=effective_message,
+            context={
+                "_trace_id": trace_id,
+                "_intent": intent,
+                **({"_personalization_hint": personalization_hint} if isinstance(personalization_hint, dict) and personalization_hint else {}),
+                **({"_tool_weather": tool_weather} if isinstance(tool_weather, dict) and tool_weather else {}),
+                **({"_comparison": tool_comparison} if isinstance(tool_comparison, dict) and tool_comparison else {}),
+                **({"character_id": req.character_id} if req.character_id else {}),
+                **({"persona_system": external_system} if external_system else {}),
+                **({"_external_knowledge": web_ctx} if isinstance(web_ctx, str) and web_ctx.strip() else {}),
+                **({"_web_rag_sources": web_sources} if isinstance(web_sources, list) and web_sources else {}),
+                **({"_web_rag_meta": web_meta} if isinstance(web_meta, dict) and web_meta else {}),
+                **({"gen": req.gen} if isinstance(req.gen, dict) and req.gen else {}),
+                **({"client_history": client_history} if client_history else {}),
+            },
+        )
 
-        # Phase02: operator overrides (best-effort)
-        try:
-            op = init_states.get("op")
-            payload = (op or {}).get("payload") if isinstance(op, dict) else None
-            if isinstance(payload, dict):
-                mode = payload.get("subjectivity_mode")
-                freeze = payload.get("freeze_updates")
-                if isinstance(mode, str) and mode.strip():
-                    preq.metadata["_operator_subjectivity_mode"] = mode.strip()
-                if isinstance(freeze, bool):
-                    preq.metadata["_freeze_updates"] = bool(preq.metadata.get("_freeze_updates") or freeze)
-        except Exception:
-            pass
+        phase04_db: Any = None
 
-        init_value = init_states.get("value") if isinstance(init_states.get("value"), ValueState) else ValueState()
-        init_trait = init_states.get("trait") if isinstance(init_states.get("trait"), TraitState) else TraitState()
-        init_ego: Optional[EgoContinuityState] = None
-        try:
-            st = init_states.get("ego")
-            if isinstance(st, dict):
-                init_ego = EgoContinuityState.from_dict(st)
-        except Exception:
-            init_ego = None
-        init_tid: Optional[TemporalIdentityState] = None
+        baseline_from_client: Optional[TraitState] = None
         try:
-            st = init_states.get("tid")
-            if isinstance(st, dict):
-                init_tid = TemporalIdentityState.from_dict(st)
+            if isinstance(req.trait_baseline, dict):
+                baseline_from_client = TraitState(
+                    calm=float(req.trait_baseline.get("calm", 0.5)),
+                    empathy=float(req.trait_baseline.get("empathy", 0.5)),
+                    curiosity=float(req.trait_baseline.get("curiosity", 0.5)),
+                )
         except Exception:
-            init_tid = None
-        episode_store = SupabaseEpisodeStore(_supabase, user_id=user_id, character_id=req.character_id)
+            baseline_from_client = None
 
-        selective_recall = SelectiveRecall(memory_backend=episode_store, embedding_model=embedding_model)
-        ambiguity_resolver = AmbiguityResolver(embedding_model=embedding_model)
-        episode_merger = EpisodeMerger(memory_backend=episode_store)
-        memory_orchestrator = MemoryOrchestrator(
-            selective_recall=selective_recall,
-            episode_merger=episode_merger,
-            ambiguity_resolver=ambiguity_resolver,
-        )
+        # wire controller (same as /persona/chat)
+        if _supabase is not None:
+            llm_client = _get_llm_client()
+            embedding_model = llm_client
+            persona_db = persona_db_early
+            phase04_db = persona_db
+            init_states = await init_task
 
-        controller = PersonaController(
-            config=PersonaControllerConfig(default_user_id=None),
-            memory_orchestrator=memory_orchestrator,
-            identity_engine=IdentityContinuityEngineV3(),
-            value_engine=ValueDriftEngine(),
-            trait_engine=TraitDriftEngine(),
-            global_fsm=GlobalStateMachine(),
-            episode_store=episode_store,
-            persona_db=persona_db,
-            llm_client=llm_client,
-            initial_value_state=init_value,
-            initial_trait_state=init_trait,
-            initial_trait_baseline=baseline_from_client or init_trait,
-            initial_ego_state=init_ego,
-            initial_temporal_identity_state=init_tid,
-        )
+            # Phase02: operator overrides (best-effort)
+            try:
+                op = init_states.get("op")
+                payload = (op or {}).get("payload") if isinstance(op, dict) else None
+                if isinstance(payload, dict):
+                    mode = payload.get("subjectivity_mode")
+                    freeze = payload.get("freeze_updates")
+                    if isinstance(mode, str) and mode.strip():
+                        preq.metadata["_operator_subjectivity_mode"] = mode.strip()
+                    if isinstance(freeze, bool):
+                        preq.metadata["_freeze_updates"] = bool(preq.metadata.get("_freeze_updates") or freeze)
+            except Exception:
+                pass
 
-        safety_layer = _get_safety_layer(embedding_model=embedding_model)
-        safety = safety_layer.assess(
-            req=preq,
-            value_state=init_value,
-            trait_state=init_trait,
-            memory=None,
-        )
+            init_value = init_states.get("value") if isinstance(init_states.get("value"), ValueState) else ValueState()
+            init_trait = init_states.get("trait") if isinstance(init_states.get("trait"), TraitState) else TraitState()
+            init_ego: Optional[EgoContinuityState] = None
+            try:
+                st = init_states.get("ego")
+                if isinstance(st, dict):
+                    init_ego = EgoContinuityState.from_dict(st)
+            except Exception:
+                init_ego = None
+            init_tid: Optional[TemporalIdentityState] = None
+            try:
+                st = init_states.get("tid")
+                if isinstance(st, dict):
+                    init_tid = TemporalIdentityState.from_dict(st)
+            except Exception:
+                init_tid = None
+            episode_store = SupabaseEpisodeStore(_supabase, user_id=user_id, character_id=req.character_id)
+
+            selective_recall = SelectiveRecall(memory_backend=episode_store, embedding_model=embedding_model)
+            ambiguity_resolver = AmbiguityResolver(embedding_model=embedding_model)
+            episode_merger = EpisodeMerger(memory_backend=episode_store)
+            memory_orchestrator = MemoryOrchestrator(
+                selective_recall=selective_recall,
+                episode_merger=episode_merger,
+                ambiguity_resolver=ambiguity_resolver,
+            )
 
-    else:
-        try:
-            controller = _get_inmemory_controller()
-        except RuntimeError as e:
-            raise HTTPException(status_code=500, detail=str(e))
+            controller = PersonaController(
+                config=PersonaControllerConfig(default_user_id=None),
+                memory_orchestrator=memory_orchestrator,
+                identity_engine=IdentityContinuityEngineV3(),
+                value_engine=ValueDriftEngine(),
+                trait_engine=TraitDriftEngine(),
+                global_fsm=GlobalStateMachine(),
+                episode_store=episode_store,
+                persona_db=persona_db,
+                llm_client=llm_client,
+                initial_value_state=init_value,
+                initial_trait_state=init_trait,
+                initial_trait_baseline=baseline_from_client or init_trait,
+                initial_ego_state=init_ego,
+                initial_temporal_identity_state=init_tid,
+            )
 
-        llm_client = _get_llm_client()
-        safety_layer = _get_safety_layer(embedding_model=llm_client)
-        safety = safety_layer.assess(
-            req=preq,
-            value_state=ValueState(),
-            trait_state=TraitState(),
-            memory=None,
-        )
-        phase04_db = None
+            safety_layer = _get_safety_layer(embedding_model=embedding_model)
+            safety = await safety_layer.assess_async(
+                req=preq,
+                value_state=init_value,
+                trait_state=init_trait,
+                memory=None,
+            )
 
-    # SafetyLayer の数値メタを controller 側でも参照できるように注入
-    try:
-        if isinstance(getattr(preq, "metadata", None), dict):
-            preq.metadata["_safety_risk_score"] = float(getattr(safety, "risk_score", 0.0) or 0.0)
-            preq.metadata["_safety_flag"] = getattr(safety, "safety_flag", None)
-            preq.metadata["_safety_categories"] = getattr(safety, "categories", {}) or {}
-    except Exception:
-        pass
+        else:
+            controller = inmemory_controller
+
+            llm_client = _get_llm_client()
+            safety_layer = _get_safety_layer(embedding_model=llm_client)
+            safety = await safety_layer.assess_async(
+                req=preq,
+                value_state=ValueState(),
+                trait_state=TraitState(),
+                memory=None,
+            )
+            phase04_db = None
+
+        # SafetyLayer の数値メタを controller 側でも参照できるように注入
+        try:
+            if isinstance(getattr(preq, "metadata", None), dict):
+                preq.metadata["_safety_risk_score"] = float(getattr(safety, "risk_score", 0.0) or 0.0)
+                preq.metadata["_safety_flag"] = getattr(safety, "safety_flag", None)
+                preq.metadata["_safety_categories"] = getattr(safety, "categories", {}) or {}
+        except Exception:
+            pass
+
+        return {
+            "preq": preq,
+            "controller": controller,
+            "safety": safety,
+            "phase04_db": phase04_db,
+            "overload_score": overload_score,
+            "web_ctx": web_ctx,
+            "web_sources": web_sources,
+            "web_meta": web_meta,
+        }
 
     def _sse(event: str, data: Any) -> str:
         payload = json.dumps(data, ensure_ascii=False)
         return f"event: {event}\ndata: {payload}\n\n"
 
-    def event_stream():
+    async def event_stream():
+        stats = _StreamStats(t_perf0)
+        hb = float(_stream_heartbeat_sec)
+        prep_task: Optional["asyncio.Future[Dict[str, Any]]"] = None
+        phase04_task: Optional["asyncio.Future[Any]"] = None
+        stream: Optional[_ThreadedStream] = None
         try:
-            # start (trace id)
+            # start (trace id): 前処理より先に送って first byte を早める
             yield _sse("start", {"trace_id": trace_id, "session_id": session_id})
+            stats.t_start = time.perf_counter()
+            last_out = stats.t_start
+
+            # ---- pre-generation (memory は controller 側 / safety・web RAG・状態ロードはここ) ----
+            prep_task = asyncio.ensure_future(_prepare_turn())
+            while True:
+                done_set, _ = await asyncio.wait({prep_task}, timeout=(hb if hb > 0 else None))
+                if done_set:
+                    break
+                stats.heartbeats += 1
+                last_out = time.perf_counter()
+                yield _sse("ping", {"trace_id": trace_id})
+            prepared = prep_task.result()
+            stats.t_ready = time.perf_counter()
+
+            preq = prepared["preq"]
+            controller = prepared["controller"]
+            safety = prepared["safety"]
+            phase04_db = prepared["phase04_db"]
+            web_ctx = prepared["web_ctx"]
+            web_sources = prepared["web_sources"]
+            web_meta = prepared["web_meta"]
+
+            def _run_phase04() -> Any:
+                rt = get_phase04_runtime()
+                return rt.run_for_turn(
+                    user_id=user_id,
+                    session_id=session_id,
+                    message=effective_message,
+                    trace_id=trace_id,
+                    persist=phase04_db,
+                    attachments=req.attachments if isinstance(req.attachments, list) else None,
+                )
 
-            reply_parts: List[str] = []
-            for ev in controller.handle_turn_stream(
-                preq,
-                user_id=user_id,
-                safety_flag=safety.safety_flag,
-                overload_score=overload_score,
-                reward_signal=req.reward_signal,
-                affect_signal=req.affect_signal,
-                defer_persistence=True,
-            ):
-                if ev.get("type") == "delta":
+            _resident_before_turn(preq, user_id=user_id)
+            stream = _ThreadedStream(
+                lambda: controller.handle_turn_stream(
+                    preq,
+                    user_id=user_id,
+                    safety_flag=safety.safety_flag,
+                    overload_score=prepared["overload_score"],
+                    reward_signal=req.reward_signal,
+                    affect_signal=req.affect_signal,
+                    defer_persistence=True,
+                )
+            )
+
+            buf: List[str] = []
+            buf_chars = 0
+            buf_since = 0.0
+            flush_sec = float(_stream_flush_ms) / 1000.0
+            result: Any = None
+
+            while True:
+                now = time.perf_counter()
+                waits: List[float] = []
+                if hb > 0:
+                    waits.append(max(0.0, hb - (now - last_out)))
+                if buf:
+                    waits.append(max(0.0, flush_sec - (now - buf_since)))
+                ev = await stream.get(min(waits) if waits else None)
+                now = time.perf_counter()
+
+                if ev is _STREAM_END:
+                    break
+
+                if ev is not None and ev.get("type") == "delta":
                     text = str(ev.get("text") or "")
                     if text:
-                        reply_parts.append(text)
-                        yield _sse("delta", {"text": text})
-                elif ev.get("type") == "done":
+                        stats.on_delta_in()
+                        if not buf:
+                            buf_since = now
+                        buf.append(text)
+                        buf_chars += len(text)
+                        # phase04 は応答本文に依存しないので、生成中に並行して走らせる
+                        if phase04_task is None:
+                            phase04_task = asyncio.ensure_future(_to_thread(_run_phase04))
+                elif ev is not None and ev.get("type") == "done":
                     result = ev.get("result")
-                    reply_text = (getattr(result, "reply_text", None) or "").strip()
 
-                    v0 = _normalize_v0(trace_id=trace_id, controller_meta=getattr(result, "meta", None))
-                    decision_candidates = _normalize_decision_candidates(
-                        controller_meta=getattr(result, "meta", None), v0=v0
-                    )
+                # flush: 即時モード / 文字数到達 / 保留時間超過 / done 到着
+                if buf and (
+                    _stream_flush_chars <= 0
+                    or buf_chars >= _stream_flush_chars
+                    or (now - buf_since) >= flush_sec
+                    or result is not None
+                ):
+                    out = "".join(buf)
+                    buf.clear()
+                    buf_chars = 0
+                    stats.on_flush(len(out))
+                    last_out = time.perf_counter()
+                    yield _sse("delta", {"text": out})
+                elif ev is None and hb > 0 and (now - last_out) >= hb:
+                    stats.heartbeats += 1
+                    last_out = now
+                    yield _sse("ping", {"trace_id": trace_id})
+
+            if result is None:
+                raise RuntimeError("stream ended without result")
+            resident_meta = _resident_after_turn(
+                controller, preq, user_id=user_id, trace_id=trace_id, session_id=session_id
+            )
 
-                    meta: Dict[str, Any] = {
-                        "meta_version": META_VERSION,
-                        "engine_version": ENGINE_VERSION,
-                        "build_sha": str(BUILD_SHA),
-                        "config_hash": str(CONFIG_HASH),
-                        "trace_id": trace_id,
-                        "intent": v0.get("intent") or {},
-                        "dialogue_state": v0.get("dialogue_state") or "UNKNOWN",
-                        "telemetry": v0.get("telemetry") or {"C": 0.0, "N": 0.0, "M": 0.0, "S": 0.0, "R": 0.0},
-                        "decision_candidates": decision_candidates,
-                        "timing_ms": int((time.time() - t0) * 1000),
-                        "safety": {
-                            "flag": safety.safety_flag,
-                            "risk_score": safety.risk_score,
-                            "total_risk": float((v0.get("safety") or {}).get("total_risk") or 0.0),
-                            "override": bool((v0.get("safety") or {}).get("override") or False),
-                            "categories": safety.categories,
-                            "reasons": safety.reasons,
-                        },
-                        "memory": result.memory.raw,
-                        "identity": result.identity.identity_context,
-                        "value": {
-                            "state": result.value.new_state.to_dict(),
-                            "delta": result.value.delta,
-                        },
-                        "trait": {
-                            "state": result.trait.new_state.to_dict(),
-                            "delta": result.trait.delta,
-                            "baseline": (result.meta or {}).get("trait_baseline"),
-                            "baseline_delta": (result.meta or {}).get("trait_baseline_delta"),
-                        },
-                        "global_state": result.global_state.to_dict(),
-                        "v0": v0,
-                        "controller_meta": result.meta,
-                        "io": {
-                            "message_preview": preview_text(effective_message) if TRACE_INCLUDE_TEXT else "",
-                            "reply_preview": preview_text(reply_text) if TRACE_INCLUDE_TEXT else "",
-                        },
-                        "phase04": None,
-                    }
+            # ---- post-generation: 最後の delta 送出後（クライアントは既に読み始めている） ----
+            reply_text = (getattr(result, "reply_text", None) or "").strip()
 
-                    try:
-                        rt = get_phase04_runtime()
-                        meta["phase04"] = rt.run_for_turn(
-                            user_id=user_id,
-                            session_id=session_id,
-                            message=effective_message,
-                            trace_id=trace_id,
-                            persist=phase04_db,
-                            attachments=req.attachments if isinstance(req.attachments, list) else None,
-                        )
-                    except Exception:
-                        meta["phase04"] = {"error": "phase04_failed"}
+            v0 = _normalize_v0(trace_id=trace_id, controller_meta=getattr(result, "meta", None))
+            decision_candidates = _normalize_decision_candidates(
+                controller_meta=getattr(result, "meta", None), v0=v0
+            )
 
-                    persona_runtime = _extract_persona_runtime_meta(req.gen)
-                    if persona_runtime:
-                        meta["persona_runtime"] = persona_runtime
+            meta: Dict[str, Any] = {
+                "meta_version": META_VERSION,
+                "engine_version": ENGINE_VERSION,
+                "build_sha": str(BUILD_SHA),
+                "config_hash": str(CONFIG_HASH),
+                "trace_id": trace_id,
+                "intent": v0.get("intent") or {},
+                "dialogue_state": v0.get("dialogue_state") or "UNKNOWN",
+                "telemetry": v0.get("telemetry") or {"C": 0.0, "N": 0.0, "M": 0.0, "S": 0.0, "R": 0.0},
+                "decision_candidates": decision_candidates,
+                "timing_ms": int((time.time() - t0) * 1000),
+                "safety": {
+                    "flag": safety.safety_flag,
+                    "risk_score": safety.risk_score,
+                    "total_risk": float((v0.get("safety") or {}).get("total_risk") or 0.0),
+                    "override": bool((v0.get("safety") or {}).get("override") or False),
+                    "categories": safety.categories,
+                    "reasons": safety.reasons,
+                },
+                "memory": result.memory.raw,
+                "identity": result.identity.identity_context,
+                "value": {
+                    "state": result.value.new_state.to_dict(),
+                    "delta": result.value.delta,
+                },
+                "trait": {
+                    "state": result.trait.new_state.to_dict(),
+                    "delta": result.trait.delta,
+                    "baseline": (result.meta or {}).get("trait_baseline"),
+                    "baseline_delta": (result.meta or {}).get("trait_baseline_delta"),
+                },
+                "global_state": result.global_state.to_dict(),
+                "v0": v0,
+                "controller_meta": result.meta,
+                "io": {
+                    "message_preview": preview_text(effective_message) if TRACE_INCLUDE_TEXT else "",
+                    "reply_preview": preview_text(reply_text) if TRACE_INCLUDE_TEXT else "",
+                },
+                "phase04": None,
+            }
+            if resident_meta:
+                meta["resident_state"] = resident_meta
 
-                    # Web RAG observability (best-effort; safe to expose)
-                    try:
-                        sources_out: List[Dict[str, Any]] = []
-                        try:
-                            if isinstance(web_sources, list):
-                                for idx, s in enumerate(web_sources, start=1):
-                                    if not isinstance(s, dict):
-                                        continue
-                                    u = str(s.get("final_url") or s.get("url") or "").strip()
-                                    if not u:
-                                        continue
-                                    sources_out.append(
-                                        {
-                                            "id": int(idx),
-                                            "title": str(s.get("title") or "").strip(),
-                                            "url": u,
-                                            "confidence": float(s.get("confidence")) if isinstance(s.get("confidence"), (int, float)) else None,
-                                        }
-                                    )
-                        except Exception:
-                            sources_out = []
-
-                        meta["web_rag"] = {
-                            "enabled": bool(_web_rag_enabled()),
-                            "injected": bool(isinstance(web_ctx, str) and web_ctx.strip()),
-                            "sources_count": int(len(web_sources)) if isinstance(web_sources, list) else 0,
-                            "meta": (web_meta if isinstance(web_meta, dict) else {}),
-                            "sources": sources_out,
-                        }
-                    except Exception:
-                        pass
+            try:
+                if phase04_task is None:
+                    phase04_task = asyncio.ensure_future(_to_thread(_run_phase04))
+                meta["phase04"] = await phase04_task
+            except Exception:
+                meta["phase04"] = {"error": "phase04_failed"}
 
-                    meta["meta_v1"] = {
-                        "trace_id": str(meta.get("trace_id") or trace_id),
-                        "intent": meta.get("intent") or {},
-                        "dialogue_state": str(meta.get("dialogue_state") or "UNKNOWN"),
-                        "telemetry": meta.get("telemetry")
-                        or {"C": 0.0, "N": 0.0, "M": 0.0, "S": 0.0, "R": 0.0},
-                        "safety": {
-                            "total_risk": float(((meta.get("safety") or {}).get("total_risk") or 0.0)),
-                            "override": bool(((meta.get("safety") or {}).get("override") or False)),
-                        },
-                        "decision_candidates": meta.get("decision_candidates") or [],
-                    }
+            persona_runtime = _extract_persona_runtime_meta(req.gen)
+            if persona_runtime:
+                meta["persona_runtime"] = persona_runtime
+
+            # Web RAG observability (best-effort; safe to expose)
+            try:
+                sources_out: List[Dict[str, Any]] = []
+                try:
+                    if isinstance(web_sources, list):
+                        for idx, s in enumerate(web_sources, start=1):
+                            if not isinstance(s, dict):
+                                continue
+                            u = str(s.get("final_url") or s.get("url") or "").strip()
+                            if not u:
+                                continue
+                            sources_out.append(
+                                {
+                                    "id": int(idx),
+                                    "title": str(s.get("title") or "").strip(),
+                                    "url": u,
+                                    "confidence": float(s.get("confidence")) if isinstance(s.get("confidence"), (int, float)) else None,
+                                }
+                            )
+                except Exception:
+                    sources_out = []
+
+                meta["web_rag"] = {
+                    "enabled": bool(_web_rag_enabled()),
+                    "injected": bool(isinstance(web_ctx, str) and web_ctx.strip()),
+                    "sources_count": int(len(web_sources)) if isinstance(web_sources, list) else 0,
+                    "meta": (web_meta if isinstance(web_meta, dict) else {}),
+                    "sources": sources_out,
+                }
+            except Exception:
+                pass
+
+            meta["meta_v1"] = {
+                "trace_id": str(meta.get("trace_id") or trace_id),
+                "intent": meta.get("intent") or {},
+                "dialogue_state": str(meta.get("dialogue_state") or "UNKNOWN"),
+                "telemetry": meta.get("telemetry")
+                or {"C": 0.0, "N": 0.0, "M": 0.0, "S": 0.0, "R": 0.0},
+                "safety": {
+                    "total_risk": float(((meta.get("safety") or {}).get("total_risk") or 0.0)),
+                    "override": bool(((meta.get("safety") or {}).get("override") or False)),
+                },
+                "decision_candidates": meta.get("decision_candidates") or [],
+            }
+
+            stats.t_done = time.perf_counter()
+            meta["stream"] = stats.to_dict()
+            trace_event(
+                log,
+                trace_id=trace_id,
+                event="persona_chat_stream.completed",
+                fields={
+                    "timing_ms": meta["timing_ms"],
+                    "safety_flag": safety.safety_flag,
+                    "ttfb_ms": meta["stream"].get("ttfb_ms"),
+                    "prepare_ms": meta["stream"].get("prepare_ms"),
+                    "inter_token_p95_ms": (meta["stream"].get("inter_token") or {}).get("p95_ms"),
+                    "events_out": meta["stream"].get("events_out"),
+                },
+            )
 
-                    yield _sse("done", {"reply": reply_text, "meta": meta})
+            yield _sse("done", {"reply": reply_text, "meta": meta})
         except Exception as e:
             log.exception("persona_chat_stream failed")
             yield _sse("error", {"error": str(e), "trace_id": trace_id})
+        finally:
+            # クライアント切断（cancel）時も生成スレッド・前処理を止める
+            if stream is not None:
+                stream.close()
+            if prep_task is not None and not prep_task.done():
+                prep_task.cancel()
+
+    return StreamingResponse(
+        event_stream(),
+        media_type="text/event-stream",
+        headers={"Cache-Control": "no-cache", "X-Accel-Buffering": "no"},
+    )
+
+
+def _dedup_response(hit: Dict[str, Any], sha: str) -> UploadResponse:
+    _UPLOADS_TOTAL.inc(outcome="deduplicated")
+    return UploadResponse(
+        attachment_id=str(hit.get("attachment_id") or ""),
+        file_name=str(hit.get("file_name") or ""),
+        mime_type=str(hit.get("mime_type") or "application/octet-stream"),
+        size=int(hit.get("size") or 0),
+        sha256=sha,
+        deduplicated=True,
+    )
+
+
+def _dedup_matches(hit: Optional[Dict[str, Any]], *, file_name: str, mime_type: str) -> bool:
+    # 同じ bytes でも名前 / mime が違えば別の attachment（返す file_name / mime をアップロードと一致させる）
+    return bool(
+        hit
+        and hit.get("attachment_id")
+        and str(hit.get("file_name") or "") == (file_name or "")
+        and str(hit.get("mime_type") or "application/octet-stream") == (mime_type or "application/octet-stream")
+    )
 
-    return StreamingResponse(event_stream(), media_type="text/event-stream")
+
+@app.get("/io/upload/sha256/{sha256}", response_model=UploadResponse)
+async def io_upload_lookup(
+    sha256: str,
+    file_name: str = "",
+    mime_type: str = "application/octet-stream",
+    auth: Optional[AuthContext] = Depends(get_auth_context),
+):
+    """
+    Upload pre-check: the caller's existing attachment with this content sha256 (and the same
+    file_name / mime_type), or 404. Clients call it before /io/upload to skip the body transfer.
+    """
+    if auth is None and _auth_required:
+        raise HTTPException(status_code=401, detail="Unauthorized")
+    sha = _normalize_sha256(sha256)
+    if not sha:
+        raise HTTPException(status_code=400, detail="invalid sha256")
+    hit = await _find_duplicate_upload(auth=auth, sha256=sha)
+    if not _dedup_matches(hit, file_name=file_name, mime_type=mime_type):
+        raise HTTPException(status_code=404, detail="not found")
+    return _dedup_response(hit or {}, sha)
 
 
 @app.post("/io/upload", response_model=UploadResponse)
@@ -3115,6 +4057,11 @@ async def io_upload(
     - If Supabase is configured, stores bytes in Supabase Storage and metadata in `common_attachments`.
     - Otherwise, stores to local disk (demo fallback).
     - Returns an attachment_id for subsequent /io/parse.
+    - Starlette spools the multipart body before this handler runs; _UploadSizeLimitMiddleware stops
+      oversized bodies (Content-Length, else running total) before they are spooled. The spooled file
+      is then copied in SIGMARIS_UPLOAD_CHUNK_BYTES chunks into our own spool, hashed on the way.
+    - Dedup: same user + same sha256 + same file_name / mime_type returns the existing attachment
+      (deduplicated=true). To skip the body transfer, check GET /io/upload/sha256/{sha256} first.
     """
     if auth is None and _auth_required:
         raise HTTPException(status_code=401, detail="Unauthorized")
@@ -3122,41 +4069,94 @@ async def io_upload(
     trace_id = str((x_sigmaris_trace_id or "").strip() or new_trace_id())
     session_id = str((x_sigmaris_session_id or "").strip() or "") or None
 
-    max_bytes = int(os.getenv("SIGMARIS_UPLOAD_MAX_BYTES", "5242880") or "5242880")  # 5MB
-    data = await file.read()
-    if len(data) > max_bytes:
-        raise HTTPException(status_code=413, detail="File too large")
-
-    attachment_id = uuid.uuid4().hex
+    max_bytes = _upload_max_bytes()
     file_name = file.filename or ""
     mime_type = file.content_type or "application/octet-stream"
 
-    sha256_hex = None
+    # Chunked ingestion: hash while spooling (memory up to SIGMARIS_UPLOAD_SPOOL_BYTES, then disk).
+    chunk_bytes = _upload_chunk_bytes()
+    spool_bytes = _env_int("SIGMARIS_UPLOAD_SPOOL_BYTES", 1048576)
+    spool = tempfile.SpooledTemporaryFile(max_size=max(0, spool_bytes))
+    hasher = hashlib.sha256()
+    size = 0
+    try:
+        while True:
+            chunk = await file.read(chunk_bytes)
+            if not chunk:
+                break
+            size += len(chunk)
+            if size > max_bytes:
+                _UPLOADS_TOTAL.inc(outcome="too_large")
+                raise HTTPException(status_code=413, detail="File too large")
+            hasher.update(chunk)
+            spool.write(chunk)
+        spool.seek(0)
+    except BaseException:
+        spool.close()
+        raise
+
+    sha256_hex = hasher.hexdigest()
     try:
-        sha256_hex = hashlib.sha256(data).hexdigest()
+        hit = await _find_duplicate_upload(auth=auth, sha256=sha256_hex)
+        if _dedup_matches(hit, file_name=file_name, mime_type=mime_type):
+            spool.close()
+            return _dedup_response(hit or {}, sha256_hex)
     except Exception:
-        sha256_hex = None
+        pass
+
+    attachment_id = uuid.uuid4().hex
+    try:
+        return await _store_upload(
+            spool=spool,
+            size=size,
+            sha256_hex=sha256_hex,
+            attachment_id=attachment_id,
+            file_name=file_name,
+            mime_type=mime_type,
+            auth=auth,
+            trace_id=trace_id,
+            session_id=session_id,
+        )
+    finally:
+        spool.close()
+
 
+async def _store_upload(
+    *,
+    spool: Any,
+    size: int,
+    sha256_hex: str,
+    attachment_id: str,
+    file_name: str,
+    mime_type: str,
+    auth: Optional[AuthContext],
+    trace_id: str,
+    session_id: Optional[str],
+) -> UploadResponse:
     # Prefer Supabase Storage when available.
     if _supabase is not None and _storage is not None and auth is not None:
         persona_db = SupabasePersonaDB(_supabase)
         object_path = f"{auth.user_id}/{attachment_id}"
         try:
-            _storage.upload(
+            # blocking urllib: off the event loop (the spool is streamed by http.client)
+            await _to_thread(
+                _storage.upload,
                 bucket_id=_storage_bucket,
                 object_path=object_path,
-                data=data,
+                data=spool,
                 content_type=mime_type,
                 upsert=True,
+                content_length=int(size),
             )
-            persona_db.insert_attachment(
+            await _to_thread(
+                persona_db.insert_attachment,
                 attachment_id=attachment_id,
                 user_id=auth.user_id,
                 bucket_id=_storage_bucket,
                 object_path=object_path,
                 file_name=file_name,
                 mime_type=mime_type,
-                size_bytes=int(len(data)),
+                size_bytes=int(size),
                 sha256=sha256_hex,
                 meta={},
             )
@@ -3170,7 +4170,7 @@ async def io_upload(
                         cache_key=None,
                         ok=True,
                         error=None,
-                        request={"file_name": file_name, "mime_type": mime_type, "size_bytes": int(len(data)), "sha256": sha256_hex},
+                        request={"file_name": file_name, "mime_type": mime_type, "size_bytes": int(size), "sha256": sha256_hex},
                         response={"attachment_id": attachment_id, "bucket_id": _storage_bucket, "object_path": object_path},
                         source_urls=[],
                         content_sha256=sha256_hex,
@@ -3189,7 +4189,7 @@ async def io_upload(
                         cache_key=None,
                         ok=False,
                         error=str(e),
-                        request={"file_name": file_name, "mime_type": mime_type, "size_bytes": int(len(data)), "sha256": sha256_hex},
+                        request={"file_name": file_name, "mime_type": mime_type, "size_bytes": int(size), "sha256": sha256_hex},
                         response={},
                         source_urls=[],
                         content_sha256=sha256_hex,
@@ -3199,42 +4199,57 @@ async def io_upload(
                 pass
             raise HTTPException(status_code=502, detail=f"storage upload failed: {e}")
 
+        _UPLOADS_TOTAL.inc(outcome="stored")
         return UploadResponse(
             attachment_id=attachment_id,
             file_name=file_name,
             mime_type=mime_type,
-            size=int(len(data)),
+            size=int(size),
+            sha256=sha256_hex,
         )
 
     # Demo fallback: local disk
-    base_dir = os.getenv("SIGMARIS_UPLOAD_DIR") or str(
-        Path(__file__).resolve().parents[2] / "data" / "uploads"
-    )
-    os.makedirs(base_dir, exist_ok=True)
+    base_dir = _upload_base_dir()
     path = os.path.join(base_dir, attachment_id)
     meta_path = path + ".json"
 
-    try:
-        with open(path, "wb") as f:
-            f.write(data)
+    def _write_local() -> None:
+        os.makedirs(base_dir, exist_ok=True)
+        # write to a temp name first so a half-written file is never visible under attachment_id
+        tmp_path = path + ".part"
+        with open(tmp_path, "wb") as f:
+            shutil.copyfileobj(spool, f, length=_upload_chunk_bytes())
+        os.replace(tmp_path, path)
         meta = {
             "attachment_id": attachment_id,
             "user_id": (auth.user_id if auth is not None else None),
             "file_name": file_name,
             "mime_type": mime_type,
-            "size": int(len(data)),
+            "size": int(size),
             "sha256": sha256_hex,
         }
         with open(meta_path, "w", encoding="utf-8", newline="\n") as f:
             json.dump(meta, f, ensure_ascii=False, separators=(",", ":"))
+        try:
+            dedup_path = _local_dedup_path(base_dir, str(auth.user_id) if auth is not None else "anon", sha256_hex)
+            os.makedirs(os.path.dirname(dedup_path), exist_ok=True)
+            with open(dedup_path, "w", encoding="utf-8") as f:
+                f.write(attachment_id)
+        except Exception:
+            pass
+
+    try:
+        await _to_thread(_write_local)
     except Exception as e:
         raise HTTPException(status_code=500, detail=f"upload failed: {e}")
 
+    _UPLOADS_TOTAL.inc(outcome="stored")
     return UploadResponse(
         attachment_id=attachment_id,
         file_name=file_name,
         mime_type=mime_type,
-        size=int(len(data)),
+        size=int(size),
+        sha256=sha256_hex,
     )
 
 
@@ -3247,6 +4262,9 @@ async def io_parse(
 ):
     """
     Phase04 MVP: parse uploaded content into bounded structured representations.
+    - Parse results are cached by content sha256 (SIGMARIS_PARSE_CACHE_*): a hit skips the download.
+    - Otherwise the object is streamed in chunks and parsed incrementally in the parse pool;
+      text stops once the excerpt is settled, markdown/code scan up to SIGMARIS_PARSE_SCAN_MAX_BYTES.
     """
     if auth is None and _auth_required:
         raise HTTPException(status_code=401, detail="Unauthorized")
@@ -3254,8 +4272,6 @@ async def io_parse(
     trace_id = str((x_sigmaris_trace_id or "").strip() or new_trace_id())
     session_id = str((x_sigmaris_session_id or "").strip() or "") or None
 
-    from persona_core.phase04.parsing.file_parser import parse_file_bytes  # local import to keep startup light
-
     # Prefer Supabase Storage when available.
     if _supabase is not None and _storage is not None and auth is not None:
         persona_db = SupabasePersonaDB(_supabase)
@@ -3274,8 +4290,21 @@ async def io_parse(
         if not object_path:
             raise HTTPException(status_code=500, detail="attachment missing object_path")
 
+        file_name = str(row.get("file_name") or "")
+        mime_type = str(row.get("mime_type") or "")
+        row_sha = _safe_str(row.get("sha256") or "") or None
+
+        owner_key = str(auth.user_id)
+        cached = _parse_cached(owner=owner_key, sha256=row_sha, file_name=file_name, mime_type=mime_type, kind=req.kind)
+        chunks: Optional[Iterable[bytes]] = None
         try:
-            data = _storage.download(bucket_id=bucket_id, object_path=object_path)
+            if cached is None:
+                chunks = await _to_thread(
+                    _storage.download_stream,
+                    bucket_id=bucket_id,
+                    object_path=object_path,
+                    chunk_size=_upload_chunk_bytes(),
+                )
         except (SupabaseStorageError, Exception) as e:
             try:
                 if _is_uuid(str(auth.user_id)):
@@ -3297,12 +4326,24 @@ async def io_parse(
                 pass
             raise HTTPException(status_code=502, detail=f"storage download failed: {e}")
 
-        parsed_kind, parsed = parse_file_bytes(
-            data=data,
-            file_name=str(row.get("file_name") or ""),
-            mime_type=str(row.get("mime_type") or ""),
-            kind=req.kind,
-        )
+        if cached is not None:
+            parsed_kind, parsed = cached
+        else:
+            opened = chunks if chunks is not None else iter(())
+            try:
+                parsed_kind, parsed = await _to_parse_pool(
+                    _parse_attachment,
+                    owner=owner_key,
+                    open_chunks=lambda: opened,
+                    file_name=file_name,
+                    mime_type=mime_type,
+                    kind=req.kind,
+                    size_bytes=row.get("size_bytes"),
+                    sha256=row_sha,
+                )
+            finally:
+                # 並行した parse が先に cache を埋めると open_chunks は呼ばれない: download はここで必ず閉じる
+                _close_quietly(chunks)
         try:
             if _is_uuid(str(auth.user_id)):
                 parsed_excerpt = ""
@@ -3336,9 +4377,7 @@ async def io_parse(
         return ParseResponse(ok=True, kind=parsed_kind, parsed=parsed)
 
     # Demo fallback: local disk
-    base_dir = os.getenv("SIGMARIS_UPLOAD_DIR") or str(
-        Path(__file__).resolve().parents[2] / "data" / "uploads"
-    )
+    base_dir = _upload_base_dir()
     path = os.path.join(base_dir, str(req.attachment_id))
     meta_path = path + ".json"
     if not os.path.exists(path):
@@ -3346,6 +4385,7 @@ async def io_parse(
 
     file_name = str(req.attachment_id)
     mime_type = "application/octet-stream"
+    meta: Dict[str, Any] = {}
     try:
         if os.path.exists(meta_path):
             with open(meta_path, "r", encoding="utf-8") as f:
@@ -3353,15 +4393,23 @@ async def io_parse(
             file_name = str(meta.get("file_name") or file_name)
             mime_type = str(meta.get("mime_type") or mime_type)
     except Exception:
-        pass
+        meta = {}
 
     try:
-        with open(path, "rb") as f:
-            data = f.read()
+        size = meta.get("size") if meta.get("size") is not None else os.path.getsize(path)
+        parsed_kind, parsed = await _to_parse_pool(
+            _parse_attachment,
+            owner=(str(auth.user_id) if auth is not None else "anon"),
+            open_chunks=lambda: _iter_file_chunks(path, _upload_chunk_bytes()),
+            file_name=file_name,
+            mime_type=mime_type,
+            kind=req.kind,
+            size_bytes=(int(size) if size is not None else None),
+            sha256=_safe_str(meta.get("sha256") or "") or None,
+        )
     except Exception as e:
         raise HTTPException(status_code=500, detail=f"parse failed: {e}")
 
-    parsed_kind, parsed = parse_file_bytes(data=data, file_name=file_name, mime_type=mime_type, kind=req.kind)
     return ParseResponse(ok=True, kind=parsed_kind, parsed=parsed)
 
 
@@ -3473,16 +4521,13 @@ async def io_attachment_get(
         },
     )
 
-@app.post("/io/web/search", response_model=WebSearchResponse)
-async def io_web_search(
+def _io_web_search_impl(
     req: WebSearchRequest,
-    auth: Optional[AuthContext] = Depends(get_auth_context),
-    x_sigmaris_trace_id: Optional[str] = Header(default=None, alias="x-sigmaris-trace-id"),
-    x_sigmaris_session_id: Optional[str] = Header(default=None, alias="x-sigmaris-session-id"),
-):
-    """
-    Phase04 MVP: web search via an explicit provider (no scraping).
-    """
+    auth: Optional[AuthContext],
+    x_sigmaris_trace_id: Optional[str],
+    x_sigmaris_session_id: Optional[str],
+) -> WebSearchResponse:
+    """Blocking body of /io/web/search (shared with /persona/turn-context)."""
     if auth is None and _auth_required:
         raise HTTPException(status_code=401, detail="Unauthorized")
 
@@ -3592,17 +4637,26 @@ async def io_web_search(
         raise HTTPException(status_code=502, detail=str(e))
 
 
-@app.post("/io/web/fetch", response_model=WebFetchResponse)
-async def io_web_fetch(
-    req: WebFetchRequest,
+@app.post("/io/web/search", response_model=WebSearchResponse)
+async def io_web_search(
+    req: WebSearchRequest,
     auth: Optional[AuthContext] = Depends(get_auth_context),
     x_sigmaris_trace_id: Optional[str] = Header(default=None, alias="x-sigmaris-trace-id"),
     x_sigmaris_session_id: Optional[str] = Header(default=None, alias="x-sigmaris-session-id"),
 ):
     """
-    Phase04: fetch a web page (allowlist required) and optionally summarize.
-    This endpoint is designed for public deployments: it includes SSRF guards.
+    Phase04 MVP: web search via an explicit provider (no scraping).
     """
+    return _io_web_search_impl(req, auth, x_sigmaris_trace_id, x_sigmaris_session_id)
+
+
+def _io_web_fetch_impl(
+    req: WebFetchRequest,
+    auth: Optional[AuthContext],
+    x_sigmaris_trace_id: Optional[str],
+    x_sigmaris_session_id: Optional[str],
+) -> WebFetchResponse:
+    """Blocking body of /io/web/fetch (shared with /persona/turn-context)."""
     if auth is None and _auth_required:
         raise HTTPException(status_code=401, detail="Unauthorized")
 
@@ -3847,6 +4901,20 @@ async def io_web_fetch(
     )
 
 
+@app.post("/io/web/fetch", response_model=WebFetchResponse)
+async def io_web_fetch(
+    req: WebFetchRequest,
+    auth: Optional[AuthContext] = Depends(get_auth_context),
+    x_sigmaris_trace_id: Optional[str] = Header(default=None, alias="x-sigmaris-trace-id"),
+    x_sigmaris_session_id: Optional[str] = Header(default=None, alias="x-sigmaris-session-id"),
+):
+    """
+    Phase04: fetch a web page (allowlist required) and optionally summarize.
+    This endpoint is designed for public deployments: it includes SSRF guards.
+    """
+    return _io_web_fetch_impl(req, auth, x_sigmaris_trace_id, x_sigmaris_session_id)
+
+
 @app.post("/io/web/rag", response_model=WebRagResponse)
 async def io_web_rag(
     req: WebRagRequest,
@@ -4017,13 +5085,13 @@ async def io_web_rag(
     return WebRagResponse(ok=True, context_text=context_text, sources=sources, meta=meta if isinstance(meta, dict) else {})
 
 
-@app.post("/io/github/repos", response_model=GitHubSearchResponse)
-async def io_github_repo_search(
+def _io_github_repo_search_impl(
     req: GitHubRepoSearchRequest,
-    auth: Optional[AuthContext] = Depends(get_auth_context),
-    x_sigmaris_trace_id: Optional[str] = Header(default=None, alias="x-sigmaris-trace-id"),
-    x_sigmaris_session_id: Optional[str] = Header(default=None, alias="x-sigmaris-session-id"),
-):
+    auth: Optional[AuthContext],
+    x_sigmaris_trace_id: Optional[str],
+    x_sigmaris_session_id: Optional[str],
+) -> GitHubSearchResponse:
+    """Blocking body of /io/github/repos (shared with /persona/turn-context)."""
     if auth is None and _auth_required:
         raise HTTPException(status_code=401, detail="Unauthorized")
 
@@ -4081,6 +5149,16 @@ async def io_github_repo_search(
         raise HTTPException(status_code=502, detail=str(e))
 
 
+@app.post("/io/github/repos", response_model=GitHubSearchResponse)
+async def io_github_repo_search(
+    req: GitHubRepoSearchRequest,
+    auth: Optional[AuthContext] = Depends(get_auth_context),
+    x_sigmaris_trace_id: Optional[str] = Header(default=None, alias="x-sigmaris-trace-id"),
+    x_sigmaris_session_id: Optional[str] = Header(default=None, alias="x-sigmaris-session-id"),
+):
+    return _io_github_repo_search_impl(req, auth, x_sigmaris_trace_id, x_sigmaris_session_id)
+
+
 @app.post("/io/github/code", response_model=GitHubSearchResponse)
 async def io_github_code_search(
     req: GitHubCodeSearchRequest,
@@ -4143,3 +5221,211 @@ async def io_github_code_search(
             except Exception:
                 pass
         raise HTTPException(status_code=502, detail=str(e))
+
+
+# =============================================================
+# Turn context batch (/persona/turn-context)
+# =============================================================
+
+# The UI gathers attachment parses + link analysis + auto browse before opening the chat stream.
+# This endpoint runs them concurrently in one round trip. /io/parse is awaited on the server loop;
+# the blocking web / GitHub bodies (_io_*_impl) run in _TURN_CONTEXT_POOL. An item past the deadline
+# is answered ok=false, but its worker thread finishes on its own (bounded by the provider timeouts).
+_turn_context_workers = max(1, min(32, _env_int("SIGMARIS_TURN_CONTEXT_WORKERS", 8)))
+_TURN_CONTEXT_POOL: ThreadPoolExecutor = ThreadPoolExecutor(
+    max_workers=_turn_context_workers, thread_name_prefix="turnctx"
+)
+
+_TURN_CONTEXT_MAX_ITEMS = 3
+
+_TURN_CONTEXT_TOTAL = metrics.REGISTRY.counter(
+    "sigmaris_turn_context_items_total",
+    "/persona/turn-context items by part (attachment / link / auto_browse) and outcome (ok / error / deadline).",
+    ("part", "outcome"),
+)
+_TURN_CONTEXT_SECONDS = metrics.REGISTRY.histogram(
+    "sigmaris_turn_context_duration_seconds", "/persona/turn-context item duration.", ("part",)
+)
+
+
+def _turn_context_deadline_sec(requested_ms: Optional[int]) -> float:
+    try:
+        cap_ms = float(os.getenv("SIGMARIS_TURN_CONTEXT_DEADLINE_MS", "8000") or "8000")
+    except Exception:
+        cap_ms = 8000.0
+    ms = cap_ms
+    if requested_ms is not None and int(requested_ms) > 0:
+        ms = min(cap_ms, float(requested_ms))
+    return max(0.1, ms / 1000.0)
+
+
+async def _run_io_handler(handler: Callable[..., Any], **kwargs: Any) -> Any:
+    return await asyncio.get_running_loop().run_in_executor(_TURN_CONTEXT_POOL, lambda: handler(**kwargs))
+
+
+def _io_result(value: Any) -> Dict[str, Any]:
+    if isinstance(value, BaseModel):
+        return value.model_dump()
+    return dict(value) if isinstance(value, dict) else {}
+
+
+def _io_error(e: BaseException) -> Dict[str, Any]:
+    if isinstance(e, HTTPException):
+        return {"ok": False, "status": int(e.status_code), "error": str(e.detail)}
+    return {"ok": False, "error": str(e) or type(e).__name__}
+
+
+def _github_repo_query_from_url(url: str) -> Optional[str]:
+    # keep parity with touhou-talk-ui retrieval.ts githubRepoQueryFromUrl
+    try:
+        from urllib.parse import urlsplit
+
+        u = urlsplit(url)
+        if u.hostname != "github.com":
+            return None
+        parts = [p for p in (u.path or "").split("/") if p]
+        if len(parts) >= 2:
+            return f"{parts[1]} user:{parts[0]}"
+        if parts:
+            return f"user:{parts[0]}"
+        return None
+    except Exception:
+        return None
+
+
+async def _turn_context_link(url: str, *, headers: Dict[str, Any]) -> Dict[str, Any]:
+    """github.com -> repo search; otherwise web fetch, falling back to web search (same order as the UI)."""
+    gh_q = _github_repo_query_from_url(url)
+    if gh_q:
+        r = await _run_io_handler(_io_github_repo_search_impl, req=GitHubRepoSearchRequest(query=gh_q, max_results=5), **headers)
+        return {"url": url, "ok": True, "provider": "github_repo_search", "response": _io_result(r)}
+
+    try:
+        f = _io_result(
+            await _run_io_handler(
+                _io_web_fetch_impl, req=WebFetchRequest(url=url, summarize=True, max_chars=12000), **headers
+            )
+        )
+    except Exception:
+        f = {}
+    if f and (isinstance(f.get("summary"), str) or isinstance(f.get("text_excerpt"), str)):
+        return {"url": url, "ok": True, "provider": "web_fetch", "response": f}
+
+    r = await _run_io_handler(_io_web_search_impl, req=WebSearchRequest(query=url, max_results=5), **headers)
+    return {"url": url, "ok": True, "provider": "web_search", "response": _io_result(r)}
+
+
+async def _turn_context_auto_browse(ab: TurnContextAutoBrowse, *, headers: Dict[str, Any]) -> Dict[str, Any]:
+    max_results = max(1, min(8, int(ab.max_results)))
+    sr = _io_result(
+        await _run_io_handler(
+            _io_web_search_impl,
+            req=WebSearchRequest(
+                query=ab.query,
+                max_results=max_results,
+                recency_days=ab.recency_days,
+                safe_search=ab.safe_search,
+                domains=ab.domains,
+            ),
+            **headers,
+        )
+    )
+    results = sr.get("results") if isinstance(sr.get("results"), list) else []
+    top_urls = [
+        str(x.get("url"))
+        for x in results[:max_results]
+        if isinstance(x, dict) and isinstance(x.get("url"), str) and x.get("url")
+    ][: max(0, min(_TURN_CONTEXT_MAX_ITEMS, int(ab.fetch_top)))]
+    fetched = await asyncio.gather(*(_turn_context_link(u, headers=headers) for u in top_urls), return_exceptions=True)
+    links = [
+        (item if not isinstance(item, BaseException) else {"url": u, **_io_error(item)})
+        for u, item in zip(top_urls, fetched)
+    ]
+    return {"ok": True, "query": ab.query, "response": sr, "links": links}
+
+
+@app.post("/persona/turn-context", response_model=TurnContextResponse)
+async def persona_turn_context(
+    req: TurnContextRequest,
+    auth: Optional[AuthContext] = Depends(get_auth_context),
+    x_sigmaris_trace_id: Optional[str] = Header(default=None, alias="x-sigmaris-trace-id"),
+    x_sigmaris_session_id: Optional[str] = Header(default=None, alias="x-sigmaris-session-id"),
+):
+    """
+    Batch of the pre-chat context calls (/io/parse per attachment, per-URL link analysis, auto browse).
+    - All items run concurrently; each item fails independently (ok=false + status/error).
+    - Items still running at the deadline are reported in timed_out and answered as ok=false.
+    - The raw /io/* responses are returned as-is; the client keeps its own shaping.
+    """
+    if auth is None and _auth_required:
+        raise HTTPException(status_code=401, detail="Unauthorized")
+
+    trace_id = str((x_sigmaris_trace_id or "").strip() or new_trace_id())
+    session_id = str((x_sigmaris_session_id or "").strip() or "") or None
+    headers: Dict[str, Any] = {"auth": auth, "x_sigmaris_trace_id": trace_id, "x_sigmaris_session_id": session_id}
+    started = time.perf_counter()
+    deadline = _turn_context_deadline_sec(req.deadline_ms)
+
+    async def timed(part: str, coro: Any) -> Any:
+        t0 = time.perf_counter()
+        try:
+            return await coro
+        finally:
+            _TURN_CONTEXT_SECONDS.observe(time.perf_counter() - t0, part=part)
+
+    async def parse_one(attachment_id: str) -> Dict[str, Any]:
+        r = await io_parse(req=ParseRequest(attachment_id=attachment_id, kind=None), **headers)
+        return {"attachment_id": attachment_id, "ok": True, "kind": r.kind, "parsed": r.parsed}
+
+    # (part, name, task)
+    jobs: List[Tuple[str, str, "asyncio.Task[Any]"]] = []
+    for aid in [str(a) for a in req.attachment_ids if str(a or "").strip()][:_TURN_CONTEXT_MAX_ITEMS]:
+        jobs.append(("attachment", aid, asyncio.ensure_future(timed("attachment", parse_one(aid)))))
+    for url in [str(u) for u in req.urls if str(u or "").strip()][:_TURN_CONTEXT_MAX_ITEMS]:
+        jobs.append(("link", url, asyncio.ensure_future(timed("link", _turn_context_link(url, headers=headers)))))
+    if req.auto_browse is not None and req.auto_browse.query.strip():
+        jobs.append(
+            (
+                "auto_browse",
+                req.auto_browse.query,
+                asyncio.ensure_future(timed("auto_browse", _turn_context_auto_browse(req.auto_browse, headers=headers))),
+            )
+        )
+
+    if jobs:
+        await asyncio.wait([t for _, _, t in jobs], timeout=deadline)
+
+    attachments: List[Dict[str, Any]] = []
+    links: List[Dict[str, Any]] = []
+    auto_browse: Optional[Dict[str, Any]] = None
+    timed_out: List[str] = []
+    for part, name, task in jobs:
+        key = "attachment_id" if part == "attachment" else ("query" if part == "auto_browse" else "url")
+        if not task.done():
+            # worker threads cannot be interrupted; their (cached) results simply go unused
+            task.cancel()
+            timed_out.append(f"{part}:{name}")
+            item: Dict[str, Any] = {key: name, "ok": False, "error": "deadline"}
+            outcome = "deadline"
+        elif task.exception() is not None:
+            item = {key: name, **_io_error(task.exception())}
+            outcome = "error"
+        else:
+            item = task.result()
+            outcome = "ok"
+        _TURN_CONTEXT_TOTAL.inc(part=part, outcome=outcome)
+        if part == "attachment":
+            attachments.append(item)
+        elif part == "link":
+            links.append(item)
+        else:
+            auto_browse = item
+
+    return TurnContextResponse(
+        ok=True,
+        attachments=attachments,
+        links=links,
+        auto_browse=auto_browse,
+        timed_out=timed_out,
+        elapsed_ms=round((time.perf_counter() - started) * 1000.0, 1),
+    )
@@ -0,0 +1,320 @@
+# gensokyo-persona-core/persona_core/state/resident_state.py
+# ----------------------------------------------------
+# ユーザーごとの常駐セッション状態（worker プロセス内）
+#
+# - 毎ターン Supabase から value / trait / ego / temporal identity を読み直す代わりに、
+#   直前ターンの結果を保持して次ターンの初期状態にする（miss のときだけ DB ロード）。
+# - 集約値（value / trait の EMA、直近 N ターンの trait 窓和）はターンごとに O(1) で更新する。
+# - LRU + idle TTL で追い出す。snapshot の書き込みを間引いている場合（snapshot_every > 1）、
+#   書いていないターンが残ったまま追い出される / shutdown するときに最新状態を write-back する。
+# - 常駐状態は DB の「鮮度マーカー」（最新 trait snapshot の trace_id + 最新 operator override の id）
+#   と一緒に持つ。使う前に呼び出し側でマーカーを読み直し、別 worker のターンや別 instance での
+#   operator override で DB が進んでいたら常駐状態を捨てて DB から読み直す（write-back もしない）。
+#   常駐状態が効くのは affinity routing で同じ worker に寄せている間（x-sigmaris-instance）。
+# ----------------------------------------------------
+
+from __future__ import annotations
+
+import threading
+import time
+from collections import deque
+from dataclasses import dataclass, field
+from typing import Any, Callable, Deque, Dict, Hashable, Optional, Sequence, Tuple
+
+from persona_core.ttl_cache import LRUTTLCache
+
+TRAIT_AXES: Tuple[str, ...] = ("calm", "empathy", "curiosity")
+VALUE_AXES: Tuple[str, ...] = ("stability", "openness", "safety_bias", "user_alignment")
+
+
+class WindowedMean:
+    """
+    直近 size 件の running sum。push / mean とも O(1)（窓から外れた分を引く）。
+    """
+
+    def __init__(self, size: int, axes: Sequence[str] = TRAIT_AXES) -> None:
+        self.size = max(1, int(size))
+        self.axes = tuple(axes)
+        self._rows: Deque[Tuple[float, ...]] = deque()
+        self._sums = [0.0] * len(self.axes)
+
+    def __len__(self) -> int:
+        return len(self._rows)
+
+    def push(self, values: Dict[str, Any]) -> None:
+        row = tuple(_f(values.get(k)) for k in self.axes)
+        self._rows.append(row)
+        for i, v in enumerate(row):
+            self._sums[i] += v
+        if len(self._rows) > self.size:
+            old = self._rows.popleft()
+            for i, v in enumerate(old):
+                self._sums[i] -= v
+
+    def mean(self) -> Dict[str, float]:
+        n = len(self._rows)
+        if n == 0:
+            return {k: 0.0 for k in self.axes}
+        return {k: round(self._sums[i] / n, 4) for i, k in enumerate(self.axes)}
+
+
+def _f(v: Any) -> float:
+    try:
+        return float(v or 0.0)
+    except Exception:
+        return 0.0
+
+
+def _ema(prev: Dict[str, float], cur: Dict[str, Any], axes: Sequence[str], alpha: float) -> Dict[str, float]:
+    if not prev:
+        return {k: _f(cur.get(k)) for k in axes}
+    return {k: prev.get(k, 0.0) + alpha * (_f(cur.get(k)) - prev.get(k, 0.0)) for k in axes}
+
+
+@dataclass
+class ResidentUserState:
+    """
+    value / trait / baseline は dict（to_dict 形）で持ち、呼び出し側で毎回新しい state を組み立てる
+    （controller が state を書き換えても常駐側には波及しない）。
+    """
+
+    user_id: str
+    value: Dict[str, float]
+    trait: Dict[str, float]
+    baseline: Optional[Dict[str, float]] = None
+    ego: Optional[Dict[str, Any]] = None
+    tid: Optional[Dict[str, Any]] = None
+    op: Any = None
+
+    turns: int = 0
+    # snapshot を書かずに進めたターン数（> 0 のまま追い出されたら write-back）
+    pending_turns: int = 0
+    persisted_value: Dict[str, float] = field(default_factory=dict)
+    persisted_trait: Dict[str, float] = field(default_factory=dict)
+    last_trace_id: Optional[str] = None
+    last_session_id: Optional[str] = None
+    # このエントリが反映している DB の鮮度マーカー（呼び出し側が定義。None は「不明 = 読み直す」）
+    db_marker: Any = None
+
+    value_ema: Dict[str, float] = field(default_factory=dict)
+    trait_ema: Dict[str, float] = field(default_factory=dict)
+    trait_window: WindowedMean = field(default_factory=lambda: WindowedMean(5))
+
+    loaded_at: float = field(default_factory=time.time)
+    updated_at: float = field(default_factory=time.time)
+
+    @property
+    def dirty(self) -> bool:
+        return self.pending_turns > 0
+
+    def observe(
+        self,
+        *,
+        value: Dict[str, float],
+        trait: Dict[str, float],
+        baseline: Optional[Dict[str, float]],
+        ego: Optional[Dict[str, Any]],
+        tid: Optional[Dict[str, Any]],
+        persisted: bool,
+        alpha: float,
+        trace_id: Optional[str] = None,
+        session_id: Optional[str] = None,
+    ) -> None:
+        self.value = dict(value)
+        self.trait = dict(trait)
+        if baseline is not None:
+            self.baseline = dict(baseline)
+        if ego is not None:
+            self.ego = ego
+        if tid is not None:
+            self.tid = tid
+
+        self.value_ema = _ema(self.value_ema, self.value, VALUE_AXES, alpha)
+        self.trait_ema = _ema(self.trait_ema, self.trait, TRAIT_AXES, alpha)
+        self.trait_window.push(self.trait)
+
+        self.turns += 1
+        if persisted:
+            self.mark_persisted()
+        else:
+            self.pending_turns += 1
+        self.last_trace_id = trace_id or self.last_trace_id
+        self.last_session_id = session_id or self.last_session_id
+        self.updated_at = time.time()
+
+    def mark_persisted(self) -> None:
+        self.pending_turns = 0
+        self.persisted_value = dict(self.value)
+        self.persisted_trait = dict(self.trait)
+
+    def delta_since_persisted(self) -> Tuple[Dict[str, float], Dict[str, float]]:
+        dv = {k: _f(self.value.get(k)) - _f(self.persisted_value.get(k)) for k in VALUE_AXES}
+        dt = {k: _f(self.trait.get(k)) - _f(self.persisted_trait.get(k)) for k in TRAIT_AXES}
+        return dv, dt
+
+    def aggregates(self) -> Dict[str, Any]:
+        return {
+            "turns": int(self.turns),
+            "pending_turns": int(self.pending_turns),
+            "value_ema": {k: round(v, 4) for k, v in self.value_ema.items()},
+            "trait_ema": {k: round(v, 4) for k, v in self.trait_ema.items()},
+            "trait_trend": self.trait_window.mean(),
+        }
+
+
+class ResidentStateStore:
+    """
+    user_id -> ResidentUserState（LRU + idle TTL）。
+
+    write_back は dirty なエントリが追い出されたとき（LRU 溢れ / TTL 切れ / invalidate / flush）に
+    呼ばれる。呼び出しはロック外・同期なので、重い処理は呼び出し側で PersistenceQueue へ投げること。
+    """
+
+    def __init__(
+        self,
+        *,
+        max_items: int,
+        idle_ttl_sec: float,
+        snapshot_every: int = 1,
+        ema_alpha: float = 0.2,
+        trend_window: int = 5,
+        write_back: Optional[Callable[[ResidentUserState], None]] = None,
+    ) -> None:
+        self.snapshot_every = max(1, int(snapshot_every))
+        self.ema_alpha = min(1.0, max(0.0, float(ema_alpha)))
+        self.trend_window = max(1, int(trend_window))
+        self._write_back = write_back
+        self._cache: LRUTTLCache[ResidentUserState] = LRUTTLCache(
+            max_items=max_items, ttl_sec=idle_ttl_sec, name="resident_state", on_evict=self._evicted
+        )
+        self._lock = threading.Lock()
+        self._write_backs = 0
+        self._write_back_failures = 0
+
+    @property
+    def enabled(self) -> bool:
+        return self._cache.enabled
+
+    @property
+    def name(self) -> str:
+        return self._cache.name
+
+    def get(self, user_id: str) -> Optional[ResidentUserState]:
+        return self._cache.get(user_id)
+
+    def adopt(
+        self,
+        user_id: str,
+        *,
+        value: Dict[str, float],
+        trait: Dict[str, float],
+        ego: Optional[Dict[str, Any]] = None,
+        tid: Optional[Dict[str, Any]] = None,
+        op: Any = None,
+        db_marker: Any = None,
+    ) -> Optional[ResidentUserState]:
+        """DB からロードした状態を常駐させる（DB にある状態なので clean）。"""
+        if not self.enabled:
+            return None
+        entry = ResidentUserState(
+            user_id=user_id,
+            value=dict(value),
+            trait=dict(trait),
+            ego=ego,
+            tid=tid,
+            op=op,
+            db_marker=db_marker,
+            trait_window=WindowedMean(self.trend_window),
+        )
+        entry.mark_persisted()
+        self._cache.put(user_id, entry)
+        return entry
+
+    def snapshot_due(self, user_id: str) -> bool:
+        """このターンで value / trait snapshot を書くべきか（常駐していなければ常に書く）。"""
+        if self.snapshot_every <= 1 or not self.enabled:
+            return True
+        entry = self._cache.peek(user_id)
+        return entry is None or (entry.pending_turns + 1) >= self.snapshot_every
+
+    def observe(
+        self,
+        user_id: str,
+        *,
+        value: Dict[str, float],
+        trait: Dict[str, float],
+        baseline: Optional[Dict[str, float]] = None,
+        ego: Optional[Dict[str, Any]] = None,
+        tid: Optional[Dict[str, Any]] = None,
+        persisted: bool = True,
+        trace_id: Optional[str] = None,
+        session_id: Optional[str] = None,
+    ) -> Optional[ResidentUserState]:
+        if not self.enabled:
+            return None
+        entry = self._cache.peek(user_id)
+        if entry is None:
+            # 追い出された直後のターン: 今回の結果から作り直す（次ターンは DB を読まない）
+            entry = ResidentUserState(user_id=user_id, value={}, trait={}, trait_window=WindowedMean(self.trend_window))
+        entry.observe(
+            value=value,
+            trait=trait,
+            baseline=baseline,
+            ego=ego,
+            tid=tid,
+            persisted=persisted,
+            alpha=self.ema_alpha,
+            trace_id=trace_id,
+            session_id=session_id,
+        )
+        self._cache.put(user_id, entry)
+        return entry
+
+    def invalidate(self, user_id: str, *, write_back: bool = True) -> None:
+        """
+        エントリを捨てる。write_back=False は外部から状態が書き換えられたとき（operator override 等）用で、
+        未保存分は書き戻さない（外部の値を優先する）。
+        """
+        entry = self._cache.pop(user_id)
+        if entry is not None and write_back:
+            self._evicted(user_id, entry)
+
+    def flush(self) -> int:
+        """dirty なエントリをすべて write-back する（shutdown 用）。エントリ自体は残す。"""
+        n = 0
+        for entry in self._cache.values():
+            if entry.dirty and self._do_write_back(entry):
+                entry.mark_persisted()
+                n += 1
+        return n
+
+    def _evicted(self, _key: Hashable, entry: ResidentUserState) -> None:
+        if entry.dirty:
+            self._do_write_back(entry)
+
+    def _do_write_back(self, entry: ResidentUserState) -> bool:
+        if self._write_back is None:
+            return False
+        try:
+            self._write_back(entry)
+            ok = True
+        except Exception:
+            ok = False
+        with self._lock:
+            if ok:
+                self._write_backs += 1
+            else:
+                self._write_back_failures += 1
+        return ok
+
+    def stats(self) -> Dict[str, Any]:
+        out = self._cache.stats()
+        with self._lock:
+            out.update(
+                {
+                    "snapshot_every": self.snapshot_every,
+                    "write_backs": self._write_backs,
+                    "write_back_failures": self._write_back_failures,
+                }
+            )
+        return out
@@ -0,0 +1,337 @@
+"""
+persona_core.storage.persistence_queue
+
+ターン後のスナップショット書き込み（Supabase 等）を処理する、バックグラウンド永続化パイプライン。
+
+- 固定数のワーカースレッド + 上限付きキュー（ターンごとにスレッドを増やさない）
+- 同一キー（例: ("kernel_state", user_id)）のジョブは、未処理のものを最新の内容で置き換えて 1 回にまとめる
+- scope（例: user_id）ごとに未完了ジョブ数を数え、wait_scope() で read-after-write の barrier にできる
+- キュー満杯時のポリシー: block（一定時間待つ → 溢れたら drop）/ drop_new / drop_oldest
+- depth / lag / failures などのメトリクスを metrics() で返す（/health で公開）
+
+Env:
+- SIGMARIS_PERSIST_QUEUE_MAX      (default 1024)
+- SIGMARIS_PERSIST_WORKERS        (default 4)
+- SIGMARIS_PERSIST_QUEUE_POLICY   (block | drop_new | drop_oldest, default block)
+- SIGMARIS_PERSIST_BLOCK_TIMEOUT_SEC (default 2.0; block ポリシーの最大待ち時間)
+"""
+
+from __future__ import annotations
+
+import os
+import threading
+import time
+from collections import deque
+from dataclasses import dataclass, field
+from typing import Any, Callable, Deque, Dict, Hashable, Optional
+
+from persona_core.trace import get_logger
+
+
+log = get_logger(__name__)
+
+_POLICIES = ("block", "drop_new", "drop_oldest")
+
+
+def _int_env(name: str, default: int) -> int:
+    try:
+        return int(os.getenv(name, str(default)) or str(default))
+    except Exception:
+        return default
+
+
+def _float_env(name: str, default: float) -> float:
+    try:
+        return float(os.getenv(name, str(default)) or str(default))
+    except Exception:
+        return default
+
+
+@dataclass
+class _Job:
+    fn: Callable[[], Any]
+    label: str
+    key: Optional[Hashable]
+    scope: Optional[Hashable] = None
+    enqueued_at: float = field(default_factory=time.monotonic)
+
+
+class PersistenceQueue:
+    """
+    上限付きキュー + 固定ワーカーの永続化パイプライン。
+
+    ジョブは引数なしの callable。例外はワーカー内で握りつぶし、failed としてカウントする
+    （呼び出し側＝ターン処理には決して伝播させない）。
+    """
+
+    def __init__(
+        self,
+        *,
+        max_size: int = 1024,
+        workers: int = 4,
+        policy: str = "block",
+        block_timeout_sec: float = 2.0,
+        name: str = "sigmaris-persist",
+    ) -> None:
+        self.max_size = max(1, int(max_size))
+        self.workers = max(1, int(workers))
+        self.policy = policy if policy in _POLICIES else "block"
+        self.block_timeout_sec = max(0.0, float(block_timeout_sec))
+        self._name = name
+
+        self._cond = threading.Condition()
+        self._jobs: Deque[_Job] = deque()
+        self._pending: Dict[Hashable, _Job] = {}
+        self._inflight = 0
+        self._running_keys: set = set()
+        self._scopes: Dict[Hashable, int] = {}
+        self._threads: list[threading.Thread] = []
+        self._stopped = False
+
+        # ---- metrics ----
+        self._submitted = 0
+        self._completed = 0
+        self._failed = 0
+        self._dropped = 0
+        self._coalesced = 0
+        self._lag_ms_last = 0.0
+        self._lag_ms_max = 0.0
+        self._last_error: Optional[str] = None
+        self._last_error_at: Optional[float] = None
+
+    # ---------------------------------------------------------
+    # submit
+    # ---------------------------------------------------------
+
+    def submit(
+        self,
+        fn: Callable[[], Any],
+        *,
+        label: str = "job",
+        key: Optional[Hashable] = None,
+        scope: Optional[Hashable] = None,
+        wait: bool = True,
+    ) -> bool:
+        """
+        ジョブを投入する。受理されたら True、ポリシーにより破棄されたら False。
+
+        wait=False は満杯時に block ポリシーでも待たずに破棄する（イベントループ上から呼ぶ場合）。
+
+        key を指定すると、同じ key の未処理ジョブがあればその中身を fn で置き換える（coalesce）。
+        キュー上の位置は元のジョブのまま（古い順序を崩さない）で、書き込む内容だけ最新になる。
+        scope を指定したジョブは、完了するまで wait_scope(scope) を待たせる。
+        """
+        with self._cond:
+            if self._stopped:
+                self._dropped += 1
+                return False
+            self._ensure_workers_locked()
+            self._submitted += 1
+
+            if key is not None:
+                existing = self._pending.get(key)
+                if existing is not None:
+                    existing.fn = fn
+                    existing.label = label
+                    self._coalesced += 1
+                    return True
+
+            if len(self._jobs) >= self.max_size:
+                if not self._make_room_locked(wait=wait):
+                    self._dropped += 1
+                    log.warning("persistence queue full; dropped job label=%s depth=%s", label, len(self._jobs))
+                    return False
+
+            job = _Job(fn=fn, label=label, key=key, scope=scope)
+            self._jobs.append(job)
+            if key is not None:
+                self._pending[key] = job
+            if scope is not None:
+                self._scopes[scope] = self._scopes.get(scope, 0) + 1
+            self._cond.notify_all()
+            return True
+
+    def _make_room_locked(self, *, wait: bool = True) -> bool:
+        if self.policy == "drop_new":
+            return False
+        if self.policy == "drop_oldest":
+            if not self._jobs:
+                return False
+            dropped = self._jobs.popleft()
+            self._forget_locked(dropped)
+            self._release_scope_locked(dropped)
+            self._dropped += 1
+            return True
+        # block: ワーカーが空けるのを待つ（上限時間付き）
+        if not wait:
+            return False
+        deadline = time.monotonic() + self.block_timeout_sec
+        while len(self._jobs) >= self.max_size and not self._stopped:
+            remaining = deadline - time.monotonic()
+            if remaining <= 0:
+                return False
+            self._cond.wait(remaining)
+        return not self._stopped
+
+    def _forget_locked(self, job: _Job) -> None:
+        if job.key is not None and self._pending.get(job.key) is job:
+            self._pending.pop(job.key, None)
+
+    def _release_scope_locked(self, job: _Job) -> None:
+        if job.scope is None:
+            return
+        n = self._scopes.get(job.scope, 0) - 1
+        if n > 0:
+            self._scopes[job.scope] = n
+        else:
+            self._scopes.pop(job.scope, None)
+
+    # ---------------------------------------------------------
+    # workers
+    # ---------------------------------------------------------
+
+    def _ensure_workers_locked(self) -> None:
+        if self._threads:
+            return
+        for i in range(self.workers):
+            t = threading.Thread(target=self._worker, name=f"{self._name}-{i}", daemon=True)
+            t.start()
+            self._threads.append(t)
+
+    def _take(self) -> Optional[_Job]:
+        with self._cond:
+            while True:
+                job = self._next_runnable_locked()
+                if job is not None:
+                    self._forget_locked(job)
+                    self._inflight += 1
+                    if job.key is not None:
+                        self._running_keys.add(job.key)
+                    lag_ms = (time.monotonic() - job.enqueued_at) * 1000.0
+                    self._lag_ms_last = lag_ms
+                    self._lag_ms_max = max(self._lag_ms_max, lag_ms)
+                    # block ポリシーで待っている submit を起こす
+                    self._cond.notify_all()
+                    return job
+                if self._stopped and not self._jobs:
+                    return None
+                self._cond.wait()
+
+    def _next_runnable_locked(self) -> Optional[_Job]:
+        # 同一キーのジョブは直列に実行する（古い upsert が新しいものを後から上書きしないように）
+        for i, job in enumerate(self._jobs):
+            if job.key is None or job.key not in self._running_keys:
+                del self._jobs[i]
+                return job
+        return None
+
+    def _worker(self) -> None:
+        while True:
+            job = self._take()
+            if job is None:
+                return
+            ok = True
+            err: Optional[str] = None
+            try:
+                job.fn()
+            except Exception as e:
+                ok = False
+                err = f"{job.label}: {type(e).__name__}: {e}"
+                log.exception("persistence job failed label=%s", job.label)
+            with self._cond:
+                self._inflight -= 1
+                if job.key is not None:
+                    self._running_keys.discard(job.key)
+                self._release_scope_locked(job)
+                if ok:
+                    self._completed += 1
+                else:
+                    self._failed += 1
+                    self._last_error = err[:300] if err else None
+                    self._last_error_at = time.time()
+                self._cond.notify_all()
+
+    # ---------------------------------------------------------
+    # lifecycle / observability
+    # ---------------------------------------------------------
+
+    def flush(self, timeout_sec: Optional[float] = None) -> bool:
+        """キューが空かつ実行中ジョブがなくなるまで待つ（テスト/シャットダウン用）。"""
+        deadline = None if timeout_sec is None else time.monotonic() + float(timeout_sec)
+        with self._cond:
+            while self._jobs or self._inflight > 0:
+                if deadline is None:
+                    self._cond.wait()
+                    continue
+                remaining = deadline - time.monotonic()
+                if remaining <= 0:
+                    return False
+                self._cond.wait(remaining)
+            return True
+
+    def wait_scope(self, scope: Hashable, timeout_sec: Optional[float] = None) -> bool:
+        """
+        scope の未完了ジョブ（キュー上 + 実行中）がなくなるまで待つ。
+        次ターンが DB から状態を読み直す前に、前ターンの書き込みを追い越さないようにするための barrier。
+        """
+        deadline = None if timeout_sec is None else time.monotonic() + float(timeout_sec)
+        with self._cond:
+            while self._scopes.get(scope, 0) > 0:
+                if deadline is None:
+                    self._cond.wait()
+                    continue
+                remaining = deadline - time.monotonic()
+                if remaining <= 0:
+                    return False
+                self._cond.wait(remaining)
+            return True
+
+    def shutdown(self, *, drain: bool = True, timeout_sec: Optional[float] = 10.0) -> None:
+        if drain:
+            self.flush(timeout_sec)
+        with self._cond:
+            self._stopped = True
+            self._cond.notify_all()
+
+    def metrics(self) -> Dict[str, Any]:
+        with self._cond:
+            oldest_ms = 0.0
+            if self._jobs:
+                oldest_ms = (time.monotonic() - self._jobs[0].enqueued_at) * 1000.0
+            return {
+                "depth": len(self._jobs),
+                "inflight": int(self._inflight),
+                "max_size": int(self.max_size),
+                "workers": int(self.workers),
+                "policy": self.policy,
+                "submitted": int(self._submitted),
+                "completed": int(self._completed),
+                "failed": int(self._failed),
+                "dropped": int(self._dropped),
+                "coalesced": int(self._coalesced),
+                "scopes_pending": len(self._scopes),
+                "lag_ms_last": round(self._lag_ms_last, 3),
+                "lag_ms_max": round(self._lag_ms_max, 3),
+                "oldest_pending_ms": round(oldest_ms, 3),
+                "last_error": self._last_error,
+                "last_error_at": self._last_error_at,
+            }
+
+
+_QUEUE: Optional[PersistenceQueue] = None
+_QUEUE_LOCK = threading.Lock()
+
+
+def get_persistence_queue() -> PersistenceQueue:
+    """プロセス共有の PersistenceQueue（環境変数で設定）。"""
+    global _QUEUE
+    if _QUEUE is None:
+        with _QUEUE_LOCK:
+            if _QUEUE is None:
+                _QUEUE = PersistenceQueue(
+                    max_size=max(1, min(100000, _int_env("SIGMARIS_PERSIST_QUEUE_MAX", 1024))),
+                    workers=max(1, min(64, _int_env("SIGMARIS_PERSIST_WORKERS", 4))),
+                    policy=(os.getenv("SIGMARIS_PERSIST_QUEUE_POLICY", "block") or "block").strip().lower(),
+                    block_timeout_sec=_float_env("SIGMARIS_PERSIST_BLOCK_TIMEOUT_SEC", 2.0),
+                )
+    return _QUEUE
@@ -1,12 +1,19 @@
 from __future__ import annotations
 
+import http.client
 import json
 import os
+import queue
+import threading
+import time
+import base64
 import urllib.parse
 import urllib.request
 from dataclasses import dataclass
 from typing import Any, Dict, List, Optional, Tuple
 
+from persona_core import metrics
+
 
 class SupabaseRESTError(RuntimeError):
     pass
@@ -36,24 +43,167 @@ class SupabaseConfig:
         return SupabaseConfig(url=url, service_role_key=key, schema=schema)
 
 
+# 再利用した keep-alive 接続がサーバ側で閉じられていた場合に出る例外
+# （新しい接続で 1 度だけ再送する。ただし送信後 = getresponse() 中の切断は
+#   サーバが処理・コミット済みの可能性があるので、冪等なメソッドに限る）
+_STALE_CONNECTION_ERRORS = (
+    http.client.RemoteDisconnected,
+    http.client.CannotSendRequest,
+    ConnectionResetError,
+    BrokenPipeError,
+)
+
+_IDEMPOTENT_METHODS = frozenset({"GET", "HEAD", "PUT", "DELETE", "OPTIONS"})
+
+
+class _KeepAliveConnectionPool:
+    """
+    http.client の keep-alive 接続プール（依存なし）。
+
+    - 接続は 1 度に 1 スレッドだけが使う（acquire → release）
+    - アイドル接続は max_idle 本まで保持し、超えた分は閉じる
+    - サーバが Connection: close を返した接続は戻さない
+    - HTTP(S)_PROXY / NO_PROXY は urllib と同じ規則で解決する
+      （https は CONNECT トンネル、http はプロキシへ絶対 URL で送る）
+    """
+
+    def __init__(self, base_url: str, *, timeout_sec: float, max_idle: int = 8) -> None:
+        parsed = urllib.parse.urlsplit(base_url)
+        self._https = parsed.scheme.lower() != "http"
+        self._host = parsed.hostname or ""
+        self._port = parsed.port
+        self._base_path = (parsed.path or "").rstrip("/")
+        self._timeout = float(timeout_sec)
+        self._idle: "queue.LifoQueue[http.client.HTTPConnection]" = queue.LifoQueue(maxsize=max(1, int(max_idle)))
+        self._proxy = self._resolve_proxy("https" if self._https else "http")
+        self._origin = f"{'https' if self._https else 'http'}://{parsed.netloc.rsplit('@', 1)[-1]}"
+
+    @property
+    def base_path(self) -> str:
+        return self._base_path
+
+    def _resolve_proxy(self, scheme: str) -> Optional[Tuple[str, Optional[int], Dict[str, str]]]:
+        """(host, port, proxy headers) or None"""
+        try:
+            proxy_url = urllib.request.getproxies().get(scheme)
+            if not proxy_url or urllib.request.proxy_bypass(self._host):
+                return None
+        except Exception:
+            return None
+        if "://" not in proxy_url:
+            proxy_url = "http://" + proxy_url
+        p = urllib.parse.urlsplit(proxy_url)
+        if not p.hostname:
+            return None
+        headers: Dict[str, str] = {}
+        if p.username:
+            cred = f"{urllib.parse.unquote(p.username)}:{urllib.parse.unquote(p.password or '')}"
+            headers["Proxy-Authorization"] = "Basic " + base64.b64encode(cred.encode("utf-8")).decode("ascii")
+        return p.hostname, p.port, headers
+
+    def _open(self) -> http.client.HTTPConnection:
+        if self._proxy is not None:
+            p_host, p_port, p_headers = self._proxy
+            if self._https:
+                conn: http.client.HTTPConnection = http.client.HTTPSConnection(p_host, p_port, timeout=self._timeout)
+                conn.set_tunnel(self._host, self._port, headers=p_headers or None)
+                return conn
+            return http.client.HTTPConnection(p_host, p_port, timeout=self._timeout)
+        if self._https:
+            return http.client.HTTPSConnection(self._host, self._port, timeout=self._timeout)
+        return http.client.HTTPConnection(self._host, self._port, timeout=self._timeout)
+
+    def acquire(self) -> Tuple[http.client.HTTPConnection, bool]:
+        """(conn, reused)"""
+        try:
+            return self._idle.get_nowait(), True
+        except queue.Empty:
+            return self._open(), False
+
+    def release(self, conn: http.client.HTTPConnection) -> None:
+        try:
+            self._idle.put_nowait(conn)
+        except queue.Full:
+            conn.close()
+
+    def close(self) -> None:
+        while True:
+            try:
+                self._idle.get_nowait().close()
+            except queue.Empty:
+                return
+            except Exception:
+                pass
+
+    def send(
+        self,
+        method: str,
+        path: str,
+        *,
+        body: Optional[bytes],
+        headers: Dict[str, str],
+    ) -> Tuple[int, bytes]:
+        target = self._base_path + path
+        if self._proxy is not None and not self._https:
+            # 平文 HTTP プロキシには絶対 URL で送る
+            target = self._origin + target
+            if self._proxy[2]:
+                headers = {**headers, **self._proxy[2]}
+        idempotent = method.upper() in _IDEMPOTENT_METHODS
+        for attempt in (0, 1):
+            conn, reused = self.acquire()
+            sent = False
+            try:
+                conn.request(method, target, body=body, headers=headers)
+                sent = True
+                resp = conn.getresponse()
+                raw = resp.read()
+                status = int(resp.status)
+            except _STALE_CONNECTION_ERRORS:
+                conn.close()
+                # POST / PATCH は送信前に落ちたときだけ再送する（insert の重複行を作らない）
+                if reused and attempt == 0 and (idempotent or not sent):
+                    continue
+                raise
+            except Exception:
+                conn.close()
+                raise
+
+            if resp.will_close:
+                conn.close()
+            else:
+                self.release(conn)
+            return status, raw
+        raise SupabaseRESTError("unreachable")  # pragma: no cover
+
+
 class SupabaseRESTClient:
     """
-    Supabase PostgREST client (依存なし / urllib版)
+    Supabase PostgREST client (依存なし / http.client keep-alive版)
 
     前提:
     - サーバ側で `SUPABASE_SERVICE_ROLE_KEY` を使って書き込む（RLS回避）。
+    - 接続は _KeepAliveConnectionPool で再利用する（書き込みのたびに TCP+TLS を張り直さない）。
+    - fire-and-forget な書き込みは returning="minimal"（`Prefer: return=minimal`）で
+      レスポンス本文を返させない。
     """
 
-    def __init__(self, config: SupabaseConfig, *, timeout_sec: int = 30) -> None:
+    def __init__(self, config: SupabaseConfig, *, timeout_sec: int = 30, max_idle_connections: int = 8) -> None:
         self._cfg = config
         self._timeout = int(timeout_sec)
+        self._pool = _KeepAliveConnectionPool(
+            self._cfg.url,
+            timeout_sec=self._timeout,
+            max_idle=max_idle_connections,
+        )
 
-    def _make_url(self, path: str, query: Optional[Dict[str, str]] = None) -> str:
-        base = self._cfg.url.rstrip("/")
-        url = base + path
+    def close(self) -> None:
+        self._pool.close()
+
+    def _make_path(self, path: str, query: Optional[Dict[str, str]] = None) -> str:
         if query:
-            url += "?" + urllib.parse.urlencode(query)
-        return url
+            path += "?" + urllib.parse.urlencode(query)
+        return path
 
     def _headers(self) -> Dict[str, str]:
         # service role key を bearer として利用
@@ -74,7 +224,7 @@ class SupabaseRESTClient:
         json_body: Optional[Any] = None,
         extra_headers: Optional[Dict[str, str]] = None,
     ) -> Tuple[int, Any]:
-        url = self._make_url(path, query=query)
+        target = self._make_path(path, query=query)
         data: Optional[bytes]
         if json_body is None:
             data = None
@@ -87,17 +237,13 @@ class SupabaseRESTClient:
         if extra_headers:
             headers.update(extra_headers)
 
-        req = urllib.request.Request(url=url, method=method.upper(), data=data, headers=headers)
-
+        started = time.perf_counter()
         try:
-            with urllib.request.urlopen(req, timeout=self._timeout) as resp:
-                raw = resp.read()
-                status = int(resp.status)
-        except urllib.error.HTTPError as e:
-            raw = e.read()
-            status = int(getattr(e, "code", 0) or 0)
+            status, raw = self._pool.send(method.upper(), target, body=data, headers=headers)
         except Exception as e:
+            metrics.note_supabase_request(method.upper(), 0, time.perf_counter() - started)
             raise SupabaseRESTError(f"Supabase REST request failed: {e}") from e
+        metrics.note_supabase_request(method.upper(), status, time.perf_counter() - started)
 
         if not raw:
             return status, None
@@ -116,20 +262,52 @@ class SupabaseRESTClient:
     # Convenience
     # --------------------------
 
-    def insert(self, table: str, row: Dict[str, Any]) -> Any:
-        _, payload = self.request("POST", f"/rest/v1/{table}", json_body=row)
+    def insert(self, table: str, row: Dict[str, Any], *, returning: str = "representation") -> Any:
+        _, payload = self.request(
+            "POST",
+            f"/rest/v1/{table}",
+            json_body=row,
+            extra_headers={"Prefer": f"return={returning}"},
+        )
+        return payload
+
+    def insert_many(self, table: str, rows: List[Dict[str, Any]], *, returning: str = "minimal") -> Any:
+        """
+        Bulk insert（JSON array を 1 リクエストで送る）。
+        PostgREST は先頭行のキーを列として扱うため、呼び出し側でキー集合を揃えること。
+        """
+        if not rows:
+            return None
+        _, payload = self.request(
+            "POST",
+            f"/rest/v1/{table}",
+            json_body=list(rows),
+            extra_headers={"Prefer": f"return={returning}"},
+        )
         return payload
 
-    def upsert(self, table: str, row: Dict[str, Any], *, on_conflict: str) -> Any:
+    def upsert(
+        self,
+        table: str,
+        row: Dict[str, Any],
+        *,
+        on_conflict: str,
+        returning: str = "representation",
+    ) -> Any:
         _, payload = self.request(
             "POST",
             f"/rest/v1/{table}",
             query={"on_conflict": on_conflict},
             json_body=row,
-            extra_headers={"Prefer": "resolution=merge-duplicates,return=representation"},
+            extra_headers={"Prefer": f"resolution=merge-duplicates,return={returning}"},
         )
         return payload
 
+    def rpc(self, fn: str, params: Optional[Dict[str, Any]] = None) -> Any:
+        # PostgREST: POST /rest/v1/rpc/<fn>（引数は JSON object）
+        _, payload = self.request("POST", f"/rest/v1/rpc/{fn}", json_body=params or {})
+        return payload
+
     def select(
         self,
         table: str,
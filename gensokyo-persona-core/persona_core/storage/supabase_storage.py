@@ -5,7 +5,7 @@ import urllib.parse
 import urllib.request
 import urllib.error
 from dataclasses import dataclass
-from typing import Any, Dict, Optional, Tuple
+from typing import Any, BinaryIO, Dict, Iterator, Optional, Tuple, Union
 
 
 class SupabaseStorageError(RuntimeError):
@@ -18,6 +18,43 @@ class SupabaseStorageConfig:
     service_role_key: str
 
 
+class _ResponseChunks:
+    """
+    Chunk iterator over an open HTTP response. close() releases the response even when
+    iteration never started (a generator's finally would not run in that case).
+    """
+
+    def __init__(self, resp: Any, chunk_size: int) -> None:
+        self._resp = resp
+        self._chunk_size = max(1, int(chunk_size))
+        self._closed = False
+
+    def __iter__(self) -> "_ResponseChunks":
+        return self
+
+    def __next__(self) -> bytes:
+        if self._closed:
+            raise StopIteration
+        try:
+            chunk = self._resp.read(self._chunk_size)
+        except BaseException:
+            self.close()
+            raise
+        if not chunk:
+            self.close()
+            raise StopIteration
+        return chunk
+
+    def close(self) -> None:
+        if self._closed:
+            return
+        self._closed = True
+        try:
+            self._resp.close()
+        except Exception:
+            pass
+
+
 class SupabaseStorageClient:
     """
     Minimal Supabase Storage client (urllib) for server-side use.
@@ -42,7 +79,9 @@ class SupabaseStorageClient:
             h["Content-Type"] = str(content_type)
         return h
 
-    def _req(self, method: str, url: str, *, data: Optional[bytes], headers: Dict[str, str]) -> Tuple[int, bytes]:
+    def _req(
+        self, method: str, url: str, *, data: Optional[Union[bytes, BinaryIO]], headers: Dict[str, str]
+    ) -> Tuple[int, bytes]:
         req = urllib.request.Request(url=url, method=method.upper(), data=data, headers=headers)
         try:
             with urllib.request.urlopen(req, timeout=self._timeout) as resp:
@@ -59,18 +98,23 @@ class SupabaseStorageClient:
         *,
         bucket_id: str,
         object_path: str,
-        data: bytes,
+        data: Union[bytes, BinaryIO],
         content_type: str,
         upsert: bool = True,
+        content_length: Optional[int] = None,
     ) -> Dict[str, Any]:
         """
         PUT /storage/v1/object/{bucket}/{path}
+
+        data may be a binary file object (streamed by http.client in blocks); pass content_length with it.
         """
         bucket = urllib.parse.quote(str(bucket_id).strip(), safe="")
         path = urllib.parse.quote(str(object_path).lstrip("/"), safe="/")
         url = f"{self._base()}/storage/v1/object/{bucket}/{path}"
         headers = self._headers(content_type=content_type)
         headers["x-upsert"] = "true" if upsert else "false"
+        if content_length is not None:
+            headers["Content-Length"] = str(int(content_length))
         status, raw = self._req("PUT", url, data=data, headers=headers)
         if status >= 400:
             raise SupabaseStorageError(f"upload failed HTTP {status}: {raw[:400]!r}")
@@ -97,3 +141,28 @@ class SupabaseStorageClient:
             raise SupabaseStorageError(f"download failed HTTP {status}: {raw[:400]!r}")
         return raw or b""
 
+    def download_stream(
+        self,
+        *,
+        bucket_id: str,
+        object_path: str,
+        chunk_size: int = 65536,
+    ) -> Iterator[bytes]:
+        """
+        Streaming GET /storage/v1/object/{bucket}/{path}.
+        The request is made eagerly (errors raise here); the returned iterator yields chunks and
+        closes the response when exhausted or closed.
+        """
+        bucket = urllib.parse.quote(str(bucket_id).strip(), safe="")
+        path = urllib.parse.quote(str(object_path).lstrip("/"), safe="/")
+        url = f"{self._base()}/storage/v1/object/{bucket}/{path}"
+        req = urllib.request.Request(url=url, method="GET", headers=self._headers())
+        try:
+            resp = urllib.request.urlopen(req, timeout=self._timeout)
+        except urllib.error.HTTPError as e:
+            raw = e.read()
+            raise SupabaseStorageError(f"download failed HTTP {int(getattr(e, 'code', 0) or 0)}: {raw[:400]!r}") from e
+        except Exception as e:
+            raise SupabaseStorageError(f"storage request failed: {e}") from e
+
+        return _ResponseChunks(resp, chunk_size)
@@ -1,8 +1,10 @@
 from __future__ import annotations
 
+import threading
+from contextlib import contextmanager
 from dataclasses import asdict
 from datetime import datetime, timezone
-from typing import Any, Dict, List, Optional
+from typing import Any, Dict, Iterator, List, Optional, Tuple
 
 from persona_core.memory.episode_store import Episode
 from persona_core.trait.trait_drift_engine import TraitState
@@ -18,10 +20,87 @@ class SupabasePersonaDB:
     いまの v2 の利用箇所:
     - ValueDriftEngine / TraitDriftEngine: store_value_snapshot / store_trait_snapshot
     - PersonaController._store_episode: store_episode (入力/出力を2回呼ぶ)
+
+    書き込み（store_* / insert_*）は戻り値を使わないため `return=minimal` で送る。
+    write_batch() の中で呼ばれた書き込みはスレッドごとにバッファされ、
+    抜けるときにテーブル単位の bulk insert にまとめて送られる。
     """
 
     def __init__(self, client: SupabaseRESTClient) -> None:
         self._c = client
+        self._batch_local = threading.local()
+
+    # --------------------------
+    # Write batching
+    # --------------------------
+
+    @contextmanager
+    def write_batch(self) -> Iterator[None]:
+        """
+        1 ターン分のスナップショット書き込みをまとめる。
+
+            with db.write_batch():
+                db.store_value_snapshot(...)
+                db.store_trait_snapshot(...)
+
+        ネストした場合は最外側を抜けたときにだけ flush する。
+        flush はテーブルごとに独立して送り、bulk insert が落ちたグループは 1 行ずつ送り直す。
+        失敗は最後にまとめて送出する。
+        """
+        depth = int(getattr(self._batch_local, "depth", 0) or 0)
+        if depth == 0:
+            self._batch_local.rows = []
+        self._batch_local.depth = depth + 1
+        try:
+            yield
+        finally:
+            self._batch_local.depth = depth
+            if depth == 0:
+                rows: List[Tuple[str, Dict[str, Any]]] = self._batch_local.rows
+                self._batch_local.rows = None
+                self._flush_batch(rows)
+
+    def _flush_batch(self, rows: List[Tuple[str, Dict[str, Any]]]) -> None:
+        # (table, キー集合) ごとにまとめる（PostgREST bulk insert は列が揃っている必要がある）
+        groups: Dict[Tuple[str, Tuple[str, ...]], List[Dict[str, Any]]] = {}
+        for table, row in rows:
+            groups.setdefault((table, tuple(sorted(row.keys()))), []).append(row)
+
+        first_error: Optional[Exception] = None
+        for (table, _keys), group in groups.items():
+            try:
+                self._c.insert_many(table, group, returning="minimal")
+                continue
+            except Exception as e:
+                if len(group) == 1:
+                    if first_error is None:
+                        first_error = e
+                    continue
+            # bulk insert は 1 行でも不正なら全体が落ちるので、1 行ずつ送り直して他の行を救う
+            for row in group:
+                try:
+                    self._c.insert(table, row, returning="minimal")
+                except Exception as e:
+                    if first_error is None:
+                        first_error = e
+        if first_error is not None:
+            raise first_error
+
+    def _insert(self, table: str, row: Dict[str, Any]) -> None:
+        buf = getattr(self._batch_local, "rows", None)
+        if buf is not None:
+            buf.append((table, row))
+            return
+        self._c.insert(table, row, returning="minimal")
+
+    def _insert_many(self, table: str, rows: List[Dict[str, Any]]) -> None:
+        if not rows:
+            return
+        buf = getattr(self._batch_local, "rows", None)
+        if buf is not None:
+            buf.extend((table, r) for r in rows)
+            return
+        self._c.insert_many(table, rows, returning="minimal")
 
     def store_episode(
         self,
@@ -48,7 +127,7 @@ class SupabasePersonaDB:
             "importance": float(importance),
             "meta": meta or {},
         }
-        self._c.insert("common_turns", row)
+        self._insert("common_turns", row)
 
     def store_value_snapshot(
         self,
@@ -65,7 +144,7 @@ class SupabasePersonaDB:
             "delta": delta or {},
             "meta": meta or {},
         }
-        self._c.insert("common_value_snapshots", row)
+        self._insert("common_value_snapshots", row)
 
     def store_trait_snapshot(
         self,
@@ -82,7 +161,7 @@ class SupabasePersonaDB:
             "delta": delta or {},
             "meta": meta or {},
         }
-        self._c.insert("common_trait_snapshots", row)
+        self._insert("common_trait_snapshots", row)
 
     def store_telemetry_snapshot(
         self,
@@ -105,7 +184,7 @@ class SupabasePersonaDB:
             "reasons": reasons or {},
             "meta": meta or {},
         }
-        self._c.insert("common_telemetry_snapshots", row)
+        self._insert("common_telemetry_snapshots", row)
 
     def store_ego_snapshot(
         self,
@@ -126,7 +205,7 @@ class SupabasePersonaDB:
             "state": state or {},
             "meta": meta or {},
         }
-        self._c.insert("common_ego_snapshots", row)
+        self._insert("common_ego_snapshots", row)
 
     # --------------------------
     # Phase02 snapshots (Temporal Identity / Subjectivity / Failure / Integration)
@@ -150,7 +229,7 @@ class SupabasePersonaDB:
             "state": state or {},
             "telemetry": telemetry or {},
         }
-        self._c.insert("common_temporal_identity_snapshots", row)
+        self._insert("common_temporal_identity_snapshots", row)
 
     def load_last_temporal_identity_state(self, *, user_id: str) -> Optional[Dict[str, Any]]:
         rows = self._c.select(
@@ -178,7 +257,7 @@ class SupabasePersonaDB:
             "session_id": session_id,
             "subjectivity": subjectivity or {},
         }
-        self._c.insert("common_subjectivity_snapshots", row)
+        self._insert("common_subjectivity_snapshots", row)
 
     def store_failure_snapshot(
         self,
@@ -194,7 +273,7 @@ class SupabasePersonaDB:
             "session_id": session_id,
             "failure": failure or {},
         }
-        self._c.insert("common_failure_snapshots", row)
+        self._insert("common_failure_snapshots", row)
 
     def store_identity_snapshot(
         self,
@@ -210,7 +289,7 @@ class SupabasePersonaDB:
             "session_id": session_id,
             "snapshot": snapshot or {},
         }
-        self._c.insert("common_identity_snapshots", row)
+        self._insert("common_identity_snapshots", row)
 
     def store_integration_events(
         self,
@@ -220,15 +299,17 @@ class SupabasePersonaDB:
         trace_id: Optional[str],
         events: List[Dict[str, Any]],
     ) -> None:
-        for ev in events or []:
-            row = {
+        rows = [
+            {
                 "trace_id": trace_id,
                 "user_id": str(user_id or ""),
                 "session_id": session_id,
                 "event_type": str(ev.get("event_type") or ""),
                 "payload": ev or {},
             }
-            self._c.insert("common_integration_events", row)
+            for ev in (events or [])
+        ]
+        self._insert_many("common_integration_events", rows)
 
     # --------------------------
     # Phase04 Kernel + Attachments
@@ -239,10 +320,11 @@ class SupabasePersonaDB:
             "common_kernel_state",
             {"user_id": str(user_id), "state": state or {}, "updated_at": datetime.now(timezone.utc).isoformat()},
             on_conflict="user_id",
+            returning="minimal",
         )
 
     def insert_kernel_snapshot(self, *, user_id: str, snapshot_id: str, state: Dict[str, Any]) -> None:
-        self._c.insert(
+        self._insert(
             "common_kernel_snapshots",
             {"user_id": str(user_id), "snapshot_id": str(snapshot_id), "state": state or {}},
         )
@@ -256,7 +338,7 @@ class SupabasePersonaDB:
         decision: Dict[str, Any],
         approved_deltas: List[Dict[str, Any]],
     ) -> None:
-        self._c.insert(
+        self._insert(
             "common_kernel_delta_logs",
             {
                 "user_id": str(user_id),
@@ -275,7 +357,7 @@ class SupabasePersonaDB:
         trace_id: Optional[str],
         reason: Optional[str],
     ) -> None:
-        self._c.insert(
+        self._insert(
             "common_kernel_rollbacks",
             {"user_id": str(user_id), "snapshot_id": str(snapshot_id), "trace_id": trace_id, "reason": reason},
         )
@@ -296,7 +378,7 @@ class SupabasePersonaDB:
         content_sha256: Optional[str],
         meta: Dict[str, Any],
     ) -> None:
-        self._c.insert(
+        self._insert(
             "common_io_events",
             {
                 "user_id": str(user_id),
@@ -353,7 +435,7 @@ class SupabasePersonaDB:
         sha256: Optional[str],
         meta: Dict[str, Any],
     ) -> None:
-        self._c.insert(
+        self._insert(
             "common_attachments",
             {
                 "attachment_id": str(attachment_id),
@@ -368,6 +450,19 @@ class SupabasePersonaDB:
             },
         )
 
+    def find_attachment_by_sha256(self, *, user_id: str, sha256: str) -> Optional[Dict[str, Any]]:
+        """Latest attachment of this user with the same content hash (upload dedup)."""
+        rows = self._c.select(
+            "common_attachments",
+            columns="attachment_id,user_id,bucket_id,object_path,file_name,mime_type,size_bytes,sha256,meta,created_at",
+            filters=[f"user_id=eq.{user_id}", f"sha256=eq.{sha256}"],
+            order="created_at.desc",
+            limit=1,
+        )
+        if not rows:
+            return None
+        return rows[0] if isinstance(rows[0], dict) else None
+
     def load_attachment(self, *, attachment_id: str) -> Optional[Dict[str, Any]]:
         rows = self._c.select(
             "common_attachments",
@@ -400,7 +495,7 @@ class SupabasePersonaDB:
         kind: str,
         payload: Dict[str, Any],
     ) -> None:
-        self._c.insert(
+        self._insert(
             "common_life_events",
             {
                 "user_id": str(user_id),
@@ -420,7 +515,7 @@ class SupabasePersonaDB:
         kind: str,
         payload: Dict[str, Any],
     ) -> None:
-        self._c.insert(
+        self._insert(
             "common_operator_overrides",
             {
                 "user_id": str(user_id),
@@ -490,6 +585,36 @@ class SupabasePersonaDB:
             curiosity=float(st.get("curiosity", 0.0)),
         )
 
+    # --------------------------
+    # Freshness markers (常駐 state の鮮度確認用。本文を読まない 1 行 select)
+    # --------------------------
+
+    def load_last_trait_trace_id(self, *, user_id: str) -> Optional[str]:
+        """最新 trait snapshot の trace_id（ターン毎 / trait_set override で必ず書かれる）。"""
+        rows = self._c.select(
+            "common_trait_snapshots",
+            columns="trace_id",
+            filters=[f"user_id=eq.{user_id}"],
+            order="created_at.desc",
+            limit=1,
+        )
+        if not rows:
+            return None
+        return rows[0].get("trace_id")
+
+    def load_last_operator_override_id(self, *, user_id: str) -> Optional[str]:
+        """最新 operator override（種類を問わない）の id。"""
+        rows = self._c.select(
+            "common_operator_overrides",
+            columns="id",
+            filters=[f"user_id=eq.{user_id}"],
+            order="created_at.desc",
+            limit=1,
+        )
+        if not rows:
+            return None
+        return rows[0].get("id")
+
 
 class SupabaseEpisodeStore:
     """
@@ -497,6 +622,7 @@ class SupabaseEpisodeStore:
     - add(ep)
     - fetch_recent(limit)
     - fetch_by_ids(ids)
+    - search_embedding(vector, limit)  ※ pgvector RPC（supabase/common_episodes_vector_search.sql）
 
     ここでは user_id を分離するため、インスタンス生成時に user_id を固定する。
     """
@@ -508,6 +634,9 @@ class SupabaseEpisodeStore:
         self._character_id: Optional[str] = cid if cid else None
         # Backward-compatibility: older DB may not have common_episodes.character_id yet.
         self._supports_character_scope = True
+        # Backward-compatibility: older DB may not have the common_episodes_match RPC yet
+        # (supabase/common_episodes_vector_search.sql).
+        self._supports_vector_rpc = True
 
     def _looks_like_missing_character_id(self, err: Exception) -> bool:
         msg = str(err)
@@ -535,13 +664,13 @@ class SupabaseEpisodeStore:
             "meta": {},
         }
         try:
-            self._c.upsert("common_episodes", row, on_conflict="episode_id")
+            self._c.upsert("common_episodes", row, on_conflict="episode_id", returning="minimal")
         except Exception as e:
             if self._supports_character_scope and self._character_id and self._looks_like_missing_character_id(e):
                 self._supports_character_scope = False
                 try:
                     row.pop("character_id", None)
-                    self._c.upsert("common_episodes", row, on_conflict="episode_id")
+                    self._c.upsert("common_episodes", row, on_conflict="episode_id", returning="minimal")
                 except Exception:
                     pass
             else:
@@ -605,6 +734,37 @@ class SupabaseEpisodeStore:
                 raise
         return [Episode.from_dict(r) for r in (rows or [])]
 
+    def _looks_like_missing_rpc(self, err: Exception) -> bool:
+        msg = str(err)
+        return "common_episodes_match" in msg or "PGRST202" in msg or "Could not find the function" in msg
+
     def search_embedding(self, vector: List[float], limit: int = 5) -> List[Episode]:
-        # TODO: pgvector での検索（RPC / SQL function）に置き換える余地あり
-        return self.fetch_recent(limit=limit)
+        """
+        pgvector RPC（common_episodes_match）でサーバ側 top-k 検索する。
+        返ってくるのは上位 limit 件のみ（embedding は含めない）。
+
+        RPC 未導入 / 次元不一致などで失敗した場合は従来どおり fetch_recent にフォールバック。
+        """
+        if not vector or limit <= 0 or not self._supports_vector_rpc:
+            return self.fetch_recent(limit=limit if limit > 0 else 5)
+
+        params: Dict[str, Any] = {
+            "p_user_id": self._user_id,
+            "p_query": [float(x) for x in vector],
+            "p_limit": int(limit),
+        }
+        if self._character_id and self._supports_character_scope:
+            params["p_character_id"] = self._character_id
+
+        try:
+            rows = self._c.rpc("common_episodes_match", params)
+        except Exception as e:
+            if self._looks_like_missing_rpc(e):
+                self._supports_vector_rpc = False
+            return self.fetch_recent(limit=limit)
+
+        out = [Episode.from_dict(r) for r in (rows or []) if isinstance(r, dict)]
+        if not out:
+            # embedding が無い / スコアゼロ → fallback（SQLiteEpisodeStore と同じ挙動）
+            return self.fetch_recent(limit=limit)
+        return out
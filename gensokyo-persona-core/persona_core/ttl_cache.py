@@ -0,0 +1,134 @@
+"""
+persona_core.ttl_cache
+
+スレッドセーフな LRU + TTL キャッシュ（get/put/evict すべて O(1)）。
+
+- OrderedDict を LRU リストとして使い、get で末尾へ移動・溢れたら先頭から捨てる
+- TTL は読み出し時に判定（期限切れはその場で削除）
+- ttl_sec <= 0 または max_items <= 0 のときは無効（get は常に miss、put は何もしない）
+- hits / misses / evictions / expirations を stats() で返す（/health で公開）
+- on_evict を渡すと LRU 溢れ / TTL 切れで捨てた (key, value) をロック外で通知する（write-back 用）
+"""
+
+from __future__ import annotations
+
+import threading
+import time
+from collections import OrderedDict
+from typing import Any, Callable, Dict, Generic, Hashable, List, Optional, Tuple, TypeVar
+
+V = TypeVar("V")
+
+
+class LRUTTLCache(Generic[V]):
+    def __init__(
+        self,
+        *,
+        max_items: int,
+        ttl_sec: float,
+        name: str = "",
+        on_evict: Optional[Callable[[Hashable, V], None]] = None,
+    ) -> None:
+        self.max_items = max(0, int(max_items))
+        self.ttl_sec = float(ttl_sec)
+        self.name = name
+        self._on_evict = on_evict
+
+        self._data: "OrderedDict[Hashable, Tuple[float, V]]" = OrderedDict()  # key -> (expires_at, value)
+        self._lock = threading.Lock()
+
+        self._hits = 0
+        self._misses = 0
+        self._evictions = 0
+        self._expirations = 0
+
+    @property
+    def enabled(self) -> bool:
+        return self.ttl_sec > 0 and self.max_items > 0
+
+    def _notify(self, dropped: List[Tuple[Hashable, V]]) -> None:
+        if self._on_evict is None:
+            return
+        for key, value in dropped:
+            try:
+                self._on_evict(key, value)
+            except Exception:
+                pass
+
+    def get(self, key: Hashable) -> Optional[V]:
+        if not self.enabled:
+            return None
+        now = time.monotonic()
+        with self._lock:
+            item = self._data.get(key)
+            if item is None:
+                self._misses += 1
+                return None
+            expires_at, value = item
+            if now <= expires_at:
+                self._data.move_to_end(key)
+                self._hits += 1
+                return value
+            del self._data[key]
+            self._expirations += 1
+            self._misses += 1
+        self._notify([(key, value)])
+        return None
+
+    def peek(self, key: Hashable) -> Optional[V]:
+        """stats / LRU 順を動かさない読み出し（期限切れは None、削除はしない）。"""
+        if not self.enabled:
+            return None
+        with self._lock:
+            item = self._data.get(key)
+        if item is None or time.monotonic() > item[0]:
+            return None
+        return item[1]
+
+    def put(self, key: Hashable, value: V) -> None:
+        if not self.enabled:
+            return
+        expires_at = time.monotonic() + self.ttl_sec
+        dropped: List[Tuple[Hashable, V]] = []
+        with self._lock:
+            if key in self._data:
+                self._data.move_to_end(key)
+            self._data[key] = (expires_at, value)
+            while len(self._data) > self.max_items:
+                old_key, (_, old_value) = self._data.popitem(last=False)
+                self._evictions += 1
+                dropped.append((old_key, old_value))
+        self._notify(dropped)
+
+    def pop(self, key: Hashable) -> Optional[V]:
+        with self._lock:
+            item = self._data.pop(key, None)
+        return item[1] if item is not None else None
+
+    def values(self) -> List[V]:
+        """期限切れも含めた現在の値（shutdown 時の flush 用）。"""
+        with self._lock:
+            return [v for _, v in self._data.values()]
+
+    def clear(self) -> None:
+        with self._lock:
+            self._data.clear()
+
+    def __len__(self) -> int:
+        with self._lock:
+            return len(self._data)
+
+    def stats(self) -> Dict[str, Any]:
+        with self._lock:
+            lookups = self._hits + self._misses
+            return {
+                "name": self.name,
+                "size": len(self._data),
+                "max_items": self.max_items,
+                "ttl_sec": self.ttl_sec,
+                "hits": self._hits,
+                "misses": self._misses,
+                "hit_rate": round(self._hits / lookups, 4) if lookups else 0.0,
+                "evictions": self._evictions,
+                "expirations": self._expirations,
+            }
@@ -0,0 +1,218 @@
+from __future__ import annotations
+
+import asyncio
+import time
+from collections import deque
+from datetime import datetime, timezone
+from typing import Any, Callable, Deque, Dict, List, Optional
+
+try:
+    import asyncpg  # type: ignore
+except Exception:  # pragma: no cover
+    asyncpg = None  # type: ignore
+
+
+def _parse_ts(value: Any) -> Optional[datetime]:
+    if not isinstance(value, str) or not value.strip():
+        return None
+    try:
+        dt = datetime.fromisoformat(value.strip().replace("Z", "+00:00"))
+    except Exception:
+        return None
+    if dt.tzinfo is None:
+        dt = dt.replace(tzinfo=timezone.utc)
+    return dt.astimezone(timezone.utc)
+
+
+def _pct(sorted_vals: List[float], p: float) -> float:
+    if not sorted_vals:
+        return 0.0
+    idx = min(len(sorted_vals) - 1, max(0, int(round(p * (len(sorted_vals) - 1)))))
+    return sorted_vals[idx]
+
+
+# --------------------------------------------
+# Postgres LISTEN (optional, asyncpg)
+# --------------------------------------------
+
+
+class PgNotifyListener:
+    """
+    One LISTEN connection shared by every pg_notify channel this process cares about
+    (world_command wakeups, world_event cache invalidation).
+
+    Handlers get the notification payload; after every (re)connect they are called once
+    with payload=None ("notifications may have been missed"). Requires asyncpg; start()
+    returns False when it is not installed.
+    """
+
+    def __init__(self, dsn: str) -> None:
+        self._dsn = dsn
+        self._handlers: Dict[str, List[Callable[[Optional[str]], None]]] = {}
+        self._task: Optional[asyncio.Task] = None
+        self.listening = False
+
+    def on(self, channel: str, handler: Callable[[Optional[str]], None]) -> None:
+        self._handlers.setdefault(channel, []).append(handler)
+
+    def _dispatch(self, channel: str, payload: Optional[str]) -> None:
+        for fn in self._handlers.get(channel, []):
+            try:
+                fn(payload)
+            except Exception:
+                pass
+
+    def start(self, on_error: Optional[Callable[[Exception], None]] = None) -> bool:
+        if asyncpg is None or not self._dsn:
+            return False
+        if self._task is not None and not self._task.done():
+            return True
+        self._task = asyncio.create_task(self._listen_loop(on_error))
+        return True
+
+    async def _listen_loop(self, on_error: Optional[Callable[[Exception], None]]) -> None:
+        backoff = 1.0
+        while True:
+            conn = None
+            try:
+                conn = await asyncpg.connect(self._dsn)  # type: ignore[union-attr]
+                for channel in self._handlers:
+                    await conn.add_listener(channel, lambda _c, _pid, ch, payload: self._dispatch(ch, payload))
+                self.listening = True
+                backoff = 1.0
+                # Anything that happened while disconnected is unknown: let handlers resync.
+                for channel in self._handlers:
+                    self._dispatch(channel, None)
+                while not conn.is_closed():
+                    await asyncio.sleep(5.0)
+            except asyncio.CancelledError:
+                raise
+            except Exception as e:
+                if on_error is not None:
+                    try:
+                        on_error(e)
+                    except Exception:
+                        pass
+            finally:
+                self.listening = False
+                if conn is not None:
+                    try:
+                        await conn.close()
+                    except Exception:
+                        pass
+            await asyncio.sleep(backoff)
+            backoff = min(30.0, backoff * 2)
+
+    async def aclose(self) -> None:
+        t = self._task
+        self._task = None
+        if t is not None and not t.done():
+            t.cancel()
+            try:
+                await t
+            except (asyncio.CancelledError, Exception):
+                pass
+
+
+# --------------------------------------------
+# Wakeup (in-process notify + optional Postgres LISTEN)
+# --------------------------------------------
+
+
+class CommandWakeup:
+    """
+    Wakes the command worker as soon as a command lands.
+
+    - notify(): same-process producers (POST /world/command) call this directly
+    - attach(listener, channel): also wake on the pg_notify emitted by the
+      world_command_log insert trigger (commands inserted via other replicas / SQL)
+
+    The worker still polls as a safety net, so a missed notification only costs latency.
+    """
+
+    def __init__(self) -> None:
+        self._event = asyncio.Event()
+        self._listener: Optional[PgNotifyListener] = None
+        self.notifications = 0
+
+    @property
+    def listening(self) -> bool:
+        return bool(self._listener is not None and self._listener.listening)
+
+    def attach(self, listener: PgNotifyListener, channel: str = "world_command") -> None:
+        self._listener = listener
+        listener.on(channel, lambda _payload: self.notify())
+
+    def notify(self) -> None:
+        self.notifications += 1
+        self._event.set()
+
+    async def wait(self, timeout: float) -> bool:
+        """Wait until notified or timeout. Returns True when woken by a notification."""
+        if not self._event.is_set():
+            try:
+                await asyncio.wait_for(self._event.wait(), timeout=max(0.0, timeout))
+            except asyncio.TimeoutError:
+                return False
+        self._event.clear()
+        return True
+
+
+# --------------------------------------------
+# Latency stats
+# --------------------------------------------
+
+
+class CommandLatencyStats:
+    """
+    Rolling command latency (ms), measured from world_command_log.created_at.
+
+    - queue_wait: created_at -> claimed by a worker
+    - end_to_end: created_at -> status done/failed written
+    """
+
+    def __init__(self, window: int = 512) -> None:
+        self._queue_wait: Deque[float] = deque(maxlen=max(16, int(window)))
+        self._end_to_end: Deque[float] = deque(maxlen=max(16, int(window)))
+        self.done = 0
+        self.failed = 0
+        self.claims = 0
+        self.empty_claims = 0
+        self.wakeups = 0
+        self.started_at = time.time()
+
+    def record_claim(self, cmd: Dict[str, Any], claimed_at: datetime) -> None:
+        created = _parse_ts(cmd.get("created_at"))
+        if created is not None:
+            self._queue_wait.append(max(0.0, (claimed_at - created).total_seconds() * 1000.0))
+
+    def record_finish(self, cmd: Dict[str, Any], finished_at: datetime, ok: bool) -> None:
+        if ok:
+            self.done += 1
+        else:
+            self.failed += 1
+        created = _parse_ts(cmd.get("created_at"))
+        if created is not None:
+            self._end_to_end.append(max(0.0, (finished_at - created).total_seconds() * 1000.0))
+
+    @staticmethod
+    def _summary(vals: Deque[float]) -> Dict[str, Any]:
+        s = sorted(vals)
+        return {
+            "n": len(s),
+            "mean_ms": round(sum(s) / len(s), 1) if s else 0.0,
+            "p50_ms": round(_pct(s, 0.50), 1),
+            "p95_ms": round(_pct(s, 0.95), 1),
+            "max_ms": round(s[-1], 1) if s else 0.0,
+        }
+
+    def to_dict(self) -> Dict[str, Any]:
+        return {
+            "done": self.done,
+            "failed": self.failed,
+            "claims": self.claims,
+            "empty_claims": self.empty_claims,
+            "wakeups": self.wakeups,
+            "queue_wait": self._summary(self._queue_wait),
+            "end_to_end": self._summary(self._end_to_end),
+        }
@@ -28,6 +28,32 @@ def content_root() -> Path:
     return Path(raw)
 
 
+def content_fingerprint() -> str:
+    """
+    Cheap change detector for the content root (hot reload).
+
+    Combines path / size / mtime of every file the loaders below read; no file contents
+    are parsed. Returns "" when nothing is present.
+    """
+
+    root = content_root()
+    paths: List[Path] = [root / n for n in ("locations.json", "sub_locations.json", "events.json", "relationships.json")]
+    event_defs = root / "event_defs"
+    try:
+        if event_defs.is_dir():
+            paths.extend(sorted(event_defs.glob("*.json")))
+    except Exception:
+        pass
+    parts: List[str] = []
+    for fp in paths:
+        try:
+            st = fp.stat()
+        except OSError:
+            continue
+        parts.append(f"{fp.name}:{st.st_size}:{st.st_mtime_ns}")
+    return "|".join(parts)
+
+
 def _read_json(path: Path) -> Any:
     with path.open("r", encoding="utf-8") as f:
         return json.load(f)
@@ -0,0 +1,353 @@
+from __future__ import annotations
+
+import random
+from dataclasses import dataclass
+from datetime import datetime
+from typing import Any, Dict, FrozenSet, List, Optional, Sequence, Tuple
+
+
+def _str_set(value: Any) -> Optional[FrozenSet[str]]:
+    if isinstance(value, list) and value:
+        return frozenset(str(x) for x in value)
+    return None
+
+
+@dataclass(frozen=True)
+class CompiledEvent:
+    idx: int  # position in load_events() (sampling order is content order)
+    id: str
+    defn: Dict[str, Any]
+    location_id: str  # "" = any location
+    probability: float
+    cooldown_sec: float
+    time_of_day: Optional[FrozenSet[str]]  # None = any
+    season: Optional[FrozenSet[str]]  # None = any
+    weather_not: FrozenSet[str]
+    participants: Tuple[str, ...]
+    location_changes: Tuple[Tuple[str, str], ...]  # (npc_id, new location_id)
+
+    def static_ok(self, *, time_of_day: str, season: str, weather: str) -> bool:
+        if self.time_of_day is not None and time_of_day not in self.time_of_day:
+            return False
+        if self.season is not None and season not in self.season:
+            return False
+        if weather in self.weather_not:
+            return False
+        return True
+
+
+def compile_event(idx: int, defn: Dict[str, Any]) -> Optional[CompiledEvent]:
+    eid = str(defn.get("id") or "")
+    if not eid:
+        return None
+    c = defn.get("constraints") if isinstance(defn.get("constraints"), dict) else {}
+    parts = defn.get("participants") if isinstance(defn.get("participants"), dict) else {}
+    req = parts.get("required") if isinstance(parts.get("required"), list) else []
+
+    changes: List[Tuple[str, str]] = []
+    effects = defn.get("effects") if isinstance(defn.get("effects"), dict) else {}
+    for e in effects.get("state") if isinstance(effects.get("state"), list) else []:
+        if not isinstance(e, dict):
+            continue
+        target = e.get("target")
+        patch = e.get("set") if isinstance(e.get("set"), dict) else {}
+        if isinstance(target, str) and isinstance(patch.get("location_id"), str) and patch.get("location_id"):
+            changes.append((target, str(patch["location_id"])))
+
+    try:
+        p = float(defn.get("probability") or 0.0)
+    except Exception:
+        p = 0.0
+    try:
+        cooldown_h = float(defn.get("cooldown_hours") or 0.0)
+    except Exception:
+        cooldown_h = 0.0
+
+    return CompiledEvent(
+        idx=idx,
+        id=eid,
+        defn=defn,
+        location_id=str(defn.get("location_id") or ""),
+        probability=p,
+        cooldown_sec=max(0.0, cooldown_h * 3600.0),
+        time_of_day=_str_set(c.get("time_of_day")),
+        season=_str_set(c.get("season")),
+        weather_not=_str_set(c.get("weather_not")) or frozenset(),
+        participants=tuple(str(x) for x in req if isinstance(x, str) and x.strip()),
+        location_changes=tuple(changes),
+    )
+
+
+# --------------------------------------------
+# Buckets (static constraints resolved) + Fenwick sampling
+# --------------------------------------------
+
+
+@dataclass(frozen=True)
+class EventBucket:
+    """Events eligible for one (location, time_of_day, season, weather), content order, p > 0."""
+
+    events: Tuple[CompiledEvent, ...]
+    prefix: Tuple[float, ...]  # cumulative base weights; prefix[i] = sum(p[0..i])
+    pos_by_id: Dict[str, int]
+    excluded_by_constraints: int
+
+
+class _Fenwick:
+    def __init__(self, weights: Sequence[float], prefix: Optional[Sequence[float]] = None) -> None:
+        n = len(weights)
+        self.n = n
+        self.w = list(weights)
+        self.tree = [0.0] * (n + 1)
+        if prefix is None:
+            acc = 0.0
+            prefix = []
+            for x in self.w:
+                acc += x
+                prefix.append(acc)  # type: ignore[attr-defined]
+        # O(n) build from prefix sums: tree[i] covers (i - lowbit(i), i].
+        for i in range(1, n + 1):
+            lo = i - (i & -i)
+            self.tree[i] = prefix[i - 1] - (prefix[lo - 1] if lo > 0 else 0.0)
+
+    def set(self, i: int, value: float) -> None:
+        delta = value - self.w[i]
+        if delta == 0.0:
+            return
+        self.w[i] = value
+        j = i + 1
+        while j <= self.n:
+            self.tree[j] += delta
+            j += j & -j
+
+    def total(self) -> float:
+        s = 0.0
+        j = self.n
+        while j > 0:
+            s += self.tree[j]
+            j -= j & -j
+        return s
+
+    def search(self, target: float) -> int:
+        """Smallest i with prefix(i) > target (O(log n))."""
+        pos = 0
+        step = 1 << max(0, self.n.bit_length() - 1) if self.n else 0
+        rem = target
+        while step:
+            nxt = pos + step
+            if nxt <= self.n and self.tree[nxt] <= rem:
+                pos = nxt
+                rem -= self.tree[nxt]
+            step >>= 1
+        i = min(pos, self.n - 1)
+        # Float residue can land on an emptied slot; move to the nearest live one.
+        if self.w[i] <= 0.0:
+            for j in list(range(i + 1, self.n)) + list(range(i - 1, -1, -1)):
+                if self.w[j] > 0.0:
+                    return j
+        return i
+
+
+def recent_weight(event_id: str, recent_event_types: Sequence[str]) -> float:
+    # Docs examples: within last 3 -> 0.05, within last 10 -> 0.2
+    if event_id in recent_event_types[:3]:
+        return 0.05
+    if event_id in recent_event_types[:10]:
+        return 0.2
+    return 1.0
+
+
+class EventIndex:
+    """
+    Compiled view of load_events() for /world/visit sampling.
+
+    - by_location: location_id -> events ("" holds location-agnostic events)
+    - buckets: (location, time_of_day, season, weather) -> EventBucket, built lazily and memoized
+    - by_moved_npc / by_participant: npc_id -> events (conflict checks, lookups)
+
+    A fingerprint of the content directory identifies the build; callers rebuild when it changes.
+    """
+
+    def __init__(self, defs: List[Dict[str, Any]], fingerprint: str = "") -> None:
+        self.fingerprint = fingerprint
+        self.events: List[CompiledEvent] = []
+        self.by_location: Dict[str, List[CompiledEvent]] = {}
+        self.by_moved_npc: Dict[str, List[CompiledEvent]] = {}
+        self.by_participant: Dict[str, List[CompiledEvent]] = {}
+        seen: set[str] = set()
+        for i, d in enumerate(defs or []):
+            if not isinstance(d, dict):
+                continue
+            ev = compile_event(i, d)
+            if ev is None or ev.id in seen:
+                continue
+            seen.add(ev.id)
+            self.events.append(ev)
+            self.by_location.setdefault(ev.location_id, []).append(ev)
+            for npc_id, _loc in ev.location_changes:
+                self.by_moved_npc.setdefault(npc_id, []).append(ev)
+            for npc_id in ev.participants:
+                self.by_participant.setdefault(npc_id, []).append(ev)
+        self._buckets: Dict[Tuple[str, str, str, str], EventBucket] = {}
+
+    def bucket(self, *, location_id: str, time_of_day: str, season: str, weather: str) -> EventBucket:
+        key = (location_id, time_of_day, season, weather)
+        b = self._buckets.get(key)
+        if b is not None:
+            return b
+        here = list(self.by_location.get(location_id, []))
+        if location_id:
+            here += self.by_location.get("", [])
+        here.sort(key=lambda e: e.idx)
+        events: List[CompiledEvent] = []
+        prefix: List[float] = []
+        excluded = 0
+        acc = 0.0
+        for ev in here:
+            if not ev.static_ok(time_of_day=time_of_day, season=season, weather=weather):
+                excluded += 1
+                continue
+            if ev.probability <= 0:
+                continue
+            acc += ev.probability
+            events.append(ev)
+            prefix.append(acc)
+        b = EventBucket(
+            events=tuple(events),
+            prefix=tuple(prefix),
+            pos_by_id={ev.id: i for i, ev in enumerate(events)},
+            excluded_by_constraints=excluded,
+        )
+        if len(self._buckets) > 4096:
+            self._buckets.clear()
+        self._buckets[key] = b
+        return b
+
+    def sampler(
+        self,
+        *,
+        location_id: str,
+        state: Dict[str, Any],
+        now: datetime,
+        last_seen_ts: Dict[str, datetime],
+        recent_types: Sequence[str],
+    ) -> "EventSampler":
+        return EventSampler(
+            self,
+            location_id=location_id,
+            state=state,
+            now=now,
+            last_seen_ts=last_seen_ts,
+            recent_types=recent_types,
+        )
+
+
+class EventSampler:
+    """
+    Weighted sampling without replacement for one visit.
+
+    Weight = probability * recent_weight, 0 while on cooldown, already selected, or when the
+    event would move an NPC that an earlier pick already moved somewhere else (invariant I1).
+    Setup is O(k) for a k-event bucket, each draw O(log k). Draw order and the pick for a
+    given rng value match a linear scan over the eligible events in content order.
+    """
+
+    def __init__(
+        self,
+        index: EventIndex,
+        *,
+        location_id: str,
+        state: Dict[str, Any],
+        now: datetime,
+        last_seen_ts: Dict[str, datetime],
+        recent_types: Sequence[str],
+    ) -> None:
+        self._index = index
+        self._location_id = location_id
+        self._now = now
+        self._last_seen_ts = dict(last_seen_ts)
+        self._recent_types = list(recent_types)
+        self._selected: set[str] = set()
+        self._reserved: Dict[str, str] = {}  # npc_id -> location_id
+        self.stats: Dict[str, int] = {
+            "candidates_count": 0,
+            "excluded_by_constraints": 0,
+            "excluded_by_cooldown": 0,
+            "excluded_by_recent_zero": 0,
+            "reduced_by_recent": 0,
+            "excluded_by_conflict": 0,
+        }
+        self._load(state)
+
+    def _key(self, state: Dict[str, Any]) -> Tuple[str, str, str]:
+        return (
+            str(state.get("time_of_day") or ""),
+            str(state.get("season") or ""),
+            str(state.get("weather") or ""),
+        )
+
+    def _load(self, state: Dict[str, Any]) -> None:
+        tod, season, weather = self._key(state)
+        self._state_key = (tod, season, weather)
+        b = self._index.bucket(location_id=self._location_id, time_of_day=tod, season=season, weather=weather)
+        self._bucket = b
+        self._fw = _Fenwick([ev.probability for ev in b.events], b.prefix)
+        self.stats["excluded_by_constraints"] += b.excluded_by_constraints
+        self.stats["candidates_count"] += len(b.events)
+
+        # Dynamic adjustments touch only the few events seen recently / on cooldown.
+        touched = set(self._recent_types[:10]) | set(self._last_seen_ts.keys()) | self._selected
+        for eid in touched:
+            i = b.pos_by_id.get(eid)
+            if i is None:
+                continue
+            self._fw.set(i, self._weight(b.events[i]))
+        for npc_id in self._reserved:
+            self._exclude_conflicts(npc_id)
+
+    def _weight(self, ev: CompiledEvent) -> float:
+        if ev.id in self._selected:
+            return 0.0
+        if ev.cooldown_sec > 0 and ev.id in self._last_seen_ts:
+            if (self._now - self._last_seen_ts[ev.id]).total_seconds() < ev.cooldown_sec:
+                self.stats["excluded_by_cooldown"] += 1
+                return 0.0
+        rw = recent_weight(ev.id, self._recent_types)
+        if rw < 1.0:
+            self.stats["reduced_by_recent"] += 1
+        w = ev.probability * rw
+        if w <= 0:
+            self.stats["excluded_by_recent_zero"] += 1
+            return 0.0
+        return w
+
+    def _exclude_conflicts(self, npc_id: str) -> None:
+        dst = self._reserved.get(npc_id)
+        for ev in self._index.by_moved_npc.get(npc_id, []):
+            i = self._bucket.pos_by_id.get(ev.id)
+            if i is None or self._fw.w[i] <= 0:
+                continue
+            if any(n == npc_id and loc != dst for n, loc in ev.location_changes):
+                self.stats["excluded_by_conflict"] += 1
+                self._fw.set(i, 0.0)
+
+    def draw(self, rng: random.Random) -> Optional[CompiledEvent]:
+        total = self._fw.total()
+        if total <= 1e-12 or self._fw.n == 0:
+            return None
+        i = self._fw.search(rng.random() * total)
+        if self._fw.w[i] <= 0:
+            return None
+        return self._bucket.events[i]
+
+    def take(self, ev: CompiledEvent, new_state: Optional[Dict[str, Any]] = None) -> None:
+        self._selected.add(ev.id)
+        i = self._bucket.pos_by_id.get(ev.id)
+        if i is not None:
+            self._fw.set(i, 0.0)
+        for npc_id, new_loc in ev.location_changes:
+            self._reserved[npc_id] = new_loc
+            self._exclude_conflicts(npc_id)
+        # World effects can change the static constraints (e.g. weather): switch buckets.
+        if new_state is not None and self._key(new_state) != self._state_key:
+            self._load(new_state)
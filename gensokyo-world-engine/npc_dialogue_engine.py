@@ -1,5 +1,6 @@
 from __future__ import annotations
 
+import asyncio
 import random
 import hashlib
 from dataclasses import dataclass
@@ -233,6 +234,77 @@ async def generate_dialogue_exchange(
     return str(a or "").strip() or "……", str(b or "").strip() or "……"
 
 
+@dataclass(frozen=True)
+class DialogueTask:
+    pair: NpcPair
+    index: int
+    # Per-exchange rng seed: template picks stay deterministic when exchanges run concurrently.
+    rng_seed: str
+
+
+def schedule_dialogues(
+    npc_ids: List[str],
+    *,
+    seed: str,
+    rng: random.Random,
+    max_conversations: int,
+    probability: float,
+    rel: Optional[RelationshipGraph] = None,
+) -> List[DialogueTask]:
+    """
+    Draw which conversations happen this tick (probability roll + pair pick per slot).
+
+    Only the draws use the shared rng, so the schedule is the same whether the exchanges
+    are then generated one by one or concurrently.
+    """
+    out: List[DialogueTask] = []
+    seen: set = set()
+    prob = max(0.0, min(1.0, float(probability or 0.0)))
+    for i in range(max(0, int(max_conversations or 0))):
+        if rng.random() >= prob:
+            continue
+        pair = pick_pair(npc_ids, rng=rng, rel=rel)
+        if not pair:
+            break
+        # The same pair twice in one tick would get identical (coalesced) LLM lines.
+        k = _pair_key(pair.speaker_id, pair.listener_id)
+        if k in seen:
+            continue
+        seen.add(k)
+        out.append(DialogueTask(pair=pair, index=i, rng_seed=f"{seed}|exchange|{i}"))
+    return out
+
+
+async def run_dialogue_exchanges(
+    tasks: List[DialogueTask],
+    *,
+    location_id: str,
+    llm_generate: Optional[Callable[[str, str, str, Optional[str]], Awaitable[str]]] = None,
+) -> List[Tuple[str, str]]:
+    """
+    Generate every scheduled exchange concurrently (results in task order).
+
+    Within one exchange the reply still waits for the opening line; across exchanges the
+    calls overlap, so conversation B's opening runs while conversation A's reply is generated.
+    The LLM budget is enforced below this layer (planner/llm_scheduler.py).
+    """
+    if not tasks:
+        return []
+    return list(
+        await asyncio.gather(
+            *[
+                generate_dialogue_exchange(
+                    t.pair,
+                    location_id=location_id,
+                    rng=random.Random(t.rng_seed),
+                    llm_generate=llm_generate,
+                )
+                for t in tasks
+            ]
+        )
+    )
+
+
 async def generate_dialogue_text(
     pair: NpcPair,
     *,
@@ -275,11 +347,26 @@ async def plan_npc_dialogue_events(
     out: List[Dict[str, Any]] = []
     rel = relationship_graph()
 
+    pairs: List[NpcPair] = []
     for _ in range(max(0, int(max_events or 0))):
         pair = pick_pair(npc_ids, rng=rng, rel=rel)
         if not pair:
             break
-        text = await generate_dialogue_text(pair, location_id=location_id, rng=rng, llm_generate=llm_generate)
+        pairs.append(pair)
+
+    # Pairs are independent, so their lines are generated concurrently.
+    texts = await asyncio.gather(
+        *[
+            generate_dialogue_text(
+                pair,
+                location_id=location_id,
+                rng=random.Random(f"{seed}|npc_dialogue|{i}"),
+                llm_generate=llm_generate,
+            )
+            for i, pair in enumerate(pairs)
+        ]
+    )
+    for pair, text in zip(pairs, texts):
         text = str(text or "").strip()
         if not text:
             continue
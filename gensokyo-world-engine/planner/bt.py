@@ -210,6 +210,54 @@ def build_tree(cooldown_sec: int, max_events: int) -> py_trees.trees.BehaviourTr
     return py_trees.trees.BehaviourTree(root)
 
 
+# Trees hold no per-call state (behaviours read ctx/bb from the blackboard), so one
+# tree per config is built once and re-ticked for every speaker.
+_TREE_CACHE: Dict[Tuple[int, int], py_trees.trees.BehaviourTree] = {}
+
+
+def compiled_tree(cooldown_sec: int, max_events: int) -> py_trees.trees.BehaviourTree:
+    key = (max(0, int(cooldown_sec)), max(0, int(max_events)))
+    tree = _TREE_CACHE.get(key)
+    if tree is None:
+        tree = build_tree(cooldown_sec=key[0], max_events=key[1])
+        _TREE_CACHE[key] = tree
+    return tree
+
+
+@dataclass
+class SpeakerInput:
+    npc_id: str
+    short_memory_state: Dict[str, Any] = field(default_factory=dict)
+    forced_text: Optional[str] = None
+
+
+def plan_batch(
+    ctx: PlannerContext,
+    speakers: List[SpeakerInput],
+    cooldown_sec: int,
+    max_events: int,
+) -> Dict[str, Tuple[List[PlannedEvent], Dict[str, Any]]]:
+    """
+    Tick the cached BT once per speaker against the same ctx.
+
+    Returns {npc_id: (planned_events, next_short_memory_state)}, in speaker order.
+    """
+    tree = compiled_tree(cooldown_sec=cooldown_sec, max_events=max_events)
+    blackboard = py_trees.blackboard.Blackboard()
+    blackboard.set("gensokyo_ctx", ctx)
+    out: Dict[str, Tuple[List[PlannedEvent], Dict[str, Any]]] = {}
+    for sp in speakers:
+        bb = _BlackboardState(
+            speaker_npc_id=sp.npc_id,
+            text=str(sp.forced_text or ""),
+            next_short_memory=dict(sp.short_memory_state or {}),
+        )
+        blackboard.set("gensokyo_bb", bb)
+        tree.tick()
+        out[sp.npc_id] = (list(bb.planned or []), dict(bb.next_short_memory or {}))
+    return out
+
+
 def plan_once(
     ctx: PlannerContext,
     speaker_npc_id: str,
@@ -221,15 +269,10 @@ def plan_once(
     """
     Pure planner step: tick the BT once and return (planned_events, next_short_memory_state).
     """
-    bb = _BlackboardState(
-        speaker_npc_id=speaker_npc_id,
-        text=str(forced_text or ""),
-        next_short_memory=dict(short_memory_state or {}),
+    res = plan_batch(
+        ctx,
+        [SpeakerInput(npc_id=speaker_npc_id, short_memory_state=short_memory_state, forced_text=forced_text)],
+        cooldown_sec=cooldown_sec,
+        max_events=max_events,
     )
-    py_trees.blackboard.Blackboard().set("gensokyo_ctx", ctx)
-    py_trees.blackboard.Blackboard().set("gensokyo_bb", bb)
-
-    tree = build_tree(cooldown_sec=cooldown_sec, max_events=max_events)
-    tree.tick()
-
-    return list(bb.planned or []), dict(bb.next_short_memory or {})
+    return res[speaker_npc_id]
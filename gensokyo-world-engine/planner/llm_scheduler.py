@@ -0,0 +1,215 @@
+from __future__ import annotations
+
+import asyncio
+import hashlib
+import json
+import time
+from dataclasses import dataclass
+from typing import Any, Awaitable, Callable, Dict, Optional, Tuple
+
+# Lanes: user-facing replies always get a slot first; background NPC chatter
+# (world ticks) is capped and may be skipped (caller falls back to templates).
+LANE_USER = "user"
+LANE_BACKGROUND = "background"
+
+
+@dataclass(frozen=True)
+class LlmSchedulerConfig:
+    max_concurrency: int = 4
+    background_max: int = 2
+    # Token bucket for background requests (sum of requested max_tokens). 0 = unlimited.
+    background_tokens_per_min: int = 6000
+    # How long a background request may wait for a slot / tokens before it is dropped.
+    background_wait_ms: int = 3000
+    # Identical background requests share one in-flight call; a non-empty result is reused for this long.
+    coalesce_ttl_sec: float = 15.0
+    cache_max_items: int = 512
+
+
+def request_key(url: str, body: Dict[str, Any]) -> str:
+    raw = json.dumps({"url": url, "body": body}, ensure_ascii=False, sort_keys=True, separators=(",", ":"))
+    return hashlib.sha1(raw.encode("utf-8")).hexdigest()
+
+
+class LlmScheduler:
+    """
+    Process-wide gate in front of persona-core /persona/chat.
+
+    - global concurrency limit; background lane limited to background_max and only
+      admitted while no user request is waiting
+    - background token budget (token bucket, refilled continuously)
+    - request coalescing (background lane only): identical bodies in flight share one call,
+      and recent non-empty results are served from a small TTL cache (identical prompts across
+      ticks). User-lane calls always go through: a persona-core turn is stateful, so skipping
+      it would lose the turn and sharing it would hand one user's reply to another.
+    """
+
+    def __init__(self, cfg: LlmSchedulerConfig) -> None:
+        self.cfg = cfg
+        self._cond: Optional[asyncio.Condition] = None
+        self._in_flight = 0
+        self._bg_in_flight = 0
+        self._user_waiting = 0
+        self._tokens = float(max(0, cfg.background_tokens_per_min))
+        self._tokens_at = time.monotonic()
+        self._pending: Dict[str, "asyncio.Future[str]"] = {}
+        self._cache: Dict[str, Tuple[float, str]] = {}
+        self.stats: Dict[str, int] = {
+            "calls": 0,
+            "coalesced": 0,
+            "cache_hits": 0,
+            "background_dropped": 0,
+        }
+
+    def _condition(self) -> asyncio.Condition:
+        if self._cond is None:
+            self._cond = asyncio.Condition()
+        return self._cond
+
+    # --------------------------------------------
+    # Admission
+    # --------------------------------------------
+
+    def _refill(self) -> None:
+        rate = max(0, int(self.cfg.background_tokens_per_min))
+        if rate <= 0:
+            return
+        now = time.monotonic()
+        self._tokens = min(float(rate), self._tokens + (now - self._tokens_at) * rate / 60.0)
+        self._tokens_at = now
+
+    def _admit(self, lane: str, cost: int) -> bool:
+        if self._in_flight >= max(1, int(self.cfg.max_concurrency)):
+            return False
+        if lane == LANE_USER:
+            return True
+        if self._user_waiting > 0 or self._bg_in_flight >= max(0, int(self.cfg.background_max)):
+            return False
+        if int(self.cfg.background_tokens_per_min) > 0:
+            self._refill()
+            # A single request larger than the bucket still runs once the bucket is full.
+            need = min(float(cost), float(self.cfg.background_tokens_per_min))
+            if self._tokens < need:
+                return False
+            self._tokens -= need
+        return True
+
+    async def _acquire(self, lane: str, cost: int) -> bool:
+        cond = self._condition()
+        deadline = None if lane == LANE_USER else time.monotonic() + max(0, self.cfg.background_wait_ms) / 1000.0
+        async with cond:
+            if lane == LANE_USER:
+                self._user_waiting += 1
+            try:
+                while not self._admit(lane, cost):
+                    if deadline is not None:
+                        left = deadline - time.monotonic()
+                        if left <= 0:
+                            return False
+                        # Token refill is time-based, so wake up periodically as well.
+                        wait = min(left, 0.25)
+                    else:
+                        wait = None
+                    try:
+                        await asyncio.wait_for(cond.wait(), timeout=wait)
+                    except asyncio.TimeoutError:
+                        pass
+            finally:
+                if lane == LANE_USER:
+                    self._user_waiting -= 1
+            self._in_flight += 1
+            if lane != LANE_USER:
+                self._bg_in_flight += 1
+            return True
+
+    async def _release(self, lane: str) -> None:
+        cond = self._condition()
+        async with cond:
+            self._in_flight -= 1
+            if lane != LANE_USER:
+                self._bg_in_flight -= 1
+            cond.notify_all()
+
+    # --------------------------------------------
+    # Coalescing
+    # --------------------------------------------
+
+    def _cached(self, key: str) -> Optional[str]:
+        hit = self._cache.get(key)
+        if hit is None:
+            return None
+        if hit[0] < time.monotonic():
+            self._cache.pop(key, None)
+            return None
+        return hit[1]
+
+    def _remember(self, key: str, value: str) -> None:
+        ttl = float(self.cfg.coalesce_ttl_sec or 0.0)
+        if ttl <= 0 or not value:
+            return
+        if len(self._cache) >= max(1, int(self.cfg.cache_max_items)):
+            now = time.monotonic()
+            for k in [k for k, (exp, _) in self._cache.items() if exp < now]:
+                self._cache.pop(k, None)
+            while len(self._cache) >= max(1, int(self.cfg.cache_max_items)):
+                self._cache.pop(next(iter(self._cache)), None)
+        self._cache[key] = (time.monotonic() + ttl, value)
+
+    async def run(self, key: str, lane: str, cost: int, call: Callable[[], Awaitable[str]]) -> str:
+        """
+        Run call() under the budget. Returns "" when a background request could not get a
+        slot in time (callers treat "" as "use the template fallback").
+        """
+        if lane != LANE_BACKGROUND:
+            return await self._run_direct(lane, cost, call)
+
+        cached = self._cached(key)
+        if cached is not None:
+            self.stats["cache_hits"] += 1
+            return cached
+        fut = self._pending.get(key)
+        if fut is not None:
+            self.stats["coalesced"] += 1
+            return await asyncio.shield(fut)
+
+        fut = asyncio.get_running_loop().create_future()
+        self._pending[key] = fut
+        result = ""
+        try:
+            if await self._acquire(lane, cost):
+                try:
+                    self.stats["calls"] += 1
+                    result = str(await call() or "")
+                finally:
+                    await self._release(lane)
+            else:
+                self.stats["background_dropped"] += 1
+            self._remember(key, result)
+        except Exception:
+            result = ""
+        finally:
+            self._pending.pop(key, None)
+            if not fut.done():
+                fut.set_result(result)
+        return result
+
+    async def _run_direct(self, lane: str, cost: int, call: Callable[[], Awaitable[str]]) -> str:
+        # Same budget and error handling as run(), but never cached or shared with another caller.
+        if not await self._acquire(lane, cost):
+            self.stats["background_dropped"] += 1
+            return ""
+        try:
+            self.stats["calls"] += 1
+            return str(await call() or "")
+        except Exception:
+            return ""
+        finally:
+            await self._release(lane)
+
+    def snapshot(self) -> Dict[str, Any]:
+        return {
+            **self.stats,
+            "in_flight": self._in_flight,
+            "background_in_flight": self._bg_in_flight,
+            "cached": len(self._cache),
+        }
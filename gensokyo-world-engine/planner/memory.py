@@ -1,8 +1,9 @@
 from __future__ import annotations
 
+from contextlib import asynccontextmanager
 from dataclasses import dataclass
 from datetime import datetime, timezone
-from typing import Any, Dict, Optional
+from typing import Any, AsyncIterator, Callable, Dict, List, Optional
 
 import httpx
 
@@ -24,6 +25,18 @@ class ShortMemoryStore:
     async def put_state(self, world_id: str, npc_id: str, state: Dict[str, Any]) -> None:
         raise NotImplementedError
 
+    # Batched access (one round trip per planning pass). Backends override these;
+    # the defaults just loop so third-party stores keep working.
+    async def get_states(self, world_id: str, npc_ids: List[str]) -> Dict[str, Dict[str, Any]]:
+        out: Dict[str, Dict[str, Any]] = {}
+        for npc_id in dict.fromkeys(npc_ids or []):
+            out[npc_id] = await self.get_state(world_id, npc_id)
+        return out
+
+    async def put_states(self, world_id: str, states: Dict[str, Dict[str, Any]]) -> None:
+        for npc_id, state in (states or {}).items():
+            await self.put_state(world_id, npc_id, state)
+
 
 class InMemoryShortMemoryStore(ShortMemoryStore):
     def __init__(self):
@@ -38,6 +51,13 @@ class InMemoryShortMemoryStore(ShortMemoryStore):
     async def put_state(self, world_id: str, npc_id: str, state: Dict[str, Any]) -> None:
         self._data[self._key(world_id, npc_id)] = dict(state or {})
 
+    async def get_states(self, world_id: str, npc_ids: List[str]) -> Dict[str, Dict[str, Any]]:
+        return {n: dict(self._data.get(self._key(world_id, n), {}) or {}) for n in dict.fromkeys(npc_ids or [])}
+
+    async def put_states(self, world_id: str, states: Dict[str, Dict[str, Any]]) -> None:
+        for npc_id, state in (states or {}).items():
+            self._data[self._key(world_id, npc_id)] = dict(state or {})
+
 
 @dataclass(frozen=True)
 class SupabaseConn:
@@ -46,8 +66,18 @@ class SupabaseConn:
 
 
 class SupabaseShortMemoryStore(ShortMemoryStore):
-    def __init__(self, conn: SupabaseConn):
+    def __init__(self, conn: SupabaseConn, client: Optional[Callable[[], httpx.AsyncClient]] = None):
         self._conn = conn
+        # Optional provider of an app-lifetime client (pooled); otherwise a client per call.
+        self._client_provider = client
+
+    @asynccontextmanager
+    async def _client(self) -> AsyncIterator[httpx.AsyncClient]:
+        if self._client_provider is not None:
+            yield self._client_provider()
+            return
+        async with httpx.AsyncClient(timeout=10.0) as client:
+            yield client
 
     async def get_state(self, world_id: str, npc_id: str) -> Dict[str, Any]:
         url = self._conn.base_url.rstrip("/") + "/world_npc_memory_short"
@@ -57,7 +87,7 @@ class SupabaseShortMemoryStore(ShortMemoryStore):
             "select": "state",
             "limit": "1",
         }
-        async with httpx.AsyncClient(timeout=10.0) as client:
+        async with self._client() as client:
             r = await client.get(url, headers=self._conn.headers, params=params)
             if r.status_code >= 400:
                 return {}
@@ -76,7 +106,7 @@ class SupabaseShortMemoryStore(ShortMemoryStore):
             "state": state or {},
             "updated_at": _now_iso(),
         }
-        async with httpx.AsyncClient(timeout=10.0) as client:
+        async with self._client() as client:
             # PostgREST upsert via resolution=merge-duplicates
             await client.post(
                 url,
@@ -88,6 +118,50 @@ class SupabaseShortMemoryStore(ShortMemoryStore):
             )
 
 
+    async def get_states(self, world_id: str, npc_ids: List[str]) -> Dict[str, Dict[str, Any]]:
+        ids = [n for n in dict.fromkeys(npc_ids or []) if n]
+        if not ids:
+            return {}
+        out: Dict[str, Dict[str, Any]] = {n: {} for n in ids}
+        url = self._conn.base_url.rstrip("/") + "/world_npc_memory_short"
+        params = {
+            "world_id": f"eq.{world_id}",
+            "npc_id": "in.(" + ",".join(f'"{n}"' for n in ids) + ")",
+            "select": "npc_id,state",
+        }
+        async with self._client() as client:
+            r = await client.get(url, headers=self._conn.headers, params=params)
+            if r.status_code >= 400:
+                return out
+            for row in r.json() or []:
+                if not isinstance(row, dict) or row.get("npc_id") not in out:
+                    continue
+                state = row.get("state")
+                out[str(row["npc_id"])] = dict(state) if isinstance(state, dict) else {}
+        return out
+
+    async def put_states(self, world_id: str, states: Dict[str, Dict[str, Any]]) -> None:
+        if not states:
+            return
+        url = self._conn.base_url.rstrip("/") + "/world_npc_memory_short"
+        now = _now_iso()
+        rows = [
+            {"world_id": world_id, "npc_id": npc_id, "state": state or {}, "updated_at": now}
+            for npc_id, state in states.items()
+        ]
+        async with self._client() as client:
+            # One bulk upsert (rows are unique per npc_id by construction).
+            await client.post(
+                url,
+                headers={
+                    **self._conn.headers,
+                    "Prefer": "resolution=merge-duplicates,return=minimal",
+                },
+                params={"on_conflict": "world_id,npc_id"},
+                json=rows,
+            )
+
+
 def parse_dt(value: Optional[str]) -> Optional[datetime]:
     if not value or not isinstance(value, str):
         return None
@@ -1,11 +1,12 @@
 from __future__ import annotations
 
+import asyncio
 import random
 from dataclasses import dataclass
 from datetime import datetime, timedelta
 from typing import Any, Awaitable, Callable, Dict, List, Optional, Tuple
 
-from .bt import plan_once
+from .bt import SpeakerInput, plan_batch
 from .interfaces import ActorRef, NpcSnapshot, PlannerContext, PlannedEvent, UserSnapshot
 from .memory import InMemoryShortMemoryStore, ShortMemoryStore
 
@@ -20,6 +21,8 @@ class PlannerConfig:
     enabled: bool = True
     cooldown_sec: int = 6
     max_events_per_trigger: int = 2
+    # NPCs at the location planned per trigger (addressed NPC first). 1 = single responder.
+    max_speakers_per_trigger: int = 1
     npc_dialogue_enabled: bool = True
     npc_dialogue_max_events: int = 1
     npc_dialogue_probability: float = 0.22  # per trigger (world_tick only)
@@ -35,15 +38,16 @@ def _get_inmem_store() -> InMemoryShortMemoryStore:
     return _inmem_store
 
 
-def _pick_speaker_npc_id(ctx: PlannerContext) -> Optional[str]:
+def _pick_speaker_npc_ids(ctx: PlannerContext, limit: int) -> List[str]:
     payload = ctx.source_event.get("payload") if isinstance(ctx.source_event.get("payload"), dict) else {}
     to = payload.get("to")
-    if isinstance(to, str) and to.strip():
-        for n in ctx.npcs_here:
-            if n.npc_id == to.strip():
-                return n.npc_id
-    # Default: first NPC at location.
-    return ctx.npcs_here[0].npc_id if ctx.npcs_here else None
+    ids = [n.npc_id for n in ctx.npcs_here if isinstance(getattr(n, "npc_id", None), str) and n.npc_id]
+    ordered: List[str] = []
+    if isinstance(to, str) and to.strip() and to.strip() in ids:
+        ordered.append(to.strip())
+    # Default: NPCs at location in listing order.
+    ordered.extend(ids)
+    return list(dict.fromkeys(ordered))[: max(1, int(limit or 1))]
 
 
 async def maybe_plan_reactions(
@@ -52,36 +56,56 @@ async def maybe_plan_reactions(
     short_memory: Optional[ShortMemoryStore] = None,
     speech_generator: Optional[Callable[[str, PlannerContext], Awaitable[str]]] = None,
     npc_dialogue_llm_generate: Optional[Callable[[str, str, str, Optional[str], PlannerContext], Awaitable[str]]] = None,
-) -> Tuple[List[PlannedEvent], Dict[str, Any]]:
+) -> Tuple[List[PlannedEvent], Dict[str, Dict[str, Any]]]:
     """
-    Returns planned events + updated short memory for the chosen speaker NPC.
+    Returns planned events + updated short memory states ({npc_id: state}, changed NPCs only).
+
+    All speakers at the location are planned in one pass: one batched short memory read,
+    one BT tick per speaker on a cached tree, and speech generation only for speakers the
+    BT lets through (cooldown / trigger), run concurrently. The caller persists the
+    returned states with a single put_states().
 
     I/O-less except for short memory store access (if provided).
     """
     if not cfg.enabled:
         return [], {}
 
-    speaker = _pick_speaker_npc_id(ctx)
-    if not speaker:
+    speakers = _pick_speaker_npc_ids(ctx, cfg.max_speakers_per_trigger)
+    if not speakers:
         return [], {}
 
     store = short_memory or _get_inmem_store()
-    state0 = await store.get_state(ctx.world_id, speaker)
-
-    forced_text: Optional[str] = None
-    if speech_generator is not None:
-        try:
-            forced_text = await speech_generator(speaker, ctx)
-        except Exception:
-            forced_text = None
-    planned, state1 = plan_once(
-        ctx=ctx,
-        speaker_npc_id=speaker,
-        short_memory_state=state0,
-        cooldown_sec=cfg.cooldown_sec,
-        max_events=cfg.max_events_per_trigger,
-        forced_text=forced_text,
-    )
+    try:
+        states0 = await store.get_states(ctx.world_id, speakers)
+    except Exception:
+        states0 = {}
+
+    # Dry pass without speech: the BT is pure, so this tells who will respond before any LLM call.
+    inputs = [SpeakerInput(npc_id=sp, short_memory_state=states0.get(sp) or {}) for sp in speakers]
+    dry = plan_batch(ctx, inputs, cooldown_sec=cfg.cooldown_sec, max_events=cfg.max_events_per_trigger)
+    responders = [sp for sp in inputs if dry[sp.npc_id][0]]
+
+    results = dry
+    if responders and speech_generator is not None:
+
+        async def _speech(npc_id: str) -> Optional[str]:
+            try:
+                return await speech_generator(npc_id, ctx)
+            except Exception:
+                return None
+
+        texts = await asyncio.gather(*[_speech(sp.npc_id) for sp in responders])
+        for sp, text in zip(responders, texts):
+            sp.forced_text = text
+        results = {**dry, **plan_batch(ctx, responders, cooldown_sec=cfg.cooldown_sec, max_events=cfg.max_events_per_trigger)}
+
+    planned: List[PlannedEvent] = []
+    next_states: Dict[str, Dict[str, Any]] = {}
+    for sp in speakers:
+        events, state1 = results[sp]
+        planned.extend(events)
+        if state1 != (states0.get(sp) or {}):
+            next_states[sp] = state1
 
     # Optional: NPC↔NPC dialogue (only on world_tick to avoid stepping on user-facing turns).
     try:
@@ -102,41 +126,38 @@ async def maybe_plan_reactions(
             npc_ids = [n.npc_id for n in (ctx.npcs_here or []) if isinstance(getattr(n, "npc_id", None), str)]
             max_conversations = max(1, int(cfg.npc_dialogue_max_events or 1))
             max_conversations = min(3, max_conversations)
-            prob = float(cfg.npc_dialogue_probability or 0.0)
-            prob = max(0.0, min(1.0, prob))
 
-            conv_i = 0
-            while conv_i < max_conversations:
-                if rng.random() >= prob:
-                    conv_i += 1
-                    continue
-                pair = npc_dialogue_engine.pick_pair(npc_ids, rng=rng)
-                if not pair:
-                    break
-
-                # 2-turn fixed exchange: A -> B, then B -> A.
-                async def _llm_generate(speaker_id: str, listener_id: str, location_id: str, previous_text: Optional[str]) -> str:
-                    if npc_dialogue_llm_generate is None:
-                        return ""
-                    return await npc_dialogue_llm_generate(speaker_id, listener_id, location_id, previous_text, ctx)
-
-                line1, line2 = await npc_dialogue_engine.generate_dialogue_exchange(
-                    pair,
-                    location_id=ctx.location_id,
-                    rng=rng,
-                    llm_generate=_llm_generate if npc_dialogue_llm_generate is not None else None,
-                )
+            tasks = npc_dialogue_engine.schedule_dialogues(
+                npc_ids,
+                seed=seed,
+                rng=rng,
+                max_conversations=max_conversations,
+                probability=float(cfg.npc_dialogue_probability or 0.0),
+            )
+
+            # 2-turn fixed exchange: A -> B, then B -> A.
+            async def _llm_generate(speaker_id: str, listener_id: str, location_id: str, previous_text: Optional[str]) -> str:
+                if npc_dialogue_llm_generate is None:
+                    return ""
+                return await npc_dialogue_llm_generate(speaker_id, listener_id, location_id, previous_text, ctx)
+
+            exchanges = await npc_dialogue_engine.run_dialogue_exchanges(
+                tasks,
+                location_id=ctx.location_id,
+                llm_generate=_llm_generate if npc_dialogue_llm_generate is not None else None,
+            )
+            for task, (line1, line2) in zip(tasks, exchanges):
+                pair = task.pair
                 t1 = str(line1 or "").strip()
                 t2 = str(line2 or "").strip()
                 if not (t1 and t2):
-                    conv_i += 1
                     continue
 
                 conv_id = npc_dialogue_engine.make_conversation_id(
                     seed=seed,
                     speaker_id=pair.speaker_id,
                     listener_id=pair.listener_id,
-                    index=conv_i,
+                    index=task.index,
                 )
 
                 planned.append(
@@ -174,7 +195,6 @@ async def maybe_plan_reactions(
                         },
                     )
                 )
-                conv_i += 1
         except Exception:
             pass
-    return planned, state1
+    return planned, next_states
@@ -1,11 +1,13 @@
 from __future__ import annotations
 
+from contextlib import asynccontextmanager
 from dataclasses import dataclass
-from typing import Any, Dict, Optional
+from typing import Any, AsyncIterator, Callable, Dict, Optional
 
 import httpx
 
 from .interfaces import PlannerContext
+from .llm_scheduler import LANE_BACKGROUND, LANE_USER, LlmScheduler, request_key
 
 
 def _extract_user_text(ctx: PlannerContext) -> str:
@@ -39,6 +41,42 @@ class PersonaChatClient:
     bearer_token: Optional[str] = None
     internal_token: Optional[str] = None
     timeout_sec: float = 25.0
+    # Optional provider of an app-lifetime client (pooled); otherwise a client per call.
+    http_client: Optional[Callable[[], httpx.AsyncClient]] = None
+    # Optional shared budget / coalescing gate (see llm_scheduler.py).
+    scheduler: Optional[LlmScheduler] = None
+
+    @asynccontextmanager
+    async def _client(self) -> AsyncIterator[httpx.AsyncClient]:
+        if self.http_client is not None:
+            yield self.http_client()
+            return
+        async with httpx.AsyncClient(timeout=self.timeout_sec) as client:
+            yield client
+
+    async def _post_chat(self, req: Dict[str, Any], lane: str) -> str:
+        headers: Dict[str, str] = {"Content-Type": "application/json", "Accept": "application/json"}
+        if self.bearer_token:
+            headers["Authorization"] = f"Bearer {self.bearer_token}"
+        if self.internal_token:
+            headers["X-Sigmaris-Internal-Token"] = self.internal_token
+
+        url = self.base_url.rstrip("/") + "/persona/chat"
+
+        async def _call() -> str:
+            async with self._client() as client:
+                r = await client.post(url, headers=headers, json=req, timeout=self.timeout_sec)
+                if r.status_code >= 400:
+                    return ""
+                data = r.json() if r.headers.get("content-type", "").startswith("application/json") else {}
+                reply = data.get("reply") if isinstance(data, dict) else ""
+                return _sanitize_reply(str(reply or ""))
+
+        if self.scheduler is None:
+            return await _call()
+        gen = req.get("gen") if isinstance(req.get("gen"), dict) else {}
+        cost = int(gen.get("max_tokens") or 120)
+        return await self.scheduler.run(request_key(url, req), lane, cost, _call)
 
     async def generate_reply(self, speaker_character_id: str, ctx: PlannerContext) -> str:
         """
@@ -74,20 +112,8 @@ class PersonaChatClient:
         if ctx.user and getattr(ctx.user, "user_id", None):
             req["user_id"] = str(ctx.user.user_id)
 
-        headers: Dict[str, str] = {"Content-Type": "application/json", "Accept": "application/json"}
-        if self.bearer_token:
-            headers["Authorization"] = f"Bearer {self.bearer_token}"
-        if self.internal_token:
-            headers["X-Sigmaris-Internal-Token"] = self.internal_token
-
-        url = self.base_url.rstrip("/") + "/persona/chat"
-        async with httpx.AsyncClient(timeout=self.timeout_sec) as client:
-            r = await client.post(url, headers=headers, json=req)
-            if r.status_code >= 400:
-                return ""
-            data = r.json() if r.headers.get("content-type", "").startswith("application/json") else {}
-            reply = data.get("reply") if isinstance(data, dict) else ""
-            return _sanitize_reply(str(reply or ""))
+        # Reply to a user-facing command: never dropped, admitted ahead of NPC chatter.
+        return await self._post_chat(req, LANE_USER)
 
     async def generate_npc_dialogue_line(
         self,
@@ -145,17 +171,5 @@ class PersonaChatClient:
             "gen": {"temperature": 0.8, "max_tokens": 180},
         }
 
-        headers: Dict[str, str] = {"Content-Type": "application/json", "Accept": "application/json"}
-        if self.bearer_token:
-            headers["Authorization"] = f"Bearer {self.bearer_token}"
-        if self.internal_token:
-            headers["X-Sigmaris-Internal-Token"] = self.internal_token
-
-        url = self.base_url.rstrip("/") + "/persona/chat"
-        async with httpx.AsyncClient(timeout=self.timeout_sec) as client:
-            r = await client.post(url, headers=headers, json=req)
-            if r.status_code >= 400:
-                return ""
-            data = r.json() if r.headers.get("content-type", "").startswith("application/json") else {}
-            reply = data.get("reply") if isinstance(data, dict) else ""
-            return _sanitize_reply(str(reply or ""))
+        # World-tick chatter: budgeted background lane ("" -> caller uses templates).
+        return await self._post_chat(req, LANE_BACKGROUND)
@@ -4,15 +4,17 @@ import os
 import sys
 import json
 import hashlib
+from contextlib import asynccontextmanager
 from pathlib import Path
 from datetime import datetime, timezone, timedelta
-from typing import Any, Dict, List, Optional, Tuple
+from typing import Any, AsyncIterator, Dict, List, Optional, Tuple
 import random
 import asyncio
+import time
 
 import httpx
 from fastapi import FastAPI, Header, HTTPException
-from fastapi.responses import JSONResponse
+from fastapi.responses import JSONResponse, Response
 from pydantic import BaseModel, Field
 
 # Allow running via uvicorn from the monorepo root (so `from planner ...` works).
@@ -23,15 +25,26 @@ if str(_THIS_DIR) not in sys.path:
 from planner import PlannerConfig, maybe_plan_reactions
 from planner.interfaces import NpcSnapshot, PlannerContext, UserSnapshot
 from planner.memory import SupabaseConn, SupabaseShortMemoryStore, InMemoryShortMemoryStore, ShortMemoryStore
+from planner.llm_scheduler import LlmScheduler, LlmSchedulerConfig
 from planner.speech_persona_chat import PersonaChatClient
 from content_loader import (
     load_locations as load_locations_from_content,
     load_events as load_events_from_content,
     load_relationships as load_relationships_from_content,
+    content_fingerprint,
 )
+from event_index import EventIndex
 
 import npc_dialogue_engine
-from world_simulator import WorldSimulatorConfig, simulator_loop
+from world_state_cache import WorldStateCache
+from command_queue import CommandLatencyStats, CommandWakeup, PgNotifyListener
+from world_simulator import (
+    LeaseUnavailable,
+    LocationTickScheduler,
+    WorldLeaseManager,
+    WorldSimulatorConfig,
+    default_owner_id,
+)
 
 
 def _load_root_dotenv_into_environ() -> None:
@@ -129,13 +142,7 @@ async def fetch_recent_summaries(
         n = max(0, min(int(limit or 6), 12))
         if n <= 0:
             return ""
-        channel = f"world:{world_id}:{location_id}"
-        rows = await postgrest_select(
-            client,
-            "world_event_log",
-            f"?channel=eq.{channel}&order=seq.desc&limit={n}&select=seq,ts,type,actor,payload",
-        )
-        rows = list(rows or [])
+        rows = list(await fetch_recent_event_rows(client, world_id, location_id, n))
         rows.reverse()
         parts: List[str] = []
         for r in rows:
@@ -229,21 +236,44 @@ app = FastAPI(title="gensokyo-world-engine", version="0.1.0", default_response_c
 
 _worker_task: Optional[asyncio.Task] = None
 _sim_task: Optional[asyncio.Task] = None
+_sim_scheduler: Optional[LocationTickScheduler] = None
+_command_wakeup = CommandWakeup()
+_command_stats = CommandLatencyStats()
+_command_claim_rpc_missing = False
+_visit_commit_rpc_missing = False
+_pg_listener: Optional[PgNotifyListener] = None
+_world_cache = WorldStateCache(
+    ttl_sec=float(env("GENSOKYO_WORLD_CACHE_TTL_SEC", "10") or "10"),
+    max_items=int(env("GENSOKYO_WORLD_CACHE_MAX_ITEMS", "2048") or "2048"),
+)
 _planner_store: Optional[ShortMemoryStore] = None
+_llm_scheduler: Optional[LlmScheduler] = None
 
 
 @app.get("/health")
 def health():
-    return {"ok": True}
+    out: Dict[str, Any] = {"ok": True}
+    out["world_cache"] = {**_world_cache.stats(), "push": bool(_pg_listener is not None and _pg_listener.listening)}
+    if _worker_task is not None:
+        out["command_worker"] = {
+            **_command_stats.to_dict(),
+            "push": bool(_command_wakeup.listening),
+            "claim_rpc": not _command_claim_rpc_missing,
+        }
+    if _sim_scheduler is not None:
+        out["world_sim"] = _sim_scheduler.stats()
+    if _llm_scheduler is not None:
+        out["npc_llm"] = _llm_scheduler.snapshot()
+    return out
 
 
 @app.on_event("startup")
 async def _startup():
-    global _worker_task, _sim_task
+    global _worker_task, _sim_task, _pg_listener
     # Warm content caches (incl. relationships.json).
     try:
         _ = load_locations()
-        _ = load_events()
+        _ = compiled_event_index()
         _ = load_relationships()
         # Warm npc_dialogue_engine relationship graph cache too.
         try:
@@ -253,6 +283,8 @@ async def _startup():
     except Exception:
         pass
 
+    _start_pg_listener()
+
     enabled = env("GENSOKYO_COMMAND_WORKER_ENABLED", "1").strip() not in ("0", "false", "False")
     if enabled and not (_worker_task and not _worker_task.done()):
         _worker_task = asyncio.create_task(command_worker_loop(x_world_secret=WORLD_ENGINE_SECRET or None))
@@ -260,18 +292,55 @@ async def _startup():
     sim_enabled = env("GENSOKYO_WORLD_SIM_ENABLED", "0").strip() not in ("0", "false", "False")
     if sim_enabled and not (_sim_task and not _sim_task.done()):
         cfg = world_simulator_config()
-        _sim_task = asyncio.create_task(simulator_loop(cfg=cfg, tick_once=_world_sim_tick_once, on_error=_on_sim_error))
+        _sim_task = asyncio.create_task(_world_sim_run(cfg))
 
 
 @app.on_event("shutdown")
 async def _shutdown():
-    global _worker_task, _sim_task
+    global _worker_task, _sim_task, _pg_listener
     if _worker_task:
         _worker_task.cancel()
         _worker_task = None
     if _sim_task:
         _sim_task.cancel()
         _sim_task = None
+    if _pg_listener is not None:
+        await _pg_listener.aclose()
+        _pg_listener = None
+    await close_shared_http_client()
+
+
+def _start_pg_listener() -> None:
+    """
+    Optional LISTEN connection (GENSOKYO_DATABASE_URL + asyncpg) carrying:
+    - world_command: command worker wakeup
+    - world_event:   world_event_log appends (same stream the event gateway relays) -> cache invalidation
+    """
+
+    global _pg_listener
+    db_url = (env("GENSOKYO_DATABASE_URL", "") or "").strip()
+    if not db_url or _pg_listener is not None:
+        return
+    listener = PgNotifyListener(db_url)
+    _command_wakeup.attach(listener, "world_command")
+    listener.on("world_event", _on_world_event_notify)
+    if listener.start(on_error=_on_command_worker_error):
+        _pg_listener = listener
+
+
+def _on_world_event_notify(payload: Optional[str]) -> None:
+    if payload is None:
+        # (Re)connected: notifications may have been missed.
+        _world_cache.clear()
+        return
+    try:
+        data = json.loads(payload)
+    except Exception:
+        return
+    world_id = str(data.get("world_id") or "") if isinstance(data, dict) else ""
+    if not world_id:
+        return
+    _world_cache.on_remote_event(world_id, str(data.get("location_id") or ""), data.get("seq"))
 
 
 def _on_sim_error(e: Exception) -> None:
@@ -296,7 +365,88 @@ def _csv_env(name: str) -> List[str]:
 def world_simulator_config() -> WorldSimulatorConfig:
     enabled = env("GENSOKYO_WORLD_SIM_ENABLED", "0").strip() not in ("0", "false", "False")
     interval_sec = int(env("GENSOKYO_WORLD_SIM_INTERVAL_SEC", "30") or "30")
-    return WorldSimulatorConfig(enabled=enabled, interval_sec=interval_sec)
+    max_concurrency = int(env("GENSOKYO_WORLD_SIM_MAX_CONCURRENCY", "8") or "8")
+    per_world_concurrency = int(env("GENSOKYO_WORLD_SIM_PER_WORLD_CONCURRENCY", "4") or "4")
+    overrun_policy = (env("GENSOKYO_WORLD_SIM_OVERRUN_POLICY", "coalesce") or "coalesce").strip().lower()
+    if overrun_policy not in ("coalesce", "skip"):
+        overrun_policy = "coalesce"
+    lease_ttl_sec = int(env("GENSOKYO_WORLD_SIM_LEASE_TTL_SEC", "0") or "0")
+    max_worlds = int(env("GENSOKYO_WORLD_SIM_MAX_WORLDS_PER_REPLICA", "0") or "0")
+    return WorldSimulatorConfig(
+        enabled=enabled,
+        interval_sec=interval_sec,
+        max_concurrency=max(1, min(64, max_concurrency)),
+        per_world_concurrency=max(1, min(64, per_world_concurrency)),
+        overrun_policy=overrun_policy,
+        lease_ttl_sec=max(0, lease_ttl_sec),
+        max_worlds_per_replica=max(0, max_worlds),
+    )
+
+
+async def _world_sim_try_lease(client: httpx.AsyncClient, world_id: str, owner_id: str, ttl_sec: int) -> bool:
+    r = await client.post(
+        rpc_url("world_sim_try_lease"),
+        headers=auth_headers(),
+        json={"p_world_id": world_id, "p_owner_id": owner_id, "p_ttl_sec": int(ttl_sec)},
+    )
+    if r.status_code == 404:
+        # RPC not installed (older schema): run as the only replica.
+        raise LeaseUnavailable("world_sim_try_lease missing")
+    if r.status_code >= 400:
+        raise RuntimeError(f"world_sim_try_lease_failed:{r.status_code}:{r.text}")
+    return r.json() is True
+
+
+async def _world_sim_release_lease(client: httpx.AsyncClient, world_id: str, owner_id: str) -> None:
+    await client.post(
+        rpc_url("world_sim_release_lease"),
+        headers=auth_headers(),
+        json={"p_world_id": world_id, "p_owner_id": owner_id},
+    )
+
+
+async def _world_sim_run(cfg: WorldSimulatorConfig) -> None:
+    """
+    Background world simulation: location ticks fan out with bounded concurrency,
+    worlds are sharded across replicas via leases (GENSOKYO_WORLD_SIM_LEASES=0 disables).
+    """
+
+    global _sim_scheduler
+    if not (SUPABASE_URL and SUPABASE_SERVICE_ROLE_KEY):
+        return
+
+    max_locations = _world_sim_max_locations()
+    async with world_http() as client:
+        leases: Optional[WorldLeaseManager] = None
+        if env("GENSOKYO_WORLD_SIM_LEASES", "1").strip() not in ("0", "false", "False"):
+            leases = WorldLeaseManager(
+                owner_id=default_owner_id(),
+                ttl_sec=cfg.lease_ttl_sec or max(1, cfg.interval_sec) * 3,
+                acquire=lambda w, o, t: _world_sim_try_lease(client, w, o, t),
+                release=lambda w, o: _world_sim_release_lease(client, w, o),
+                max_worlds=cfg.max_worlds_per_replica,
+            )
+
+        async def _list_locations(world_id: str, dt: datetime) -> List[str]:
+            return await _fetch_active_locations(client, world_id=world_id, now=dt, max_locations=max_locations)
+
+        async def _tick(world_id: str, location_id: str, dt: datetime, world_lock: asyncio.Lock) -> None:
+            await _world_sim_tick_location(client, world_id=world_id, location_id=location_id, dt=dt, world_lock=world_lock)
+
+        scheduler = LocationTickScheduler(
+            cfg=cfg,
+            list_worlds=lambda: _fetch_world_ids(client),
+            list_locations=_list_locations,
+            tick_location=_tick,
+            leases=leases,
+            on_error=_on_sim_error,
+        )
+        _sim_scheduler = scheduler
+        try:
+            await scheduler.run()
+        finally:
+            if _sim_scheduler is scheduler:
+                _sim_scheduler = None
 
 
 async def _fetch_world_ids(client: httpx.AsyncClient) -> List[str]:
@@ -376,177 +526,197 @@ async def _fetch_active_locations(
     return ["hakurei_shrine"]
 
 
-async def _world_sim_tick_once(dt: datetime) -> None:
+def _world_sim_layer_id(world_id: str) -> str:
+    return "gensokyo" if world_id.startswith("gensokyo") else "gensokyo"
+
+
+def _world_sim_max_locations() -> int:
+    max_locations = int(env("GENSOKYO_WORLD_SIM_MAX_LOCATIONS", "2") or "2")
+    return max(1, min(200, max_locations))
+
+
+async def _world_sim_tick_location(
+    client: httpx.AsyncClient,
+    *,
+    world_id: str,
+    location_id: str,
+    dt: datetime,
+    world_lock: asyncio.Lock,
+) -> None:
     """
-    Autonomous world loop tick.
+    Autonomous world tick for one location.
 
     Uses /world/visit logic for time-skip event generation, then adds:
     - NPC movement (very lightweight, rule-based)
     - NPC-to-NPC dialogue (BT planner trigger on a synthetic world_tick source event)
-    """
 
-    if not (SUPABASE_URL and SUPABASE_SERVICE_ROLE_KEY):
-        return
+    Locations of one world tick concurrently; NPC movement crosses locations, so that
+    step runs under world_lock to keep one world's moves ordered.
+    """
 
-    max_locations = int(env("GENSOKYO_WORLD_SIM_MAX_LOCATIONS", "2") or "2")
-    max_locations = max(1, min(20, max_locations))
+    layer_id = _world_sim_layer_id(world_id)
     move_prob = float(env("GENSOKYO_WORLD_SIM_NPC_MOVE_PROB", "0.18") or "0.18")
     move_prob = max(0.0, min(1.0, move_prob))
 
-    async with httpx.AsyncClient(timeout=20.0) as client:
-        world_ids = await _fetch_world_ids(client)
-        for world_id in world_ids:
-            layer_id = "gensokyo" if world_id.startswith("gensokyo") else "gensokyo"
-            locs = await _fetch_active_locations(
-                client,
+    # 1) Time-skip event generation via visit (visitor_key isolates simulator cadence).
+    try:
+        await visit(
+            VisitRequest(
                 world_id=world_id,
-                now=dt,
-                max_locations=max_locations,
-            )
-            for location_id in locs:
-                # 1) Time-skip event generation via visit (visitor_key isolates simulator cadence).
+                layer_id=layer_id,
+                location_id=location_id,
+                sub_location_id=None,
+                user_time=dt.isoformat(),
+                visitor_key="world_simulator",
+            ),
+            x_world_secret=WORLD_ENGINE_SECRET or None,
+        )
+    except Exception:
+        # best-effort: keep the loop alive
+        pass
+
+    # 2) Ensure NPC presence and optionally move one NPC.
+    async with world_lock:
+        await ensure_default_npcs_present(client, world_id=world_id, location_id=location_id)
+        npcs_here = await fetch_npcs_here(client, world_id=world_id, location_id=location_id)
+        if npcs_here and move_prob > 0 and random.random() < move_prob:
+            neigh = _location_neighbors(location_id)
+            if neigh:
+                mover = random.choice(npcs_here)
+                dst = random.choice(neigh)
                 try:
-                    await visit(
-                        VisitRequest(
+                    await postgrest_upsert_one(
+                        client,
+                        "world_npc_state",
+                        {
+                            "world_id": world_id,
+                            "npc_id": mover.npc_id,
+                            "location_id": dst,
+                            "action": "move",
+                            "emotion": mover.emotion or "neutral",
+                            "updated_at": dt.isoformat(),
+                        },
+                        on_conflict="world_id,npc_id",
+                    )
+                    await emit_event(
+                        EmitEventRequest(
                             world_id=world_id,
                             layer_id=layer_id,
                             location_id=location_id,
-                            sub_location_id=None,
-                            user_time=dt.isoformat(),
-                            visitor_key="world_simulator",
+                            type="npc_action",
+                            actor=Actor(kind="npc", id=mover.npc_id),
+                            ts=dt.isoformat(),
+                            payload={
+                                "event_type": "npc_move",
+                                "from": location_id,
+                                "to": dst,
+                                "summary": f"{mover.npc_id} moved to {dst}",
+                            },
                         ),
                         x_world_secret=WORLD_ENGINE_SECRET or None,
                     )
                 except Exception:
-                    # best-effort: keep the loop alive
                     pass
 
-                # 2) Ensure NPC presence and optionally move one NPC.
-                await ensure_default_npcs_present(client, world_id=world_id, location_id=location_id)
-                npcs_here = await fetch_npcs_here(client, world_id=world_id, location_id=location_id)
-                if npcs_here and move_prob > 0 and random.random() < move_prob:
-                    neigh = _location_neighbors(location_id)
-                    if neigh:
-                        mover = random.choice(npcs_here)
-                        dst = random.choice(neigh)
-                        try:
-                            await postgrest_upsert_one(
-                                client,
-                                "world_npc_state",
-                                {
-                                    "world_id": world_id,
-                                    "npc_id": mover.npc_id,
-                                    "location_id": dst,
-                                    "action": "move",
-                                    "emotion": mover.emotion or "neutral",
-                                    "updated_at": dt.isoformat(),
-                                },
-                                on_conflict="world_id,npc_id",
-                            )
-                            await emit_event(
-                                EmitEventRequest(
-                                    world_id=world_id,
-                                    layer_id=layer_id,
-                                    location_id=location_id,
-                                    type="npc_action",
-                                    actor=Actor(kind="npc", id=mover.npc_id),
-                                    ts=dt.isoformat(),
-                                    payload={
-                                        "event_type": "npc_move",
-                                        "from": location_id,
-                                        "to": dst,
-                                        "summary": f"{mover.npc_id} moved to {dst}",
-                                    },
-                                ),
-                                x_world_secret=WORLD_ENGINE_SECRET or None,
-                            )
-                        except Exception:
-                            pass
-
-                # 3) Trigger planner on a synthetic world_tick source event (dialogue + tiny actions).
-                try:
-                    await ensure_default_npcs_present(client, world_id=world_id, location_id=location_id)
-                    npcs_here = await fetch_npcs_here(client, world_id=world_id, location_id=location_id)
-                    ctx = PlannerContext(
-                        world_id=world_id,
-                        layer_id=layer_id,
-                        location_id=location_id,
-                        source_event={
-                            "id": "",
-                            "world_id": world_id,
-                            "layer_id": layer_id,
-                            "location_id": location_id,
-                            "type": "world_tick",
-                            "actor": {"kind": "system", "id": "world_simulator"},
-                            "payload": {"event_type": "world_tick"},
-                        },
-                        npcs_here=npcs_here,
-                        user=None,
-                        now=dt,
-                    )
-                    # No user relations in autonomous ticks.
-                    store = get_short_memory_store()
-                    llm = persona_chat_client()
+    # 3) Trigger planner on a synthetic world_tick source event (dialogue + tiny actions).
+    try:
+        await ensure_default_npcs_present(client, world_id=world_id, location_id=location_id)
+        npcs_here, world_ctx = await asyncio.gather(
+            fetch_npcs_here(client, world_id=world_id, location_id=location_id),
+            fetch_recent_summaries(client, world_id=world_id, location_id=location_id, limit=8),
+        )
+        ctx = PlannerContext(
+            world_id=world_id,
+            layer_id=layer_id,
+            location_id=location_id,
+            source_event={
+                "id": "",
+                "world_id": world_id,
+                "layer_id": layer_id,
+                "location_id": location_id,
+                "type": "world_tick",
+                "actor": {"kind": "system", "id": "world_simulator"},
+                "payload": {"event_type": "world_tick"},
+            },
+            npcs_here=npcs_here,
+            user=None,
+            now=dt,
+        )
+        # No user relations in autonomous ticks.
+        store = get_short_memory_store()
+        llm = persona_chat_client()
+
+        async def _speech(speaker_id: str, _ctx: PlannerContext) -> str:
+            if llm is None:
+                return ""
+            return await llm.generate_reply(speaker_character_id=speaker_id, ctx=_ctx)
+
+        async def _npc_dialogue_llm(
+            speaker_id: str,
+            listener_id: str,
+            loc_id: str,
+            previous_text: Optional[str],
+            _ctx: PlannerContext,
+        ) -> str:
+            if llm is None:
+                return ""
+            return await llm.generate_npc_dialogue_line(
+                speaker_character_id=speaker_id,
+                listener_character_id=listener_id,
+                location_id=loc_id,
+                ctx=_ctx,
+                previous_text=previous_text,
+                world_context=world_ctx,
+            )
 
-                    async def _speech(speaker_id: str, _ctx: PlannerContext) -> str:
-                        if llm is None:
-                            return ""
-                        return await llm.generate_reply(speaker_character_id=speaker_id, ctx=_ctx)
+        cfg = planner_config()
+        planned, _next_mem = await maybe_plan_reactions(
+            cfg=cfg,
+            ctx=ctx,
+            short_memory=store,
+            speech_generator=_speech,
+            npc_dialogue_llm_generate=_npc_dialogue_llm if llm is not None else None,
+        )
+        for pe in planned or []:
+            await emit_event(
+                EmitEventRequest(
+                    world_id=world_id,
+                    layer_id=layer_id,
+                    location_id=location_id,
+                    type=pe.type,
+                    actor=Actor(kind=pe.actor.kind, id=pe.actor.id),
+                    ts=pe.ts.isoformat(),
+                    payload=pe.payload,
+                ),
+                x_world_secret=WORLD_ENGINE_SECRET or None,
+            )
+    except Exception:
+        pass
 
-                    world_ctx = await fetch_recent_summaries(
-                        client,
-                        world_id=world_id,
-                        location_id=location_id,
-                        limit=8,
-                    )
 
-                    async def _npc_dialogue_llm(
-                        speaker_id: str,
-                        listener_id: str,
-                        loc_id: str,
-                        previous_text: Optional[str],
-                        _ctx: PlannerContext,
-                    ) -> str:
-                        if llm is None:
-                            return ""
-                        return await llm.generate_npc_dialogue_line(
-                            speaker_character_id=speaker_id,
-                            listener_character_id=listener_id,
-                            location_id=loc_id,
-                            ctx=_ctx,
-                            previous_text=previous_text,
-                            world_context=world_ctx,
-                        )
+async def _world_sim_tick_once(dt: datetime) -> None:
+    """
+    One sequential pass over every world/location (manual / debugging use).
+    The background loop uses LocationTickScheduler instead.
+    """
 
-                    cfg = planner_config()
-                    planned, _next_mem = await maybe_plan_reactions(
-                        cfg=cfg,
-                        ctx=ctx,
-                        short_memory=store,
-                        speech_generator=_speech,
-                        npc_dialogue_llm_generate=_npc_dialogue_llm if llm is not None else None,
-                    )
-                    for pe in planned or []:
-                        await emit_event(
-                            EmitEventRequest(
-                                world_id=world_id,
-                                layer_id=layer_id,
-                                location_id=location_id,
-                                type=pe.type,
-                                actor=Actor(kind=pe.actor.kind, id=pe.actor.id),
-                                ts=pe.ts.isoformat(),
-                                payload=pe.payload,
-                            ),
-                            x_world_secret=WORLD_ENGINE_SECRET or None,
-                        )
-                except Exception:
-                    pass
+    if not (SUPABASE_URL and SUPABASE_SERVICE_ROLE_KEY):
+        return
+
+    max_locations = _world_sim_max_locations()
+    async with world_http() as client:
+        for world_id in await _fetch_world_ids(client):
+            locs = await _fetch_active_locations(client, world_id=world_id, now=dt, max_locations=max_locations)
+            lock = asyncio.Lock()
+            for location_id in locs:
+                await _world_sim_tick_location(client, world_id=world_id, location_id=location_id, dt=dt, world_lock=lock)
 
 
 def planner_config() -> PlannerConfig:
     enabled = env("GENSOKYO_NPC_PLANNER_ENABLED", "1").strip() not in ("0", "false", "False")
     cooldown_sec = int(env("GENSOKYO_NPC_PLANNER_COOLDOWN_SEC", "6") or "6")
     max_events = int(env("GENSOKYO_NPC_PLANNER_MAX_EVENTS", "2") or "2")
+    max_speakers = max(1, min(8, int(env("GENSOKYO_NPC_PLANNER_MAX_SPEAKERS", "1") or "1")))
     npc_dialogue_enabled = env("GENSOKYO_NPC_DIALOGUE_ENABLED", "1").strip() not in ("0", "false", "False")
     npc_dialogue_max_events = int(env("GENSOKYO_NPC_DIALOGUE_MAX_EVENTS", "1") or "1")
     try:
@@ -559,6 +729,7 @@ def planner_config() -> PlannerConfig:
         enabled=enabled,
         cooldown_sec=cooldown_sec,
         max_events_per_trigger=max_events,
+        max_speakers_per_trigger=max_speakers,
         npc_dialogue_enabled=npc_dialogue_enabled,
         npc_dialogue_max_events=npc_dialogue_max_events,
         npc_dialogue_probability=npc_dialogue_probability,
@@ -582,7 +753,7 @@ def get_short_memory_store() -> ShortMemoryStore:
 
     if SUPABASE_URL and SUPABASE_SERVICE_ROLE_KEY:
         conn = SupabaseConn(base_url=postgrest_base_url().rstrip("/"), headers=auth_headers())
-        _planner_store = SupabaseShortMemoryStore(conn)
+        _planner_store = SupabaseShortMemoryStore(conn, client=shared_http_client)
         return _planner_store
 
     _planner_store = InMemoryShortMemoryStore()
@@ -600,7 +771,44 @@ def persona_chat_client() -> Optional[PersonaChatClient]:
         return None
     bearer = (env("GENSOKYO_PERSONA_CORE_BEARER_TOKEN", "") or "").strip() or None
     internal = (env("GENSOKYO_PERSONA_CORE_INTERNAL_TOKEN", "") or "").strip() or None
-    return PersonaChatClient(base_url=base, bearer_token=bearer, internal_token=internal)
+    return PersonaChatClient(
+        base_url=base,
+        bearer_token=bearer,
+        internal_token=internal,
+        http_client=shared_http_client,
+        scheduler=llm_scheduler(),
+    )
+
+
+def llm_scheduler() -> LlmScheduler:
+    """
+    Process-wide budget for persona-core calls made by NPC planning / dialogue.
+    User-facing replies are admitted first; world-tick chatter is capped and falls back to templates.
+    """
+    global _llm_scheduler
+    if _llm_scheduler is not None:
+        return _llm_scheduler
+
+    def _int(name: str, default: int) -> int:
+        try:
+            return int(env(name, str(default)) or str(default))
+        except Exception:
+            return default
+
+    try:
+        ttl = float(env("GENSOKYO_NPC_LLM_COALESCE_TTL_SEC", "15") or "15")
+    except Exception:
+        ttl = 15.0
+    _llm_scheduler = LlmScheduler(
+        LlmSchedulerConfig(
+            max_concurrency=max(1, _int("GENSOKYO_NPC_LLM_MAX_CONCURRENCY", 4)),
+            background_max=max(0, _int("GENSOKYO_NPC_LLM_BACKGROUND_MAX", 2)),
+            background_tokens_per_min=max(0, _int("GENSOKYO_NPC_LLM_BACKGROUND_TOKENS_PER_MIN", 6000)),
+            background_wait_ms=max(0, _int("GENSOKYO_NPC_LLM_BACKGROUND_WAIT_MS", 3000)),
+            coalesce_ttl_sec=max(0.0, ttl),
+        )
+    )
+    return _llm_scheduler
 
 
 def check_secret(x_world_secret: Optional[str]):
@@ -695,10 +903,52 @@ def log_world_visit_debug(data: Dict[str, Any]):
 _LOC_CACHE: Optional[Dict[str, Any]] = None
 _EVENT_CACHE: Optional[List[Dict[str, Any]]] = None
 _REL_CACHE: Optional[List[Dict[str, Any]]] = None
+_EVENT_INDEX: Optional[EventIndex] = None
+_CONTENT_FINGERPRINT: Optional[str] = None
+_CONTENT_CHECKED_AT = 0.0
+
+
+def _content_reload_sec() -> float:
+    # 0 disables hot reload (content is read once per process).
+    try:
+        return max(0.0, float(env("GENSOKYO_CONTENT_RELOAD_SEC", "5") or 5))
+    except Exception:
+        return 5.0
+
+
+def _check_content_changed() -> None:
+    """
+    Drop content caches (and the compiled event index) when the content root changed.
+    The directory is stat'ed at most every GENSOKYO_CONTENT_RELOAD_SEC.
+    """
+
+    global _LOC_CACHE, _EVENT_CACHE, _REL_CACHE, _EVENT_INDEX, _CONTENT_FINGERPRINT, _CONTENT_CHECKED_AT
+    interval = _content_reload_sec()
+    if _CONTENT_FINGERPRINT is not None and interval <= 0:
+        return
+    now = time.monotonic()
+    if _CONTENT_FINGERPRINT is not None and now - _CONTENT_CHECKED_AT < interval:
+        return
+    _CONTENT_CHECKED_AT = now
+    try:
+        fp = content_fingerprint()
+    except Exception:
+        return
+    if fp == _CONTENT_FINGERPRINT:
+        return
+    if _CONTENT_FINGERPRINT is not None:
+        print("[world.content] content changed; reloading", flush=True)
+    _CONTENT_FINGERPRINT = fp
+    _LOC_CACHE = None
+    _EVENT_CACHE = None
+    _REL_CACHE = None
+    _EVENT_INDEX = None
+    npc_dialogue_engine._REL_CACHE = None
 
 
 def load_locations() -> Dict[str, Any]:
     global _LOC_CACHE
+    _check_content_changed()
     if _LOC_CACHE is not None:
         return _LOC_CACHE
     data = load_locations_from_content()
@@ -708,19 +958,81 @@ def load_locations() -> Dict[str, Any]:
 
 def load_events() -> List[Dict[str, Any]]:
     global _EVENT_CACHE
+    _check_content_changed()
     if _EVENT_CACHE is not None:
         return _EVENT_CACHE
     _EVENT_CACHE = load_events_from_content()
     return _EVENT_CACHE
 
 
+def compiled_event_index() -> EventIndex:
+    """load_events() compiled for sampling (rebuilt when the content changes)."""
+    global _EVENT_INDEX
+    defs = load_events()
+    if _EVENT_INDEX is None:
+        _EVENT_INDEX = EventIndex(defs, fingerprint=_CONTENT_FINGERPRINT or "")
+    return _EVENT_INDEX
+
+
 def load_relationships() -> List[Dict[str, Any]]:
     global _REL_CACHE
+    _check_content_changed()
     if _REL_CACHE is not None:
         return _REL_CACHE
     rr = load_relationships_from_content()
     _REL_CACHE = rr if isinstance(rr, list) else []
     return _REL_CACHE
+
+
+# --------------------------------------------
+# Shared HTTP client (app lifetime)
+# --------------------------------------------
+# One pooled AsyncClient for every handler / background loop: keep-alive + HTTP/2
+# (when `h2` is installed) instead of a TCP/TLS handshake per request.
+
+_http_client: Optional[httpx.AsyncClient] = None
+
+
+def _http2_available() -> bool:
+    try:
+        import h2  # type: ignore  # noqa: F401
+    except Exception:
+        return False
+    return True
+
+
+def shared_http_client() -> httpx.AsyncClient:
+    global _http_client
+    if _http_client is None or _http_client.is_closed:
+        http2 = env("GENSOKYO_HTTP2", "1").strip() not in ("0", "false", "False") and _http2_available()
+        max_conn = max(4, int(env("GENSOKYO_HTTP_MAX_CONNECTIONS", "100") or "100"))
+        _http_client = httpx.AsyncClient(
+            timeout=20.0,
+            http2=http2,
+            limits=httpx.Limits(
+                max_connections=max_conn,
+                max_keepalive_connections=max(4, max_conn // 2),
+                keepalive_expiry=30.0,
+            ),
+        )
+    return _http_client
+
+
+@asynccontextmanager
+async def world_http() -> AsyncIterator[httpx.AsyncClient]:
+    """`async with world_http() as client:` — borrows the shared client (never closes it)."""
+    yield shared_http_client()
+
+
+async def close_shared_http_client() -> None:
+    global _http_client
+    c = _http_client
+    _http_client = None
+    if c is not None and not c.is_closed:
+        try:
+            await c.aclose()
+        except Exception:
+            pass
 
 
 def table_url(table: str) -> str:
@@ -754,13 +1066,114 @@ async def postgrest_upsert_one(
     if r.status_code >= 400:
         raise HTTPException(status_code=500, detail=f"upsert_failed:{table}:{r.status_code}:{r.text}")
     data = r.json()
+    out = row
     if isinstance(data, list) and data:
-        return data[0]
-    if isinstance(data, dict):
-        return data
+        out = data[0]
+    elif isinstance(data, dict):
+        out = data
+    _cache_write_through(table, [out])
+    return out
+
+
+def _cache_write_through(table: str, rows: List[Dict[str, Any]]) -> None:
+    # Keep the world read cache coherent with this process's own writes.
+    if table == "world_state":
+        for row in rows:
+            _world_cache.put_state(row)
+    elif table == "world_npc_state":
+        by_world: Dict[str, List[Dict[str, Any]]] = {}
+        for row in rows:
+            if isinstance(row, dict) and row.get("world_id"):
+                by_world.setdefault(str(row["world_id"]), []).append(row)
+        for world_id, world_rows in by_world.items():
+            _world_cache.merge_npcs(world_id, world_rows)
+
+
+async def fetch_world_state_row(client: httpx.AsyncClient, world_id: str, location_id: str) -> Optional[Dict[str, Any]]:
+    cached = _world_cache.get_state(world_id, location_id)
+    if cached is not None:
+        return cached
+    v = _world_cache.version("state", world_id, location_id)
+    rows = await postgrest_select(
+        client,
+        "world_state",
+        f"?world_id=eq.{world_id}&location_id=eq.{location_id}&select=*",
+    )
+    row = rows[0] if isinstance(rows, list) and rows and isinstance(rows[0], dict) else None
+    if row is not None:
+        _world_cache.put_state(row, expect_version=v)
     return row
 
 
+async def fetch_world_npc_rows(client: httpx.AsyncClient, world_id: str) -> List[Dict[str, Any]]:
+    # All NPC rows of the world (cached as one list; per-location views filter it).
+    cached = _world_cache.get_npcs(world_id)
+    if cached is not None:
+        return cached
+    v = _world_cache.version("npcs", world_id)
+    rows = await postgrest_select(
+        client,
+        "world_npc_state",
+        f"?world_id=eq.{world_id}&select=npc_id,location_id,action,emotion,updated_at",
+    )
+    out = [r for r in rows or [] if isinstance(r, dict)]
+    _world_cache.put_npcs(world_id, out, expect_version=v)
+    return out
+
+
+async def fetch_recent_event_rows(
+    client: httpx.AsyncClient,
+    world_id: str,
+    location_id: str,
+    limit: int,
+) -> List[Dict[str, Any]]:
+    # Latest events of world:{world_id}[:{location_id}], seq desc.
+    cached = _world_cache.get_recent(world_id, location_id, limit)
+    if cached is not None:
+        return cached
+    v = _world_cache.version("recent", world_id, location_id)
+    channel = f"world:{world_id}" if not location_id else f"world:{world_id}:{location_id}"
+    rows = await postgrest_select(
+        client,
+        "world_event_log",
+        f"?channel=eq.{channel}&order=seq.desc&limit={int(limit)}&select=seq,ts,type,actor,payload",
+    )
+    out = [r for r in rows or [] if isinstance(r, dict)]
+    _world_cache.put_recent(world_id, location_id, limit, out, expect_version=v)
+    return out
+
+
+def _etag_matches(if_none_match: Optional[str], etag: str) -> bool:
+    if not if_none_match:
+        return False
+    tags = [t.strip() for t in if_none_match.split(",")]
+    return "*" in tags or etag in tags
+
+
+def _conditional_json(content: Any, etag: str, if_none_match: Optional[str]) -> Response:
+    headers = {"ETag": etag, "Cache-Control": "no-cache"}
+    if _etag_matches(if_none_match, etag):
+        return Response(status_code=304, headers=headers)
+    return Utf8JSONResponse(content=content, headers=headers)
+
+
+async def postgrest_upsert_many(
+    client: httpx.AsyncClient,
+    table: str,
+    rows: List[Dict[str, Any]],
+    on_conflict: str,
+) -> None:
+    # Bulk upsert in one request (rows must not repeat a conflict key).
+    if not rows:
+        return
+    headers = auth_headers()
+    headers["Prefer"] = "resolution=merge-duplicates,return=minimal"
+    r = await client.post(table_url(table) + f"?on_conflict={on_conflict}", headers=headers, json=rows)
+    if r.status_code >= 400:
+        raise HTTPException(status_code=500, detail=f"upsert_failed:{table}:{r.status_code}:{r.text}")
+    _cache_write_through(table, rows)
+
+
 async def postgrest_update(
     client: httpx.AsyncClient,
     table: str,
@@ -805,16 +1218,12 @@ def default_npcs_for_location(location_id: str) -> List[str]:
 
     # Fallback: infer from event definitions (required participants for this location).
     try:
-        events = load_events()
+        events = compiled_event_index().by_location.get(location_id, [])
     except Exception:
         return out
     for e in events:
-        if not isinstance(e, dict) or str(e.get("location_id") or "") != location_id:
-            continue
-        parts = e.get("participants") if isinstance(e.get("participants"), dict) else {}
-        required = parts.get("required") if isinstance(parts.get("required"), list) else []
-        for n in required:
-            if isinstance(n, str) and n.strip() and n.strip() not in out:
+        for n in e.participants:
+            if n.strip() not in out:
                 out.append(n.strip())
     return out
 
@@ -831,19 +1240,6 @@ def check_sub_location(parent_location_id: str, sub_location_id: Optional[str])
     return None
 
 
-def event_constraints_ok(defn: Dict[str, Any], world_state: Dict[str, Any]) -> bool:
-    c = defn.get("constraints") if isinstance(defn.get("constraints"), dict) else {}
-    tod = str(world_state.get("time_of_day") or "")
-    weather = str(world_state.get("weather") or "")
-    if isinstance(c.get("time_of_day"), list) and c["time_of_day"]:
-        if tod not in [str(x) for x in c["time_of_day"]]:
-            return False
-    if isinstance(c.get("weather_not"), list) and c["weather_not"]:
-        if weather in [str(x) for x in c["weather_not"]]:
-            return False
-    return True
-
-
 def event_participants(defn: Dict[str, Any]) -> List[str]:
     parts = defn.get("participants")
     if not isinstance(parts, dict):
@@ -868,29 +1264,6 @@ def extract_summary(row: Dict[str, Any]) -> str:
     return ""
 
 
-def recent_weight(event_id: str, recent_event_types: List[str]) -> float:
-    # Docs examples: within last 3 -> 0.05, within last 10 -> 0.2
-    if event_id in recent_event_types[:3]:
-        return 0.05
-    if event_id in recent_event_types[:10]:
-        return 0.2
-    return 1.0
-
-
-def effect_location_changes(defn: Dict[str, Any]) -> List[Tuple[str, str]]:
-    effects = defn.get("effects") if isinstance(defn.get("effects"), dict) else {}
-    state = effects.get("state") if isinstance(effects.get("state"), list) else []
-    changes: List[Tuple[str, str]] = []
-    for e in state:
-        if not isinstance(e, dict):
-            continue
-        target = e.get("target")
-        patch = e.get("set") if isinstance(e.get("set"), dict) else {}
-        if isinstance(target, str) and isinstance(patch.get("location_id"), str) and patch.get("location_id"):
-            changes.append((target, str(patch.get("location_id"))))
-    return changes
-
-
 def apply_effects_world(world_state: Dict[str, Any], defn: Dict[str, Any]) -> Dict[str, Any]:
     effects = defn.get("effects") if isinstance(defn.get("effects"), dict) else {}
     world = effects.get("world") if isinstance(effects.get("world"), list) else []
@@ -928,7 +1301,7 @@ async def emit_event(req: EmitEventRequest, x_world_secret: Optional[str] = Head
     payload = req.payload or {}
     ts = parse_user_time(req.ts) if req.ts else None
 
-    async with httpx.AsyncClient(timeout=20.0) as client:
+    async with world_http() as client:
         r = await client.post(
             rpc_url("world_append_event"),
             headers=auth_headers(),
@@ -945,7 +1318,14 @@ async def emit_event(req: EmitEventRequest, x_world_secret: Optional[str] = Head
         if r.status_code >= 400:
             raise HTTPException(status_code=500, detail=f"append_event_failed: {r.status_code} {r.text}")
 
-        return {"ok": True, "event": r.json()}
+        event = r.json()
+        _world_cache.on_event(
+            req.world_id,
+            req.location_id or "",
+            [event.get("seq")] if isinstance(event, dict) else [],
+            expect_echo=_pg_listener is not None,
+        )
+        return {"ok": True, "event": event}
 
 
 def command_trace(cmd: Dict[str, Any]) -> Dict[str, Any]:
@@ -1166,7 +1546,7 @@ async def emit_for_command(cmd: Dict[str, Any], x_world_secret: Optional[str]) -
         if not (npc_id and to_loc):
             raise HTTPException(status_code=400, detail="npc_move_missing:npc_id/to")
 
-        async with httpx.AsyncClient(timeout=20.0) as client:
+        async with world_http() as client:
             prev_loc = ""
             try:
                 rows = await postgrest_select(
@@ -1261,23 +1641,26 @@ async def ensure_default_npcs_present(
     world_id: str,
     location_id: str,
 ):
-    defaults = default_npcs_for_location(location_id)
+    defaults = list(dict.fromkeys(default_npcs_for_location(location_id)))
     if not defaults:
         return
-    for npc_id in defaults:
-        await postgrest_upsert_one(
-            client,
-            "world_npc_state",
+    ts = now_utc().isoformat()
+    await postgrest_upsert_many(
+        client,
+        "world_npc_state",
+        [
             {
                 "world_id": world_id,
                 "npc_id": npc_id,
                 "location_id": location_id,
                 "action": "idle",
                 "emotion": "neutral",
-                "updated_at": now_utc().isoformat(),
-            },
-            on_conflict="world_id,npc_id",
-        )
+                "updated_at": ts,
+            }
+            for npc_id in defaults
+        ],
+        on_conflict="world_id,npc_id",
+    )
 
 
 async def fetch_npcs_here(
@@ -1285,13 +1668,9 @@ async def fetch_npcs_here(
     world_id: str,
     location_id: str,
 ) -> List[NpcSnapshot]:
-    rows = await postgrest_select(
-        client,
-        "world_npc_state",
-        f"?world_id=eq.{world_id}&location_id=eq.{location_id}&select=npc_id,location_id,action,emotion,updated_at",
-    )
+    rows = [r for r in await fetch_world_npc_rows(client, world_id) if str(r.get("location_id") or "") == location_id]
     out: List[NpcSnapshot] = []
-    for r in rows or []:
+    for r in rows:
         if not isinstance(r, dict) or not isinstance(r.get("npc_id"), str):
             continue
         out.append(
@@ -1325,8 +1704,10 @@ async def run_planner_after_command(
         return
 
     await ensure_default_npcs_present(client, world_id=world_id, location_id=location_id)
-    npcs_here = await fetch_npcs_here(client, world_id=world_id, location_id=location_id)
-    user = await fetch_user_state(client, world_id=world_id, user_id=str(cmd.get("user_id") or ""))
+    npcs_here, user = await asyncio.gather(
+        fetch_npcs_here(client, world_id=world_id, location_id=location_id),
+        fetch_user_state(client, world_id=world_id, user_id=str(cmd.get("user_id") or "")),
+    )
 
     # Update player<->character relation from the triggering user-facing event (best-effort).
     try:
@@ -1399,7 +1780,7 @@ async def run_planner_after_command(
     trace0["planner"] = "bt_v1"
     trace0["causation_event_id"] = str(source_event.get("id") or "")
 
-    speaker_npc_id: Optional[str] = None
+    speaker_npc_ids: List[str] = []
     for pe in planned:
         if not isinstance(pe.payload, dict):
             pe.payload = {}
@@ -1419,121 +1800,255 @@ async def run_planner_after_command(
             x_world_secret=x_world_secret,
         )
         _ = r  # reserved for future causation chaining
-        if pe.actor.kind == "npc" and pe.actor.id:
-            speaker_npc_id = pe.actor.id
+        if pe.actor.kind == "npc" and pe.actor.id and pe.actor.id not in speaker_npc_ids:
+            speaker_npc_ids.append(pe.actor.id)
 
-    if speaker_npc_id:
+    if speaker_npc_ids:
+        # One write for every speaker's short memory.
         try:
-            await store.put_state(world_id, speaker_npc_id, next_mem)
+            await store.put_states(world_id, {k: v for k, v in next_mem.items() if k in speaker_npc_ids})
         except Exception:
             pass
-        # Update NPC snapshot for UI hints (best-effort).
+        # Update NPC snapshots for UI hints (best-effort).
         try:
-            await postgrest_upsert_one(
+            ts = now_utc().isoformat()
+            await postgrest_upsert_many(
                 client,
                 "world_npc_state",
-                {
-                    "world_id": world_id,
-                    "npc_id": speaker_npc_id,
-                    "location_id": location_id,
-                    "action": "talking",
-                    "emotion": "neutral",
-                    "updated_at": now_utc().isoformat(),
-                },
+                [
+                    {
+                        "world_id": world_id,
+                        "npc_id": npc_id,
+                        "location_id": location_id,
+                        "action": "talking",
+                        "emotion": "neutral",
+                        "updated_at": ts,
+                    }
+                    for npc_id in speaker_npc_ids
+                ],
                 on_conflict="world_id,npc_id",
             )
         except Exception:
             pass
 
 
+async def _claim_commands_fallback(client: httpx.AsyncClient, batch: int) -> List[Dict[str, Any]]:
+    # Pre-RPC schema: select then claim row by row (optimistic status guard).
+    rows = await postgrest_select(
+        client,
+        "world_command_log",
+        f"?status=in.(queued,accepted)&order=created_at.asc&limit={batch}&select=*",
+    )
+    out: List[Dict[str, Any]] = []
+    for cmd in rows or []:
+        if not isinstance(cmd, dict) or not cmd.get("id"):
+            continue
+        claimed = await postgrest_update(
+            client,
+            "world_command_log",
+            f"?id=eq.{cmd['id']}&status=in.(queued,accepted)",
+            {"status": "processing", "updated_at": now_utc().isoformat()},
+        )
+        if claimed:
+            out.append(claimed[0])
+    return out
+
+
+async def claim_commands(client: httpx.AsyncClient, *, worker_id: str, batch: int, stale_sec: int) -> List[Dict[str, Any]]:
+    """
+    Atomically claim up to `batch` queued commands (world_claim_commands: FOR UPDATE SKIP LOCKED),
+    so several workers/replicas can drain the queue without double-processing.
+    Falls back to select+update when the RPC is not installed.
+    """
+
+    global _command_claim_rpc_missing
+    if _command_claim_rpc_missing:
+        return await _claim_commands_fallback(client, batch)
+    r = await client.post(
+        rpc_url("world_claim_commands"),
+        headers=auth_headers(),
+        json={"p_worker_id": worker_id, "p_limit": int(batch), "p_stale_sec": int(stale_sec)},
+    )
+    if r.status_code == 404:
+        _command_claim_rpc_missing = True
+        return await _claim_commands_fallback(client, batch)
+    if r.status_code >= 400:
+        raise HTTPException(status_code=500, detail=f"claim_commands_failed:{r.status_code}:{r.text}")
+    data = r.json()
+    return [c for c in (data if isinstance(data, list) else []) if isinstance(c, dict) and c.get("id")]
+
+
+async def process_command(client: httpx.AsyncClient, cmd: Dict[str, Any], *, x_world_secret: Optional[str]) -> bool:
+    cmd_id = str(cmd["id"])
+    try:
+        if isinstance(cmd.get("payload"), dict) and cmd.get("user_id"):
+            p = cmd["payload"]
+            loc = p.get("loc") or p.get("location_id")
+            sub = p.get("sub_location_id")
+            if cmd.get("type") == "user_move":
+                loc = p.get("to") or loc
+            await upsert_user_state(
+                client,
+                str(cmd.get("world_id") or ""),
+                str(cmd.get("user_id") or ""),
+                str(loc) if loc is not None else None,
+                str(sub) if sub is not None else None,
+            )
+        source_event = await emit_for_command(cmd, x_world_secret=x_world_secret)
+        await run_planner_after_command(
+            client,
+            cmd=cmd,
+            source_event=source_event,
+            x_world_secret=x_world_secret,
+        )
+        await postgrest_update(
+            client,
+            "world_command_log",
+            f"?id=eq.{cmd_id}",
+            {"status": "done", "updated_at": now_utc().isoformat()},
+        )
+        return True
+    except Exception as e:
+        await postgrest_update(
+            client,
+            "world_command_log",
+            f"?id=eq.{cmd_id}",
+            {
+                "status": "failed",
+                "error_code": "worker_error",
+                "error_message": str(e)[:500],
+                "updated_at": now_utc().isoformat(),
+            },
+        )
+        return False
+
+
+async def release_commands(client: httpx.AsyncClient, cmds: List[Dict[str, Any]], *, worker_id: str) -> None:
+    """
+    Put claimed commands that were never processed back to 'queued' (world_release_commands),
+    so their group is not blocked until the stale timeout. Best-effort.
+    """
+
+    ids = [str(c["id"]) for c in cmds if c.get("id")]
+    if not ids:
+        return
+    try:
+        r = await client.post(
+            rpc_url("world_release_commands"),
+            headers=auth_headers(),
+            json={"p_worker_id": worker_id, "p_ids": ids},
+        )
+        if r.status_code != 404:
+            return
+        await postgrest_update(
+            client,
+            "world_command_log",
+            f"?id=in.({','.join(ids)})&status=eq.processing",
+            {"status": "queued", "updated_at": now_utc().isoformat()},
+        )
+    except Exception as e:
+        _on_command_worker_error(e)
+
+
+def _command_order_key(cmd: Dict[str, Any]) -> Tuple[str, str]:
+    # Commands of one user in one world are applied in order (user_move etc. depend on it).
+    return (str(cmd.get("world_id") or ""), str(cmd.get("user_id") or cmd.get("id")))
+
+
 async def command_worker_loop(x_world_secret: Optional[str]):
     require_supabase()
     poll_ms = int(env("GENSOKYO_COMMAND_WORKER_POLL_MS", "500") or "500")
+    idle_poll_ms = int(env("GENSOKYO_COMMAND_WORKER_IDLE_POLL_MS", "5000") or "5000")
     batch = int(env("GENSOKYO_COMMAND_WORKER_BATCH", "20") or "20")
     batch = max(1, min(batch, 50))
-
-    async with httpx.AsyncClient(timeout=20.0) as client:
+    concurrency = int(env("GENSOKYO_COMMAND_WORKER_CONCURRENCY", "4") or "4")
+    concurrency = max(1, min(concurrency, 32))
+    stale_sec = int(env("GENSOKYO_COMMAND_WORKER_STALE_SEC", "120") or "120")
+    worker_id = default_owner_id()
+
+    wakeup = _command_wakeup
+
+    # Without push notifications the poll interval backs off while idle
+    # (poll_ms -> idle_poll_ms) and snaps back as soon as work shows up.
+    min_wait = max(0.05, poll_ms / 1000.0)
+    max_wait = max(min_wait, idle_poll_ms / 1000.0)
+    wait = min_wait
+    sem = asyncio.Semaphore(concurrency)
+    stats = _command_stats
+
+    async def _run_group(client: httpx.AsyncClient, cmds: List[Dict[str, Any]]) -> None:
+        finished = 0
+        try:
+            async with sem:
+                for cmd in cmds:
+                    ok = await process_command(client, cmd, x_world_secret=x_world_secret)
+                    finished += 1
+                    stats.record_finish(cmd, now_utc(), ok)
+        finally:
+            if finished < len(cmds):
+                # process_command could not even record failure (or we were cancelled):
+                # release the rest of the group instead of leaving it in 'processing'.
+                await release_commands(client, cmds[finished:], worker_id=worker_id)
+
+    async with world_http() as client:
         while True:
+            claimed: List[Dict[str, Any]] = []
             try:
-                rows = await postgrest_select(
-                    client,
-                    "world_command_log",
-                    f"?status=in.(queued,accepted)&order=created_at.asc&limit={batch}&select=*",
-                )
-                for cmd in rows or []:
-                    if not isinstance(cmd, dict) or not cmd.get("id"):
-                        continue
-                    cmd_id = str(cmd["id"])
-                    claimed = await postgrest_update(
-                        client,
-                        "world_command_log",
-                        f"?id=eq.{cmd_id}&status=in.(queued,accepted)",
-                        {"status": "processing", "updated_at": now_utc().isoformat()},
+                claimed = await claim_commands(client, worker_id=worker_id, batch=batch, stale_sec=stale_sec)
+                stats.claims += 1
+                if not claimed:
+                    stats.empty_claims += 1
+                claimed_at = now_utc()
+                claimed.sort(key=lambda c: str(c.get("created_at") or ""))
+                groups: Dict[Tuple[str, str], List[Dict[str, Any]]] = {}
+                for cmd in claimed:
+                    stats.record_claim(cmd, claimed_at)
+                    groups.setdefault(_command_order_key(cmd), []).append(cmd)
+                if groups:
+                    await asyncio.gather(
+                        *[_run_group(client, cmds) for cmds in groups.values()],
+                        return_exceptions=True,
                     )
-                    if not claimed:
-                        continue
-                    cmd = claimed[0]
-                    try:
-                        if isinstance(cmd.get("payload"), dict) and cmd.get("user_id"):
-                            p = cmd["payload"]
-                            loc = p.get("loc") or p.get("location_id")
-                            sub = p.get("sub_location_id")
-                            if cmd.get("type") == "user_move":
-                                loc = p.get("to") or loc
-                            await upsert_user_state(
-                                client,
-                                str(cmd.get("world_id") or ""),
-                                str(cmd.get("user_id") or ""),
-                                str(loc) if loc is not None else None,
-                                str(sub) if sub is not None else None,
-                            )
-                        source_event = await emit_for_command(cmd, x_world_secret=x_world_secret)
-                        await run_planner_after_command(
-                            client,
-                            cmd=cmd,
-                            source_event=source_event,
-                            x_world_secret=x_world_secret,
-                        )
-                        await postgrest_update(
-                            client,
-                            "world_command_log",
-                            f"?id=eq.{cmd_id}",
-                            {"status": "done", "updated_at": now_utc().isoformat()},
-                        )
-                    except Exception as e:
-                        await postgrest_update(
-                            client,
-                            "world_command_log",
-                            f"?id=eq.{cmd_id}",
-                            {
-                                "status": "failed",
-                                "error_code": "worker_error",
-                                "error_message": str(e)[:500],
-                                "updated_at": now_utc().isoformat(),
-                            },
-                        )
             except asyncio.CancelledError:
                 raise
-            except Exception:
-                pass
+            except Exception as e:
+                _on_command_worker_error(e)
+
+            if len(claimed) >= batch:
+                # Backlog: claim the next batch right away.
+                wait = min_wait
+                continue
+            if claimed:
+                wait = min_wait
+            else:
+                wait = min_wait if wakeup.listening else min(max_wait, wait * 2)
+            if await wakeup.wait(max_wait if wakeup.listening else wait):
+                stats.wakeups += 1
+                wait = min_wait
 
-            await asyncio.sleep(max(0.05, poll_ms / 1000.0))
+
+def _on_command_worker_error(e: Exception) -> None:
+    try:
+        print("[world.command] error:", repr(e))
+    except Exception:
+        pass
 
 
 @app.get("/world/state")
-async def get_world_state(world_id: str, location_id: str = "", x_world_secret: Optional[str] = Header(default=None)):
+async def get_world_state(
+    world_id: str,
+    location_id: str = "",
+    x_world_secret: Optional[str] = Header(default=None),
+    if_none_match: Optional[str] = Header(default=None),
+):
     check_secret(x_world_secret)
     require_supabase()
 
     loc = location_id or ""
-    async with httpx.AsyncClient(timeout=20.0) as client:
-        rows = await postgrest_select(
-            client,
-            "world_state",
-            f"?world_id=eq.{world_id}&location_id=eq.{loc}&select=*",
-        )
-        if rows:
-            return rows[0]
+    async with world_http() as client:
+        cur = await fetch_world_state_row(client, world_id, loc)
+        if cur is not None:
+            return _conditional_json(cur, _world_cache.etag("state", cur), if_none_match)
 
         # Create default state
         dt = now_utc()
@@ -1552,7 +2067,7 @@ async def get_world_state(world_id: str, location_id: str = "", x_world_secret:
             },
             on_conflict="world_id,location_id",
         )
-        return row
+        return _conditional_json(row, _world_cache.etag("state", row), if_none_match)
 
 
 @app.get("/world/recent")
@@ -1561,20 +2076,16 @@ async def get_recent_events(
     location_id: str = "",
     limit: int = 10,
     x_world_secret: Optional[str] = Header(default=None),
+    if_none_match: Optional[str] = Header(default=None),
 ):
     check_secret(x_world_secret)
     require_supabase()
 
     loc = location_id or ""
-    channel = f"world:{world_id}" if not loc else f"world:{world_id}:{loc}"
     n = max(1, min(int(limit or 10), 50))
 
-    async with httpx.AsyncClient(timeout=20.0) as client:
-        rows = await postgrest_select(
-            client,
-            "world_event_log",
-            f"?channel=eq.{channel}&order=seq.desc&limit={n}&select=seq,ts,type,actor,payload",
-        )
+    async with world_http() as client:
+        rows = list(await fetch_recent_event_rows(client, world_id, loc, n))
         rows.reverse()
         out = []
         for r in rows:
@@ -1586,28 +2097,25 @@ async def get_recent_events(
             if not summary:
                 continue
             out.append({"event_type": event_type, "summary": summary, "created_at": created_at})
-        return {"recent_events": out}
+        body = {"recent_events": out}
+        return _conditional_json(body, _world_cache.etag("recent", body), if_none_match)
 
 
 @app.get("/world/npcs")
-async def get_npcs(world_id: str, location_id: str = "", x_world_secret: Optional[str] = Header(default=None)):
+async def get_npcs(
+    world_id: str,
+    location_id: str = "",
+    x_world_secret: Optional[str] = Header(default=None),
+    if_none_match: Optional[str] = Header(default=None),
+):
     check_secret(x_world_secret)
     require_supabase()
 
     loc = location_id or ""
-    async with httpx.AsyncClient(timeout=20.0) as client:
+    async with world_http() as client:
+        rows = await fetch_world_npc_rows(client, world_id)
         if loc:
-            rows = await postgrest_select(
-                client,
-                "world_npc_state",
-                f"?world_id=eq.{world_id}&location_id=eq.{loc}&select=npc_id,location_id,action,emotion,updated_at",
-            )
-        else:
-            rows = await postgrest_select(
-                client,
-                "world_npc_state",
-                f"?world_id=eq.{world_id}&select=npc_id,location_id,action,emotion,updated_at",
-            )
+            rows = [r for r in rows if str(r.get("location_id") or "") == loc]
         npcs = [
             {
                 "id": r.get("npc_id"),
@@ -1617,7 +2125,128 @@ async def get_npcs(world_id: str, location_id: str = "", x_world_secret: Optiona
             }
             for r in rows or []
         ]
-        return {"npcs": npcs}
+        body = {"npcs": npcs}
+        return _conditional_json(body, _world_cache.etag("npcs", body), if_none_match)
+
+
+async def _commit_visit_fallback(
+    client: httpx.AsyncClient,
+    *,
+    world_id: str,
+    layer_id: str,
+    location_id: str,
+    visitor_key: str,
+    visit_ts: datetime,
+    state: Dict[str, Any],
+    npc_rows: List[Dict[str, Any]],
+    events: List[Dict[str, Any]],
+    x_world_secret: Optional[str],
+) -> Dict[str, Any]:
+    # Pre-RPC schema: same writes, one request each.
+    await postgrest_upsert_one(
+        client,
+        "world_visits",
+        {
+            "world_id": world_id,
+            "visitor_key": visitor_key,
+            "location_id": location_id,
+            "last_visit": visit_ts.isoformat(),
+            "updated_at": now_utc().isoformat(),
+        },
+        on_conflict="world_id,visitor_key,location_id",
+    )
+    state_row = await postgrest_upsert_one(
+        client,
+        "world_state",
+        {"world_id": world_id, "location_id": location_id, **state},
+        on_conflict="world_id,location_id",
+    )
+    for row in npc_rows:
+        await postgrest_upsert_one(client, "world_npc_state", row, on_conflict="world_id,npc_id")
+    for ev in events:
+        actor = ev.get("actor") if isinstance(ev.get("actor"), dict) else None
+        await emit_event(
+            EmitEventRequest(
+                world_id=world_id,
+                layer_id=layer_id,
+                location_id=location_id,
+                type=str(ev.get("type") or "system"),
+                actor=Actor(**actor) if actor else None,
+                ts=ev.get("ts"),
+                payload=ev.get("payload") or {},
+            ),
+            x_world_secret=x_world_secret,
+        )
+    return state_row
+
+
+async def commit_visit(
+    client: httpx.AsyncClient,
+    *,
+    world_id: str,
+    layer_id: str,
+    location_id: str,
+    visitor_key: str,
+    visit_ts: datetime,
+    state: Dict[str, Any],
+    npc_rows: List[Dict[str, Any]],
+    events: List[Dict[str, Any]],
+    x_world_secret: Optional[str],
+) -> Dict[str, Any]:
+    """
+    Write a visit's results in one transaction (world_visit_commit RPC):
+    world_visits, world_state, world_npc_state patches, then events in order.
+    Returns the persisted world_state row.
+    """
+
+    global _visit_commit_rpc_missing
+    kwargs: Dict[str, Any] = dict(
+        world_id=world_id,
+        layer_id=layer_id,
+        location_id=location_id,
+        visitor_key=visitor_key,
+        visit_ts=visit_ts,
+        state=state,
+        npc_rows=npc_rows,
+        events=events,
+        x_world_secret=x_world_secret,
+    )
+    if _visit_commit_rpc_missing:
+        return await _commit_visit_fallback(client, **kwargs)
+
+    r = await client.post(
+        rpc_url("world_visit_commit"),
+        headers=auth_headers(),
+        json={
+            "p_world_id": world_id,
+            "p_layer_id": layer_id,
+            "p_location_id": location_id,
+            "p_visitor_key": visitor_key,
+            "p_visit_ts": visit_ts.isoformat(),
+            "p_state": state,
+            "p_npc_states": npc_rows,
+            "p_events": events,
+        },
+    )
+    if r.status_code == 404:
+        _visit_commit_rpc_missing = True
+        return await _commit_visit_fallback(client, **kwargs)
+    if r.status_code >= 400:
+        raise HTTPException(status_code=500, detail=f"visit_commit_failed: {r.status_code} {r.text}")
+    data = r.json()
+    row = data.get("world_state") if isinstance(data, dict) else None
+    row = row if isinstance(row, dict) else {"world_id": world_id, "location_id": location_id, **state}
+    _cache_write_through("world_state", [row])
+    _cache_write_through("world_npc_state", npc_rows)
+    if events:
+        appended = data.get("events") if isinstance(data, dict) else None
+        _world_cache.on_event(
+            world_id,
+            location_id,
+            [e.get("seq") for e in appended or [] if isinstance(e, dict)],
+            expect_echo=_pg_listener is not None,
+        )
+    return row
 
 
 @app.post("/world/visit")
@@ -1629,12 +2258,16 @@ async def visit(req: VisitRequest, x_world_secret: Optional[str] = Header(defaul
     visitor_key = req.visitor_key or "anon"
     sub_loc = check_sub_location(req.location_id, req.sub_location_id)
 
-    async with httpx.AsyncClient(timeout=20.0) as client:
-        # Get last visit
-        visit_rows = await postgrest_select(
-            client,
-            "world_visits",
-            f"?world_id=eq.{req.world_id}&visitor_key=eq.{visitor_key}&location_id=eq.{req.location_id}&select=last_visit",
+    async with world_http() as client:
+        # Independent reads in one round trip: last visit, current world_state, recent events.
+        visit_rows, cur_state, recent_rows_desc = await asyncio.gather(
+            postgrest_select(
+                client,
+                "world_visits",
+                f"?world_id=eq.{req.world_id}&visitor_key=eq.{visitor_key}&location_id=eq.{req.location_id}&select=last_visit",
+            ),
+            fetch_world_state_row(client, req.world_id, req.location_id),
+            fetch_recent_event_rows(client, req.world_id, req.location_id, 50),
         )
         last_visit: Optional[datetime] = None
         if visit_rows and isinstance(visit_rows[0], dict) and visit_rows[0].get("last_visit"):
@@ -1655,27 +2288,8 @@ async def visit(req: VisitRequest, x_world_secret: Optional[str] = Header(defaul
 
         delta_sec = max(0, int((user_dt - last_visit).total_seconds()))
 
-        # Update visit
-        await postgrest_upsert_one(
-            client,
-            "world_visits",
-            {
-                "world_id": req.world_id,
-                "visitor_key": visitor_key,
-                "location_id": req.location_id,
-                "last_visit": user_dt.isoformat(),
-                "updated_at": now_utc().isoformat(),
-            },
-            on_conflict="world_id,visitor_key,location_id",
-        )
-
-        # Load current world_state, then update time fields deterministically.
-        existing = await postgrest_select(
-            client,
-            "world_state",
-            f"?world_id=eq.{req.world_id}&location_id=eq.{req.location_id}&select=*",
-        )
-        cur = existing[0] if isinstance(existing, list) and existing else {}
+        # Current world_state, with time fields updated deterministically.
+        cur = cur_state or {}
         state: Dict[str, Any] = {
             "world_id": req.world_id,
             "location_id": req.location_id,
@@ -1687,7 +2301,7 @@ async def visit(req: VisitRequest, x_world_secret: Optional[str] = Header(defaul
             "updated_at": user_dt.isoformat(),
         }
 
-        # Emit a world_tick event for this location (always, but cheap)
+        # A world_tick event for this location (always, but cheap); written with the rest below.
         tick_payload = {
             "delta_sec": delta_sec,
             "location_id": req.location_id,
@@ -1697,28 +2311,19 @@ async def visit(req: VisitRequest, x_world_secret: Optional[str] = Header(defaul
             "season": state.get("season"),
             "moon_phase": state.get("moon_phase"),
         }
-        await emit_event(
-            EmitEventRequest(
-                world_id=req.world_id,
-                layer_id=req.layer_id,
-                location_id=req.location_id,
-                type="world_tick",
-                actor=Actor(kind="system", id="world_engine"),
-                ts=user_dt.isoformat(),
-                payload=tick_payload,
-            ),
-            x_world_secret=x_world_secret,
-        )
+        events_out: List[Dict[str, Any]] = [
+            {
+                "type": "world_tick",
+                "actor": {"kind": "system", "id": "world_engine"},
+                "ts": user_dt.isoformat(),
+                "payload": tick_payload,
+            }
+        ]
 
         # --- Time Skip event generation (docs-driven) ---
         density = location_density(req.location_id)
         budget = compute_event_budget(delta_sec, density)
 
-        recent_rows_desc = await postgrest_select(
-            client,
-            "world_event_log",
-            f"?channel=eq.world:{req.world_id}:{req.location_id}&order=seq.desc&limit=50&select=seq,ts,payload",
-        )
         recent_types_desc: List[str] = []
         last_seen_ts: Dict[str, datetime] = {}
         for r in recent_rows_desc or []:
@@ -1734,129 +2339,46 @@ async def visit(req: VisitRequest, x_world_secret: Optional[str] = Header(defaul
                 except Exception:
                     pass
 
-        defs = load_events()
         seed = stable_seed(req.layer_id, req.location_id, last_visit.isoformat(), user_dt.isoformat(), visitor_key)
         rng = random.Random(seed)
 
+        # Weighted picks without replacement over the precompiled index (O(log n) per pick).
+        sampler = compiled_event_index().sampler(
+            location_id=req.location_id,
+            state=state,
+            now=user_dt,
+            last_seen_ts=last_seen_ts,
+            recent_types=recent_types_desc,
+        )
         selected: List[Dict[str, Any]] = []
-        selected_ids: set[str] = set()
-        reserved_locations: Dict[str, str] = {}  # npc_id -> location_id
-
-        candidates_count_total = 0
-        excluded_by_constraints = 0
-        excluded_by_cooldown = 0
-        excluded_by_conflict = 0
-        reduced_by_recent = 0
-        excluded_by_recent_zero = 0
-
         for _ in range(budget):
-            weighted: List[Tuple[Dict[str, Any], float]] = []
-            for d in defs:
-                eid = str(d.get("id") or "")
-                if not eid or eid in selected_ids:
-                    continue
-
-                loc = str(d.get("location_id") or "")
-                if loc and loc != req.location_id:
-                    continue
-
-                if not event_constraints_ok(d, state):
-                    excluded_by_constraints += 1
-                    continue
-
-                p = float(d.get("probability") or 0.0)
-                if p <= 0:
-                    continue
-
-                candidates_count_total += 1
-
-                # cooldown
-                cooldown_h = float(d.get("cooldown_hours") or 0.0)
-                if cooldown_h > 0 and eid in last_seen_ts:
-                    if (user_dt - last_seen_ts[eid]).total_seconds() < cooldown_h * 3600:
-                        excluded_by_cooldown += 1
-                        continue
-
-                # recent filter weight
-                rw = recent_weight(eid, recent_types_desc)
-                if rw < 1.0:
-                    reduced_by_recent += 1
-                w = p * rw
-                if w <= 0:
-                    excluded_by_recent_zero += 1
-                    continue
-
-                # invariant I1 guard: avoid conflicting location changes in same tick
-                changes = effect_location_changes(d)
-                conflict = False
-                for npc_id, new_loc in changes:
-                    if npc_id in reserved_locations and reserved_locations[npc_id] != new_loc:
-                        conflict = True
-                        break
-                if conflict:
-                    excluded_by_conflict += 1
-                    continue
-
-                weighted.append((d, w))
-
-            total = sum(w for _, w in weighted)
-            if total <= 0:
+            picked = sampler.draw(rng)
+            if picked is None:
                 break
+            selected.append(picked.defn)
+            state = apply_effects_world(state, picked.defn)
+            sampler.take(picked, state)
 
-            pick = rng.random() * total
-            acc = 0.0
-            chosen: Optional[Dict[str, Any]] = None
-            for d, w in weighted:
-                acc += w
-                if acc >= pick:
-                    chosen = d
-                    break
-
-            if not chosen:
-                break
-
-            selected.append(chosen)
-            selected_ids.add(str(chosen.get("id")))
-            for npc_id, new_loc in effect_location_changes(chosen):
-                reserved_locations[npc_id] = new_loc
-
-            state = apply_effects_world(state, chosen)
-
-        # Persist world_state
-        state_row = await postgrest_upsert_one(
-            client,
-            "world_state",
-            {
-                "world_id": req.world_id,
-                "location_id": req.location_id,
-                "time_of_day": state.get("time_of_day"),
-                "weather": state.get("weather"),
-                "season": state.get("season"),
-                "moon_phase": state.get("moon_phase"),
-                "anomaly": state.get("anomaly"),
-                "updated_at": user_dt.isoformat(),
-            },
-            on_conflict="world_id,location_id",
-        )
-
-        # Apply NPC state effects
+        # NPC state effects
+        npc_rows: List[Dict[str, Any]] = []
         npc_state_changes: List[Dict[str, Any]] = []
         for d in selected:
             for npc_id, patch in npc_effect_patches(d):
                 new_loc = str(patch.get("location_id") or "")
-                row = {
-                    "world_id": req.world_id,
-                    "npc_id": npc_id,
-                    "location_id": new_loc,
-                    "action": patch.get("action"),
-                    "emotion": patch.get("emotion"),
-                    "updated_at": user_dt.isoformat(),
-                }
-                await postgrest_upsert_one(client, "world_npc_state", row, on_conflict="world_id,npc_id")
+                npc_rows.append(
+                    {
+                        "world_id": req.world_id,
+                        "npc_id": npc_id,
+                        "location_id": new_loc,
+                        "action": patch.get("action"),
+                        "emotion": patch.get("emotion"),
+                        "updated_at": user_dt.isoformat(),
+                    }
+                )
                 if new_loc:
                     npc_state_changes.append({"id": npc_id, "location_id": new_loc})
 
-        # Append generated events (ordered, deterministic timestamps within the window)
+        # Generated events (ordered, deterministic timestamps within the window)
         recent_events: List[Dict[str, Any]] = []
         if selected:
             step = max(1, int(delta_sec / (len(selected) + 1))) if delta_sec > 0 else 0
@@ -1870,31 +2392,48 @@ async def visit(req: VisitRequest, x_world_secret: Optional[str] = Header(defaul
                 ev_ts = user_dt if step == 0 else (last_visit + timedelta(seconds=step * (i + 1)))
                 ev_ts = min(ev_ts, user_dt)
 
-                actor: Optional[Actor] = None
+                actor: Optional[Dict[str, Any]] = None
                 if log_type in ("npc_action", "npc_say") and participants:
-                    actor = Actor(kind="npc", id=participants[0])
-
-                await emit_event(
-                    EmitEventRequest(
-                        world_id=req.world_id,
-                        layer_id=req.layer_id,
-                        location_id=req.location_id,
-                        type=log_type,
-                        actor=actor,
-                        ts=ev_ts.isoformat(),
-                        payload={
+                    actor = {"kind": "npc", "id": participants[0]}
+
+                events_out.append(
+                    {
+                        "type": log_type,
+                        "actor": actor,
+                        "ts": ev_ts.isoformat(),
+                        "payload": {
                             "event_type": eid,
                             "summary": summary,
                             "participants": participants,
                             "sub_location_id": sub_loc,
                         },
-                    ),
-                    x_world_secret=x_world_secret,
+                    }
                 )
 
                 if summary:
                     recent_events.append({"event_type": eid, "summary": summary, "created_at": ev_ts.isoformat()})
 
+        # Persist visit + world_state + NPC effects + events (one RPC round trip when available).
+        state_row = await commit_visit(
+            client,
+            world_id=req.world_id,
+            layer_id=req.layer_id,
+            location_id=req.location_id,
+            visitor_key=visitor_key,
+            visit_ts=user_dt,
+            state={
+                "time_of_day": state.get("time_of_day"),
+                "weather": state.get("weather"),
+                "season": state.get("season"),
+                "moon_phase": state.get("moon_phase"),
+                "anomaly": state.get("anomaly"),
+                "updated_at": user_dt.isoformat(),
+            },
+            npc_rows=npc_rows,
+            events=events_out,
+            x_world_secret=x_world_secret,
+        )
+
         log_world_visit_debug(
             {
                 "world_id": req.world_id,
@@ -1907,12 +2446,7 @@ async def visit(req: VisitRequest, x_world_secret: Optional[str] = Header(defaul
                 "delta_sec": delta_sec,
                 "density": density,
                 "event_budget": budget,
-                "candidates_count": candidates_count_total,
-                "excluded_by_constraints": excluded_by_constraints,
-                "excluded_by_cooldown": excluded_by_cooldown,
-                "excluded_by_recent_zero": excluded_by_recent_zero,
-                "reduced_by_recent": reduced_by_recent,
-                "excluded_by_conflict": excluded_by_conflict,
+                **sampler.stats,
                 "picked_event_types": [str(d.get("id") or "") for d in selected],
             }
         )
@@ -1940,7 +2474,7 @@ async def tick(req: TickRequest, x_world_secret: Optional[str] = Header(default=
     dt = now_utc()
     loc = req.location_id or ""
 
-    async with httpx.AsyncClient(timeout=20.0) as client:
+    async with world_http() as client:
         state = await postgrest_upsert_one(
             client,
             "world_state",
@@ -1983,7 +2517,10 @@ async def tick(req: TickRequest, x_world_secret: Optional[str] = Header(default=
         try:
             if loc:
                 await ensure_default_npcs_present(client, world_id=req.world_id, location_id=loc)
-                npcs_here = await fetch_npcs_here(client, world_id=req.world_id, location_id=loc)
+                npcs_here, world_ctx = await asyncio.gather(
+                    fetch_npcs_here(client, world_id=req.world_id, location_id=loc),
+                    fetch_recent_summaries(client, world_id=req.world_id, location_id=loc, limit=8),
+                )
                 if len(npcs_here) >= 1:
                     ctx = PlannerContext(
                         world_id=req.world_id,
@@ -2011,13 +2548,6 @@ async def tick(req: TickRequest, x_world_secret: Optional[str] = Header(default=
                             return ""
                         return await llm.generate_reply(speaker_character_id=speaker_id, ctx=_ctx)
 
-                    world_ctx = await fetch_recent_summaries(
-                        client,
-                        world_id=req.world_id,
-                        location_id=loc,
-                        limit=8,
-                    )
-
                     async def _npc_dialogue_llm(
                         speaker_id: str,
                         listener_id: str,
@@ -2086,7 +2616,7 @@ async def submit_command(req: CommandRequest, x_world_secret: Optional[str] = He
         "status": "queued",
     }
 
-    async with httpx.AsyncClient(timeout=20.0) as client:
+    async with world_http() as client:
         r = await client.post(url, headers=headers, json=row)
         if r.status_code == 409:
             # dedupe conflict -> return existing row (idempotent)
@@ -2111,6 +2641,8 @@ async def submit_command(req: CommandRequest, x_world_secret: Optional[str] = He
         inserted = r.json()
         # PostgREST returns a list for return=representation
         cmd = inserted[0] if isinstance(inserted, list) and inserted else inserted
+        # Local worker picks it up immediately (other replicas wake via pg_notify).
+        _command_wakeup.notify()
         return {"ok": True, "command_id": cmd.get("id"), "correlation_id": cmd.get("correlation_id"), "status": cmd.get("status")}
 
 
@@ -2126,7 +2658,7 @@ async def get_command(
     if not cid:
         raise HTTPException(status_code=400, detail="missing_command_id")
 
-    async with httpx.AsyncClient(timeout=20.0) as client:
+    async with world_http() as client:
         rows = await postgrest_select(
             client,
             "world_command_log",
@@ -2166,6 +2698,6 @@ async def list_commands(
 
     where += f"&order=created_at.desc&limit={n}&select=id,correlation_id,type,status,error_code,error_message,created_at,updated_at"
 
-    async with httpx.AsyncClient(timeout=20.0) as client:
+    async with world_http() as client:
         rows = await postgrest_select(client, "world_command_log", where)
         return {"ok": True, "commands": rows or []}
@@ -0,0 +1,49 @@
+from __future__ import annotations
+
+import os
+import sys
+import unittest
+
+sys.path.insert(0, os.path.dirname(os.path.dirname(os.path.abspath(__file__))))
+
+from world_state_cache import WorldStateCache  # noqa: E402
+
+
+ROW = {"world_id": "w1", "location_id": "loc", "weather": "clear"}
+
+
+class WorldStateCacheFillTest(unittest.TestCase):
+    def test_cold_fill(self) -> None:
+        c = WorldStateCache()
+        c.put_state(ROW, expect_version=c.version("state", "w1", "loc"))
+        self.assertEqual(c.get_state("w1", "loc"), ROW)
+
+    def test_fill_after_clear(self) -> None:
+        c = WorldStateCache()
+        c.clear()
+        c.put_state(ROW, expect_version=c.version("state", "w1", "loc"))
+        self.assertEqual(c.get_state("w1", "loc"), ROW)
+
+    def test_fill_after_invalidate_world(self) -> None:
+        c = WorldStateCache()
+        c.invalidate_world("w1")
+        c.put_state(ROW, expect_version=c.version("state", "w1", "loc"))
+        self.assertEqual(c.get_state("w1", "loc"), ROW)
+
+    def test_fill_started_before_clear_is_dropped(self) -> None:
+        c = WorldStateCache()
+        v = c.version("state", "w1", "loc")
+        c.clear()
+        c.put_state(ROW, expect_version=v)
+        self.assertIsNone(c.get_state("w1", "loc"))
+
+    def test_fill_loses_to_concurrent_write(self) -> None:
+        c = WorldStateCache()
+        v = c.version("state", "w1", "loc")
+        c.on_remote_event("w1", "loc")
+        c.put_state(ROW, expect_version=v)
+        self.assertIsNone(c.get_state("w1", "loc"))
+
+
+if __name__ == "__main__":
+    unittest.main()
@@ -1,15 +1,31 @@
 from __future__ import annotations
 
 import asyncio
+import os
+import random
+import socket
+import uuid
 from dataclasses import dataclass
 from datetime import datetime, timezone
-from typing import Awaitable, Callable, Optional
+from typing import Any, Awaitable, Callable, Dict, List, Optional, Set, Tuple
 
 
 @dataclass(frozen=True)
 class WorldSimulatorConfig:
     enabled: bool = True
     interval_sec: int = 30
+    # Location ticks running at once (across all worlds this replica owns).
+    max_concurrency: int = 8
+    # Location ticks running at once inside one world.
+    per_world_concurrency: int = 4
+    # What to do when a location's previous tick is still running at the next period:
+    # - "coalesce": run once more right after it finishes (with the latest tick time)
+    # - "skip": drop this period for that location
+    overrun_policy: str = "coalesce"
+    # World lease (multi-replica sharding). 0 -> 3 * interval_sec.
+    lease_ttl_sec: int = 0
+    # 0 = unlimited. Caps how many worlds one replica will take ownership of.
+    max_worlds_per_replica: int = 0
 
 
 def utc_now() -> datetime:
@@ -47,3 +63,298 @@ async def simulator_loop(
                     pass
         await asyncio.sleep(interval)
 
+
+# --------------------------------------------
+# World leases (shard worlds across replicas)
+# --------------------------------------------
+
+
+class LeaseUnavailable(RuntimeError):
+    """Lease backend is not installed (e.g. RPC missing). Caller falls back to single-replica mode."""
+
+
+def default_owner_id() -> str:
+    explicit = (os.environ.get("GENSOKYO_WORLD_ENGINE_INSTANCE_ID") or "").strip()
+    if explicit:
+        return explicit
+    try:
+        host = socket.gethostname()
+    except Exception:
+        host = "host"
+    return f"{host}:{os.getpid()}:{uuid.uuid4().hex[:8]}"
+
+
+class WorldLeaseManager:
+    """
+    Lease-based world ownership.
+
+    - acquire(world_id, owner_id, ttl_sec) -> bool is an atomic "take or renew" on the backend.
+      It succeeds when the lease is free, expired, or already held by owner_id.
+    - Owned worlds are renewed every period; a replica that dies stops renewing and
+      another replica takes the world over after ttl_sec.
+    - If the backend raises LeaseUnavailable, every world is treated as owned (single replica).
+    """
+
+    def __init__(
+        self,
+        *,
+        owner_id: str,
+        ttl_sec: int,
+        acquire: Callable[[str, str, int], Awaitable[bool]],
+        release: Optional[Callable[[str, str], Awaitable[None]]] = None,
+        max_worlds: int = 0,
+    ) -> None:
+        self.owner_id = owner_id
+        self.ttl_sec = max(1, int(ttl_sec))
+        self._acquire = acquire
+        self._release = release
+        self._max_worlds = max(0, int(max_worlds))
+        self.owned: Set[str] = set()
+        self.unavailable = False
+
+    async def refresh(self, world_ids: List[str]) -> List[str]:
+        if self.unavailable:
+            return list(world_ids)
+
+        wanted = list(dict.fromkeys(world_ids))
+        # Renew what we already hold first, then try the rest in random order so
+        # replicas that start together spread worlds between them.
+        held = [w for w in wanted if w in self.owned]
+        others = [w for w in wanted if w not in self.owned]
+        random.shuffle(others)
+
+        owned: Set[str] = set()
+        for world_id in held + others:
+            if world_id not in self.owned and self._max_worlds and len(owned) >= self._max_worlds:
+                continue
+            try:
+                ok = await self._acquire(world_id, self.owner_id, self.ttl_sec)
+            except LeaseUnavailable:
+                self.unavailable = True
+                self.owned = set(wanted)
+                return list(wanted)
+            except asyncio.CancelledError:
+                raise
+            except Exception:
+                # Transient backend error: keep a world we already held (its lease has not
+                # expired yet), never take a new one.
+                ok = world_id in self.owned
+            if ok:
+                owned.add(world_id)
+
+        self.owned = owned
+        return [w for w in wanted if w in owned]
+
+    async def release_all(self) -> None:
+        if self._release is None or self.unavailable:
+            self.owned = set()
+            return
+        for world_id in list(self.owned):
+            try:
+                await self._release(world_id, self.owner_id)
+            except Exception:
+                pass
+        self.owned = set()
+
+
+# --------------------------------------------
+# Location tick scheduler
+# --------------------------------------------
+
+LocationKey = Tuple[str, str]  # (world_id, location_id)
+
+
+class LocationTickScheduler:
+    """
+    Fixed-rate scheduler that fans location ticks out concurrently.
+
+    Guarantees:
+    - a location never has two ticks running at once, and its ticks run in time order
+      (an overrunning tick is skipped or coalesced into one follow-up run, per overrun_policy)
+    - bounded concurrency overall (max_concurrency) and per world (per_world_concurrency)
+    - tick_location receives a per-world asyncio.Lock for steps that must be ordered
+      across the locations of one world (e.g. NPC moves between locations)
+    - periods are anchored to a fixed cadence (no drift); missed periods are counted, not replayed
+    """
+
+    def __init__(
+        self,
+        *,
+        cfg: WorldSimulatorConfig,
+        list_worlds: Callable[[], Awaitable[List[str]]],
+        list_locations: Callable[[str, datetime], Awaitable[List[str]]],
+        tick_location: Callable[[str, str, datetime, asyncio.Lock], Awaitable[None]],
+        leases: Optional[WorldLeaseManager] = None,
+        on_error: Optional[Callable[[Exception], None]] = None,
+    ) -> None:
+        self.cfg = cfg
+        self._list_worlds = list_worlds
+        self._list_locations = list_locations
+        self._tick_location = tick_location
+        self._leases = leases
+        self._on_error = on_error
+
+        self._sem = asyncio.Semaphore(max(1, int(cfg.max_concurrency or 1)))
+        self._world_sems: Dict[str, asyncio.Semaphore] = {}
+        self._world_locks: Dict[str, asyncio.Lock] = {}
+        self._running: Dict[LocationKey, asyncio.Task] = {}
+        self._pending: Dict[LocationKey, datetime] = {}
+
+        self._stats: Dict[str, int] = {
+            "periods": 0,
+            "missed_periods": 0,
+            "dispatched": 0,
+            "completed": 0,
+            "failed": 0,
+            "skipped": 0,
+            "coalesced": 0,
+        }
+        self._last_period_worlds: List[str] = []
+
+    def _report(self, e: Exception) -> None:
+        if self._on_error is None:
+            return
+        try:
+            self._on_error(e)
+        except Exception:
+            pass
+
+    def _world_sem(self, world_id: str) -> asyncio.Semaphore:
+        sem = self._world_sems.get(world_id)
+        if sem is None:
+            sem = asyncio.Semaphore(max(1, int(self.cfg.per_world_concurrency or 1)))
+            self._world_sems[world_id] = sem
+        return sem
+
+    def _world_lock(self, world_id: str) -> asyncio.Lock:
+        lock = self._world_locks.get(world_id)
+        if lock is None:
+            lock = asyncio.Lock()
+            self._world_locks[world_id] = lock
+        return lock
+
+    def _prune_worlds(self, active: List[str]) -> None:
+        """Drop per-world semaphores/locks of worlds that left the period and have no tick in flight."""
+        keep = set(active)
+        keep.update(w for (w, _loc), t in self._running.items() if not t.done())
+        keep.update(w for (w, _loc) in self._pending)
+        for table in (self._world_sems, self._world_locks):
+            for world_id in [w for w in table if w not in keep]:
+                table.pop(world_id, None)
+
+    # ---- dispatch ----
+
+    def dispatch(self, world_id: str, location_id: str, dt: datetime) -> None:
+        key: LocationKey = (world_id, location_id)
+        task = self._running.get(key)
+        if task is not None and not task.done():
+            if str(self.cfg.overrun_policy or "coalesce").lower() == "skip":
+                self._stats["skipped"] += 1
+            else:
+                if key in self._pending:
+                    self._stats["skipped"] += 1
+                self._pending[key] = dt
+                self._stats["coalesced"] += 1
+            return
+        self._stats["dispatched"] += 1
+        self._running[key] = asyncio.create_task(self._run_location(key, dt))
+
+    async def _run_location(self, key: LocationKey, dt: datetime) -> None:
+        world_id, location_id = key
+        try:
+            while True:
+                async with self._sem:
+                    async with self._world_sem(world_id):
+                        try:
+                            await self._tick_location(world_id, location_id, dt, self._world_lock(world_id))
+                            self._stats["completed"] += 1
+                        except asyncio.CancelledError:
+                            raise
+                        except Exception as e:
+                            self._stats["failed"] += 1
+                            self._report(e)
+                nxt = self._pending.pop(key, None)
+                if nxt is None:
+                    return
+                dt = nxt
+        finally:
+            if self._running.get(key) is asyncio.current_task():
+                self._running.pop(key, None)
+
+    async def run_period(self, dt: datetime) -> None:
+        self._stats["periods"] += 1
+        worlds = await self._list_worlds()
+        if self._leases is not None:
+            worlds = await self._leases.refresh(worlds)
+        self._last_period_worlds = list(worlds)
+
+        async def _locs(world_id: str) -> Tuple[str, List[str]]:
+            try:
+                return world_id, list(await self._list_locations(world_id, dt))
+            except asyncio.CancelledError:
+                raise
+            except Exception as e:
+                self._report(e)
+                return world_id, []
+
+        for world_id, locs in await asyncio.gather(*[_locs(w) for w in worlds]):
+            for location_id in locs:
+                self.dispatch(world_id, location_id, dt)
+        self._prune_worlds(worlds)
+
+    # ---- loop ----
+
+    async def run(self) -> None:
+        if not self.cfg.enabled:
+            return
+        loop = asyncio.get_running_loop()
+        interval = float(max(1, int(self.cfg.interval_sec or 30)))
+        next_at = loop.time()
+        try:
+            while True:
+                try:
+                    await self.run_period(utc_now())
+                except asyncio.CancelledError:
+                    raise
+                except Exception as e:
+                    self._report(e)
+
+                next_at += interval
+                now = loop.time()
+                if next_at <= now:
+                    missed = int((now - next_at) // interval) + 1
+                    self._stats["missed_periods"] += missed
+                    next_at += missed * interval
+                await asyncio.sleep(max(0.0, next_at - now))
+        finally:
+            await self.aclose()
+
+    async def aclose(self) -> None:
+        tasks = [t for t in self._running.values() if not t.done()]
+        for t in tasks:
+            t.cancel()
+        if tasks:
+            await asyncio.gather(*tasks, return_exceptions=True)
+        self._running.clear()
+        self._pending.clear()
+        self._world_sems.clear()
+        self._world_locks.clear()
+        if self._leases is not None:
+            try:
+                await self._leases.release_all()
+            except Exception:
+                pass
+
+    def stats(self) -> Dict[str, Any]:
+        out: Dict[str, Any] = dict(self._stats)
+        out["running"] = sum(1 for t in self._running.values() if not t.done())
+        out["pending"] = len(self._pending)
+        out["worlds"] = list(self._last_period_worlds)
+        if self._leases is not None:
+            out["lease"] = {
+                "owner_id": self._leases.owner_id,
+                "ttl_sec": self._leases.ttl_sec,
+                "owned": sorted(self._leases.owned),
+                "single_replica_fallback": bool(self._leases.unavailable),
+            }
+        return out
@@ -0,0 +1,255 @@
+from __future__ import annotations
+
+import hashlib
+import json
+import time
+from typing import Any, Dict, Iterable, List, Optional, Tuple
+
+
+class WorldStateCache:
+    """
+    In-process cache for hot world reads (single event loop; no locking).
+
+    Kinds / keys:
+    - "state":   (world_id, location_id) -> world_state row
+    - "npcs":    (world_id, "")          -> all world_npc_state rows of the world
+    - "recent":  (world_id, location_id) -> {limit: rows} of world_event_log (seq desc)
+
+    Writes made by this process update the cache write-through; writes made elsewhere
+    arrive as world_event_log notifications (invalidate). Entries also expire after
+    ttl_sec so a missed notification only costs bounded staleness.
+
+    Every (kind, world_id, location_id) has a version that changes whenever the cached
+    value may have changed; read fills pass the version they started from so a write that
+    landed meanwhile wins. Versions come from one monotonic counter, so dropping a key's
+    version is safe: an absent key reads as the counter value at the last prune, which is
+    newer than any version an in-flight read could have seen before that key changed.
+
+    ETags are derived from the response content (etag()), so they are correct with the cache
+    disabled and identical across replicas for identical data.
+    """
+
+    # Own appends whose pg_notify echo has not arrived after this long are forgotten.
+    ECHO_TTL_SEC = 60.0
+
+    def __init__(self, *, ttl_sec: float = 10.0, max_items: int = 2048) -> None:
+        self.ttl_sec = float(ttl_sec)
+        self.max_items = max(16, int(max_items))
+        self._data: Dict[Tuple[str, str, str], Tuple[float, Any]] = {}
+        self._versions: Dict[Tuple[str, str, str], int] = {}
+        self._clock = 0
+        self._version_floor = 0
+        # Events this process appended, by (channel-ish key, seq), until their pg_notify echo arrives.
+        self._pending_echo: Dict[Tuple[str, str, int], float] = {}
+        self._stats: Dict[str, int] = {"hits": 0, "misses": 0, "invalidations": 0, "notifications": 0}
+
+    @property
+    def enabled(self) -> bool:
+        return self.ttl_sec > 0
+
+    # ---- versions ----
+
+    def version(self, kind: str, world_id: str, location_id: str = "") -> int:
+        return self._versions.get((kind, world_id, location_id), self._version_floor)
+
+    @staticmethod
+    def etag(kind: str, content: Any) -> str:
+        body = json.dumps(content, ensure_ascii=False, sort_keys=True, separators=(",", ":"), default=str)
+        return f'W/"{kind}-{hashlib.sha256(body.encode("utf-8")).hexdigest()[:32]}"'
+
+    def _bump(self, key: Tuple[str, str, str]) -> None:
+        self._clock += 1
+        self._versions[key] = self._clock
+        if len(self._versions) > 2 * self.max_items:
+            self._prune_versions()
+
+    def _prune_versions(self) -> None:
+        # Keep versions of live entries only; every dropped key now reads as the current clock.
+        self._version_floor = self._clock
+        self._versions = {k: v for k, v in self._versions.items() if k in self._data}
+
+    # ---- raw get/put ----
+
+    def _get(self, key: Tuple[str, str, str]) -> Optional[Any]:
+        if not self.enabled:
+            return None
+        item = self._data.get(key)
+        if item is None:
+            self._stats["misses"] += 1
+            return None
+        expires_at, value = item
+        if time.monotonic() > expires_at:
+            self._data.pop(key, None)
+            # Expired: an in-flight fill that started from the old entry must not win.
+            self._bump(key)
+            self._stats["misses"] += 1
+            return None
+        self._stats["hits"] += 1
+        return value
+
+    def _put(
+        self,
+        key: Tuple[str, str, str],
+        value: Any,
+        *,
+        bump: bool = True,
+        expect_version: Optional[int] = None,
+    ) -> None:
+        # Read-fill guard: a write that landed while the read was in flight wins.
+        if expect_version is not None and self._versions.get(key, self._version_floor) != expect_version:
+            return
+        if bump:
+            self._bump(key)
+        if not self.enabled:
+            return
+        if len(self._data) >= self.max_items and key not in self._data:
+            # Drop the entry closest to expiry (cheap, good enough at this size).
+            oldest = min(self._data.items(), key=lambda kv: kv[1][0])[0]
+            self._data.pop(oldest, None)
+            self._bump(oldest)
+        self._data[key] = (time.monotonic() + self.ttl_sec, value)
+
+    def _invalidate(self, key: Tuple[str, str, str]) -> None:
+        self._data.pop(key, None)
+        self._bump(key)
+        self._stats["invalidations"] += 1
+
+    # ---- world_state ----
+
+    def get_state(self, world_id: str, location_id: str) -> Optional[Dict[str, Any]]:
+        v = self._get(("state", world_id, location_id))
+        return dict(v) if isinstance(v, dict) else None
+
+    def put_state(self, row: Dict[str, Any], *, expect_version: Optional[int] = None) -> None:
+        if not isinstance(row, dict) or not isinstance(row.get("world_id"), str):
+            return
+        key = ("state", str(row["world_id"]), str(row.get("location_id") or ""))
+        self._put(key, dict(row), expect_version=expect_version)
+
+    # ---- world_npc_state ----
+
+    def get_npcs(self, world_id: str, location_id: Optional[str] = None) -> Optional[List[Dict[str, Any]]]:
+        rows = self._get(("npcs", world_id, ""))
+        if not isinstance(rows, list):
+            return None
+        if location_id is None:
+            return [dict(r) for r in rows]
+        return [dict(r) for r in rows if str(r.get("location_id") or "") == location_id]
+
+    def put_npcs(self, world_id: str, rows: List[Dict[str, Any]], *, expect_version: Optional[int] = None) -> None:
+        self._put(("npcs", world_id, ""), [dict(r) for r in rows if isinstance(r, dict)], expect_version=expect_version)
+
+    def merge_npcs(self, world_id: str, rows: Iterable[Dict[str, Any]]) -> None:
+        """Write-through for world_npc_state upserts (merge by npc_id into the cached world list)."""
+        key = ("npcs", world_id, "")
+        item = self._data.get(key)
+        if item is None or time.monotonic() > item[0]:
+            self._invalidate(key)
+            return
+        by_id: Dict[str, Dict[str, Any]] = {str(r.get("npc_id")): dict(r) for r in item[1]}
+        for r in rows:
+            if isinstance(r, dict) and r.get("npc_id"):
+                cur = by_id.get(str(r["npc_id"]), {})
+                cur.update({k: v for k, v in r.items() if k in ("npc_id", "location_id", "action", "emotion", "updated_at")})
+                by_id[str(r["npc_id"])] = cur
+        self._put(key, list(by_id.values()))
+
+    # ---- world_event_log (recent, per channel) ----
+
+    def get_recent(self, world_id: str, location_id: str, limit: int) -> Optional[List[Dict[str, Any]]]:
+        by_limit = self._get(("recent", world_id, location_id))
+        if not isinstance(by_limit, dict):
+            return None
+        rows = by_limit.get(int(limit))
+        return list(rows) if isinstance(rows, list) else None
+
+    def put_recent(
+        self,
+        world_id: str,
+        location_id: str,
+        limit: int,
+        rows: List[Dict[str, Any]],
+        *,
+        expect_version: Optional[int] = None,
+    ) -> None:
+        key = ("recent", world_id, location_id)
+        item = self._data.get(key)
+        live = item is not None and time.monotonic() <= item[0]
+        by_limit = dict(item[1]) if live else {}
+        by_limit[int(limit)] = list(rows)
+        # Filling another limit of an unchanged channel is not a new version.
+        self._put(key, by_limit, bump=not live, expect_version=expect_version)
+
+    # ---- invalidation ----
+
+    def on_event(
+        self,
+        world_id: str,
+        location_id: str,
+        seqs: Iterable[Any] = (),
+        *,
+        expect_echo: bool = False,
+    ) -> None:
+        """
+        Events with these seqs were appended to world:{world_id}[:{location_id}] by this process.
+        Only events whose seq is known are matched against their echo; without a seq the echo
+        is treated like a remote event (one extra invalidation, never a missed one).
+        """
+        self._invalidate(("recent", world_id, location_id))
+        if not expect_echo:
+            return
+        now = time.monotonic()
+        self._expire_echoes(now)
+        for seq in seqs:
+            try:
+                self._pending_echo[(world_id, location_id, int(seq))] = now
+            except (TypeError, ValueError):
+                continue
+
+    def _expire_echoes(self, now: float) -> None:
+        cutoff = now - self.ECHO_TTL_SEC
+        for k in [k for k, at in self._pending_echo.items() if at < cutoff]:
+            self._pending_echo.pop(k, None)
+
+    def on_remote_event(self, world_id: str, location_id: str, seq: Any = None) -> None:
+        """
+        world_event_log notification. For this process's own appends (echo, matched by seq) the
+        caches were already updated write-through; otherwise the rows behind the event
+        (state / NPCs) may have changed elsewhere, so drop them too.
+        """
+        self._stats["notifications"] += 1
+        try:
+            k = (world_id, location_id, int(seq))
+        except (TypeError, ValueError):
+            k = None
+        if k is not None and self._pending_echo.pop(k, None) is not None:
+            return
+        self._invalidate(("recent", world_id, location_id))
+        self._invalidate(("state", world_id, location_id))
+        self._invalidate(("npcs", world_id, ""))
+
+    def invalidate_world(self, world_id: str) -> None:
+        for key in {k for k in list(self._data.keys()) + list(self._versions.keys()) if k[1] == world_id}:
+            self._invalidate(key)
+        # Keys of the world that have no version yet (first read still in flight) change too.
+        self._clock += 1
+        self._version_floor = self._clock
+
+    def clear(self) -> None:
+        self._pending_echo.clear()
+        self._stats["invalidations"] += len(self._data)
+        self._data.clear()
+        self._clock += 1
+        self._version_floor = self._clock
+        self._versions = {}
+
+    def stats(self) -> Dict[str, Any]:
+        lookups = self._stats["hits"] + self._stats["misses"]
+        return {
+            **self._stats,
+            "size": len(self._data),
+            "versions": len(self._versions),
+            "pending_echo": len(self._pending_echo),
+            "ttl_sec": self.ttl_sec,
+            "hit_rate": round(self._stats["hits"] / lookups, 4) if lookups else 0.0,
+        }
@@ -265,3 +265,300 @@ create index if not exists idx_world_command_world_time
 
 create index if not exists idx_world_command_corr
   on public.world_command_log(world_id, correlation_id);
+
+-- --------------------------------------------
+-- World simulator leases (shard worlds across world-engine replicas)
+-- --------------------------------------------
+
+create table if not exists public.world_sim_leases (
+  world_id text primary key,
+  owner_id text not null,
+  expires_at timestamptz not null,
+  updated_at timestamptz not null default now()
+);
+
+-- Take or renew a lease. Succeeds when the lease is free, expired, or already ours.
+create or replace function public.world_sim_try_lease(
+  p_world_id text,
+  p_owner_id text,
+  p_ttl_sec integer
+) returns boolean
+language plpgsql
+security definer
+as $$
+declare
+  v_owner text;
+begin
+  insert into public.world_sim_leases(world_id, owner_id, expires_at, updated_at)
+  values (p_world_id, p_owner_id, now() + make_interval(secs => greatest(1, p_ttl_sec)), now())
+  on conflict (world_id) do update
+    set owner_id = excluded.owner_id,
+        expires_at = excluded.expires_at,
+        updated_at = now()
+    where public.world_sim_leases.owner_id = excluded.owner_id
+       or public.world_sim_leases.expires_at < now()
+  returning owner_id into v_owner;
+
+  return coalesce(v_owner = p_owner_id, false);
+end $$;
+
+create or replace function public.world_sim_release_lease(
+  p_world_id text,
+  p_owner_id text
+) returns void
+language plpgsql
+security definer
+as $$
+begin
+  delete from public.world_sim_leases
+    where world_id = p_world_id
+      and owner_id = p_owner_id;
+end $$;
+
+-- --------------------------------------------
+-- Command queue (atomic claim + push wakeup)
+-- --------------------------------------------
+
+alter table public.world_command_log add column if not exists claimed_by text;
+alter table public.world_command_log add column if not exists claimed_at timestamptz;
+
+create index if not exists idx_world_command_pending
+  on public.world_command_log(created_at)
+  where status in ('queued', 'accepted', 'processing');
+
+-- Claim up to p_limit pending commands for one worker.
+-- - FOR UPDATE SKIP LOCKED: concurrent workers never claim the same row and never block each other
+-- - rows stuck in 'processing' longer than p_stale_sec (crashed worker) are re-claimed
+-- - commands of one (world_id, user_id) group are claimed under a transaction-scoped advisory lock,
+--   and only while no earlier command of the group is still processing. The processing check runs
+--   after the lock is taken, so it sees claims committed by a concurrent claimer of the same group
+--   (a plain NOT EXISTS would miss claims of transactions that have not committed yet).
+--   A group whose lock is held by another claimer is skipped for this call.
+create or replace function public.world_claim_commands(
+  p_worker_id text,
+  p_limit integer default 20,
+  p_stale_sec integer default 120
+) returns setof public.world_command_log
+language plpgsql
+security definer
+as $$
+declare
+  v_limit integer := greatest(1, least(p_limit, 100));
+  v_stale interval := make_interval(secs => greatest(1, p_stale_sec));
+  v_group record;
+  v_row public.world_command_log;
+  v_claimed integer := 0;
+begin
+  for v_group in
+    select g.world_id, g.user_id
+    from (
+      select c.world_id, c.user_id, min(c.created_at) as first_at
+      from public.world_command_log c
+      where c.status in ('queued', 'accepted')
+         or (c.status = 'processing' and c.claimed_at < now() - v_stale)
+      group by c.world_id, c.user_id
+    ) g
+    order by g.first_at asc
+  loop
+    exit when v_claimed >= v_limit;
+
+    if not pg_try_advisory_xact_lock(
+      hashtext('world_command:' || v_group.world_id || ':' || coalesce(v_group.user_id::text, ''))
+    ) then
+      continue;
+    end if;
+
+    if exists (
+      select 1
+      from public.world_command_log p
+      where p.world_id = v_group.world_id
+        and p.user_id is not distinct from v_group.user_id
+        and p.status = 'processing'
+        and p.claimed_at >= now() - v_stale
+    ) then
+      continue;
+    end if;
+
+    for v_row in
+      with picked as (
+        select c.id
+        from public.world_command_log c
+        where c.world_id = v_group.world_id
+          and c.user_id is not distinct from v_group.user_id
+          and (
+            c.status in ('queued', 'accepted')
+            or (c.status = 'processing' and c.claimed_at < now() - v_stale)
+          )
+        order by c.created_at asc
+        limit v_limit - v_claimed
+        for update skip locked
+      )
+      update public.world_command_log w
+        set status = 'processing',
+            claimed_by = p_worker_id,
+            claimed_at = now(),
+            updated_at = now()
+        from picked
+        where w.id = picked.id
+      returning w.*
+    loop
+      v_claimed := v_claimed + 1;
+      return next v_row;
+    end loop;
+  end loop;
+  return;
+end $$;
+
+-- Hand claimed-but-unprocessed commands back to the queue (worker error / shutdown),
+-- instead of leaving their group blocked in 'processing' until p_stale_sec.
+create or replace function public.world_release_commands(
+  p_worker_id text,
+  p_ids uuid[]
+) returns integer
+language plpgsql
+security definer
+as $$
+declare
+  v_n integer;
+begin
+  update public.world_command_log
+    set status = 'queued',
+        claimed_by = null,
+        claimed_at = null,
+        updated_at = now()
+    where id = any(p_ids)
+      and status = 'processing'
+      and (claimed_by is null or claimed_by = p_worker_id);
+  get diagnostics v_n = row_count;
+  return v_n;
+end $$;
+
+-- Wake listening workers (LISTEN world_command) as soon as a command lands.
+create or replace function public.world_command_notify()
+returns trigger
+language plpgsql
+as $$
+begin
+  perform pg_notify('world_command', new.world_id);
+  return new;
+end $$;
+
+drop trigger if exists trg_world_command_notify on public.world_command_log;
+create trigger trg_world_command_notify
+  after insert on public.world_command_log
+  for each row execute function public.world_command_notify();
+
+-- --------------------------------------------
+-- Visit commit (one round trip for /world/visit writes)
+-- --------------------------------------------
+
+-- Writes a visit's results in one transaction:
+-- world_visits (monotonic last_visit), world_state, world_npc_state patches, then events in order.
+-- p_npc_states: [{npc_id, location_id, action, emotion, updated_at}]
+-- p_events:     [{type, actor, payload, ts}]
+create or replace function public.world_visit_commit(
+  p_world_id text,
+  p_layer_id text,
+  p_location_id text,
+  p_visitor_key text,
+  p_visit_ts timestamptz,
+  p_state jsonb,
+  p_npc_states jsonb default '[]'::jsonb,
+  p_events jsonb default '[]'::jsonb
+) returns jsonb
+language plpgsql
+security definer
+as $$
+declare
+  v_state public.world_state;
+  v_row public.world_event_log;
+  v_events jsonb := '[]'::jsonb;
+  v_x jsonb;
+begin
+  insert into public.world_visits(world_id, visitor_key, location_id, last_visit, updated_at)
+  values (p_world_id, p_visitor_key, p_location_id, p_visit_ts, now())
+  on conflict (world_id, visitor_key, location_id) do update
+    set last_visit = greatest(public.world_visits.last_visit, excluded.last_visit),
+        updated_at = now();
+
+  insert into public.world_state(world_id, location_id, time_of_day, weather, season, moon_phase, anomaly, updated_at)
+  values (
+    p_world_id,
+    p_location_id,
+    coalesce(p_state->>'time_of_day', 'day'),
+    coalesce(p_state->>'weather', 'clear'),
+    coalesce(p_state->>'season', 'spring'),
+    coalesce(p_state->>'moon_phase', 'unknown'),
+    nullif(p_state->'anomaly', 'null'::jsonb),
+    coalesce((p_state->>'updated_at')::timestamptz, now())
+  )
+  on conflict (world_id, location_id) do update
+    set time_of_day = excluded.time_of_day,
+        weather = excluded.weather,
+        season = excluded.season,
+        moon_phase = excluded.moon_phase,
+        anomaly = excluded.anomaly,
+        updated_at = excluded.updated_at
+  returning * into v_state;
+
+  -- Row by row: the same NPC may be patched more than once (later patch wins).
+  for v_x in select * from jsonb_array_elements(coalesce(p_npc_states, '[]'::jsonb)) loop
+    insert into public.world_npc_state(world_id, npc_id, location_id, action, emotion, updated_at)
+    values (
+      p_world_id,
+      v_x->>'npc_id',
+      coalesce(v_x->>'location_id', ''),
+      v_x->>'action',
+      v_x->>'emotion',
+      coalesce((v_x->>'updated_at')::timestamptz, now())
+    )
+    on conflict (world_id, npc_id) do update
+      set location_id = excluded.location_id,
+          action = excluded.action,
+          emotion = excluded.emotion,
+          updated_at = excluded.updated_at;
+  end loop;
+
+  for v_x in select * from jsonb_array_elements(coalesce(p_events, '[]'::jsonb)) loop
+    v_row := public.world_append_event(
+      p_world_id,
+      p_layer_id,
+      p_location_id,
+      v_x->>'type',
+      case when jsonb_typeof(v_x->'actor') = 'object' then v_x->'actor' else null end,
+      coalesce(v_x->'payload', '{}'::jsonb),
+      (v_x->>'ts')::timestamptz
+    );
+    v_events := v_events || jsonb_build_array(to_jsonb(v_row));
+  end loop;
+
+  return jsonb_build_object('world_state', to_jsonb(v_state), 'events', v_events);
+end $$;
+
+-- --------------------------------------------
+-- Event notifications (world-engine read cache invalidation)
+-- --------------------------------------------
+
+-- Same stream the event gateway relays via Realtime, as a lightweight pg_notify for
+-- world-engine replicas (LISTEN world_event; payload: {channel, seq, world_id, location_id}).
+create or replace function public.world_event_notify()
+returns trigger
+language plpgsql
+as $$
+begin
+  perform pg_notify(
+    'world_event',
+    json_build_object(
+      'channel', new.channel,
+      'seq', new.seq,
+      'world_id', new.world_id,
+      'location_id', coalesce(new.location_id, '')
+    )::text
+  );
+  return new;
+end $$;
+
+drop trigger if exists trg_world_event_notify on public.world_event_log;
+create trigger trg_world_event_notify
+  after insert on public.world_event_log
+  for each row execute function public.world_event_notify();
@@ -419,6 +419,10 @@ create index if not exists idx_common_attachments_user_created
 create index if not exists idx_common_attachments_user_attachment_id
   on public.common_attachments (user_id, attachment_id);
 
+-- Upload dedup: same user + same content hash -> reuse the stored object.
+create index if not exists idx_common_attachments_user_sha256
+  on public.common_attachments (user_id, sha256, created_at desc);
+
 -- ============================================================
 -- Phase04: External I/O audit log (replay-friendly)
 -- ============================================================
@@ -0,0 +1,86 @@
+-- Project Sigmaris - pgvector semantic recall for common_episodes (Sigmaris Persona Core)
+-- ============================================================
+-- Additive migration (safe to run multiple times).
+-- Intended to be run in Supabase SQL Editor, after common_episodes_character_scoped.sql.
+--
+-- Goal:
+-- - Serve SupabaseEpisodeStore.search_embedding() on the server side.
+-- - Only the top-k rows (filtered by user_id / character_id) come back over HTTP.
+--
+-- Notes:
+-- - The embedding dimension must match the embedding model used by persona-core
+--   (text-embedding-3-small = 1536).
+-- - Similarity is cosine similarity (1 - cosine distance).
+-- - The function is `security invoker`, so RLS on common_episodes still applies:
+--   an authenticated caller only sees its own rows whatever p_user_id says.
+--   persona-core calls it with the service_role key. anon cannot execute it.
+
+create extension if not exists vector;
+
+alter table if exists public.common_episodes
+  add column if not exists embedding vector(1536);
+
+-- ANN index for cosine distance (pgvector >= 0.5).
+create index if not exists idx_common_episodes_embedding_hnsw
+  on public.common_episodes using hnsw (embedding vector_cosine_ops);
+
+-- Top-k similarity search scoped by (user_id, character_id).
+-- - p_character_id null/empty: no character filter (same as SupabaseEpisodeStore._filters()).
+-- - p_include_embedding=false: embedding is returned as null to keep the payload small.
+create or replace function public.common_episodes_match(
+  p_user_id uuid,
+  p_query vector(1536),
+  p_character_id text default null,
+  p_limit int default 5,
+  p_min_similarity real default 0,
+  p_include_embedding boolean default false
+) returns table (
+  episode_id text,
+  "timestamp" timestamptz,
+  summary text,
+  emotion_hint text,
+  traits_hint jsonb,
+  raw_context text,
+  embedding vector(1536),
+  similarity real
+)
+language plpgsql
+stable
+security invoker
+as $$
+begin
+  -- pgvector >= 0.8: keep scanning the HNSW graph until enough rows pass the
+  -- user/character filter. Older versions ignore this (unknown setting).
+  begin
+    perform set_config('hnsw.iterative_scan', 'relaxed_order', true);
+  exception when others then
+    null;
+  end;
+
+  return query
+  select
+    e.episode_id,
+    e.timestamp,
+    e.summary,
+    e.emotion_hint,
+    e.traits_hint,
+    e.raw_context,
+    case when p_include_embedding then e.embedding else null end,
+    (1 - (e.embedding <=> p_query))::real as similarity
+  from public.common_episodes e
+  where e.user_id = p_user_id
+    -- defense in depth on top of RLS: a signed-in user can only match its own rows
+    and (auth.uid() is null or e.user_id = auth.uid())
+    and e.embedding is not null
+    and (
+      p_character_id is null
+      or p_character_id = ''
+      or e.character_id = p_character_id
+    )
+    and (1 - (e.embedding <=> p_query)) > p_min_similarity
+  order by e.embedding <=> p_query
+  limit greatest(1, least(coalesce(p_limit, 5), 100));
+end $$;
+
+revoke execute on function public.common_episodes_match(uuid, vector, text, int, real, boolean) from public, anon;
+grant execute on function public.common_episodes_match(uuid, vector, text, int, real, boolean) to authenticated, service_role;
@@ -0,0 +1,129 @@
+from __future__ import annotations
+
+import argparse
+import json
+import random
+import sqlite3
+import statistics
+import sys
+import tempfile
+import time
+import uuid
+from contextlib import contextmanager
+from datetime import datetime, timedelta, timezone
+from pathlib import Path
+from typing import Any, Dict, Iterator, List
+
+
+REPO_ROOT = Path(__file__).resolve().parents[2]
+SIGMARIS_CORE = REPO_ROOT / "gensokyo-persona-core"
+
+# Ensure we import the *real* persona_core package under gensokyo-persona-core/,
+# not the legacy top-level persona_core/ folder (if present).
+sys.path.insert(0, str(SIGMARIS_CORE))
+
+
+from persona_core.memory.episode_store import Episode  # noqa: E402
+from persona_core.memory.episode_store_sqlite import SQLiteEpisodeStore  # noqa: E402
+
+
+class PerCallConnectEpisodeStore(SQLiteEpisodeStore):
+    """
+    Reproduces the previous connection strategy (a fresh sqlite3.connect per call,
+    default rollback journal, no pragmas) as the "before" side of the comparison.
+    """
+
+    @contextmanager
+    def _connect(self) -> Iterator[sqlite3.Connection]:
+        conn = sqlite3.connect(self.db_path)
+        conn.row_factory = sqlite3.Row
+        try:
+            with conn:
+                yield conn
+        finally:
+            conn.close()
+
+
+def _episode(i: int, *, base: datetime, dim: int, rng: random.Random) -> Episode:
+    return Episode(
+        episode_id=str(uuid.uuid4()),
+        timestamp=base + timedelta(seconds=i),
+        summary=f"bench episode {i}",
+        emotion_hint="neutral",
+        traits_hint={"calm": rng.random(), "empathy": rng.random(), "curiosity": rng.random()},
+        raw_context=f"user: message {i}\nassistant: reply {i}",
+        embedding=[rng.uniform(-1.0, 1.0) for _ in range(dim)],
+    )
+
+
+def _turn(store: SQLiteEpisodeStore, *, i: int, base: datetime, dim: int, rng: random.Random) -> None:
+    # Storage calls a single persona turn makes (recall + drift + persistence).
+    store.fetch_recent(limit=50)
+    store.get_last(5)
+    store.count()
+    store.trait_trend(5)
+    store.search_embedding([rng.uniform(-1.0, 1.0) for _ in range(dim)], limit=5)
+    store.add(_episode(i, base=base, dim=dim, rng=rng))
+    store.add(_episode(i, base=base, dim=dim, rng=rng))
+
+
+def _bench(store_cls: Any, *, db_path: str, seed_rows: int, turns: int, dim: int) -> Dict[str, Any]:
+    rng = random.Random(7)
+    base = datetime.now(timezone.utc) - timedelta(days=30)
+
+    store = store_cls(db_path)
+    seed = [_episode(i, base=base, dim=dim, rng=rng) for i in range(seed_rows)]
+    store.add_many(seed)
+
+    # Warm-up (index load, page cache) so we measure steady-state turns.
+    _turn(store, i=seed_rows, base=base, dim=dim, rng=rng)
+
+    samples: List[float] = []
+    for t in range(turns):
+        started = time.perf_counter()
+        _turn(store, i=seed_rows + 1 + t, base=base, dim=dim, rng=rng)
+        samples.append((time.perf_counter() - started) * 1000.0)
+
+    samples.sort()
+    return {
+        "turns": turns,
+        "mean_ms": round(statistics.fmean(samples), 3),
+        "p50_ms": round(samples[len(samples) // 2], 3),
+        "p95_ms": round(samples[min(len(samples) - 1, int(len(samples) * 0.95))], 3),
+    }
+
+
+def main() -> int:
+    ap = argparse.ArgumentParser(description="Per-turn storage overhead of SQLiteEpisodeStore (before/after pooling).")
+    ap.add_argument("--seed-rows", type=int, default=2000)
+    ap.add_argument("--turns", type=int, default=200)
+    ap.add_argument("--dim", type=int, default=256)
+    args = ap.parse_args()
+
+    report: Dict[str, Any] = {"seed_rows": args.seed_rows, "dim": args.dim}
+    with tempfile.TemporaryDirectory() as tmp:
+        report["per_call_connect"] = _bench(
+            PerCallConnectEpisodeStore,
+            db_path=str(Path(tmp) / "before.sqlite3"),
+            seed_rows=args.seed_rows,
+            turns=args.turns,
+            dim=args.dim,
+        )
+        report["pooled"] = _bench(
+            SQLiteEpisodeStore,
+            db_path=str(Path(tmp) / "after.sqlite3"),
+            seed_rows=args.seed_rows,
+            turns=args.turns,
+            dim=args.dim,
+        )
+
+    before = report["per_call_connect"]["mean_ms"]
+    after = report["pooled"]["mean_ms"]
+    report["speedup"] = round(before / after, 2) if after > 0 else None
+
+    print(json.dumps(report, ensure_ascii=False, indent=2))
+    return 0
+
+
+if __name__ == "__main__":
+    raise SystemExit(main())
@@ -3,12 +3,16 @@ from __future__ import annotations
 import argparse
 import json
 import os
+import random
 import sys
+import threading
 import time
+import tracemalloc
 import uuid
+from concurrent.futures import ThreadPoolExecutor
 from dataclasses import dataclass
 from pathlib import Path
-from typing import Any, Dict, List, Optional, Tuple
+from typing import Any, Callable, Dict, Iterable, List, Optional, Tuple
 
 
 REPO_ROOT = Path(__file__).resolve().parents[2]
@@ -220,12 +224,16 @@ def _compare_with_baseline(
     return len(failures) == 0, failures
 
 
-def _build_controller() -> Tuple[PersonaController, SafetyLayer]:
+def _build_controller(
+    *,
+    llm: Optional[MockLLMClient] = None,
+    episode_store: Optional[InMemoryEpisodeStore] = None,
+) -> Tuple[PersonaController, SafetyLayer]:
     # Remove time-dependent hysteresis for benchmark determinism.
     os.environ.setdefault("SIGMARIS_DSM_MIN_DWELL_SEC", "0")
 
-    llm = MockLLMClient(reply_style="echo")
-    episode_store = InMemoryEpisodeStore()
+    llm = llm or MockLLMClient(reply_style="echo")
+    episode_store = episode_store or InMemoryEpisodeStore()
 
     selective_recall = SelectiveRecall(memory_backend=episode_store, embedding_model=llm)
     ambiguity_resolver = AmbiguityResolver(embedding_model=llm)
@@ -254,11 +262,27 @@ def _build_controller() -> Tuple[PersonaController, SafetyLayer]:
     return controller, safety
 
 
-def run(*, cases_path: Path) -> Dict[str, Any]:
+def _load_cases(cases_path: Path) -> List[Dict[str, Any]]:
     payload = json.loads(cases_path.read_text(encoding="utf-8"))
     cases = payload.get("cases")
     if not isinstance(cases, list) or not cases:
         raise SystemExit("cases file has no cases")
+    return [c for c in cases if _is_record(c)]
+
+
+def _case_request(item: Dict[str, Any], *, session_suffix: str = "") -> PersonaRequest:
+    cid = str(item.get("id") or "")
+    req_cfg = item.get("req") if _is_record(item.get("req")) else {}
+    user_id = str(req_cfg.get("user_id") or "u_bench")
+    session_id = str(req_cfg.get("session_id") or f"s_{cid}") + session_suffix
+    message = str(req_cfg.get("message") or "")
+    metadata = dict(req_cfg.get("metadata") or {}) if _is_record(req_cfg.get("metadata")) else {}
+    metadata["_trace_id"] = str(uuid.uuid4())
+    return PersonaRequest(user_id=user_id, session_id=session_id, message=message, metadata=metadata)
+
+
+def run(*, cases_path: Path) -> Dict[str, Any]:
+    cases = _load_cases(cases_path)
 
     controller, safety = _build_controller()
 
@@ -269,18 +293,10 @@ def run(*, cases_path: Path) -> Dict[str, Any]:
         if not _is_record(item):
             continue
         cid = str(item.get("id") or "")
-        req_cfg = item.get("req") if _is_record(item.get("req")) else {}
         expected = item.get("expect") if _is_record(item.get("expect")) else {}
 
-        user_id = str(req_cfg.get("user_id") or "u_bench")
-        session_id = str(req_cfg.get("session_id") or f"s_{cid}")
-        message = str(req_cfg.get("message") or "")
-        metadata = dict(req_cfg.get("metadata") or {}) if _is_record(req_cfg.get("metadata")) else {}
-
-        trace_id = str(uuid.uuid4())
-        metadata["_trace_id"] = trace_id
-
-        req = PersonaRequest(user_id=user_id, session_id=session_id, message=message, metadata=metadata)
+        req = _case_request(item)
+        user_id = req.user_id
 
         # SafetyLayer first (server_persona_os does this outside controller)
         assessment = safety.assess(
@@ -351,14 +367,410 @@ def run(*, cases_path: Path) -> Dict[str, Any]:
     return report
 
 
+# ==========================================================
+# Performance mode (--perf)
+# ==========================================================
+#
+# Replays the same cases through handle_turn / handle_turn_stream with a mock LLM,
+# embedder and episode store that sleep like the real services would, at N concurrent
+# sessions (one controller per session, like server_persona_os builds one per request).
+# Stage timings come from wrapping the controller's stage methods on each instance.
+
+PERF_STAGES = ("safety", "memory_recall", "identity", "drift", "naturalness", "llm", "persistence")
+
+
+@dataclass
+class LatencyProfile:
+    llm_ms: float = 40.0
+    stream_chunk_ms: float = 2.0
+    embed_ms: float = 3.0
+    store_ms: float = 1.0
+    jitter: float = 0.2  # +/- fraction, seeded per session
+
+    def sleep(self, rng: random.Random, ms: float) -> None:
+        if ms <= 0:
+            return
+        j = max(0.0, float(self.jitter))
+        time.sleep(ms * (1.0 + rng.uniform(-j, j)) / 1000.0)
+
+
+@dataclass
+class LatencyMockLLMClient(MockLLMClient):
+    """MockLLMClient with simulated network latency (generation, streaming chunks, embeddings)."""
+
+    profile: LatencyProfile = None  # type: ignore[assignment]
+    seed: int = 0
+
+    def __post_init__(self) -> None:
+        self.profile = self.profile or LatencyProfile()
+        self._rng = random.Random(self.seed)
+
+    def encode(self, text: str) -> List[float]:
+        self.profile.sleep(self._rng, self.profile.embed_ms)
+        return super().encode(text)
+
+    def generate(self, **kwargs: Any) -> str:
+        self.profile.sleep(self._rng, self.profile.llm_ms)
+        return super().generate(**kwargs)
+
+    def generate_stream(self, **kwargs: Any) -> Iterable[str]:
+        text = MockLLMClient.generate(self, **kwargs)
+        # Time to first token ~ half the full generation, then a steady chunk rate.
+        self.profile.sleep(self._rng, self.profile.llm_ms / 2.0)
+        for i in range(0, len(text), 16):
+            yield text[i : i + 16]
+            self.profile.sleep(self._rng, self.profile.stream_chunk_ms)
+
+
+class LatencyEpisodeStore(InMemoryEpisodeStore):
+    def __init__(self, profile: LatencyProfile, seed: int = 0) -> None:
+        super().__init__()
+        self._profile = profile
+        self._rng = random.Random(seed)
+
+    def fetch_recent(self, *, limit: int = 50) -> List[Any]:
+        self._profile.sleep(self._rng, self._profile.store_ms)
+        return super().fetch_recent(limit=limit)
+
+    def add(self, ep: Any) -> None:
+        self._profile.sleep(self._rng, self._profile.store_ms)
+        super().add(ep)
+
+
+class _StageClock:
+    """Per-thread accumulation of stage time for the turn in progress."""
+
+    def __init__(self) -> None:
+        self._local = threading.local()
+
+    def begin(self) -> None:
+        self._local.turn = {}
+
+    def end(self) -> Dict[str, float]:
+        out = dict(getattr(self._local, "turn", {}) or {})
+        self._local.turn = {}
+        return out
+
+    def add(self, stage: str, ms: float) -> None:
+        turn = getattr(self._local, "turn", None)
+        if turn is None:
+            turn = self._local.turn = {}
+        turn[stage] = turn.get(stage, 0.0) + ms
+
+    def wrap(self, obj: Any, attr: str, stage: str) -> None:
+        fn = getattr(obj, attr, None)
+        if not callable(fn):
+            return
+        clock = self
+
+        def timed(*args: Any, **kwargs: Any) -> Any:
+            started = time.perf_counter()
+            try:
+                return fn(*args, **kwargs)
+            finally:
+                clock.add(stage, (time.perf_counter() - started) * 1000.0)
+
+        setattr(obj, attr, timed)
+
+    def wrap_iter(self, obj: Any, attr: str, stage: str) -> None:
+        # Generators: time spent producing chunks (not the consumer side).
+        fn = getattr(obj, attr, None)
+        if not callable(fn):
+            return
+        clock = self
+
+        def timed(*args: Any, **kwargs: Any) -> Iterable[Any]:
+            it = iter(fn(*args, **kwargs))
+            while True:
+                started = time.perf_counter()
+                try:
+                    item = next(it)
+                except StopIteration:
+                    clock.add(stage, (time.perf_counter() - started) * 1000.0)
+                    return
+                clock.add(stage, (time.perf_counter() - started) * 1000.0)
+                yield item
+
+        setattr(obj, attr, timed)
+
+
+def _instrument(controller: PersonaController, safety: SafetyLayer, llm: LatencyMockLLMClient, clock: _StageClock) -> None:
+    clock.wrap(safety, "assess", "safety")
+    clock.wrap(controller, "_select_memory", "memory_recall")
+    clock.wrap(getattr(controller, "_identity", None), "build_identity_context", "identity")
+    clock.wrap(getattr(controller, "_value", None), "apply", "drift")
+    clock.wrap(getattr(controller, "_trait", None), "apply", "drift")
+    clock.wrap(controller, "_apply_naturalness_policy", "naturalness")
+    clock.wrap(controller, "_finalize_naturalness_policy", "naturalness")
+    clock.wrap(llm, "generate", "llm")
+    clock.wrap_iter(llm, "generate_stream", "llm")
+    clock.wrap(controller, "_store_episode", "persistence")
+
+
+def _pct(sorted_vals: List[float], p: float) -> float:
+    if not sorted_vals:
+        return 0.0
+    i = min(len(sorted_vals) - 1, max(0, int(round(p * (len(sorted_vals) - 1)))))
+    return float(sorted_vals[i])
+
+
+def _summarize(samples: List[float]) -> Dict[str, float]:
+    v = sorted(samples)
+    return {
+        "p50_ms": round(_pct(v, 0.50), 3),
+        "p95_ms": round(_pct(v, 0.95), 3),
+        "p99_ms": round(_pct(v, 0.99), 3),
+        "mean_ms": round(sum(v) / len(v), 3) if v else 0.0,
+    }
+
+
+def _perf_turn(
+    controller: PersonaController,
+    safety: SafetyLayer,
+    req: PersonaRequest,
+    *,
+    stream: bool,
+) -> Tuple[float, Optional[float]]:
+    """One turn as server_persona_os runs it (safety first). Returns (total_ms, first_delta_ms)."""
+    started = time.perf_counter()
+    assessment = safety.assess(req=req, value_state=ValueState(), trait_state=TraitState(), memory=None)
+    try:
+        req.metadata["_safety_risk_score"] = float(assessment.risk_score)
+    except Exception:
+        req.metadata["_safety_risk_score"] = 0.0
+    first: Optional[float] = None
+    if stream:
+        for ev in controller.handle_turn_stream(req, user_id=req.user_id, safety_flag=assessment.safety_flag):
+            if first is None and isinstance(ev, dict) and ev.get("type") == "delta":
+                first = (time.perf_counter() - started) * 1000.0
+    else:
+        controller.handle_turn(req, user_id=req.user_id, safety_flag=assessment.safety_flag)
+    return (time.perf_counter() - started) * 1000.0, first
+
+
+def _perf_session(
+    idx: int,
+    cases: List[Dict[str, Any]],
+    *,
+    turns: int,
+    stream: bool,
+    profile: LatencyProfile,
+    clock: _StageClock,
+) -> List[Dict[str, float]]:
+    llm = LatencyMockLLMClient(reply_style="echo", profile=profile, seed=idx)
+    controller, safety = _build_controller(llm=llm, episode_store=LatencyEpisodeStore(profile, seed=idx))
+    _instrument(controller, safety, llm, clock)
+    out: List[Dict[str, float]] = []
+    for t in range(turns):
+        req = _case_request(cases[(idx + t) % len(cases)], session_suffix=f":perf{idx}")
+        clock.begin()
+        total_ms, first_ms = _perf_turn(controller, safety, req, stream=stream)
+        row = clock.end()
+        row["turn_total"] = total_ms
+        if first_ms is not None:
+            row["first_delta"] = first_ms
+        out.append(row)
+    return out
+
+
+def _perf_allocations(cases: List[Dict[str, Any]], *, turns: int, stream: bool) -> Dict[str, float]:
+    # Separate single-session pass: tracemalloc distorts timings, so it never overlaps the timed run.
+    controller, safety = _build_controller(llm=LatencyMockLLMClient(profile=LatencyProfile(0, 0, 0, 0, 0)))
+    peaks: List[float] = []
+    retained: List[float] = []
+    _perf_turn(controller, safety, _case_request(cases[0], session_suffix=":alloc"), stream=stream)  # warm-up
+    tracemalloc.start()
+    try:
+        for t in range(turns):
+            req = _case_request(cases[t % len(cases)], session_suffix=":alloc")
+            before, _ = tracemalloc.get_traced_memory()
+            tracemalloc.reset_peak()
+            _perf_turn(controller, safety, req, stream=stream)
+            after, peak = tracemalloc.get_traced_memory()
+            peaks.append((peak - before) / 1024.0)
+            retained.append((after - before) / 1024.0)
+    finally:
+        tracemalloc.stop()
+    peaks.sort()
+    return {
+        "peak_kb_p50": round(_pct(peaks, 0.50), 1),
+        "peak_kb_p95": round(_pct(peaks, 0.95), 1),
+        "retained_kb_per_turn": round(sum(retained) / len(retained), 2) if retained else 0.0,
+    }
+
+
+def run_perf(
+    *,
+    cases_path: Path,
+    sessions: int,
+    turns: int,
+    modes: List[str],
+    profile: LatencyProfile,
+    alloc_turns: int,
+) -> Dict[str, Any]:
+    cases = _load_cases(cases_path)
+    report: Dict[str, Any] = {
+        "meta": {
+            "format": "sigmaris-bench-perf-v1",
+            "generated_at": time.strftime("%Y-%m-%dT%H:%M:%SZ", time.gmtime()),
+            "sessions": sessions,
+            "turns_per_session": turns,
+            "latency_profile": profile.__dict__,
+        },
+        "modes": {},
+    }
+    for mode in modes:
+        stream = mode == "stream"
+        clock = _StageClock()
+        # Warm-up outside the measurement (imports, lazy caches).
+        _perf_session(0, cases, turns=1, stream=stream, profile=profile, clock=_StageClock())
+        started = time.perf_counter()
+        with ThreadPoolExecutor(max_workers=sessions) as pool:
+            futs = [
+                pool.submit(_perf_session, i, cases, turns=turns, stream=stream, profile=profile, clock=clock)
+                for i in range(sessions)
+            ]
+            rows = [r for f in futs for r in f.result()]
+        wall = time.perf_counter() - started
+
+        stages: Dict[str, Dict[str, float]] = {}
+        for name in PERF_STAGES + ("first_delta", "turn_total"):
+            samples = [float(r[name]) for r in rows if name in r]
+            if samples:
+                stages[name] = _summarize(samples)
+        report["modes"][mode] = {
+            "turns": len(rows),
+            "wall_ms": round(wall * 1000.0, 1),
+            "turns_per_sec": round(len(rows) / wall, 2) if wall > 0 else 0.0,
+            "stages": stages,
+            "allocations": _perf_allocations(cases, turns=alloc_turns, stream=stream),
+        }
+    return report
+
+
+def _compare_perf(
+    *, baseline: Dict[str, Any], current: Dict[str, Any], tolerance: float, slack_ms: float
+) -> Tuple[bool, List[str]]:
+    """
+    Regression detection (relative):
+    - stage p95 may not exceed baseline * (1 + tolerance) + slack_ms
+    - turns/sec may not drop below baseline * (1 - tolerance)
+
+    The numbers are only comparable under the same synthetic workload, so a
+    latency_profile / sessions / turns mismatch is reported as a failure and
+    the per-stage comparison is skipped.
+    """
+    failures: List[str] = []
+    base_meta = baseline.get("meta") if _is_record(baseline.get("meta")) else {}
+    cur_meta = current.get("meta") if _is_record(current.get("meta")) else {}
+    for key in ("latency_profile", "sessions", "turns_per_session"):
+        bv, cv = base_meta.get(key), cur_meta.get(key)
+        if bv != cv:
+            failures.append(f"workload mismatch: {key} baseline={bv!r} current={cv!r} (re-run with matching flags or --write-baseline)")
+    if failures:
+        return False, failures
+    base_modes = baseline.get("modes") if _is_record(baseline.get("modes")) else {}
+    cur_modes = current.get("modes") if _is_record(current.get("modes")) else {}
+    for mode, b in base_modes.items():
+        c = cur_modes.get(mode)
+        if not _is_record(b) or not _is_record(c):
+            continue
+        bt = _num(b.get("turns_per_sec"), 0.0)
+        ct = _num(c.get("turns_per_sec"), 0.0)
+        if bt > 0 and ct < bt * (1.0 - tolerance):
+            failures.append(f"{mode}: turns_per_sec {bt:.2f} -> {ct:.2f} (tol={tolerance:.2f})")
+        bs = b.get("stages") if _is_record(b.get("stages")) else {}
+        cs = c.get("stages") if _is_record(c.get("stages")) else {}
+        for stage, bv in bs.items():
+            cv = cs.get(stage)
+            if not _is_record(bv) or not _is_record(cv):
+                continue
+            b95 = _num(bv.get("p95_ms"), 0.0)
+            c95 = _num(cv.get("p95_ms"), 0.0)
+            if c95 > b95 * (1.0 + tolerance) + slack_ms:
+                failures.append(f"{mode}: {stage}.p95 {b95:.2f}ms -> {c95:.2f}ms (tol={tolerance:.2f}, slack={slack_ms:.1f}ms)")
+    return len(failures) == 0, failures
+
+
+def main_perf(args: Any) -> int:
+    modes = ["turn", "stream"] if args.perf_mode == "both" else [args.perf_mode]
+    profile = LatencyProfile(
+        llm_ms=args.llm_ms,
+        stream_chunk_ms=args.chunk_ms,
+        embed_ms=args.embed_ms,
+        store_ms=args.store_ms,
+        jitter=args.jitter,
+    )
+    report = run_perf(
+        cases_path=Path(args.cases),
+        sessions=max(1, int(args.sessions)),
+        turns=max(1, int(args.turns)),
+        modes=modes,
+        profile=profile,
+        alloc_turns=max(1, int(args.alloc_turns)),
+    )
+    baseline_path = Path(args.perf_baseline)
+
+    if args.write_baseline:
+        baseline_path.write_text(json.dumps(report, ensure_ascii=False, indent=2), encoding="utf-8")
+        print(f"[bench] perf baseline written: {baseline_path}")
+        return 0
+
+    print(json.dumps(report["modes"], ensure_ascii=False, indent=2))
+    for mode, m in report["modes"].items():
+        tt = m["stages"].get("turn_total", {})
+        print(
+            f"[bench] perf mode={mode} sessions={report['meta']['sessions']} turns={m['turns']} "
+            f"turns_per_sec={m['turns_per_sec']:.2f} p50={tt.get('p50_ms', 0):.1f}ms p99={tt.get('p99_ms', 0):.1f}ms"
+        )
+
+    if not baseline_path.exists():
+        print(f"[bench] perf baseline missing: {baseline_path}")
+        print("[bench] run with --perf --write-baseline once.")
+        return 2
+
+    baseline = json.loads(baseline_path.read_text(encoding="utf-8"))
+    ok, failures = _compare_perf(
+        baseline=baseline,
+        current=report,
+        tolerance=float(args.perf_tolerance),
+        slack_ms=float(args.perf_slack_ms),
+    )
+    if not ok:
+        print("[bench] regression detected:")
+        for f in failures:
+            print(f"  - {f}")
+        return 1
+
+    print("[bench] OK")
+    return 0
+
+
 def main() -> int:
     ap = argparse.ArgumentParser()
     ap.add_argument("--cases", default=str(Path(__file__).with_name("cases_v1.json")))
     ap.add_argument("--baseline", default=str(Path(__file__).with_name("baseline.json")))
     ap.add_argument("--write-baseline", action="store_true")
     ap.add_argument("--tolerance", type=float, default=0.12)
+    # Performance mode
+    ap.add_argument("--perf", action="store_true", help="latency/throughput benchmark instead of behavioural scoring")
+    ap.add_argument("--perf-mode", choices=("turn", "stream", "both"), default="both")
+    ap.add_argument("--perf-baseline", default=str(Path(__file__).with_name("perf_baseline.json")))
+    ap.add_argument("--perf-tolerance", type=float, default=0.30, help="relative slowdown allowed vs perf baseline")
+    ap.add_argument("--perf-slack-ms", type=float, default=2.0, help="absolute slack added to each stage p95")
+    ap.add_argument("--sessions", type=int, default=8)
+    ap.add_argument("--turns", type=int, default=24, help="turns per session")
+    ap.add_argument("--alloc-turns", type=int, default=24)
+    ap.add_argument("--llm-ms", type=float, default=40.0)
+    ap.add_argument("--chunk-ms", type=float, default=2.0)
+    ap.add_argument("--embed-ms", type=float, default=3.0)
+    ap.add_argument("--store-ms", type=float, default=1.0)
+    ap.add_argument("--jitter", type=float, default=0.2)
     args = ap.parse_args()
 
+    if args.perf:
+        return main_perf(args)
+
     cases_path = Path(args.cases)
     baseline_path = Path(args.baseline)
 
@@ -0,0 +1,425 @@
+"""
+Parallel deterministic replay of recorded sessions (regression + load testing).
+
+Recordings come from `replay_session.py --export DIR` (one {session_id}.json per session: kernel
+delta-log rows, base checkpoint state, user turns, io events). For every recording:
+
+- kernel:     re-apply the recorded deltas and compare state hashes (deterministic, no I/O).
+- controller: additionally drive the recorded user turns through an in-process PersonaController
+              (bench wiring, MockLLMClient) and Phase04Runtime, reporting latency and whether the
+              re-derived governance decisions still match the recorded ones.
+- http:       additionally POST the recorded turns to a live server_persona_os /persona/chat.
+
+Sessions run concurrently; turns inside a session stay ordered. --qps paces turn starts globally
+(open-loop slots shared by all sessions). The report is JSON (stdout or --out); the exit code is 1
+when any kernel hash mismatches (or, with --strict-decisions, any decision drifts).
+"""
+
+from __future__ import annotations
+
+import argparse
+import http.client
+import json
+import os
+import sys
+import threading
+import time
+import urllib.parse
+import uuid
+from concurrent.futures import ThreadPoolExecutor
+from dataclasses import dataclass, field
+from pathlib import Path
+from typing import Any, Dict, List, Optional, Tuple
+
+
+REPO_ROOT = Path(__file__).resolve().parents[2]
+sys.path.insert(0, str(REPO_ROOT / "gensokyo-persona-core"))
+sys.path.insert(0, str(REPO_ROOT / "tools" / "bench"))
+sys.path.insert(0, str(Path(__file__).resolve().parent))
+
+from persona_core.phase04.kernel import Kernel  # noqa: E402
+from persona_core.storage.env_loader import load_dotenv  # noqa: E402
+from replay_session import RECORDING_FORMAT, verify_recording  # noqa: E402
+
+
+REPORT_FORMAT = "sigmaris-replay-report-v1"
+
+
+def _load_recordings(path: Path, *, limit: int) -> List[Tuple[str, Dict[str, Any]]]:
+    files = sorted(path.glob("*.json")) if path.is_dir() else [path]
+    out: List[Tuple[str, Dict[str, Any]]] = []
+    for f in files:
+        try:
+            rec = json.loads(f.read_text(encoding="utf-8"))
+        except Exception as e:
+            print(f"[replay] skip {f.name}: {e}", file=sys.stderr)
+            continue
+        if not isinstance(rec, dict) or rec.get("format") != RECORDING_FORMAT:
+            print(f"[replay] skip {f.name}: not a {RECORDING_FORMAT} file", file=sys.stderr)
+            continue
+        out.append((f.stem, rec))
+        if limit > 0 and len(out) >= limit:
+            break
+    return out
+
+
+class _Pacer:
+    """Global open-loop schedule: the n-th turn (across all sessions) may start at t0 + n / qps."""
+
+    def __init__(self, qps: float) -> None:
+        self._interval = (1.0 / qps) if qps > 0 else 0.0
+        self._lock = threading.Lock()
+        self._next = 0.0
+
+    def wait(self) -> float:
+        """Blocks until the next slot; returns how late the turn started (ms, schedule lag)."""
+        if self._interval <= 0:
+            return 0.0
+        with self._lock:
+            now = time.perf_counter()
+            if self._next <= 0.0:
+                self._next = now
+            slot = self._next
+            self._next = slot + self._interval
+        delay = slot - time.perf_counter()
+        if delay > 0:
+            time.sleep(delay)
+            return 0.0
+        return -delay * 1000.0
+
+
+def _delta_key(d: Any) -> str:
+    # source_reference / confidence / reasons carry per-run ids and scores; compare the state mutation only.
+    # Keys embed the source signal id (e.g. "note:{signal.id}"), which is fresh on every run.
+    if not isinstance(d, dict):
+        return ""
+    key = str(d.get("key") or "")
+    ref = str(d.get("source_reference") or "")
+    if ref:
+        key = key.replace(ref, "*")
+    return json.dumps(
+        [d.get("target_category"), key, d.get("operation_type"), d.get("delta_value")],
+        ensure_ascii=False,
+        sort_keys=True,
+        separators=(",", ":"),
+    )
+
+
+def _recorded_rows_by_turn(rec: Dict[str, Any]) -> List[Optional[Dict[str, Any]]]:
+    """Pair each user turn with its delta-log row: by trace_id when recorded, else by position."""
+    rows = [r for r in rec.get("delta_logs") or [] if isinstance(r, dict)]
+    by_trace = {str(r.get("trace_id")): r for r in rows if r.get("trace_id")}
+    out: List[Optional[Dict[str, Any]]] = []
+    for i, t in enumerate(rec.get("turns") or []):
+        tid = str((t or {}).get("trace_id") or "")
+        out.append(by_trace.get(tid) if tid and tid in by_trace else (rows[i] if i < len(rows) else None))
+    return out
+
+
+# -------------------------------------------------------------
+# Targets
+# -------------------------------------------------------------
+
+
+class _ControllerTarget:
+    """In-process PersonaController (same wiring as tools/bench) + a per-session Phase04Runtime."""
+
+    name = "controller"
+
+    def __init__(self, *, llm_ms: float) -> None:
+        from run_bench import LatencyProfile  # local: pulls the controller stack
+
+        # Kernel apply on, no live persistence (the runtime is in-process and per session).
+        os.environ["SIGMARIS_PHASE04_KERNEL_APPLY"] = "1"
+        self._profile = LatencyProfile(llm_ms=llm_ms, stream_chunk_ms=0.0, embed_ms=0.0, store_ms=0.0, jitter=0.0)
+
+    def open_session(self, idx: int, rec: Dict[str, Any]) -> Dict[str, Any]:
+        from persona_core.phase04.runtime import Phase04Runtime
+        from run_bench import LatencyMockLLMClient, _build_controller
+
+        llm = LatencyMockLLMClient(reply_style="echo", profile=self._profile, seed=idx)
+        controller, safety = _build_controller(llm=llm)
+        runtime = Phase04Runtime()
+        user_id = str(rec.get("user_id") or f"replay-{idx}")
+        if isinstance(rec.get("base_state"), dict):
+            runtime.kernel.set_state(user_id=user_id, state=rec["base_state"])
+        return {"controller": controller, "safety": safety, "runtime": runtime, "user_id": user_id}
+
+    def turn(self, ctx: Dict[str, Any], *, session_id: str, message: str, trace_id: str) -> Dict[str, Any]:
+        from run_bench import _perf_turn
+        from persona_core.types.core_types import PersonaRequest
+
+        req = PersonaRequest(
+            user_id=ctx["user_id"],
+            session_id=session_id,
+            message=message,
+            metadata={"_trace_id": trace_id},
+        )
+        _perf_turn(ctx["controller"], ctx["safety"], req, stream=False)
+        p4 = ctx["runtime"].run_for_turn(
+            user_id=ctx["user_id"], session_id=session_id, message=message, trace_id=trace_id, persist=None
+        )
+        gov = p4.get("governance") if isinstance(p4.get("governance"), dict) else {}
+        return {"approved": gov.get("approved") if isinstance(gov.get("approved"), list) else []}
+
+    def close_session(self, ctx: Dict[str, Any]) -> None:
+        return None
+
+
+class _HttpTarget:
+    """Live server_persona_os: POST /persona/chat over one keep-alive connection per session."""
+
+    name = "http"
+
+    def __init__(self, *, base_url: str, token: Optional[str], timeout_sec: float) -> None:
+        u = urllib.parse.urlsplit(base_url.rstrip("/"))
+        if u.scheme not in ("http", "https") or not u.netloc:
+            raise SystemExit(f"--base-url must be http(s)://host[:port], got {base_url!r}")
+        self._https = u.scheme == "https"
+        self._netloc = u.netloc
+        self._path = (u.path or "") + "/persona/chat"
+        self._token = token
+        self._timeout = float(timeout_sec)
+
+    def _connect(self) -> http.client.HTTPConnection:
+        cls = http.client.HTTPSConnection if self._https else http.client.HTTPConnection
+        return cls(self._netloc, timeout=self._timeout)
+
+    def open_session(self, idx: int, rec: Dict[str, Any]) -> Dict[str, Any]:
+        return {"conn": self._connect()}
+
+    def turn(self, ctx: Dict[str, Any], *, session_id: str, message: str, trace_id: str) -> Dict[str, Any]:
+        body = json.dumps({"session_id": session_id, "message": message}, ensure_ascii=False).encode("utf-8")
+        headers = {"Content-Type": "application/json", "x-sigmaris-trace-id": trace_id}
+        if self._token:
+            headers["Authorization"] = f"Bearer {self._token}"
+        for attempt in (0, 1):
+            conn: http.client.HTTPConnection = ctx["conn"]
+            try:
+                conn.request("POST", self._path, body=body, headers=headers)
+                resp = conn.getresponse()
+                raw = resp.read()
+                if resp.status >= 400:
+                    raise RuntimeError(f"HTTP {resp.status}: {raw[:200]!r}")
+                return {"status": resp.status}
+            except (http.client.HTTPException, ConnectionError, OSError):
+                # server closed the idle keep-alive connection: reconnect once
+                conn.close()
+                ctx["conn"] = self._connect()
+                if attempt == 1:
+                    raise
+        return {}
+
+    def close_session(self, ctx: Dict[str, Any]) -> None:
+        try:
+            ctx["conn"].close()
+        except Exception:
+            pass
+
+
+# -------------------------------------------------------------
+# Engine
+# -------------------------------------------------------------
+
+
+@dataclass
+class _SessionResult:
+    name: str
+    kernel: Dict[str, Any]
+    turn_ms: List[float] = field(default_factory=list)
+    lag_ms: List[float] = field(default_factory=list)
+    decisions_matched: int = 0
+    decisions_drifted: int = 0
+    drift: List[Dict[str, Any]] = field(default_factory=list)
+    errors: List[str] = field(default_factory=list)
+
+
+def _replay_one(
+    idx: int,
+    name: str,
+    rec: Dict[str, Any],
+    *,
+    target: Any,
+    pacer: _Pacer,
+    max_turns: int,
+    run_tag: str,
+) -> _SessionResult:
+    # 1) deterministic kernel hash chain (always)
+    res = _SessionResult(name=name, kernel=verify_recording(rec, kernel=Kernel()))
+    if target is None:
+        return res
+
+    # 2) drive the recorded user turns
+    turns = [t for t in rec.get("turns") or [] if isinstance(t, dict) and isinstance(t.get("message"), str)]
+    if max_turns > 0:
+        turns = turns[:max_turns]
+    recorded = _recorded_rows_by_turn(rec)
+    # replay sessions never write into the recorded session
+    session_id = f"replay:{run_tag}:{rec.get('session_id') or name}"
+    try:
+        ctx = target.open_session(idx, rec)
+    except Exception as e:
+        res.errors.append(f"open_session: {e}")
+        return res
+    try:
+        for i, t in enumerate(turns):
+            res.lag_ms.append(pacer.wait())
+            started = time.perf_counter()
+            try:
+                out = target.turn(ctx, session_id=session_id, message=t["message"], trace_id=uuid.uuid4().hex)
+            except Exception as e:
+                res.errors.append(f"turn {i}: {e}")
+                continue
+            res.turn_ms.append((time.perf_counter() - started) * 1000.0)
+
+            row = recorded[i] if i < len(recorded) else None
+            if "approved" in out and row is not None:
+                want = sorted(_delta_key(d) for d in (row.get("approved_deltas") or []))
+                got = sorted(_delta_key(d) for d in out["approved"])
+                if want == got:
+                    res.decisions_matched += 1
+                else:
+                    res.decisions_drifted += 1
+                    if len(res.drift) < 5:
+                        res.drift.append({"turn": i, "trace_id": row.get("trace_id"), "recorded": want, "replayed": got})
+    finally:
+        target.close_session(ctx)
+    return res
+
+
+def _pct(sorted_vals: List[float], p: float) -> float:
+    if not sorted_vals:
+        return 0.0
+    i = min(len(sorted_vals) - 1, max(0, int(round(p * (len(sorted_vals) - 1)))))
+    return float(sorted_vals[i])
+
+
+def _summarize(samples: List[float]) -> Dict[str, float]:
+    v = sorted(samples)
+    return {
+        "p50_ms": round(_pct(v, 0.50), 3),
+        "p95_ms": round(_pct(v, 0.95), 3),
+        "p99_ms": round(_pct(v, 0.99), 3),
+        "max_ms": round(v[-1], 3) if v else 0.0,
+        "mean_ms": round(sum(v) / len(v), 3) if v else 0.0,
+    }
+
+
+def run_replay(
+    recordings: List[Tuple[str, Dict[str, Any]]],
+    *,
+    target: Any,
+    qps: float,
+    concurrency: int,
+    max_turns: int,
+) -> Dict[str, Any]:
+    pacer = _Pacer(qps)
+    run_tag = uuid.uuid4().hex[:8]
+    started = time.perf_counter()
+    with ThreadPoolExecutor(max_workers=max(1, concurrency)) as pool:
+        futs = [
+            pool.submit(_replay_one, i, name, rec, target=target, pacer=pacer, max_turns=max_turns, run_tag=run_tag)
+            for i, (name, rec) in enumerate(recordings)
+        ]
+        results = [f.result() for f in futs]
+    wall = time.perf_counter() - started
+
+    turn_ms = [x for r in results for x in r.turn_ms]
+    lag_ms = [x for r in results for x in r.lag_ms]
+    verified = sum(int(r.kernel.get("verified") or 0) for r in results)
+    failed = sum(int(r.kernel.get("failed") or 0) for r in results)
+    errors = [f"{r.name}: {e}" for r in results for e in r.errors]
+    report: Dict[str, Any] = {
+        "meta": {
+            "format": REPORT_FORMAT,
+            "generated_at": time.strftime("%Y-%m-%dT%H:%M:%SZ", time.gmtime()),
+            "target": getattr(target, "name", "kernel"),
+            "sessions": len(results),
+            "concurrency": int(concurrency),
+            "qps_target": float(qps),
+        },
+        "kernel": {
+            "rows_verified": verified,
+            "rows_failed": failed,
+            "mismatches": [dict(m, session=r.name) for r in results for m in r.kernel.get("mismatches") or []][:20],
+        },
+        "throughput": {
+            "turns": len(turn_ms),
+            "wall_ms": round(wall * 1000.0, 1),
+            "turns_per_sec": round(len(turn_ms) / wall, 2) if wall > 0 and turn_ms else 0.0,
+        },
+        "latency": _summarize(turn_ms) if turn_ms else {},
+        # > 0 means the target could not keep up with --qps (turns started late)
+        "schedule_lag": _summarize(lag_ms) if (lag_ms and qps > 0) else {},
+        "errors": {"count": len(errors), "first": errors[:10]},
+    }
+    if getattr(target, "name", "") == "controller":
+        report["decisions"] = {
+            "matched": sum(r.decisions_matched for r in results),
+            "drifted": sum(r.decisions_drifted for r in results),
+            "examples": [dict(d, session=r.name) for r in results for d in r.drift][:10],
+        }
+    return report
+
+
+def main(argv: List[str]) -> int:
+    load_dotenv(override=False)
+
+    ap = argparse.ArgumentParser(description="Replay recorded sessions concurrently (kernel hash check + load test).")
+    ap.add_argument("recordings", help="directory of recordings (replay_session.py --export) or a single file")
+    ap.add_argument("--target", choices=("kernel", "controller", "http"), default="kernel")
+    ap.add_argument("--qps", type=float, default=0.0, help="target turn starts per second across all sessions (0 = unpaced)")
+    ap.add_argument("--concurrency", type=int, default=8, help="sessions replayed at the same time")
+    ap.add_argument("--sessions", type=int, default=0, help="replay at most N recordings (0 = all)")
+    ap.add_argument("--max-turns", type=int, default=0, help="turns per session (0 = all recorded)")
+    ap.add_argument("--base-url", default=os.getenv("SIGMARIS_REPLAY_BASE_URL", "http://127.0.0.1:8000"))
+    ap.add_argument("--token", default=os.getenv("SIGMARIS_REPLAY_TOKEN") or None, help="Bearer token for --target http")
+    ap.add_argument("--timeout", type=float, default=60.0, help="per-request timeout for --target http (sec)")
+    ap.add_argument("--llm-ms", type=float, default=0.0, help="simulated LLM latency for --target controller")
+    ap.add_argument("--strict-decisions", action="store_true", help="fail when replayed governance decisions drift")
+    ap.add_argument("--out", default=None, help="write the JSON report here (default: stdout)")
+    args = ap.parse_args(argv)
+
+    recordings = _load_recordings(Path(args.recordings), limit=int(args.sessions))
+    if not recordings:
+        print(f"[replay] no {RECORDING_FORMAT} recordings under {args.recordings}", file=sys.stderr)
+        return 2
+
+    target: Any = None
+    if args.target == "controller":
+        target = _ControllerTarget(llm_ms=float(args.llm_ms))
+    elif args.target == "http":
+        target = _HttpTarget(base_url=str(args.base_url), token=args.token, timeout_sec=float(args.timeout))
+
+    report = run_replay(
+        recordings,
+        target=target,
+        qps=max(0.0, float(args.qps)),
+        concurrency=int(args.concurrency),
+        max_turns=int(args.max_turns),
+    )
+    text = json.dumps(report, ensure_ascii=False, indent=2)
+    if args.out:
+        Path(args.out).write_text(text, encoding="utf-8")
+    else:
+        print(text)
+
+    k = report["kernel"]
+    tp = report["throughput"]
+    lat = report.get("latency") or {}
+    print(
+        f"[replay] target={report['meta']['target']} sessions={report['meta']['sessions']} "
+        f"rows_verified={k['rows_verified']} rows_failed={k['rows_failed']} turns={tp['turns']} "
+        f"turns_per_sec={tp['turns_per_sec']:.2f} p50={lat.get('p50_ms', 0):.1f}ms p99={lat.get('p99_ms', 0):.1f}ms "
+        f"errors={report['errors']['count']}",
+        file=sys.stderr,
+    )
+    if k["rows_failed"] > 0:
+        return 1
+    if args.strict_decisions and (report.get("decisions") or {}).get("drifted"):
+        return 1
+    return 0
+
+
+if __name__ == "__main__":
+    raise SystemExit(main(sys.argv[1:]))
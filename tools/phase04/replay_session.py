@@ -5,12 +5,13 @@ import json
 import sys
 import uuid
 from datetime import datetime, timezone
+from pathlib import Path
 from typing import Any, Dict, List, Optional, Tuple
 
 from persona_core.storage.env_loader import load_dotenv
 from persona_core.storage.supabase_rest import SupabaseConfig, SupabaseRESTClient
 from persona_core.storage.supabase_store import SupabasePersonaDB
-from persona_core.phase04.kernel import Kernel
+from persona_core.phase04.kernel import STATE_HASH_ALG, Kernel
 
 
 def _iso_now() -> str:
@@ -41,6 +42,73 @@ def _load_snapshot_state(db: SupabasePersonaDB, *, snapshot_id: str) -> Optional
     return st if isinstance(st, dict) else None
 
 
+def _notes(row: Dict[str, Any]) -> Dict[str, Any]:
+    decision = row.get("decision") if isinstance(row.get("decision"), dict) else {}
+    notes = decision.get("notes")
+    return notes if isinstance(notes, dict) else {}
+
+
+def _state_hash(kernel: Kernel, *, user_id: str, alg: str) -> str:
+    # rows written before STATE_HASH_ALG used the full-state json hash
+    if alg == STATE_HASH_ALG:
+        return kernel.state_sha256(user_id=user_id)
+    return kernel.state_sha256_full(user_id=user_id)
+
+
+def _restore_from_checkpoint(
+    c: SupabaseRESTClient,
+    db: SupabasePersonaDB,
+    kernel: Kernel,
+    *,
+    user_id: str,
+    checkpoint_id: str,
+    until_created_at: str,
+) -> bool:
+    """
+    Rebuild the state a session started from: checkpoint state + every (non rolled back)
+    delta-log row of the user after the checkpoint was taken, up to the session's first row.
+    A compacted checkpoint is taken after its row's deltas (kernel_checkpoint_id); an initial
+    checkpoint is taken before the first row that uses it as base (inclusive).
+    """
+    st = _load_snapshot_state(db, snapshot_id=checkpoint_id)
+    if st is None:
+        return False
+    kernel.set_state(user_id=user_id, state=st)
+    origin = c.select(
+        "common_kernel_delta_logs",
+        columns="created_at",
+        filters=[f"user_id=eq.{user_id}", f"decision->notes->>kernel_checkpoint_id=eq.{checkpoint_id}"],
+        limit=1,
+    )
+    after = "gt"
+    if not isinstance(origin, list) or not origin or not isinstance(origin[0], dict):
+        origin = c.select(
+            "common_kernel_delta_logs",
+            columns="created_at",
+            filters=[f"user_id=eq.{user_id}", f"decision->notes->>kernel_base_checkpoint_id=eq.{checkpoint_id}"],
+            order="created_at.asc",
+            limit=1,
+        )
+        after = "gte"
+    if not isinstance(origin, list) or not origin or not isinstance(origin[0], dict):
+        return True
+    rows = c.select(
+        "common_kernel_delta_logs",
+        columns="created_at,decision,approved_deltas",
+        filters=[
+            f"user_id=eq.{user_id}",
+            f"and=(created_at.{after}.{origin[0].get('created_at')},created_at.lt.{until_created_at})",
+        ],
+        order="created_at.asc",
+    )
+    for row in rows if isinstance(rows, list) else []:
+        if not isinstance(row, dict) or _notes(row).get("kernel_rolled_back"):
+            continue
+        approved = row.get("approved_deltas") if isinstance(row.get("approved_deltas"), list) else []
+        _apply_deltas(kernel, user_id=user_id, deltas=approved)
+    return True
+
+
 def _apply_deltas(kernel: Kernel, *, user_id: str, deltas: List[Dict[str, Any]]) -> Tuple[int, List[Dict[str, Any]]]:
     applied = 0
     errors: List[Dict[str, Any]] = []
@@ -61,119 +129,249 @@ def _apply_deltas(kernel: Kernel, *, user_id: str, deltas: List[Dict[str, Any]])
     return applied, errors
 
 
-def main(argv: List[str]) -> int:
-    load_dotenv(override=False)
+RECORDING_FORMAT = "sigmaris-replay-recording-v1"
 
-    ap = argparse.ArgumentParser(description="Replay Phase04 kernel deltas from Supabase logs.")
-    ap.add_argument("--user-id", required=True, help="Supabase auth uid (uuid)")
-    ap.add_argument("--session-id", required=True, help="session_id used by the UI/core")
-    ap.add_argument("--max-turns", type=int, default=200, help="limit number of delta-log rows")
-    ap.add_argument("--print-io", action="store_true", help="also show recent io events for the session")
-    args = ap.parse_args(argv)
-
-    user_id = str(args.user_id)
-    session_id = str(args.session_id)
-    if not _is_uuid(user_id):
-        print("user-id must be a uuid (Supabase auth uid)", file=sys.stderr)
-        return 2
-
-    cfg = SupabaseConfig.from_env()
-    if cfg is None:
-        print("SUPABASE_URL / SUPABASE_SERVICE_ROLE_KEY not configured", file=sys.stderr)
-        return 2
 
-    c = SupabaseRESTClient(cfg)
-    db = SupabasePersonaDB(c)
-
-    # Load delta logs for the session (chronological)
+def load_recording(
+    c: SupabaseRESTClient,
+    db: SupabasePersonaDB,
+    *,
+    user_id: str,
+    session_id: str,
+    max_turns: int = 200,
+    with_io: bool = True,
+    with_turns: bool = True,
+) -> Dict[str, Any]:
+    """
+    One recorded session as a self-contained dict (see replay_engine.py):
+    - delta_logs: common_kernel_delta_logs rows (chronological)
+    - base_state: kernel state before the first row (checkpoint + later deltas), when the rows carry one
+    - snapshots: legacy full before-snapshots referenced by rows without kernel_state_hash_alg
+    - turns: user messages (common_turns) for controller/http replay; io_events: common_io_events
+    """
     logs = c.select(
         "common_kernel_delta_logs",
         columns="id,created_at,decision,approved_deltas,trace_id",
         filters=[f"user_id=eq.{user_id}", f"session_id=eq.{session_id}"],
         order="created_at.asc",
-        limit=int(max(1, args.max_turns)),
+        limit=int(max(1, max_turns)),
     )
     if not isinstance(logs, list):
-        print("unexpected response from common_kernel_delta_logs", file=sys.stderr)
-        return 2
+        raise RuntimeError("unexpected response from common_kernel_delta_logs")
+    logs = [r for r in logs if isinstance(r, dict)]
 
-    kernel = Kernel()
-    replay_user = user_id
+    base_state: Optional[Dict[str, Any]] = None
+    snapshots: Dict[str, Dict[str, Any]] = {}
+    for idx, row in enumerate(logs):
+        notes = _notes(row)
+        snap_before_id = str(notes.get("kernel_snapshot_before_id") or "")
+        if snap_before_id and not notes.get("kernel_state_hash_alg"):
+            st = _load_snapshot_state(db, snapshot_id=snap_before_id)
+            if st is not None:
+                snapshots[snap_before_id] = st
+        elif idx == 0 and notes.get("kernel_base_checkpoint_id"):
+            k = Kernel()
+            if _restore_from_checkpoint(
+                c,
+                db,
+                k,
+                user_id=user_id,
+                checkpoint_id=str(notes.get("kernel_base_checkpoint_id")),
+                until_created_at=str(row.get("created_at") or _iso_now()),
+            ):
+                base_state = json.loads(json.dumps(k.get_state(user_id=user_id).to_dict(), ensure_ascii=False))
+
+    turns: List[Dict[str, Any]] = []
+    if with_turns:
+        rows = c.select(
+            "common_turns",
+            columns="created_at,trace_id,content",
+            filters=[f"user_id=eq.{user_id}", f"session_id=eq.{session_id}", "role=eq.user"],
+            order="created_at.asc",
+            limit=int(max(1, max_turns)),
+        )
+        for r in rows if isinstance(rows, list) else []:
+            if isinstance(r, dict) and isinstance(r.get("content"), str):
+                turns.append({"created_at": r.get("created_at"), "trace_id": r.get("trace_id"), "message": r["content"]})
+
+    io_rows: List[Dict[str, Any]] = []
+    if with_io:
+        rows = c.select(
+            "common_io_events",
+            columns="created_at,event_type,ok,error,source_urls,cache_key,trace_id",
+            filters=[f"user_id=eq.{user_id}", f"session_id=eq.{session_id}"],
+            order="created_at.asc",
+            limit=500,
+        )
+        io_rows = [r for r in rows if isinstance(r, dict)] if isinstance(rows, list) else []
+
+    return {
+        "format": RECORDING_FORMAT,
+        "user_id": user_id,
+        "session_id": session_id,
+        "exported_at": _iso_now(),
+        "state_hash_alg": STATE_HASH_ALG,
+        "base_state": base_state,
+        "snapshots": snapshots,
+        "delta_logs": logs,
+        "turns": turns,
+        "io_events": io_rows,
+    }
+
+
+def verify_recording(rec: Dict[str, Any], *, kernel: Optional[Kernel] = None) -> Dict[str, Any]:
+    """
+    Deterministic kernel replay of one recording: re-apply every row's approved deltas and compare
+    the before/after state hashes. No I/O, so recordings can be verified concurrently.
+    """
+    kernel = kernel or Kernel()
+    replay_user = str(rec.get("user_id") or "replay")
+    snapshots = rec.get("snapshots") if isinstance(rec.get("snapshots"), dict) else {}
+    base_state = rec.get("base_state") if isinstance(rec.get("base_state"), dict) else None
 
     verified = 0
     failed = 0
+    mismatches: List[Dict[str, Any]] = []
+    started = False
 
-    for row in logs:
+    for row in rec.get("delta_logs") or []:
         if not isinstance(row, dict):
             continue
-        decision = row.get("decision") if isinstance(row.get("decision"), dict) else {}
         approved = row.get("approved_deltas") if isinstance(row.get("approved_deltas"), list) else []
 
-        snap_before_id = str(decision.get("notes", {}).get("kernel_snapshot_before_id") or "") if isinstance(decision.get("notes"), dict) else ""
-        snap_after_id = str(decision.get("notes", {}).get("kernel_snapshot_after_id") or "") if isinstance(decision.get("notes"), dict) else ""
-        hash_before = str(decision.get("notes", {}).get("kernel_state_hash_before") or "") if isinstance(decision.get("notes"), dict) else ""
-        hash_after = str(decision.get("notes", {}).get("kernel_state_hash_after") or "") if isinstance(decision.get("notes"), dict) else ""
+        notes = _notes(row)
+        snap_before_id = str(notes.get("kernel_snapshot_before_id") or "")
+        snap_after_id = str(notes.get("kernel_snapshot_after_id") or "")
+        hash_before = str(notes.get("kernel_state_hash_before") or "")
+        hash_after = str(notes.get("kernel_state_hash_after") or "")
+        hash_alg = str(notes.get("kernel_state_hash_alg") or "")
 
-        if snap_before_id:
-            st = _load_snapshot_state(db, snapshot_id=snap_before_id)
-            if st is not None:
-                kernel.set_state(user_id=replay_user, state=st)
+        # Legacy rows stored full before/after snapshots; newer rows only carry deltas, so the
+        # state is chained row to row and the first row starts from its base checkpoint.
+        st = snapshots.get(snap_before_id) if snap_before_id and not hash_alg else None
+        if isinstance(st, dict):
+            kernel.set_state(user_id=replay_user, state=st)
+        elif not started and base_state is not None:
+            kernel.set_state(user_id=replay_user, state=base_state)
+        started = True
 
-        got_before = kernel.state_sha256(user_id=replay_user)
+        got_before = _state_hash(kernel, user_id=replay_user, alg=hash_alg)
         if hash_before and got_before != hash_before:
             failed += 1
-            print(
-                json.dumps(
-                    {
-                        "ok": False,
-                        "kind": "hash_mismatch_before",
-                        "created_at": row.get("created_at"),
-                        "trace_id": row.get("trace_id"),
-                        "expected": hash_before,
-                        "got": got_before,
-                    },
-                    ensure_ascii=False,
-                )
+            mismatches.append(
+                {
+                    "ok": False,
+                    "kind": "hash_mismatch_before",
+                    "created_at": row.get("created_at"),
+                    "trace_id": row.get("trace_id"),
+                    "expected": hash_before,
+                    "got": got_before,
+                }
             )
             continue
 
-        applied, errors = _apply_deltas(kernel, user_id=replay_user, deltas=approved)  # noqa: F841
-        got_after = kernel.state_sha256(user_id=replay_user)
+        if notes.get("kernel_rolled_back"):
+            # the turn was undone in the live kernel; state_hash_after == state_hash_before
+            applied, errors = 0, []
+        else:
+            applied, errors = _apply_deltas(kernel, user_id=replay_user, deltas=approved)  # noqa: F841
+        got_after = _state_hash(kernel, user_id=replay_user, alg=hash_alg)
 
         if hash_after and got_after != hash_after:
             failed += 1
-            print(
-                json.dumps(
-                    {
-                        "ok": False,
-                        "kind": "hash_mismatch_after",
-                        "created_at": row.get("created_at"),
-                        "trace_id": row.get("trace_id"),
-                        "expected": hash_after,
-                        "got": got_after,
-                        "errors": errors,
-                        "snapshot_after_id": snap_after_id or None,
-                    },
-                    ensure_ascii=False,
-                )
+            mismatches.append(
+                {
+                    "ok": False,
+                    "kind": "hash_mismatch_after",
+                    "created_at": row.get("created_at"),
+                    "trace_id": row.get("trace_id"),
+                    "expected": hash_after,
+                    "got": got_after,
+                    "errors": errors,
+                    "snapshot_after_id": snap_after_id or None,
+                }
             )
             continue
 
         verified += 1
 
-    if args.print_io:
-        io_rows = c.select(
-            "common_io_events",
-            columns="created_at,event_type,ok,error,source_urls,cache_key,trace_id",
-            filters=[f"user_id=eq.{user_id}", f"session_id=eq.{session_id}"],
-            order="created_at.desc",
-            limit=50,
-        )
-        if isinstance(io_rows, list):
+    return {"verified": verified, "failed": failed, "mismatches": mismatches}
+
+
+def main(argv: List[str]) -> int:
+    load_dotenv(override=False)
+
+    ap = argparse.ArgumentParser(description="Replay Phase04 kernel deltas from Supabase logs.")
+    ap.add_argument("--user-id", required=True, help="Supabase auth uid (uuid)")
+    ap.add_argument("--session-id", required=True, action="append", help="session_id used by the UI/core (repeatable)")
+    ap.add_argument("--max-turns", type=int, default=200, help="limit number of delta-log rows")
+    ap.add_argument("--print-io", action="store_true", help="also show recent io events for the session")
+    ap.add_argument(
+        "--export",
+        metavar="DIR",
+        default=None,
+        help="write each session as a recording ({session_id}.json) for replay_engine.py instead of replaying",
+    )
+    args = ap.parse_args(argv)
+
+    user_id = str(args.user_id)
+    if not _is_uuid(user_id):
+        print("user-id must be a uuid (Supabase auth uid)", file=sys.stderr)
+        return 2
+
+    cfg = SupabaseConfig.from_env()
+    if cfg is None:
+        print("SUPABASE_URL / SUPABASE_SERVICE_ROLE_KEY not configured", file=sys.stderr)
+        return 2
+
+    c = SupabaseRESTClient(cfg)
+    db = SupabasePersonaDB(c)
+
+    total_verified = 0
+    total_failed = 0
+    for session_id in [str(s) for s in args.session_id]:
+        try:
+            rec = load_recording(
+                c,
+                db,
+                user_id=user_id,
+                session_id=session_id,
+                max_turns=int(args.max_turns),
+                with_io=bool(args.print_io or args.export),
+                with_turns=bool(args.export),
+            )
+        except RuntimeError as e:
+            print(str(e), file=sys.stderr)
+            return 2
+
+        if args.export:
+            out_dir = Path(args.export)
+            out_dir.mkdir(parents=True, exist_ok=True)
+            safe = "".join(ch if (ch.isalnum() or ch in "-_.") else "_" for ch in session_id)[:120]
+            path = out_dir / f"{safe}.json"
+            path.write_text(json.dumps(rec, ensure_ascii=False, separators=(",", ":")), encoding="utf-8")
+            print(json.dumps({"ok": True, "exported": str(path), "rows": len(rec["delta_logs"]), "turns": len(rec["turns"])}))
+            continue
+
+        res = verify_recording(rec)
+        for m in res["mismatches"]:
+            print(json.dumps(m, ensure_ascii=False))
+        total_verified += int(res["verified"])
+        total_failed += int(res["failed"])
+
+        if args.print_io:
+            io_rows = list(reversed(rec["io_events"]))[:50]
             print(json.dumps({"io_events": io_rows, "generated_at": _iso_now()}, ensure_ascii=False))
 
-    print(json.dumps({"ok": True, "verified": verified, "failed": failed, "generated_at": _iso_now()}, ensure_ascii=False))
-    return 0 if failed == 0 else 1
+    if args.export:
+        return 0
+    print(
+        json.dumps(
+            {"ok": True, "verified": total_verified, "failed": total_failed, "generated_at": _iso_now()},
+            ensure_ascii=False,
+        )
+    )
+    return 0 if total_failed == 0 else 1
 
 
 if __name__ == "__main__":
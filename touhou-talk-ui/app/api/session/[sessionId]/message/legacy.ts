@@ -20,10 +20,7 @@ import {
   envFlag,
   wantsStream,
 } from "@/lib/server/session-message/request";
-import type {
-  PersonaIntentResponse,
-  Phase04LinkAnalysis,
-} from "@/lib/server/session-message-v2/types";
+import type { PersonaIntentResponse } from "@/lib/server/session-message-v2/types";
 
 import {
   normalizePersonaIntent,
@@ -39,12 +36,9 @@ import {
   buildRecentUserText,
 } from "@/lib/server/session-message-v2/sanitize";
 
-import {
-  uploadAndParseFiles,
-  analyzeLinks,
-  autoBrowseFromText,
-  buildAugmentedMessage,
-} from "@/lib/server/session-message-v2/retrieval";
+import { buildAugmentedMessage } from "@/lib/server/session-message-v2/retrieval";
+
+import { gatherTurnContext } from "@/lib/server/session-message-v2/turn-context";
 
 import {
   retrievalSystemHint,
@@ -146,26 +140,18 @@ export async function runLegacySessionMessageRoute(
         })
       : Promise.resolve(null);
   const isProd = process.env.NODE_ENV === "production";
-  const uploadsEnabled = envFlag("TOUHOU_UPLOAD_ENABLED", !isProd);
-  const linkAnalysisEnabled = envFlag("TOUHOU_LINK_ANALYSIS_ENABLED", !isProd);
-  const autoBrowseEnabled = envFlag("TOUHOU_AUTO_BROWSE_ENABLED", false);
-
-  const phase04Uploads = uploadsEnabled
-    ? await uploadAndParseFiles({ base, accessToken, files })
-    : [];
-
-  let phase04Links: Phase04LinkAnalysis[] = [];
-  if (linkAnalysisEnabled && urls.length > 0) {
-    phase04Links = await analyzeLinks({ base, accessToken, urls });
-  } else if (autoBrowseEnabled) {
-    phase04Links = await autoBrowseFromText({
-      base,
-      accessToken,
-      userText: text.trim(),
-    });
-  } else {
-    phase04Links = [];
-  }
+
+  // Uploads / link analysis / auto browse run concurrently (and alongside intent / relationship / world).
+  const { uploads: phase04Uploads, links: phase04Links } = await gatherTurnContext({
+    base,
+    accessToken,
+    files,
+    urls,
+    userText: text.trim(),
+    uploadsEnabled: envFlag("TOUHOU_UPLOAD_ENABLED", !isProd),
+    linkAnalysisEnabled: envFlag("TOUHOU_LINK_ANALYSIS_ENABLED", !isProd),
+    autoBrowseEnabled: envFlag("TOUHOU_AUTO_BROWSE_ENABLED", false),
+  });
   const augmentedText = buildAugmentedMessage({
     userText: text.trim(),
     uploads: phase04Uploads,
@@ -13,3 +13,22 @@ export function worldEngineHeaders(init?: HeadersInit): Headers {
   return headers;
 }
 
+
+/** Headers for a conditional GET: forwards the browser's If-None-Match to the world engine. */
+export function worldEngineConditionalHeaders(req: Request): Headers {
+  const headers = worldEngineHeaders();
+  const inm = req.headers.get("if-none-match");
+  if (inm) headers.set("If-None-Match", inm);
+  return headers;
+}
+
+/** ETag / Cache-Control from the world engine response, to relay to the browser. */
+export function worldEngineCacheHeaders(upstream: { headers?: Headers }): Headers {
+  const out = new Headers();
+  const etag = upstream.headers?.get("etag");
+  if (etag) {
+    out.set("ETag", etag);
+    out.set("Cache-Control", "no-cache");
+  }
+  return out;
+}
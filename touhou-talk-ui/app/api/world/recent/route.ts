@@ -4,7 +4,11 @@ export const dynamic = "force-dynamic";
 import { NextRequest, NextResponse } from "next/server";
 import "server-only";
 
-import { worldEngineBaseUrl, worldEngineHeaders } from "@/app/api/world/_worldEngine";
+import {
+  worldEngineBaseUrl,
+  worldEngineCacheHeaders,
+  worldEngineConditionalHeaders,
+} from "@/app/api/world/_worldEngine";
 
 export async function GET(req: NextRequest) {
   const url = new URL(req.url);
@@ -20,16 +24,20 @@ export async function GET(req: NextRequest) {
   }).toString();
 
   const upstream = await fetch(`${worldEngineBaseUrl()}/world/recent?${qs}`, {
-    headers: worldEngineHeaders(),
+    headers: worldEngineConditionalHeaders(req),
     cache: "no-store",
   }).catch((e) => ({ ok: false, status: 502, text: async () => String(e) }) as any);
 
+  if (upstream.status === 304) {
+    return new NextResponse(null, { status: 304, headers: worldEngineCacheHeaders(upstream) });
+  }
+
   if (!upstream.ok) {
     const text = await upstream.text().catch(() => "");
     return NextResponse.json({ error: "world_engine_error", detail: text }, { status: upstream.status || 502 });
   }
 
   const json = await upstream.json().catch(() => null);
-  return NextResponse.json(json ?? { ok: true });
+  return NextResponse.json(json ?? { ok: true }, { headers: worldEngineCacheHeaders(upstream) });
 }
 
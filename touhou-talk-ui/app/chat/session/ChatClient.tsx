@@ -325,9 +325,10 @@ export default function ChatClient() {
     (async () => {
       try {
         const qs = new URLSearchParams({ world_id: layer, location_id: location }).toString();
+        // "no-cache": revalidate with the ETag (304 reuses the browser copy).
         const [stateRes, recentRes] = await Promise.all([
-          fetch(`/api/world/state?${qs}`, { cache: "no-store" }),
-          fetch(`/api/world/recent?${qs}&limit=6`, { cache: "no-store" }),
+          fetch(`/api/world/state?${qs}`, { cache: "no-cache" }),
+          fetch(`/api/world/recent?${qs}&limit=6`, { cache: "no-cache" }),
         ]);
         const state = (await stateRes.json().catch(() => null)) as any;
         const recent = (await recentRes.json().catch(() => null)) as any;
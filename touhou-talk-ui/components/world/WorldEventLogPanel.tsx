@@ -110,7 +110,13 @@ export default function WorldEventLogPanel(props: { className?: string }) {
         if (closed) return;
         const lastSeq = readLastSeq(channel);
         lastSeqRef.current = lastSeq;
-        ws.send(JSON.stringify({ type: "hello", auth: token ? { mode: "supabase_jwt", access_token: token } : undefined }));
+        ws.send(
+          JSON.stringify({
+            type: "hello",
+            auth: token ? { mode: "supabase_jwt", access_token: token } : undefined,
+            features: ["batch"],
+          }),
+        );
         ws.send(JSON.stringify({ type: "subscribe", channel, lastSeq }));
       };
 
@@ -119,7 +125,8 @@ export default function WorldEventLogPanel(props: { className?: string }) {
         try {
           const msg = JSON.parse(String(ev.data ?? "")) as any;
           if (msg?.type === "ack" && msg.hello) setConnected(true);
-          if (msg?.type === "snapshot" && msg.channel === channel && Array.isArray(msg.events)) {
+          // snapshot pages and batched live bursts ("events") merge the same way
+          if ((msg?.type === "snapshot" || msg?.type === "events") && msg.channel === channel && Array.isArray(msg.events)) {
             const incoming = msg.events as WorldEvent[];
             if (incoming.length === 0) return;
             setEvents((prev) => {
@@ -142,6 +149,10 @@ export default function WorldEventLogPanel(props: { className?: string }) {
               return trimmed;
             });
           }
+          if (msg?.type === "resync" && msg.channel === channel) {
+            // gateway dropped live events for us (slow client): replay from what we have
+            ws.send(JSON.stringify({ type: "subscribe", channel, lastSeq: lastSeqRef.current }));
+          }
           if (msg?.type === "event" && msg.channel === channel && msg.event) {
             const e = msg.event as WorldEvent;
             setEvents((prev) => {
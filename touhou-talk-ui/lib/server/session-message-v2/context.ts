@@ -71,23 +71,32 @@ export async function buildSessionMessageContext(params: {
     }
   }
 
-  let accessToken: string | null = null;
-  try {
-    const {
-      data: { session },
-    } = await supabase.auth.getSession();
-    accessToken = session?.access_token ?? null;
-  } catch {
-    accessToken = null;
-  }
-
-  const { data: conv, error: convError } = await supabase
-    .from("common_sessions")
-    .select("id, chat_mode, layer, location")
-    .eq("id", sessionId)
-    .eq("user_id", userId)
-    .eq("app", "touhou")
-    .maybeSingle();
+  // Independent reads: token, session row, history and core base are fetched concurrently.
+  const [accessToken, convRes, coreHistory, base] = await Promise.all([
+    supabase.auth
+      .getSession()
+      .then(({ data: { session } }) => session?.access_token ?? null)
+      .catch(() => null),
+    supabase
+      .from("common_sessions")
+      .select("id, chat_mode, layer, location")
+      .eq("id", sessionId)
+      .eq("user_id", userId)
+      .eq("app", "touhou")
+      .maybeSingle(),
+    loadCoreHistory({
+      supabase,
+      sessionId,
+      userId,
+      limit: 16,
+    }),
+    resolveCoreBaseUrl({
+      supabase,
+      requestedMode:
+        typeof params.coreModeRaw === "string" ? params.coreModeRaw : null,
+    }),
+  ]);
+  const { data: conv, error: convError } = convRes;
 
   if (convError) {
     console.error("[touhou] conversation select error:", convError);
@@ -101,19 +110,6 @@ export async function buildSessionMessageContext(params: {
     );
   }
 
-  const coreHistory = await loadCoreHistory({
-    supabase,
-    sessionId,
-    userId,
-    limit: 16,
-  });
-
-  const base = await resolveCoreBaseUrl({
-    supabase,
-    requestedMode:
-      typeof params.coreModeRaw === "string" ? params.coreModeRaw : null,
-  });
-
   const chatModeRaw =
     typeof (conv as Record<string, unknown>).chat_mode === "string"
       ? String((conv as Record<string, unknown>).chat_mode)
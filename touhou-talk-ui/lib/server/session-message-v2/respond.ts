@@ -2,6 +2,7 @@ import { NextResponse } from "next/server";
 
 import type { supabaseServer } from "@/lib/supabase-server";
 import type { TouhouChatMode } from "@/lib/touhouPersona";
+import { fetchWithAffinity } from "@/lib/server/session-message/core-affinity";
 import { mergeMeta, isRecord } from "@/lib/server/session-message/meta";
 import type {
   PersonaChatResponse,
@@ -37,7 +38,7 @@ export async function handleNonStreamSessionMessage(params: {
   intent: PersonaIntentResponse | null;
   isSeedTurn: boolean;
 }) {
-  const r = await fetch(`${params.base}/persona/chat`, {
+  const r = await fetchWithAffinity(params.userId, `${params.base}/persona/chat`, {
     method: "POST",
     headers: {
       "Content-Type": "application/json",
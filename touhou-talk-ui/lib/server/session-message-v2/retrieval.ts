@@ -1,3 +1,5 @@
+import { createHash } from "crypto";
+
 import {
   Phase04Attachment,
   Phase04LinkAnalysis,
@@ -126,10 +128,45 @@ export function githubRepoQueryFromUrl(urlStr: string): string | null {
   }
 }
 
+function authHeaders(accessToken: string | null): Record<string, string> {
+  return accessToken ? { Authorization: `Bearer ${accessToken}` } : {};
+}
+
+function envMs(name: string, fallback: number, max: number) {
+  const raw = Number(process.env[name] ?? String(fallback));
+  return Number.isFinite(raw) ? Math.max(0, Math.min(max, raw)) : fallback;
+}
+
+// Per-request deadline for persona-core I/O calls (0 = none).
+export function coreIoTimeoutMs() {
+  return envMs("TOUHOU_CORE_IO_TIMEOUT_MS", 6000, 60_000);
+}
+
+function anySignal(signals: AbortSignal[]): AbortSignal {
+  const ctrl = new AbortController();
+  for (const s of signals) {
+    if (s.aborted) {
+      ctrl.abort(s.reason);
+      break;
+    }
+    s.addEventListener("abort", () => ctrl.abort(s.reason), { once: true });
+  }
+  return ctrl.signal;
+}
+
+// Combine the per-request timeout with an optional stage deadline.
+export function requestSignal(parent?: AbortSignal): AbortSignal | undefined {
+  const ms = coreIoTimeoutMs();
+  const own = ms > 0 ? AbortSignal.timeout(ms) : undefined;
+  if (own && parent) return anySignal([own, parent]);
+  return own ?? parent;
+}
+
 export async function coreJson<T>(params: {
   url: string;
   accessToken: string | null;
   body: unknown;
+  signal?: AbortSignal;
 }): Promise<{ ok: boolean; status: number; json: T | null; text: string }> {
   const r = await fetch(params.url, {
     method: "POST",
@@ -138,6 +175,7 @@ export async function coreJson<T>(params: {
       ...(params.accessToken ? { Authorization: `Bearer ${params.accessToken}` } : {}),
     },
     body: JSON.stringify(params.body),
+    signal: requestSignal(params.signal),
   });
   const text = await r.text().catch(() => "");
   let json: T | null = null;
@@ -149,178 +187,258 @@ export async function coreJson<T>(params: {
   return { ok: r.ok, status: r.status, json, text };
 }
 
+// Promise.allSettled + drop failures, keeping input order.
+export async function settledValues<T>(tasks: Array<Promise<T | null>>): Promise<T[]> {
+  const settled = await Promise.allSettled(tasks);
+  const out: T[] = [];
+  for (const s of settled) {
+    if (s.status === "fulfilled" && s.value !== null) out.push(s.value);
+  }
+  return out;
+}
+
+export type UploadedFile = {
+  attachment_id: string;
+  file_name: string;
+  mime_type: string;
+};
+
+function uploadedFrom(json: unknown, file: File): UploadedFile | null {
+  const j = json as { attachment_id?: unknown; file_name?: unknown; mime_type?: unknown } | null;
+  const attachmentId = typeof j?.attachment_id === "string" ? j.attachment_id : null;
+  if (!attachmentId) return null;
+  return {
+    attachment_id: attachmentId,
+    file_name: typeof j?.file_name === "string" ? j.file_name : file.name,
+    mime_type:
+      typeof j?.mime_type === "string"
+        ? j.mime_type
+        : (file.type || "application/octet-stream"),
+  };
+}
+
+export async function uploadFile(params: {
+  base: string;
+  accessToken: string | null;
+  file: File;
+  signal?: AbortSignal;
+}): Promise<UploadedFile | null> {
+  const { file } = params;
+  // Ask the core for an existing upload of the same bytes first, so a hit skips the body transfer.
+  const sha256 = createHash("sha256")
+    .update(new Uint8Array(await file.arrayBuffer()))
+    .digest("hex");
+  const query = new URLSearchParams({
+    file_name: file.name,
+    mime_type: file.type || "application/octet-stream",
+  });
+  const known = await fetch(`${params.base}/io/upload/sha256/${sha256}?${query}`, {
+    headers: authHeaders(params.accessToken),
+    signal: requestSignal(params.signal),
+  }).catch(() => null);
+  if (known?.ok) {
+    const hit = uploadedFrom(await known.json().catch(() => null), file);
+    if (hit) return hit;
+  } else {
+    await known?.body?.cancel().catch(() => {});
+  }
+
+  const form = new FormData();
+  form.append("file", file, file.name);
+  const up = await fetch(`${params.base}/io/upload`, {
+    method: "POST",
+    headers: authHeaders(params.accessToken),
+    body: form,
+    signal: requestSignal(params.signal),
+  });
+  if (!up.ok) return null;
+  return uploadedFrom(await up.json().catch(() => null), file);
+}
+
+export function attachmentFromParse(uploaded: UploadedFile, parsedJson: unknown): Phase04Attachment {
+  const pj = parsedJson as { kind?: unknown; parsed?: any } | null;
+  const kind = typeof pj?.kind === "string" ? pj.kind : "unknown";
+
+  const parsedAny = pj?.parsed;
+  const excerptCandidate =
+    typeof parsedAny?.raw_excerpt === "string"
+      ? parsedAny.raw_excerpt
+      : typeof parsedAny?.text_excerpt === "string"
+        ? parsedAny.text_excerpt
+        : typeof parsedAny?.content_summary === "string"
+          ? parsedAny.content_summary
+          : typeof parsedAny?.excerpt_summary === "string"
+            ? parsedAny.excerpt_summary
+            : typeof parsedAny?.ocr?.detected_text === "string"
+              ? parsedAny.ocr.detected_text
+          : "";
+
+  return {
+    type: "upload",
+    attachment_id: uploaded.attachment_id,
+    file_name: uploaded.file_name,
+    mime_type: uploaded.mime_type,
+    kind,
+    parsed_excerpt: excerptCandidate ? clampText(String(excerptCandidate), 1200) : undefined,
+  };
+}
+
 export async function uploadAndParseFiles(params: {
   base: string;
   accessToken: string | null;
   files: File[];
+  signal?: AbortSignal;
 }): Promise<Phase04Attachment[]> {
-  const out: Phase04Attachment[] = [];
-
-  for (const file of params.files.slice(0, 3)) {
-    try {
-      const form = new FormData();
-      form.append("file", file, file.name);
-      const up = await fetch(`${params.base}/io/upload`, {
-        method: "POST",
-        headers: {
-          ...(params.accessToken ? { Authorization: `Bearer ${params.accessToken}` } : {}),
-        },
-        body: form,
-      });
-      if (!up.ok) continue;
-
-      const upJson = (await up.json().catch(() => null)) as
-        | { attachment_id?: unknown; file_name?: unknown; mime_type?: unknown }
-        | null;
-      const attachmentId = typeof upJson?.attachment_id === "string" ? upJson.attachment_id : null;
-      if (!attachmentId) continue;
-
+  return settledValues(
+    params.files.slice(0, 3).map(async (file) => {
+      // a single-file failure only drops that file
+      const uploaded = await uploadFile({ ...params, file });
+      if (!uploaded) return null;
       const parsed = await coreJson<{ ok?: boolean; kind?: unknown; parsed?: unknown }>({
         url: `${params.base}/io/parse`,
         accessToken: params.accessToken,
-        body: { attachment_id: attachmentId, kind: null },
+        body: { attachment_id: uploaded.attachment_id, kind: null },
+        signal: params.signal,
       });
-      const kind = typeof parsed.json?.kind === "string" ? parsed.json.kind : "unknown";
-
-      const parsedAny = (parsed.json as any)?.parsed;
-      const excerptCandidate =
-        typeof parsedAny?.raw_excerpt === "string"
-          ? parsedAny.raw_excerpt
-          : typeof parsedAny?.text_excerpt === "string"
-            ? parsedAny.text_excerpt
-            : typeof parsedAny?.content_summary === "string"
-              ? parsedAny.content_summary
-              : typeof parsedAny?.excerpt_summary === "string"
-                ? parsedAny.excerpt_summary
-                : typeof parsedAny?.ocr?.detected_text === "string"
-                  ? parsedAny.ocr.detected_text
-              : "";
-
-      out.push({
-        type: "upload",
-        attachment_id: attachmentId,
-        file_name: typeof upJson?.file_name === "string" ? upJson.file_name : file.name,
-        mime_type:
-          typeof upJson?.mime_type === "string"
-            ? upJson.mime_type
-            : (file.type || "application/octet-stream"),
-        kind,
-        parsed_excerpt: excerptCandidate ? clampText(String(excerptCandidate), 1200) : undefined,
-      });
-    } catch {
-      // ignore single-file failure
-    }
-  }
+      return attachmentFromParse(uploaded, parsed.json);
+    }),
+  );
+}
 
-  return out;
+export function linkAnalysisFromGithub(url: string, json: unknown): Phase04LinkAnalysis {
+  const j = json as { results?: unknown } | null;
+  const results = Array.isArray(j?.results) ? (j?.results as any[]) : [];
+  return {
+    type: "link_analysis",
+    url,
+    provider: "github_repo_search",
+    results: results.slice(0, 5).map((x) => ({
+      name: typeof x?.name === "string" ? x.name : undefined,
+      owner: typeof x?.owner === "string" ? x.owner : undefined,
+      snippet: typeof x?.description === "string" ? x.description : undefined,
+      repository_url: typeof x?.repository_url === "string" ? x.repository_url : undefined,
+    })),
+  };
 }
 
-export async function analyzeLinks(params: {
-  base: string;
-  accessToken: string | null;
-  urls: string[];
-}): Promise<Phase04LinkAnalysis[]> {
-  const out: Phase04LinkAnalysis[] = [];
+type WebFetchJson = {
+  ok?: boolean;
+  title?: unknown;
+  final_url?: unknown;
+  summary?: unknown;
+  text_excerpt?: unknown;
+  key_points?: unknown;
+  sources?: unknown[];
+};
+
+// null when the fetch produced nothing usable (caller falls back to web_search).
+export function linkAnalysisFromFetch(url: string, fj: WebFetchJson | null): Phase04LinkAnalysis | null {
+  const fetchedSnippet = fj
+    ? typeof fj.summary === "string"
+      ? String(fj.summary)
+      : typeof fj.text_excerpt === "string"
+        ? String(fj.text_excerpt)
+        : ""
+    : "";
+  if (!fetchedSnippet || !fj) return null;
+
+  const kp = Array.isArray(fj.key_points) ? (fj.key_points as any[]) : [];
+  const title = typeof fj.title === "string" ? fj.title : "";
+  const finalUrl = typeof fj.final_url === "string" ? fj.final_url : url;
+  return {
+    type: "link_analysis",
+    url,
+    provider: "web_fetch",
+    results: [
+      {
+        title: title || undefined,
+        snippet: clampText(fetchedSnippet, 600),
+        url: finalUrl || url,
+      },
+      ...kp.slice(0, 3).map((x) => ({ snippet: clampText(String(x ?? ""), 160) })),
+    ],
+  };
+}
 
-  for (const url of params.urls.slice(0, 3)) {
-    const ghQ = githubRepoQueryFromUrl(url);
-    if (ghQ) {
-      const r = await coreJson<{ ok?: boolean; results?: unknown[] }>({
-        url: `${params.base}/io/github/repos`,
-        accessToken: params.accessToken,
-        body: { query: ghQ, max_results: 5 },
-      });
-      const results = Array.isArray(r.json?.results) ? (r.json?.results as any[]) : [];
-      out.push({
-        type: "link_analysis",
-        url,
-        provider: "github_repo_search",
-        results: results.slice(0, 5).map((x) => ({
-          name: typeof x?.name === "string" ? x.name : undefined,
-          owner: typeof x?.owner === "string" ? x.owner : undefined,
-          snippet: typeof x?.description === "string" ? x.description : undefined,
-          repository_url: typeof x?.repository_url === "string" ? x.repository_url : undefined,
-        })),
-      });
-      continue;
-    }
+export function linkAnalysisFromSearch(url: string, json: unknown, limit = 5): Phase04LinkAnalysis {
+  const j = json as { results?: unknown } | null;
+  const results = Array.isArray(j?.results) ? (j?.results as any[]) : [];
+  return {
+    type: "link_analysis",
+    url,
+    provider: "web_search",
+    results: results.slice(0, limit).map((x) => ({
+      title: typeof x?.title === "string" ? x.title : undefined,
+      snippet: typeof x?.snippet === "string" ? x.snippet : undefined,
+      url: typeof x?.url === "string" ? x.url : undefined,
+    })),
+  };
+}
 
-    // Prefer /io/web/fetch for deeper content (allowlist + summarization). Fallback to web_search.
-    const f = await coreJson<{
-      ok?: boolean;
-      title?: unknown;
-      final_url?: unknown;
-      summary?: unknown;
-      text_excerpt?: unknown;
-      key_points?: unknown;
-      sources?: unknown[];
-    }>({
-      url: `${params.base}/io/web/fetch`,
+async function analyzeLink(params: {
+  base: string;
+  accessToken: string | null;
+  url: string;
+  signal?: AbortSignal;
+}): Promise<Phase04LinkAnalysis> {
+  const { url } = params;
+  const ghQ = githubRepoQueryFromUrl(url);
+  if (ghQ) {
+    const r = await coreJson<{ ok?: boolean; results?: unknown[] }>({
+      url: `${params.base}/io/github/repos`,
       accessToken: params.accessToken,
-      body: { url, summarize: true, max_chars: 12000 },
+      body: { query: ghQ, max_results: 5 },
+      signal: params.signal,
     });
+    return linkAnalysisFromGithub(url, r.json);
+  }
 
-    const fj = f.json;
-    const fetchedSnippet =
-      f.ok && fj
-        ? typeof fj.summary === "string"
-          ? String(fj.summary)
-          : typeof fj.text_excerpt === "string"
-            ? String(fj.text_excerpt)
-            : ""
-        : "";
+  // Prefer /io/web/fetch for deeper content (allowlist + summarization). Fallback to web_search.
+  const f = await coreJson<WebFetchJson>({
+    url: `${params.base}/io/web/fetch`,
+    accessToken: params.accessToken,
+    body: { url, summarize: true, max_chars: 12000 },
+    signal: params.signal,
+  }).catch(() => null);
+  const fetched = f?.ok ? linkAnalysisFromFetch(url, f.json) : null;
+  if (fetched) return fetched;
 
-    if (fetchedSnippet && fj) {
-      const kp = Array.isArray(fj.key_points) ? (fj.key_points as any[]) : [];
-      const title = typeof fj.title === "string" ? fj.title : "";
-      const finalUrl = typeof fj.final_url === "string" ? fj.final_url : url;
-      out.push({
-        type: "link_analysis",
-        url,
-        provider: "web_fetch",
-        results: [
-          {
-            title: title || undefined,
-            snippet: clampText(fetchedSnippet, 600),
-            url: finalUrl || url,
-          },
-          ...kp.slice(0, 3).map((x) => ({ snippet: clampText(String(x ?? ""), 160) })),
-        ],
-      });
-      continue;
-    }
+  const r = await coreJson<{ ok?: boolean; results?: unknown[] }>({
+    url: `${params.base}/io/web/search`,
+    accessToken: params.accessToken,
+    body: { query: url, max_results: 5 },
+    signal: params.signal,
+  });
+  return linkAnalysisFromSearch(url, r.json);
+}
 
-    const r = await coreJson<{ ok?: boolean; results?: unknown[] }>({
-      url: `${params.base}/io/web/search`,
-      accessToken: params.accessToken,
-      body: { query: url, max_results: 5 },
-    });
-    const results = Array.isArray(r.json?.results) ? (r.json?.results as any[]) : [];
-    out.push({
-      type: "link_analysis",
-      url,
-      provider: "web_search",
-      results: results.slice(0, 5).map((x) => ({
-        title: typeof x?.title === "string" ? x.title : undefined,
-        snippet: typeof x?.snippet === "string" ? x.snippet : undefined,
-        url: typeof x?.url === "string" ? x.url : undefined,
-      })),
-    });
-  }
+export async function analyzeLinks(params: {
+  base: string;
+  accessToken: string | null;
+  urls: string[];
+  signal?: AbortSignal;
+}): Promise<Phase04LinkAnalysis[]> {
+  return settledValues(params.urls.slice(0, 3).map((url) => analyzeLink({ ...params, url })));
+}
 
-  return out;
+export function autoBrowseLimits() {
+  const maxResultsRaw = Number(process.env.SIGMARIS_AUTO_BROWSE_MAX_RESULTS ?? "5");
+  const maxResults = Number.isFinite(maxResultsRaw) ? Math.min(8, Math.max(1, maxResultsRaw)) : 5;
+  const fetchTopRaw = Number(process.env.SIGMARIS_AUTO_BROWSE_FETCH_TOP ?? "2");
+  const fetchTop = Number.isFinite(fetchTopRaw) ? Math.min(3, Math.max(0, fetchTopRaw)) : 2;
+  return { maxResults, fetchTop };
 }
 
 export async function autoBrowseFromText(params: {
   base: string;
   accessToken: string | null;
   userText: string;
+  signal?: AbortSignal;
 }): Promise<Phase04LinkAnalysis[]> {
   const intent = detectAutoBrowse(params.userText);
   if (!intent.enabled) return [];
 
-  const maxResultsRaw = Number(process.env.SIGMARIS_AUTO_BROWSE_MAX_RESULTS ?? "5");
-  const maxResults = Number.isFinite(maxResultsRaw) ? Math.min(8, Math.max(1, maxResultsRaw)) : 5;
+  const { maxResults, fetchTop } = autoBrowseLimits();
 
   const sr = await coreJson<{ ok?: boolean; results?: unknown[] }>({
     url: `${params.base}/io/web/search`,
@@ -332,6 +450,7 @@ export async function autoBrowseFromText(params: {
       safe_search: "active",
       domains: intent.domains,
     },
+    signal: params.signal,
   });
 
   const results = Array.isArray(sr.json?.results) ? (sr.json?.results as any[]) : [];
@@ -350,15 +469,17 @@ export async function autoBrowseFromText(params: {
   });
 
   // Deep fetch a couple of URLs (allowlist enforced by core)
-  const fetchTopRaw = Number(process.env.SIGMARIS_AUTO_BROWSE_FETCH_TOP ?? "2");
-  const fetchTop = Number.isFinite(fetchTopRaw) ? Math.min(3, Math.max(0, fetchTopRaw)) : 2;
-
   const urls = top
     .map((x) => (typeof x?.url === "string" ? String(x.url) : ""))
     .filter(Boolean)
     .slice(0, fetchTop);
 
-  const fetched = await analyzeLinks({ base: params.base, accessToken: params.accessToken, urls });
+  const fetched = await analyzeLinks({
+    base: params.base,
+    accessToken: params.accessToken,
+    urls,
+    signal: params.signal,
+  });
   return [...analyses, ...fetched];
 }
 
@@ -2,6 +2,7 @@ import { NextResponse } from "next/server";
 
 import type { supabaseServer } from "@/lib/supabase-server";
 import type { TouhouChatMode } from "@/lib/touhouPersona";
+import { fetchWithAffinity } from "@/lib/server/session-message/core-affinity";
 import { mergeMeta, isRecord } from "@/lib/server/session-message/meta";
 import type { PersonaIntentResponse } from "@/lib/server/session-message-v2/types";
 import {
@@ -38,7 +39,7 @@ export async function handleStreamSessionMessage(params: {
   let upstream: Response;
 
   try {
-    upstream = await fetch(`${params.base}/persona/chat/stream`, {
+    upstream = await fetchWithAffinity(params.userId, `${params.base}/persona/chat/stream`, {
       method: "POST",
       headers: {
         "Content-Type": "application/json",
@@ -0,0 +1,241 @@
+import { envFlag } from "@/lib/server/session-message/request";
+import type {
+  Phase04Attachment,
+  Phase04LinkAnalysis,
+} from "@/lib/server/session-message-v2/types";
+import {
+  analyzeLinks,
+  attachmentFromParse,
+  autoBrowseFromText,
+  autoBrowseLimits,
+  coreIoTimeoutMs,
+  coreJson,
+  detectAutoBrowse,
+  linkAnalysisFromFetch,
+  linkAnalysisFromGithub,
+  linkAnalysisFromSearch,
+  settledValues,
+  uploadAndParseFiles,
+  uploadFile,
+  type UploadedFile,
+} from "@/lib/server/session-message-v2/retrieval";
+
+/* =========================================================
+ * Turn context stage
+ * - Everything persona-core has to look at before the chat stream opens:
+ *   attachment parses, link analysis, auto browse.
+ * - Parts run concurrently under one stage deadline; a failed or late part is dropped.
+ * - /persona/turn-context batches parses + links into one core round trip.
+ *   Older cores (404/405) fall back to per-endpoint fan-out.
+ * ========================================================= */
+
+export type TurnContext = {
+  uploads: Phase04Attachment[];
+  links: Phase04LinkAnalysis[];
+  source: "batch" | "fanout";
+  elapsedMs: number;
+};
+
+type TurnContextItem = {
+  ok?: boolean;
+  url?: string;
+  attachment_id?: string;
+  provider?: string;
+  kind?: unknown;
+  parsed?: unknown;
+  response?: unknown;
+};
+
+type TurnContextJson = {
+  ok?: boolean;
+  attachments?: TurnContextItem[];
+  links?: TurnContextItem[];
+  auto_browse?: { ok?: boolean; query?: string; response?: unknown; links?: TurnContextItem[] } | null;
+  timed_out?: string[];
+};
+
+// Set once the core answers 404/405 for the batch endpoint (kept for the process lifetime).
+let batchUnsupported = false;
+
+function turnContextDeadlineMs() {
+  const raw = Number(process.env.TOUHOU_TURN_CONTEXT_DEADLINE_MS ?? "8000");
+  return Number.isFinite(raw) ? Math.max(500, Math.min(60_000, raw)) : 8000;
+}
+
+// Sent as the batch deadline_ms: the core must answer (late items as ok=false) before coreJson's
+// per-request timeout aborts the whole batch, so stay under both deadlines with some margin.
+const BATCH_DEADLINE_MARGIN_MS = 500;
+
+function batchDeadlineMs() {
+  const stage = turnContextDeadlineMs();
+  const io = coreIoTimeoutMs();
+  const cap = io > 0 ? Math.min(stage, io) : stage;
+  return Math.max(250, cap - BATCH_DEADLINE_MARGIN_MS);
+}
+
+function batchEnabled() {
+  return !batchUnsupported && envFlag("TOUHOU_TURN_CONTEXT_BATCH", true);
+}
+
+function linkFromItem(item: TurnContextItem): Phase04LinkAnalysis | null {
+  const url = typeof item.url === "string" ? item.url : "";
+  if (!item.ok || !url) return null;
+  if (item.provider === "github_repo_search") return linkAnalysisFromGithub(url, item.response);
+  if (item.provider === "web_fetch") return linkAnalysisFromFetch(url, item.response as any);
+  if (item.provider === "web_search") return linkAnalysisFromSearch(url, item.response);
+  return null;
+}
+
+async function fetchTurnContext(params: {
+  base: string;
+  accessToken: string | null;
+  body: Record<string, unknown>;
+  signal: AbortSignal;
+}): Promise<TurnContextJson | null> {
+  const r = await coreJson<TurnContextJson>({
+    url: `${params.base}/persona/turn-context`,
+    accessToken: params.accessToken,
+    body: { ...params.body, deadline_ms: batchDeadlineMs() },
+    signal: params.signal,
+  });
+  if (r.status === 404 || r.status === 405) {
+    batchUnsupported = true;
+    return null;
+  }
+  return r.ok ? r.json : null;
+}
+
+async function batchLinks(params: {
+  base: string;
+  accessToken: string | null;
+  urls: string[];
+  userText: string;
+  autoBrowse: boolean;
+  signal: AbortSignal;
+}): Promise<Phase04LinkAnalysis[] | null> {
+  let body: Record<string, unknown>;
+  if (params.urls.length > 0) {
+    body = { urls: params.urls.slice(0, 3) };
+  } else {
+    const intent = detectAutoBrowse(params.userText);
+    if (!params.autoBrowse || !intent.enabled) return [];
+    const { maxResults, fetchTop } = autoBrowseLimits();
+    body = {
+      auto_browse: {
+        query: intent.query,
+        max_results: maxResults,
+        recency_days: intent.recency_days,
+        safe_search: "active",
+        domains: intent.domains,
+        fetch_top: fetchTop,
+      },
+    };
+  }
+
+  const j = await fetchTurnContext({ ...params, body });
+  if (!j) return null;
+
+  const out: Phase04LinkAnalysis[] = [];
+  const ab = j.auto_browse;
+  if (ab && ab.ok && typeof ab.query === "string") {
+    const { maxResults } = autoBrowseLimits();
+    out.push(linkAnalysisFromSearch(`query:${ab.query}`, ab.response, maxResults));
+  }
+  for (const item of [...(j.links ?? []), ...(ab?.links ?? [])]) {
+    const a = item ? linkFromItem(item) : null;
+    if (a) out.push(a);
+  }
+  return out;
+}
+
+async function batchUploads(params: {
+  base: string;
+  accessToken: string | null;
+  files: File[];
+  signal: AbortSignal;
+}): Promise<Phase04Attachment[]> {
+  // Uploads are multipart and stay per-file (in parallel); the parses go in one batch.
+  const uploaded = await settledValues<UploadedFile>(
+    params.files.slice(0, 3).map((file) => uploadFile({ ...params, file })),
+  );
+  if (uploaded.length === 0) return [];
+
+  const j = batchEnabled()
+    ? await fetchTurnContext({
+        ...params,
+        body: { attachment_ids: uploaded.map((u) => u.attachment_id) },
+      }).catch(() => null)
+    : null;
+  if (!j) {
+    return settledValues(
+      uploaded.map(async (u) => {
+        const parsed = await coreJson<{ ok?: boolean; kind?: unknown; parsed?: unknown }>({
+          url: `${params.base}/io/parse`,
+          accessToken: params.accessToken,
+          body: { attachment_id: u.attachment_id, kind: null },
+          signal: params.signal,
+        });
+        return attachmentFromParse(u, parsed.json);
+      }),
+    );
+  }
+
+  const byId = new Map<string, TurnContextItem>();
+  for (const item of j.attachments ?? []) {
+    if (item && typeof item.attachment_id === "string") byId.set(item.attachment_id, item);
+  }
+  return uploaded.map((u) => {
+    const item = byId.get(u.attachment_id);
+    // keep the upload even when its parse missed the deadline (the core can auto-parse it later)
+    return attachmentFromParse(u, item?.ok ? item : null);
+  });
+}
+
+export async function gatherTurnContext(params: {
+  base: string;
+  accessToken: string | null;
+  files: File[];
+  urls: string[];
+  userText: string;
+  uploadsEnabled: boolean;
+  linkAnalysisEnabled: boolean;
+  autoBrowseEnabled: boolean;
+}): Promise<TurnContext> {
+  const started = Date.now();
+  const signal = AbortSignal.timeout(turnContextDeadlineMs());
+  const useBatch = batchEnabled();
+
+  const wantUploads = params.uploadsEnabled && params.files.length > 0;
+  const wantLinks = params.linkAnalysisEnabled && params.urls.length > 0;
+  const wantAutoBrowse = !wantLinks && params.autoBrowseEnabled;
+
+  const uploadsTask: Promise<Phase04Attachment[]> = !wantUploads
+    ? Promise.resolve([])
+    : useBatch
+      ? batchUploads({ ...params, signal })
+      : uploadAndParseFiles({ ...params, signal });
+
+  const linksTask: Promise<Phase04LinkAnalysis[]> = (async () => {
+    if (!wantLinks && !wantAutoBrowse) return [];
+    if (useBatch) {
+      const batched = await batchLinks({
+        ...params,
+        urls: wantLinks ? params.urls : [],
+        autoBrowse: wantAutoBrowse,
+        signal,
+      });
+      if (batched) return batched;
+    }
+    return wantLinks
+      ? analyzeLinks({ ...params, signal })
+      : autoBrowseFromText({ ...params, signal });
+  })();
+
+  const [uploads, links] = await Promise.allSettled([uploadsTask, linksTask]);
+  return {
+    uploads: uploads.status === "fulfilled" ? uploads.value : [],
+    links: links.status === "fulfilled" ? links.value : [],
+    source: useBatch && !batchUnsupported ? "batch" : "fanout",
+    elapsedMs: Date.now() - started,
+  };
+}
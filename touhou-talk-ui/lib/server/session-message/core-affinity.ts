@@ -0,0 +1,105 @@
+import { envFlag } from "@/lib/server/session-message/request";
+
+/* =========================================================
+ * Core affinity
+ * - persona-core keeps per-user state resident in the worker that served the
+ *   last turn and reports it as `x-sigmaris-instance`.
+ * - The next chat turn of the same user is pinned to that instance
+ *   (Fly.io: `fly-force-instance-id`) so the resident state stays warm.
+ * - A pinned request is retried once unpinned only when it provably never
+ *   reached core: the connection could not be opened, or the proxy answered
+ *   503 itself (core stamps `x-sigmaris-instance` on every response). Chat
+ *   POSTs are not idempotent, so a 502, a reset or a timeout after the request
+ *   was sent is returned as-is: retrying could run the turn twice.
+ * - `pins` is per Node process. On serverless or multi-instance Next
+ *   deployments each instance has its own (often empty) map, so affinity is
+ *   best-effort there; correctness never depends on it.
+ * ========================================================= */
+
+type Pin = { instance: string; at: number };
+
+// userId -> last instance (Map keeps insertion order = LRU)
+const pins = new Map<string, Pin>();
+
+function envInt(name: string, fallback: number) {
+  const raw = Number(process.env[name] ?? "");
+  return Number.isFinite(raw) && raw > 0 ? raw : fallback;
+}
+
+function affinityHeader() {
+  return String(process.env.TOUHOU_CORE_AFFINITY_HEADER ?? "").trim() || "fly-force-instance-id";
+}
+
+function pinnedInstance(userId: string): string | null {
+  if (!userId || !envFlag("TOUHOU_CORE_AFFINITY", true)) return null;
+  const pin = pins.get(userId);
+  if (!pin) return null;
+  if (Date.now() - pin.at > envInt("TOUHOU_CORE_AFFINITY_TTL_MS", 1_800_000)) {
+    pins.delete(userId);
+    return null;
+  }
+  return pin.instance;
+}
+
+function remember(userId: string, r: Response) {
+  const instance = String(r.headers.get("x-sigmaris-instance") ?? "").trim();
+  if (!userId || !instance || !r.ok) return;
+  pins.delete(userId);
+  pins.set(userId, { instance, at: Date.now() });
+  const max = envInt("TOUHOU_CORE_AFFINITY_MAX", 2000);
+  while (pins.size > max) {
+    const oldest = pins.keys().next().value;
+    if (oldest === undefined) break;
+    pins.delete(oldest);
+  }
+}
+
+// Errors raised before any byte of the request left this process.
+const CONNECT_ERROR_CODES = new Set([
+  "ECONNREFUSED",
+  "ENOTFOUND",
+  "EAI_AGAIN",
+  "EHOSTUNREACH",
+  "ENETUNREACH",
+  "UND_ERR_CONNECT_TIMEOUT",
+]);
+
+function neverSent(e: unknown): boolean {
+  const cause = (e as { cause?: { code?: unknown } } | null)?.cause;
+  return typeof cause?.code === "string" && CONNECT_ERROR_CODES.has(cause.code);
+}
+
+function rejectedByProxy(r: Response): boolean {
+  return r.status === 503 && !r.headers.get("x-sigmaris-instance");
+}
+
+/** fetch() for persona-core chat calls; `init.body` must be replayable (string). */
+export async function fetchWithAffinity(
+  userId: string,
+  url: string,
+  init: RequestInit & { headers?: Record<string, string> },
+): Promise<Response> {
+  const instance = pinnedInstance(userId);
+  if (instance) {
+    try {
+      const r = await fetch(url, {
+        ...init,
+        headers: { ...(init.headers ?? {}), [affinityHeader()]: instance },
+      });
+      if (!rejectedByProxy(r)) {
+        if (r.status === 502) pins.delete(userId);
+        else remember(userId, r);
+        return r;
+      }
+      await r.body?.cancel().catch(() => {});
+    } catch (e) {
+      pins.delete(userId);
+      if (init.signal?.aborted || !neverSent(e)) throw e;
+    }
+    pins.delete(userId);
+  }
+
+  const r = await fetch(url, init);
+  remember(userId, r);
+  return r;
+}